@@ -31,6 +31,7 @@
 #include "parser/position.hpp"
 #include "visitor.hpp"
 
+#include <atomic>
 #include <set>
 #include <memory>
 
@@ -42,22 +43,54 @@ using ptr = std::unique_ptr<T>;
 
 using symbol = std::string;
 
+/**
+ * \brief Enum of concrete node types
+ *
+ * Every concrete AST node records its kind on construction, allowing
+ * tag-based dispatch without virtual calls
+ * \see staq::ast::StaticVisitor
+ */
+enum class NodeKind {
+    VarAccess,
+    BExpr,
+    UExpr,
+    PiExpr,
+    IntExpr,
+    RealExpr,
+    VarExpr,
+    MeasureStmt,
+    ResetStmt,
+    IfStmt,
+    UGate,
+    CNOTGate,
+    BarrierGate,
+    DeclaredGate,
+    GateDecl,
+    OracleDecl,
+    RegisterDecl,
+    AncillaDecl,
+    Program
+};
+
 /**
  * \class staq::ast::ASTNode
  * \brief Base class for AST nodes
  */
 class ASTNode {
-    static int& max_uid_() {
-        static int v;
+    static std::atomic<int>& max_uid_() {
+        static std::atomic<int> v;
         return v;
-    } ///< the maximum uid that has been assigned
+    } ///< the maximum uid that has been assigned, shared across threads
 
   protected:
     const int uid_;              ///< the node's unique ID
     const parser::Position pos_; ///< the node's source code position
+    const NodeKind kind_;        ///< the node's concrete type
 
   public:
-    ASTNode(parser::Position pos) : uid_(++max_uid_()), pos_(pos) {}
+    ASTNode(parser::Position pos, NodeKind kind)
+        : uid_(max_uid_().fetch_add(1, std::memory_order_relaxed) + 1),
+          pos_(pos), kind_(kind) {}
     virtual ~ASTNode() = default;
 
     /**
@@ -74,6 +107,13 @@ class ASTNode {
      */
     parser::Position pos() const { return pos_; }
 
+    /**
+     * \brief Get the kind of the node
+     *
+     * \return The node's concrete type
+     */
+    NodeKind kind() const { return kind_; }
+
     /**
      * \brief Provides dispatch for the Visitor pattern
      */
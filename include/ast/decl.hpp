@@ -99,8 +99,8 @@ class GateDecl final : public Stmt, public Decl {
     GateDecl(parser::Position pos, symbol id, bool opaque,
              std::vector<symbol> c_params, std::vector<symbol> q_params,
              std::list<ptr<Gate>>&& body)
-        : Stmt(pos), Decl(id), opaque_(opaque), c_params_(c_params),
-          q_params_(q_params), body_(std::move(body)) {}
+        : Stmt(pos, NodeKind::GateDecl), Decl(id), opaque_(opaque),
+          c_params_(c_params), q_params_(q_params), body_(std::move(body)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -146,7 +146,8 @@ class GateDecl final : public Stmt, public Decl {
      *
      * \param f A void function taking a reference to a Gate
      */
-    void foreach_stmt(std::function<void(Gate&)> f) {
+    template <typename Fn>
+    void foreach_stmt(Fn&& f) {
         for (auto it = body_.begin(); it != body_.end(); it++)
             f(**it);
     }
@@ -224,7 +225,8 @@ class OracleDecl final : public Stmt, public Decl {
      */
     OracleDecl(parser::Position pos, symbol id, std::vector<symbol> params,
                symbol fname)
-        : Stmt(pos), Decl(id), params_(params), fname_(fname) {}
+        : Stmt(pos, NodeKind::OracleDecl), Decl(id), params_(params),
+          fname_(fname) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -281,7 +283,8 @@ class RegisterDecl final : public Stmt, public Decl {
      * \param size the size of the register
      */
     RegisterDecl(parser::Position pos, symbol id, bool quantum, int size)
-        : Stmt(pos), Decl(id), quantum_(quantum), size_(size) {}
+        : Stmt(pos, NodeKind::RegisterDecl), Decl(id), quantum_(quantum),
+          size_(size) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -334,7 +337,8 @@ class AncillaDecl final : public Gate, public Decl {
      * \param size The size of the register
      */
     AncillaDecl(parser::Position pos, symbol id, bool dirty, int size)
-        : Gate(pos), Decl(id), dirty_(dirty), size_(size) {}
+        : Gate(pos, NodeKind::AncillaDecl), Decl(id), dirty_(dirty),
+          size_(size) {}
 
     /**
      * \brief Protected heap-allocated construction
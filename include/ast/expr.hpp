@@ -98,7 +98,7 @@ inline std::ostream& operator<<(std::ostream& os, const UnaryOp& uop) {
  */
 class Expr : public ASTNode {
   public:
-    Expr(parser::Position pos) : ASTNode(pos) {}
+    Expr(parser::Position pos, NodeKind kind) : ASTNode(pos, kind) {}
     virtual ~Expr() = default;
     virtual Expr* clone() const override = 0;
 
@@ -143,7 +143,8 @@ class BExpr final : public Expr {
      * \param rexp The right sub-expression
      */
     BExpr(parser::Position pos, ptr<Expr> lexp, BinaryOp op, ptr<Expr> rexp)
-        : Expr(pos), lexp_(std::move(lexp)), op_(op), rexp_(std::move(rexp)) {}
+        : Expr(pos, NodeKind::BExpr), lexp_(std::move(lexp)), op_(op),
+          rexp_(std::move(rexp)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -251,7 +252,7 @@ class UExpr final : public Expr {
      * \param exp The sub-expression
      */
     UExpr(parser::Position pos, UnaryOp op, ptr<Expr> exp)
-        : Expr(pos), op_(op), exp_(std::move(exp)) {}
+        : Expr(pos, NodeKind::UExpr), op_(op), exp_(std::move(exp)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -339,7 +340,7 @@ class PiExpr final : public Expr {
      *
      * \param pos The source position
      */
-    PiExpr(parser::Position pos) : Expr(pos) {}
+    PiExpr(parser::Position pos) : Expr(pos, NodeKind::PiExpr) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -376,7 +377,8 @@ class IntExpr final : public Expr {
      * \param pos The source position
      * \param val The integer value
      */
-    IntExpr(parser::Position pos, int value) : Expr(pos), value_(value) {}
+    IntExpr(parser::Position pos, int value)
+        : Expr(pos, NodeKind::IntExpr), value_(value) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -420,7 +422,8 @@ class RealExpr final : public Expr {
      * \param pos The source position
      * \param val The floating point value
      */
-    RealExpr(parser::Position pos, double value) : Expr(pos), value_(value) {}
+    RealExpr(parser::Position pos, double value)
+        : Expr(pos, NodeKind::RealExpr), value_(value) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -462,7 +465,8 @@ class VarExpr final : public Expr {
      * \param pos The source position
      * \param var The variable name
      */
-    VarExpr(parser::Position pos, symbol var) : Expr(pos), var_(var) {}
+    VarExpr(parser::Position pos, symbol var)
+        : Expr(pos, NodeKind::VarExpr), var_(var) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -50,7 +50,8 @@ class Program : public ASTNode {
      * \param body The program body
      */
     Program(parser::Position pos, bool std_include, std::list<ptr<Stmt>>&& body)
-        : ASTNode(pos), std_include_(std_include), body_(std::move(body)) {}
+        : ASTNode(pos, NodeKind::Program), std_include_(std_include),
+          body_(std::move(body)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -60,6 +61,13 @@ class Program : public ASTNode {
         return std::make_unique<Program>(pos, std_include, std::move(body));
     }
 
+    /**
+     * \brief Whether the program includes the standard library
+     *
+     * \return True if qelib1.inc is included
+     */
+    bool std_include() const { return std_include_; }
+
     /**
      * \brief Get the program body
      *
@@ -72,7 +80,8 @@ class Program : public ASTNode {
      *
      * \param f Void function accepting a reference to a statement
      */
-    void foreach_stmt(std::function<void(Stmt&)> f) {
+    template <typename Fn>
+    void foreach_stmt(Fn&& f) {
         for (auto it = body_.begin(); it != body_.end(); it++)
             f(**it);
     }
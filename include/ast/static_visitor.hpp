@@ -0,0 +1,203 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file ast/static_visitor.hpp
+ * \brief Statically dispatched visitors for syntax trees
+ */
+#pragma once
+
+#include "program.hpp"
+
+namespace staq {
+namespace ast {
+
+/**
+ * \class staq::ast::StaticVisitor
+ * \brief Generic complete traversal with compile-time dispatch
+ * \see staq::ast::Traverse
+ *
+ * CRTP counterpart to staq::ast::Traverse for performance critical passes.
+ * Rather than double dispatch through ASTNode::accept, nodes are dispatched
+ * by switching on ASTNode::kind and calling the derived class' visit
+ * overloads directly, so no virtual calls are made and the visit overloads
+ * are candidates for inlining.
+ *
+ * Standard usage is to derive from StaticVisitor<Derived>, bring the default
+ * overloads into scope with a using declaration, and define only the visit
+ * overloads desired. As with Traverse, defining an overload kills traversal
+ * to the children of that node; children can be visited from the derived
+ * class with dispatch or by calling StaticVisitor::visit directly.
+ */
+template <typename Derived>
+class StaticVisitor {
+  public:
+    /**
+     * \brief Dispatches a node to the derived visitor
+     *
+     * \param node Reference to the node to visit
+     */
+    void dispatch(ASTNode& node) {
+        switch (node.kind()) {
+            case NodeKind::VarAccess:
+                return derived().visit(static_cast<VarAccess&>(node));
+            case NodeKind::BExpr:
+            case NodeKind::UExpr:
+            case NodeKind::PiExpr:
+            case NodeKind::IntExpr:
+            case NodeKind::RealExpr:
+            case NodeKind::VarExpr:
+                return dispatch(static_cast<Expr&>(node));
+            case NodeKind::Program:
+                return derived().visit(static_cast<Program&>(node));
+            default:
+                return dispatch(static_cast<Stmt&>(node));
+        }
+    }
+
+    /**
+     * \brief Dispatches an expression to the derived visitor
+     *
+     * \param expr Reference to the expression to visit
+     */
+    void dispatch(Expr& expr) {
+        switch (expr.kind()) {
+            case NodeKind::BExpr:
+                return derived().visit(static_cast<BExpr&>(expr));
+            case NodeKind::UExpr:
+                return derived().visit(static_cast<UExpr&>(expr));
+            case NodeKind::PiExpr:
+                return derived().visit(static_cast<PiExpr&>(expr));
+            case NodeKind::IntExpr:
+                return derived().visit(static_cast<IntExpr&>(expr));
+            case NodeKind::RealExpr:
+                return derived().visit(static_cast<RealExpr&>(expr));
+            case NodeKind::VarExpr:
+                return derived().visit(static_cast<VarExpr&>(expr));
+            default:
+                throw std::logic_error("Invalid expression kind");
+        }
+    }
+
+    /**
+     * \brief Dispatches a statement to the derived visitor
+     *
+     * \param stmt Reference to the statement to visit
+     */
+    void dispatch(Stmt& stmt) {
+        switch (stmt.kind()) {
+            case NodeKind::MeasureStmt:
+                return derived().visit(static_cast<MeasureStmt&>(stmt));
+            case NodeKind::ResetStmt:
+                return derived().visit(static_cast<ResetStmt&>(stmt));
+            case NodeKind::IfStmt:
+                return derived().visit(static_cast<IfStmt&>(stmt));
+            case NodeKind::GateDecl:
+                return derived().visit(static_cast<GateDecl&>(stmt));
+            case NodeKind::OracleDecl:
+                return derived().visit(static_cast<OracleDecl&>(stmt));
+            case NodeKind::RegisterDecl:
+                return derived().visit(static_cast<RegisterDecl&>(stmt));
+            default:
+                return dispatch(static_cast<Gate&>(stmt));
+        }
+    }
+
+    /**
+     * \brief Dispatches a gate to the derived visitor
+     *
+     * \param gate Reference to the gate to visit
+     */
+    void dispatch(Gate& gate) {
+        switch (gate.kind()) {
+            case NodeKind::UGate:
+                return derived().visit(static_cast<UGate&>(gate));
+            case NodeKind::CNOTGate:
+                return derived().visit(static_cast<CNOTGate&>(gate));
+            case NodeKind::BarrierGate:
+                return derived().visit(static_cast<BarrierGate&>(gate));
+            case NodeKind::DeclaredGate:
+                return derived().visit(static_cast<DeclaredGate&>(gate));
+            case NodeKind::AncillaDecl:
+                return derived().visit(static_cast<AncillaDecl&>(gate));
+            default:
+                throw std::logic_error("Invalid gate kind");
+        }
+    }
+
+    /* Default (pass-through) traversal */
+    void visit(VarAccess&) {}
+    void visit(BExpr& expr) {
+        dispatch(expr.lexp());
+        dispatch(expr.rexp());
+    }
+    void visit(UExpr& expr) { dispatch(expr.subexp()); }
+    void visit(PiExpr&) {}
+    void visit(IntExpr&) {}
+    void visit(RealExpr&) {}
+    void visit(VarExpr&) {}
+    void visit(MeasureStmt& stmt) {
+        derived().visit(stmt.q_arg());
+        derived().visit(stmt.c_arg());
+    }
+    void visit(ResetStmt& stmt) { derived().visit(stmt.arg()); }
+    void visit(IfStmt& stmt) { dispatch(stmt.then()); }
+    void visit(UGate& gate) {
+        dispatch(gate.theta());
+        dispatch(gate.phi());
+        dispatch(gate.lambda());
+        derived().visit(gate.arg());
+    }
+    void visit(CNOTGate& gate) {
+        derived().visit(gate.ctrl());
+        derived().visit(gate.tgt());
+    }
+    void visit(BarrierGate& gate) {
+        for (int i = 0; i < gate.num_args(); i++)
+            derived().visit(gate.arg(i));
+    }
+    void visit(DeclaredGate& gate) {
+        for (int i = 0; i < gate.num_cargs(); i++)
+            dispatch(gate.carg(i));
+        for (int i = 0; i < gate.num_qargs(); i++)
+            derived().visit(gate.qarg(i));
+    }
+    void visit(GateDecl& decl) {
+        for (auto it = decl.begin(); it != decl.end(); it++)
+            dispatch(**it);
+    }
+    void visit(OracleDecl&) {}
+    void visit(RegisterDecl&) {}
+    void visit(AncillaDecl&) {}
+    void visit(Program& prog) {
+        for (auto it = prog.begin(); it != prog.end(); it++)
+            dispatch(**it);
+    }
+
+  private:
+    Derived& derived() { return static_cast<Derived&>(*this); }
+};
+
+} // namespace ast
+} // namespace staq
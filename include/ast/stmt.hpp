@@ -44,7 +44,7 @@ namespace ast {
  */
 class Stmt : public ASTNode {
   public:
-    Stmt(parser::Position pos) : ASTNode(pos) {}
+    Stmt(parser::Position pos, NodeKind kind) : ASTNode(pos, kind) {}
     virtual ~Stmt() = default;
     virtual Stmt* clone() const override = 0;
 
@@ -80,7 +80,8 @@ class MeasureStmt final : public Stmt {
      * \param c_arg Rvalue reference to the classical argument
      */
     MeasureStmt(parser::Position pos, VarAccess&& q_arg, VarAccess&& c_arg)
-        : Stmt(pos), q_arg_(std::move(q_arg)), c_arg_(std::move(c_arg)) {}
+        : Stmt(pos, NodeKind::MeasureStmt), q_arg_(std::move(q_arg)),
+          c_arg_(std::move(c_arg)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -145,7 +146,7 @@ class ResetStmt final : public Stmt {
      * \param arg Rvalue reference to the argument
      */
     ResetStmt(parser::Position pos, VarAccess&& arg)
-        : Stmt(pos), arg_(std::move(arg)) {}
+        : Stmt(pos, NodeKind::ResetStmt), arg_(std::move(arg)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -198,7 +199,8 @@ class IfStmt final : public Stmt {
      * \param then The statement to execute in the then branch
      */
     IfStmt(parser::Position pos, symbol var, int cond, ptr<Stmt> then)
-        : Stmt(pos), var_(var), cond_(cond), then_(std::move(then)) {}
+        : Stmt(pos, NodeKind::IfStmt), var_(var), cond_(cond),
+          then_(std::move(then)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -252,7 +254,7 @@ class IfStmt final : public Stmt {
  */
 class Gate : public Stmt {
   public:
-    Gate(parser::Position pos) : Stmt(pos) {}
+    Gate(parser::Position pos, NodeKind kind) : Stmt(pos, kind) {}
     virtual ~Gate() = default;
     virtual Gate* clone() const = 0;
 };
@@ -281,8 +283,9 @@ class UGate final : public Gate {
      */
     UGate(parser::Position pos, ptr<Expr> theta, ptr<Expr> phi,
           ptr<Expr> lambda, VarAccess&& arg)
-        : Gate(pos), theta_(std::move(theta)), phi_(std::move(phi)),
-          lambda_(std::move(lambda)), arg_(std::move(arg)) {}
+        : Gate(pos, NodeKind::UGate), theta_(std::move(theta)),
+          phi_(std::move(phi)), lambda_(std::move(lambda)),
+          arg_(std::move(arg)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -380,7 +383,8 @@ class CNOTGate final : public Gate {
      * \param tgt Rvalue reference to the target argument
      */
     CNOTGate(parser::Position pos, VarAccess&& ctrl, VarAccess&& tgt)
-        : Gate(pos), ctrl_(std::move(ctrl)), tgt_(std::move(tgt)) {}
+        : Gate(pos, NodeKind::CNOTGate), ctrl_(std::move(ctrl)),
+          tgt_(std::move(tgt)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -444,7 +448,7 @@ class BarrierGate final : public Gate {
      * \param args Rvalue reference to a list of arguments
      */
     BarrierGate(parser::Position pos, std::vector<VarAccess>&& args)
-        : Gate(pos), args_(std::move(args)) {}
+        : Gate(pos, NodeKind::BarrierGate), args_(std::move(args)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -481,7 +485,8 @@ class BarrierGate final : public Gate {
      *
      * \param f Void function accepting a reference to the argument
      */
-    void foreach_arg(std::function<void(VarAccess&)> f) {
+    template <typename Fn>
+    void foreach_arg(Fn&& f) {
         for (auto it = args_.begin(); it != args_.end(); it++)
             f(*it);
     }
@@ -530,8 +535,8 @@ class DeclaredGate final : public Gate {
     DeclaredGate(parser::Position pos, symbol name,
                  std::vector<ptr<Expr>>&& c_args,
                  std::vector<VarAccess>&& q_args)
-        : Gate(pos), name_(name), c_args_(std::move(c_args)),
-          q_args_(std::move(q_args)) {}
+        : Gate(pos, NodeKind::DeclaredGate), name_(name),
+          c_args_(std::move(c_args)), q_args_(std::move(q_args)) {}
 
     /**
      * \brief Protected heap-allocated construction
@@ -592,7 +597,8 @@ class DeclaredGate final : public Gate {
      *
      * \param f Void function accepting an expression reference
      */
-    void foreach_carg(std::function<void(Expr&)> f) {
+    template <typename Fn>
+    void foreach_carg(Fn&& f) {
         for (auto it = c_args_.begin(); it != c_args_.end(); it++)
             f(**it);
     }
@@ -602,7 +608,8 @@ class DeclaredGate final : public Gate {
      *
      * \param f Void function accepting a reference to an argument
      */
-    void foreach_qarg(std::function<void(VarAccess&)> f) {
+    template <typename Fn>
+    void foreach_qarg(Fn&& f) {
         for (auto it = q_args_.begin(); it != q_args_.end(); it++)
             f(*it);
     }
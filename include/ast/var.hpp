@@ -64,13 +64,14 @@ class VarAccess final : public ASTNode {
      */
     VarAccess(parser::Position pos, symbol var,
               std::optional<int> offset = std::nullopt)
-        : ASTNode(pos), var_(var), offset_(offset) {}
+        : ASTNode(pos, NodeKind::VarAccess), var_(var), offset_(offset) {}
 
     /**
      * \brief Copy constructor
      */
     VarAccess(const VarAccess& va)
-        : ASTNode(va.pos_), var_(va.var_), offset_(va.offset_) {}
+        : ASTNode(va.pos_, NodeKind::VarAccess), var_(va.var_),
+          offset_(va.offset_) {}
 
     /**
      * \brief Get the register name
@@ -509,6 +509,26 @@ struct ChannelRepr {
         }
         /**@}*/
 
+        /** @name Accessors */
+        /**@{*/
+        /**
+         * \brief Apply a function to each generator mapping
+         *
+         * \tparam Fn The type of the function to be applied. Must be
+         *            invocable on a single-qubit Pauli and a Pauli
+         * \param fn The function to be applied to each mapping
+         */
+        template <typename Fn>
+        void foreach (Fn&& fn) const {
+            static_assert(
+                std::is_invocable_r_v<void, Fn,
+                                      std::pair<qarg, PauliOp> const&,
+                                      Pauli const&>);
+            for (auto& [pauli_in, pauli_out] : perm_)
+                fn(pauli_in, pauli_out);
+        }
+        /**@}*/
+
         /** @name Printing */
         /**@{*/
         /** \brief Pretty printer */
@@ -629,6 +649,8 @@ struct ChannelRepr {
         /**@{*/
         /** \brief Get the angle of rotation */
         utils::Angle rotation_angle() { return theta_; }
+        /** \brief Get the Pauli rotated on */
+        const Pauli& pauli() const { return pauli_; }
         /**@}*/
 
         /** @name Operators */
@@ -31,15 +31,22 @@
 
 #include "ast/var.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include <unordered_map>
 #include <list>
 #include <set>
 
 #include <functional>
+#include <limits>
+#include <memory>
 #include <queue>
 
 #include <iostream>
+#include <string>
 
 namespace staq {
 namespace mapping {
@@ -47,8 +54,6 @@ namespace mapping {
 using layout = std::unordered_map<ast::VarAccess, int>;
 using path = std::list<int>;
 using coupling = std::pair<int, int>;
-using cmp_couplings = std::function<bool(std::pair<coupling, double>,
-                                         std::pair<coupling, double>)>;
 using spanning_tree = std::list<std::pair<int, int>>;
 
 /**
@@ -65,9 +70,26 @@ using spanning_tree = std::list<std::pair<int, int>>;
  * The device class also allows computation of shortest paths between vertices
  * and [Steiner trees](https://en.wikipedia.org/wiki/Steiner_tree_problem) for
  * solving mapping problems.
+ *
+ * Devices are immutable once constructed, so one device can be shared by
+ * any number of layouts & mappers, including concurrently.
  */
 class Device {
   public:
+    /**
+     * \brief All-pairs shortest path tables
+     *
+     * Immutable once published, so copies of a device share them
+     */
+    struct path_tables {
+        std::vector<std::vector<double>>
+            dist; ///< Distances returned by Floyd-Warshall
+        std::vector<std::vector<int>>
+            next; ///< Next hops returned by Floyd-Warshall
+        std::vector<std::vector<int>>
+            hops; ///< Number of hops along each path, or -1
+    };
+
     /** @name Constructors */
     /**@{*/
     /** \brief Empty constructor */
@@ -89,6 +111,7 @@ class Device {
                 coupling_fidelities_[i][j] = 0.99;
             }
         }
+        sort_couplings();
     }
     /**
      * \brief Construct a device from a coupling graph
@@ -98,16 +121,36 @@ class Device {
      * \param sq_fi A vector of average single-qubit gate fidelities for each
      * qubit \param tq_fi A matrix of average two-qubit gate fidelities for each
      * directed pair
+     * \param sq_time Durations of single-qubit gates at each qubit, if known
+     * \param tq_time Durations of two-qubit gates at each directed pair, if
+     * known
      */
     Device(std::string name, int n, const std::vector<std::vector<bool>>& dag,
            const std::vector<double>& sq_fi,
-           const std::vector<std::vector<double>>& tq_fi)
+           const std::vector<std::vector<double>>& tq_fi,
+           std::vector<double> sq_time = {},
+           std::vector<std::vector<double>> tq_time = {})
         : name_(name), qubits_(n), couplings_(dag),
-          single_qubit_fidelities_(sq_fi), coupling_fidelities_(tq_fi) {}
+          single_qubit_fidelities_(sq_fi), coupling_fidelities_(tq_fi),
+          single_qubit_durations_(std::move(sq_time)),
+          coupling_durations_(std::move(tq_time)) {
+        sort_couplings();
+    }
+    /**
+     * \brief Construct a copy of a device with precomputed path tables
+     * \param dev The device
+     * \param paths The shortest path tables of dev, see read_paths
+     */
+    Device(const Device& dev, std::shared_ptr<const path_tables> paths)
+        : Device(dev) {
+        paths_ = std::move(paths);
+    }
     /**@}*/
 
-    std::string name_;
-    int qubits_;
+    /** \brief The name of the device */
+    const std::string& name() const { return name_; }
+    /** \brief The number of qubits of the device */
+    int qubits() const { return qubits_; }
 
     /**
      * \brief Whether the device allows a CNOT between two qubits
@@ -115,7 +158,7 @@ class Device {
      * \param j The target qubit
      * \return True if the device admits a CNOT between qubits i and j
      */
-    bool coupled(int i, int j) {
+    bool coupled(int i, int j) const {
         if (0 <= i && i < qubits_ && 0 <= j && j < qubits_)
             return couplings_[i][j];
         else
@@ -127,7 +170,7 @@ class Device {
      * \param i The qubit
      * \return The fidelity as a double precision float
      */
-    double sq_fidelity(int i) {
+    double sq_fidelity(int i) const {
         if (0 <= i && i < qubits_)
             return single_qubit_fidelities_[i];
         else
@@ -139,13 +182,36 @@ class Device {
      * \param j The target qubit
      * \return The fidelity as a double precision float
      */
-    double tq_fidelity(int i, int j) {
+    double tq_fidelity(int i, int j) const {
         if (coupled(i, j))
             return coupling_fidelities_[i][j];
         else
             throw std::logic_error("Qubit not coupled");
     }
 
+    /**
+     * \brief Get the duration of single-qubit gates at a qubit
+     * \param i The qubit
+     * \return The duration, or 0 if the device does not specify one
+     */
+    double sq_duration(int i) const {
+        if (0 <= i && i < static_cast<int>(single_qubit_durations_.size()))
+            return single_qubit_durations_[i];
+        return 0;
+    }
+    /**
+     * \brief Get the duration of two-qubit gates at a coupling
+     * \param i The control qubit
+     * \param j The target qubit
+     * \return The duration, or 0 if the device does not specify one
+     */
+    double tq_duration(int i, int j) const {
+        if (0 <= i && i < static_cast<int>(coupling_durations_.size()) &&
+            0 <= j && j < static_cast<int>(coupling_durations_[i].size()))
+            return coupling_durations_[i][j];
+        return 0;
+    }
+
     /**
      * \brief Get a shortest path between two qubits
      *
@@ -155,16 +221,16 @@ class Device {
      * \param j The target qubit
      * \return A shortest (or highest fidelity) path between qubits i and j
      */
-    path shortest_path(int i, int j) {
-        compute_shortest_paths();
+    path shortest_path(int i, int j) const {
+        const auto& next = tables().next;
         path ret{i};
 
-        if (shortest_paths[i][j] == qubits_) {
+        if (next[i][j] == qubits_) {
             return ret;
         }
 
         while (i != j) {
-            i = shortest_paths[i][j];
+            i = next[i][j];
             ret.push_back(i);
         }
 
@@ -177,50 +243,110 @@ class Device {
      * \param j The target qubit
      * \return The length of a shortest path between qubits i and j
      */
-    int distance(int i, int j) {
-        compute_shortest_paths();
+    int distance(int i, int j) const { return tables().hops[i][j]; }
 
-        if (shortest_paths[i][j] == qubits_) {
-            return -1;
-        }
+    /**
+     * \brief Get the qubits coupled to a qubit in either direction
+     * \param i The qubit
+     * \return The neighbouring qubits, in increasing order
+     */
+    const std::vector<int>& neighbours(int i) const { return neighbours_[i]; }
 
-        int ret = 0;
-        while (i != j) {
-            i = shortest_paths[i][j];
-            ++ret;
+    /**
+     * \brief Get the number of couplings between each pair of qubits
+     *
+     * Unlike distance, ignores fidelities & the direction of couplings.
+     * Computed by breadth-first search on first use
+     *
+     * \return The table in row-major order, with the number of qubits for
+     * disconnected pairs
+     */
+    const std::vector<int>& hop_distances() const {
+        auto ret = std::atomic_load(&hop_distances_);
+        if (!ret) {
+            auto computed = compute_hop_distances();
+            std::shared_ptr<const std::vector<int>> expected;
+            std::atomic_compare_exchange_strong(&hop_distances_, &expected,
+                                                computed);
+            ret = std::atomic_load(&hop_distances_);
         }
-
-        return ret;
+        return *ret;
     }
 
     /**
-     * \brief Get a list of all edges in the coupling digraph
-     * \note Couplings are ordered in decreasing fidelity.
-     * \return A set of (coupling, fidelity) pairs
+     * \brief Writes the all-pairs shortest path tables in binary form
+     *
+     * Computes the tables first if necessary. Used to cache the tables of
+     * large devices between runs
      */
-    std::set<std::pair<coupling, double>, cmp_couplings> couplings() {
-        // Sort in order of decreasing coupling fidelity
-        cmp_couplings cmp = [](std::pair<coupling, double> a,
-                               std::pair<coupling, double> b) {
-            if (a.second == b.second)
-                return a.first < b.first;
-            else
-                return a.second > b.second;
-        };
-
-        std::set<std::pair<coupling, double>, cmp_couplings> ret(cmp);
+    void write_paths(std::ostream& os) const {
+        const auto& t = tables();
         for (auto i = 0; i < qubits_; i++) {
-            for (auto j = 0; j < qubits_; j++) {
-                if (couplings_[i][j]) {
-                    ret.insert(std::make_pair(std::make_pair(i, j),
-                                              coupling_fidelities_[i][j]));
-                }
+            os.write(reinterpret_cast<const char*>(t.dist[i].data()),
+                     sizeof(double) * qubits_);
+            os.write(reinterpret_cast<const char*>(t.next[i].data()),
+                     sizeof(int) * qubits_);
+        }
+    }
+
+    /**
+     * \brief Reads all-pairs shortest path tables written by write_paths
+     *
+     * The tables are passed to the device on construction
+     *
+     * \param is The input stream
+     * \param n The number of qubits of the device
+     * \return The tables, or null if the stream ended early or the tables
+     * are invalid, that is if a next hop is out of range, a path doesn't
+     * terminate, or a distance is negative, not a number, or infinite for
+     * other than disconnected qubits
+     */
+    static std::shared_ptr<const path_tables> read_paths(std::istream& is,
+                                                         int n) {
+        auto t = std::make_shared<path_tables>();
+        t->dist.assign(n, std::vector<double>(n));
+        t->next.assign(n, std::vector<int>(n));
+        for (auto i = 0; i < n; i++) {
+            is.read(reinterpret_cast<char*>(t->dist[i].data()),
+                    sizeof(double) * n);
+            is.read(reinterpret_cast<char*>(t->next[i].data()),
+                    sizeof(int) * n);
+        }
+        if (!is)
+            return nullptr;
+        for (auto i = 0; i < n; i++) {
+            for (auto j = 0; j < n; j++) {
+                auto dist = t->dist[i][j];
+                auto disconnected = t->next[i][j] == n;
+                if (std::isnan(dist) || dist < 0 ||
+                    std::isinf(dist) != disconnected || t->next[i][j] < 0 ||
+                    t->next[i][j] > n)
+                    return nullptr;
             }
         }
 
-        return ret;
+        if (!compute_hops(*t, n))
+            return nullptr;
+        return t;
+    }
+
+    /**
+     * \brief Get a list of all edges in the coupling digraph
+     * \note Couplings are ordered in decreasing fidelity.
+     * \return A vector of (coupling, fidelity) pairs
+     */
+    const std::vector<std::pair<coupling, double>>& couplings() const {
+        return sorted_couplings_;
     }
 
+    /**
+     * \brief Hash of the size, couplings & coupling fidelities
+     *
+     * Identifies the device for results which depend on its topology, such
+     * as cached synthesized circuits
+     */
+    uint64_t fingerprint() const { return fingerprint_; }
+
     /**
      * \brief Get an approximation to a minimal Steiner tree
      *
@@ -232,147 +358,281 @@ class Device {
      * \param root A root for the Steiner tree
      * \return A spanning tree represented as a list of edges
      */
-    spanning_tree steiner(std::list<int> terminals, int root) {
-        compute_shortest_paths();
-
-        spanning_tree ret;
-
-        // Internal data structures
-        std::vector<double> vertex_cost(qubits_);
-        std::vector<int> edge_in(qubits_);
-        std::set<int> in_tree{root};
-
-        auto min_node = terminals.end();
-        for (auto it = terminals.begin(); it != terminals.end(); it++) {
-            vertex_cost[*it] = dist[root][*it];
-            edge_in[*it] = root;
-            if (min_node == terminals.end() ||
-                (vertex_cost[*it] < vertex_cost[*min_node])) {
-                min_node = it;
+    spanning_tree steiner(std::list<int> terminals, int root) const {
+        std::vector<coupling> tree;
+        steiner(std::vector<int>(terminals.begin(), terminals.end()), root,
+                tree);
+        return spanning_tree(tree.begin(), tree.end());
+    }
+
+    /**
+     * \brief Get an approximation to a minimal Steiner tree
+     *
+     * Allocation-free variant of the above, writing the edges of the tree
+     * into a caller-owned buffer
+     *
+     * \param terms The terminal qubits to be connected
+     * \param root A root for the Steiner tree
+     * \param ret Buffer receiving the edges of the tree, in topological order
+     */
+    void steiner(const std::vector<int>& terms, int root,
+                 std::vector<coupling>& ret) const {
+        const auto& dist = tables().dist;
+        const auto& shortest_paths = tables().next;
+
+        ret.clear();
+
+        // Scratch buffers are reused across calls, since gray-steiner calls
+        // this once per parity term
+        thread_local steiner_scratch scratch;
+        auto& [vertex_cost, edge_in, in_tree, terminals, new_nodes, path] =
+            scratch;
+        vertex_cost.resize(qubits_);
+        edge_in.resize(qubits_);
+        in_tree.assign(qubits_, false);
+        terminals.assign(terms.begin(), terms.end());
+        in_tree[root] = true;
+
+        int min_node = -1;
+        for (auto i = 0; i < static_cast<int>(terminals.size()); i++) {
+            auto t = terminals[i];
+            vertex_cost[t] = dist[root][t];
+            edge_in[t] = root;
+            if (min_node == -1 ||
+                (vertex_cost[t] < vertex_cost[terminals[min_node]])) {
+                min_node = i;
             }
         }
 
         // Algorithm proper
-        while (min_node != terminals.end()) {
-            auto current = *min_node;
-            terminals.erase(min_node);
-            auto new_nodes = add_to_tree(
-                ret, shortest_path(edge_in[current], current), in_tree);
-            in_tree.insert(new_nodes.begin(), new_nodes.end());
+        while (min_node != -1) {
+            auto current = terminals[min_node];
+            terminals.erase(terminals.begin() + min_node);
+
+            // Walk the shortest path back from current until it meets the
+            // tree, then append its edges in topological order
+            path.clear();
+            for (auto i = edge_in[current]; ; i = shortest_paths[i][current]) {
+                path.push_back(i);
+                if (i == current || shortest_paths[i][current] == qubits_)
+                    break;
+            }
+            auto join = path.size() - 1;
+            while (join > 0 && !in_tree[path[join]])
+                --join;
+            for (auto i = join; i + 1 < path.size(); i++)
+                ret.emplace_back(path[i], path[i + 1]);
+
+            new_nodes.assign(path.begin() + join, path.end());
+            std::sort(new_nodes.begin(), new_nodes.end());
+            for (auto node : new_nodes)
+                in_tree[node] = true;
 
             // Update costs, edges, and find new minimum edge
-            min_node = terminals.end();
-            for (auto it = terminals.begin(); it != terminals.end(); it++) {
+            min_node = -1;
+            for (auto i = 0; i < static_cast<int>(terminals.size()); i++) {
+                auto t = terminals[i];
                 for (auto node : new_nodes) {
-                    if (dist[node][*it] < vertex_cost[*it]) {
-                        vertex_cost[*it] = dist[node][*it];
-                        edge_in[*it] = node;
+                    if (dist[node][t] < vertex_cost[t]) {
+                        vertex_cost[t] = dist[node][t];
+                        edge_in[t] = node;
                     }
                 }
-                if (min_node == terminals.end() ||
-                    (vertex_cost[*it] < vertex_cost[*min_node])) {
-                    min_node = it;
+                if (min_node == -1 ||
+                    (vertex_cost[t] < vertex_cost[terminals[min_node]])) {
+                    min_node = i;
                 }
             }
         }
-
-        return ret;
     }
 
   private:
+    std::string name_; ///< The name of the device
+    int qubits_ = 0;   ///< The number of qubits
     std::vector<std::vector<bool>>
         couplings_; ///< The adjacency matrix of the device topology
     std::vector<double>
         single_qubit_fidelities_; ///< The fidelities of single-qubit gates
     std::vector<std::vector<double>>
         coupling_fidelities_; ///< The fidelities of two-qubit gates
+    std::vector<double>
+        single_qubit_durations_; ///< The durations of single-qubit gates
+    std::vector<std::vector<double>>
+        coupling_durations_; ///< The durations of two-qubit gates
+
+    std::vector<std::pair<coupling, double>>
+        sorted_couplings_; ///< Couplings in order of decreasing fidelity
+    std::vector<std::vector<int>>
+        neighbours_; ///< Qubits coupled to each qubit in either direction
+    uint64_t fingerprint_ = 0; ///< Hash of the couplings, see fingerprint()
 
     /** @name All-pairs-shortest-paths */
     /**@{*/
-    std::vector<std::vector<double>>
-        dist; ///< Distances returned by Floyd-Warshall
-    std::vector<std::vector<int>>
-        shortest_paths; ///< Matrix return by Floyd-Warshall
+    /**
+     * \brief Shortest path tables, computed on first use unless given on
+     * construction
+     *
+     * Published atomically, so concurrent readers need no locking
+     */
+    mutable std::shared_ptr<const path_tables> paths_;
+    /** \brief Breadth-first hop distances, computed on first use */
+    mutable std::shared_ptr<const std::vector<int>> hop_distances_;
     /**@}*/
 
+    /** \brief Reusable working storage for Steiner tree construction */
+    struct steiner_scratch {
+        std::vector<double> vertex_cost;
+        std::vector<int> edge_in;
+        std::vector<bool> in_tree;
+        std::vector<int> terminals;
+        std::vector<int> new_nodes;
+        std::vector<int> path;
+    };
+
+    void sort_couplings() {
+        sorted_couplings_.clear();
+        neighbours_.assign(qubits_, {});
+        for (auto i = 0; i < qubits_; i++) {
+            for (auto j = 0; j < qubits_; j++) {
+                if (couplings_[i][j]) {
+                    sorted_couplings_.emplace_back(std::make_pair(i, j),
+                                                   coupling_fidelities_[i][j]);
+                }
+                if (i != j && (couplings_[i][j] || couplings_[j][i]))
+                    neighbours_[i].push_back(j);
+            }
+        }
+
+        // Sort in order of decreasing coupling fidelity
+        std::stable_sort(sorted_couplings_.begin(), sorted_couplings_.end(),
+                         [](const auto& a, const auto& b) {
+                             return a.second > b.second;
+                         });
+
+        // FNV-1a over the size & couplings
+        fingerprint_ = 14695981039346656037ull;
+        auto mix = [this](uint64_t word) {
+            for (auto i = 0; i < 8; i++, word >>= 8) {
+                fingerprint_ ^= word & 0xff;
+                fingerprint_ *= 1099511628211ull;
+            }
+        };
+        mix(qubits_);
+        for (auto& [c, f] : sorted_couplings_) {
+            uint64_t bits;
+            std::memcpy(&bits, &f, sizeof(bits));
+            mix(c.first);
+            mix(c.second);
+            mix(bits);
+        }
+    }
+
+    /** \brief The shortest path tables, computing them if necessary */
+    const path_tables& tables() const {
+        auto ret = std::atomic_load(&paths_);
+        if (!ret) {
+            // Racing threads may both compute the tables, but only the first
+            // result is published
+            auto computed = compute_shortest_paths();
+            std::shared_ptr<const path_tables> expected;
+            std::atomic_compare_exchange_strong(&paths_, &expected, computed);
+            ret = std::atomic_load(&paths_);
+        }
+        return *ret;
+    }
+
     /**
-     * \brief Floyd-Warshall all-pairs-shortest-paths algorithm
-     * \note Assigns result to dist and shortest_paths
+     * \brief Fills in the hop counts from the next hop table
+     * \return False if a path leaves the device or doesn't reach its end
+     * within as many hops as there are qubits
      */
-    void compute_shortest_paths() {
-        if (dist.empty() || shortest_paths.empty()) {
-            // Initialize
-            dist = std::vector<std::vector<double>>(
-                qubits_, std::vector<double>(qubits_));
-            shortest_paths = std::vector<std::vector<int>>(
-                qubits_, std::vector<int>(qubits_));
-
-            // All-pairs shortest paths
-            for (auto i = 0; i < qubits_; i++) {
-                for (auto j = 0; j < qubits_; j++) {
-                    if (i == j) {
-                        dist[i][j] = 0;
-                        shortest_paths[i][j] = j;
-                    } else if (couplings_[i][j]) {
-                        dist[i][j] = 1.0 - coupling_fidelities_[i][j];
-                        shortest_paths[i][j] = j;
-                    } else if (couplings_[j][i]) { // Since swaps are the same
-                                                   // cost either direction
-                        dist[i][j] = 1.0 - coupling_fidelities_[j][i];
-                        shortest_paths[i][j] = j;
-                    } else {
-                        dist[i][j] = 10.0; // Effectively infinite
-                        shortest_paths[i][j] = qubits_;
-                    }
+    static bool compute_hops(path_tables& t, int n) {
+        t.hops.assign(n, std::vector<int>(n, -1));
+        for (auto i = 0; i < n; i++) {
+            for (auto j = 0; j < n; j++) {
+                if (t.next[i][j] == n)
+                    continue;
+                int count = 0;
+                for (auto k = i; k != j; k = t.next[k][j]) {
+                    if (k == n || ++count > n)
+                        return false;
                 }
+                t.hops[i][j] = count;
             }
+        }
+        return true;
+    }
 
-            for (auto k = 0; k < qubits_; k++) {
-                for (auto i = 0; i < qubits_; i++) {
-                    for (auto j = 0; j < qubits_; j++) {
-                        if (dist[i][j] > (dist[i][k] + dist[k][j])) {
-                            dist[i][j] = dist[i][k] + dist[k][j];
-                            shortest_paths[i][j] = shortest_paths[i][k];
-                        }
+    /** \brief Breadth-first search from each qubit */
+    std::shared_ptr<const std::vector<int>> compute_hop_distances() const {
+        auto n = qubits_;
+        auto ret = std::make_shared<std::vector<int>>(
+            static_cast<std::size_t>(n) * n, n);
+        std::vector<int> queue(n);
+        for (auto i = 0; i < n; i++) {
+            auto* row = &(*ret)[static_cast<std::size_t>(i) * n];
+            row[i] = 0;
+            queue[0] = i;
+            for (int head = 0, tail = 1; head < tail; head++) {
+                auto u = queue[head];
+                for (auto v : neighbours_[u]) {
+                    if (row[v] == n) {
+                        row[v] = row[u] + 1;
+                        queue[tail++] = v;
                     }
                 }
             }
         }
+        return ret;
     }
 
     /**
-     * \brief Adds a path to a spanning tree
-     *
-     * Inserts a path into a spanning tree so that edges are not duplicated, and
-     * moreover maintains the spanning tree property & the topological order on
-     * the tree
-     *
-     * \param s_tree The input spanning tree
-     * \param p Const reference to the path to be inserted
-     * \param in_tree The set of nodes already in the tree
-     * \return The set of nodes in the resulting spanning tree
+     * \brief Floyd-Warshall all-pairs-shortest-paths algorithm
      */
-    std::set<int> add_to_tree(spanning_tree& s_tree, const path& p,
-                              const std::set<int>& in_tree) {
-        std::set<int> ret;
-
-        int next = -1;
-        auto insert_iter = s_tree.end();
-        for (auto it = p.rbegin(); it != p.rend(); it++) {
-            // If we're not at the endpoint, insert the edge
-            if (next != -1) {
-                s_tree.insert(insert_iter, std::make_pair(*it, next));
-                --insert_iter;
+    std::shared_ptr<const path_tables> compute_shortest_paths() const {
+        auto t = std::make_shared<path_tables>();
+        auto& dist = t->dist;
+        auto& shortest_paths = t->next;
+
+        // Initialize
+        dist = std::vector<std::vector<double>>(qubits_,
+                                                std::vector<double>(qubits_));
+        shortest_paths =
+            std::vector<std::vector<int>>(qubits_, std::vector<int>(qubits_));
+
+        // All-pairs shortest paths
+        for (auto i = 0; i < qubits_; i++) {
+            for (auto j = 0; j < qubits_; j++) {
+                if (i == j) {
+                    dist[i][j] = 0;
+                    shortest_paths[i][j] = j;
+                } else if (couplings_[i][j]) {
+                    dist[i][j] = 1.0 - coupling_fidelities_[i][j];
+                    shortest_paths[i][j] = j;
+                } else if (couplings_[j][i]) { // Since swaps are the same
+                                               // cost either direction
+                    dist[i][j] = 1.0 - coupling_fidelities_[j][i];
+                    shortest_paths[i][j] = j;
+                } else {
+                    dist[i][j] = std::numeric_limits<double>::infinity();
+                    shortest_paths[i][j] = qubits_;
+                }
             }
-            next = *it;
-            ret.insert(*it);
+        }
 
-            // If the current node is already in the tree, we're done
-            if (in_tree.find(*it) != in_tree.end())
-                break;
+        for (auto k = 0; k < qubits_; k++) {
+            for (auto i = 0; i < qubits_; i++) {
+                for (auto j = 0; j < qubits_; j++) {
+                    if (dist[i][j] > (dist[i][k] + dist[k][j])) {
+                        dist[i][j] = dist[i][k] + dist[k][j];
+                        shortest_paths[i][j] = shortest_paths[i][k];
+                    }
+                }
+            }
         }
 
-        return ret;
+        compute_hops(*t, qubits_);
+        return t;
     }
 };
 
@@ -553,5 +813,62 @@ inline Device fully_connected(uint32_t n) {
         std::vector<std::vector<bool>>(n, std::vector<bool>(n, true)));
 }
 
+/**
+ * \brief Generates a rows x cols square lattice
+ *
+ * Qubit (r, c) has index r * cols + c and is coupled in both directions to
+ * its horizontal and vertical neighbours
+ */
+inline Device grid(int rows, int cols) {
+    auto n = rows * cols;
+    std::vector<std::vector<bool>> dag(n, std::vector<bool>(n, false));
+    for (auto r = 0; r < rows; r++) {
+        for (auto c = 0; c < cols; c++) {
+            auto i = r * cols + c;
+            if (c + 1 < cols)
+                dag[i][i + 1] = dag[i + 1][i] = true;
+            if (r + 1 < rows)
+                dag[i][i + cols] = dag[i + cols][i] = true;
+        }
+    }
+    return Device(std::to_string(rows) + "x" + std::to_string(cols) +
+                      " square lattice",
+                  n, dag);
+}
+
+/**
+ * \brief Generates a heavy-hex lattice
+ *
+ * Starts from a brick-wall hexagonal lattice of rows x cols degree-3 sites,
+ * in which site (r, c) is joined to (r, c + 1) and, when r + c is even, to
+ * (r + 1, c). A further qubit is then placed on every edge, as in IBM's
+ * heavy-hex devices. Site (r, c) has index r * cols + c, and edge qubits
+ * follow in order
+ */
+inline Device heavy_hex(int rows, int cols) {
+    std::vector<std::pair<int, int>> edges;
+    for (auto r = 0; r < rows; r++) {
+        for (auto c = 0; c < cols; c++) {
+            auto i = r * cols + c;
+            if (c + 1 < cols)
+                edges.emplace_back(i, i + 1);
+            if (r + 1 < rows && (r + c) % 2 == 0)
+                edges.emplace_back(i, i + cols);
+        }
+    }
+
+    auto n = rows * cols + static_cast<int>(edges.size());
+    std::vector<std::vector<bool>> dag(n, std::vector<bool>(n, false));
+    auto bridge = rows * cols;
+    for (auto [i, j] : edges) {
+        dag[i][bridge] = dag[bridge][i] = true;
+        dag[j][bridge] = dag[bridge][j] = true;
+        ++bridge;
+    }
+    return Device(std::to_string(rows) + "x" + std::to_string(cols) +
+                      " heavy-hex lattice",
+                  n, dag);
+}
+
 } // namespace mapping
 } // namespace staq
@@ -0,0 +1,322 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * \file mapping/device_file.hpp
+ * \brief Device descriptions from files and generated topologies
+ *
+ * A device description is a text file with one directive per line. Blank
+ * lines and anything following a '#' are ignored.
+   \verbatim
+   name <device name>
+   qubits <n>                    number of qubits, with no couplings
+   grid <rows> <cols>            square lattice, see mapping::grid
+   heavy-hex <rows> <cols>       heavy-hex lattice, see mapping::heavy_hex
+   qubit <i> <fidelity> [time]   single-qubit gate fidelity & duration
+   coupling <i> <j> [fidelity [time]]  directed coupling from i to j
+   edge <i> <j> [fidelity [time]]      coupling in both directions
+   \endverbatim
+ * Exactly one of qubits, grid or heavy-hex must come before any other
+ * directive. Fidelities lie in (0, 1] and default to 0.99. Gate durations
+ * are non-negative, only used for scheduling, see tools/scheduler.hpp, and
+ * are left unspecified (0) by default.
+ *
+ * The all-pairs shortest path tables of a device read from a file are
+ * cached in a binary sidecar file (the description's path with ".cache"
+ * appended). The cache is keyed on a hash of the description, so it is
+ * recomputed whenever the description changes.
+ */
+
+#include "mapping/device.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string_view>
+
+namespace staq {
+namespace mapping {
+
+/** \brief FNV-1a hash of a device description */
+inline uint64_t device_fingerprint(const std::string& text) {
+    uint64_t hash = 14695981039346656037ull;
+    for (auto ch : text) {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * \brief Parses a device description
+ * \param text The contents of the description
+ * \param fname The file name, for error messages
+ * \return The device, or nullopt on a malformed description
+ */
+inline std::optional<Device> parse_device(const std::string& text,
+                                          const std::string& fname) {
+    std::string name = fname;
+    int n = -1;
+    std::vector<std::vector<bool>> dag;
+    std::vector<double> sq_fi;
+    std::vector<std::vector<double>> tq_fi;
+    std::vector<double> sq_time;
+    std::vector<std::vector<double>> tq_time;
+
+    auto error = [&fname](int line, const std::string& msg) {
+        std::cerr << fname << ":" << line << ": error: " << msg << "\n";
+        return std::nullopt;
+    };
+    auto init = [&](Device dev) {
+        n = dev.qubits();
+        dag.assign(n, std::vector<bool>(n, false));
+        for (auto i = 0; i < n; i++) {
+            for (auto j = 0; j < n; j++)
+                dag[i][j] = dev.coupled(i, j);
+        }
+        sq_fi.assign(n, 0.99);
+        tq_fi.assign(n, std::vector<double>(n, 0.99));
+        sq_time.assign(n, 0);
+        tq_time.assign(n, std::vector<double>(n, 0));
+    };
+
+    // Reads a trailing number, unless the line has ended
+    auto optional = [](std::istringstream& tokens, double& value) {
+        if ((tokens >> std::ws).eof())
+            return true;
+        return static_cast<bool>(tokens >> value);
+    };
+    // Checks the rest of a qubit or coupling line
+    auto check = [](std::istringstream& tokens, double fidelity,
+                    double time) -> std::string {
+        if (!(fidelity > 0 && fidelity <= 1))
+            return "fidelity not in (0, 1]";
+        if (!(time >= 0))
+            return "negative duration";
+        if (!(tokens >> std::ws).eof())
+            return "unexpected input at end of line";
+        return "";
+    };
+
+    std::istringstream in(text);
+    std::string line;
+    for (auto lineno = 1; std::getline(in, line); lineno++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string directive;
+        if (!(tokens >> directive))
+            continue;
+
+        if (directive == "name") {
+            std::getline(tokens >> std::ws, name);
+            continue;
+        }
+
+        if (directive == "qubits" || directive == "grid" ||
+            directive == "heavy-hex") {
+            if (n != -1)
+                return error(lineno, "device size given twice");
+
+            int a = 0, b = 0;
+            if (!(tokens >> a) || a <= 0 ||
+                (directive != "qubits" && (!(tokens >> b) || b <= 0)))
+                return error(lineno, "expected positive dimensions");
+
+            if (directive == "qubits")
+                init(Device("", a, std::vector<std::vector<bool>>(
+                                       a, std::vector<bool>(a, false))));
+            else if (directive == "grid")
+                init(grid(a, b));
+            else
+                init(heavy_hex(a, b));
+            continue;
+        }
+
+        if (n == -1)
+            return error(lineno, "expected qubits, grid or heavy-hex first");
+
+        if (directive == "qubit") {
+            int i;
+            double fidelity, time = 0;
+            if (!(tokens >> i >> fidelity) || i < 0 || i >= n)
+                return error(lineno, "expected a qubit and a fidelity");
+            if (!optional(tokens, time))
+                return error(lineno, "expected a duration");
+            if (auto msg = check(tokens, fidelity, time); !msg.empty())
+                return error(lineno, msg);
+            sq_fi[i] = fidelity;
+            sq_time[i] = time;
+        } else if (directive == "coupling" || directive == "edge") {
+            int i, j;
+            double fidelity = 0.99, time = 0;
+            if (!(tokens >> i >> j) || i < 0 || i >= n || j < 0 || j >= n ||
+                i == j)
+                return error(lineno, "expected two distinct qubits");
+            if (!optional(tokens, fidelity) || !optional(tokens, time))
+                return error(lineno, "expected a fidelity and a duration");
+            if (auto msg = check(tokens, fidelity, time); !msg.empty())
+                return error(lineno, msg);
+            dag[i][j] = true;
+            tq_fi[i][j] = fidelity;
+            tq_time[i][j] = time;
+            if (directive == "edge") {
+                dag[j][i] = true;
+                tq_fi[j][i] = fidelity;
+                tq_time[j][i] = time;
+            }
+        } else {
+            return error(lineno, "unknown directive \"" + directive + "\"");
+        }
+    }
+
+    if (n == -1)
+        return error(1, "no qubits declared");
+
+    return Device(name, n, dag, sq_fi, tq_fi, std::move(sq_time),
+                  std::move(tq_time));
+}
+
+/**
+ * \brief Reads a device description file
+ *
+ * Shortest path tables are read from the sidecar cache if it is up to
+ * date, and otherwise computed and written back to it
+ *
+ * \param fname The description file
+ * \param use_cache Whether to read & write the sidecar cache
+ * \return The device, or nullopt if the file could not be read or parsed
+ */
+inline std::optional<Device> read_device_file(const std::string& fname,
+                                              bool use_cache = true) {
+    std::ifstream file(fname);
+    if (!file) {
+        std::cerr << "Error: could not open device file \"" << fname
+                  << "\"\n";
+        return std::nullopt;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    auto text = buffer.str();
+
+    auto dev = parse_device(text, fname);
+    if (!dev || !use_cache)
+        return dev;
+
+    // Sidecar cache: magic, fingerprint, size, then the tables
+    static constexpr char magic[8] = {'s', 't', 'a', 'q', 'd', 'e', 'v', '1'};
+    auto fingerprint = device_fingerprint(text);
+    auto cache_name = fname + ".cache";
+
+    std::ifstream cache(cache_name, std::ios::binary);
+    if (cache) {
+        char m[8];
+        uint64_t f = 0;
+        int32_t n = 0;
+        cache.read(m, sizeof(m));
+        cache.read(reinterpret_cast<char*>(&f), sizeof(f));
+        cache.read(reinterpret_cast<char*>(&n), sizeof(n));
+        if (cache && std::equal(m, m + 8, magic) && f == fingerprint &&
+            n == dev->qubits()) {
+            if (auto paths = Device::read_paths(cache, n))
+                return Device(*dev, std::move(paths));
+        }
+    }
+
+    // Written to a temporary file & renamed into place, so concurrent
+    // readers never see a partial cache
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::random_device rd;
+    auto tmp = cache_name + ".tmp" + std::to_string(rd());
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out)
+            return dev;
+        int32_t n = dev->qubits();
+        out.write(magic, sizeof(magic));
+        out.write(reinterpret_cast<const char*>(&fingerprint),
+                  sizeof(fingerprint));
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        dev->write_paths(out);
+        if (!out) {
+            out.close();
+            fs::remove(tmp, ec);
+            return dev;
+        }
+    }
+    fs::rename(tmp, cache_name, ec);
+    if (ec)
+        fs::remove(tmp, ec);
+
+    return dev;
+}
+
+/**
+ * \brief Looks up a device by name, generator or description file
+ *
+ * Accepts the names of the built-in devices, generated lattices of the form
+ * grid:RxC or heavy-hex:RxC, and otherwise the path of a device
+ * description file
+ *
+ * \return The device, or nullopt if the specification is not recognized
+ */
+inline std::optional<Device> get_device(std::string_view spec) {
+    if (spec == "tokyo")
+        return tokyo;
+    else if (spec == "agave")
+        return agave;
+    else if (spec == "aspen-4")
+        return aspen4;
+    else if (spec == "singapore")
+        return singapore;
+    else if (spec == "square")
+        return square_9q;
+    else if (spec == "fullycon")
+        return fully_connected(9);
+
+    for (std::string_view kind : {"grid:", "heavy-hex:"}) {
+        if (spec.substr(0, kind.size()) != kind)
+            continue;
+
+        std::istringstream dims(std::string(spec.substr(kind.size())));
+        int rows = 0, cols = 0;
+        char x = 0;
+        if (!(dims >> rows >> x >> cols) || x != 'x' || rows <= 0 ||
+            cols <= 0) {
+            std::cerr << "Error: expected " << kind << "RxC\n";
+            return std::nullopt;
+        }
+        return kind == "grid:" ? grid(rows, cols) : heavy_hex(rows, cols);
+    }
+
+    return read_device_file(std::string(spec));
+}
+
+} // namespace mapping
+} // namespace staq
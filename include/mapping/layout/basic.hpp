@@ -73,7 +73,7 @@ class LayoutTransformer final : public ast::Replacer {
         // Physical register declaration
         prog.body().emplace_front(
             std::make_unique<ast::RegisterDecl>(ast::RegisterDecl(
-                prog.pos(), config_.register_name, true, d.qubits_)));
+                prog.pos(), config_.register_name, true, d.qubits())));
 
         // Substitution
         std::unordered_map<ast::VarAccess, ast::VarAccess> subst;
@@ -104,7 +104,7 @@ class LayoutTransformer final : public ast::Replacer {
  */
 class BasicLayout final : public ast::Traverse {
   public:
-    BasicLayout(Device& device) : Traverse(), device_(device) {}
+    BasicLayout(const Device& device) : Traverse(), device_(device) {}
     ~BasicLayout() = default;
 
     /** \brief Main generation method */
@@ -119,7 +119,7 @@ class BasicLayout final : public ast::Traverse {
 
     void visit(ast::RegisterDecl& decl) override {
         if (decl.is_quantum()) {
-            if (n_ + decl.size() <= device_.qubits_) {
+            if (n_ + decl.size() <= device_.qubits()) {
                 for (auto i = 0; i < decl.size(); i++) {
                     current_[ast::VarAccess(parser::Position(), decl.id(), i)] =
                         n_ + i;
@@ -132,7 +132,7 @@ class BasicLayout final : public ast::Traverse {
     }
 
   private:
-    Device device_;
+    const Device& device_;
     layout current_;
     size_t n_;
 };
@@ -144,7 +144,7 @@ inline void apply_layout(const layout& l, const Device& d, ast::Program& prog) {
 }
 
 /** \brief Generates a layout for a program on a physical device */
-inline layout compute_basic_layout(Device& device, ast::Program& prog) {
+inline layout compute_basic_layout(const Device& device, ast::Program& prog) {
     BasicLayout gen(device);
     return gen.generate(prog);
 }
@@ -47,12 +47,12 @@ namespace mapping {
  */
 class BestFit final : public ast::Traverse {
   public:
-    BestFit(Device& device) : Traverse(), device_(device) {}
+    BestFit(const Device& device) : Traverse(), device_(device) {}
     ~BestFit() = default;
 
     /** \brief Main generation method */
     layout generate(ast::Program& prog) {
-        allocated_ = std::vector<bool>(device_.qubits_, false);
+        allocated_ = std::vector<bool>(device_.qubits(), false);
         access_paths_.clear();
         histogram_.clear();
 
@@ -76,7 +76,7 @@ class BestFit final : public ast::Traverse {
     }
 
   private:
-    Device device_;
+    const Device& device_;
     std::vector<bool> allocated_;
     std::set<ast::VarAccess> access_paths_;
     std::map<std::pair<ast::VarAccess, ast::VarAccess>, int> histogram_;
@@ -98,11 +98,13 @@ class BestFit final : public ast::Traverse {
         pairs.sort(cmp);
 
         // For each pair with CNOT gates between them, try to assign a coupling
-        auto couplings = device_.couplings();
+        std::list<std::pair<coupling, double>> couplings(
+            device_.couplings().begin(), device_.couplings().end());
         for (auto& [args, val] : pairs) {
             int ctrl_bit;
             int tgt_bit;
-            for (auto& [coupling, f] : couplings) {
+            for (auto ct = couplings.begin(); ct != couplings.end(); ct++) {
+                auto& [coupling, f] = *ct;
                 if (auto it = ret.find(args.first); it != ret.end()) {
                     if (it->second != coupling.first)
                         continue;
@@ -129,7 +131,7 @@ class BestFit final : public ast::Traverse {
                 ret[args.second] = tgt_bit;
                 allocated_[ctrl_bit] = true;
                 allocated_[tgt_bit] = true;
-                couplings.erase(std::make_pair(coupling, f));
+                couplings.erase(ct);
                 break;
             }
         }
@@ -139,7 +141,7 @@ class BestFit final : public ast::Traverse {
             auto i = 0;
             bool cont = ret.find(ap) == ret.end();
             while (cont) {
-                if (i >= device_.qubits_) {
+                if (i >= device_.qubits()) {
                     throw std::logic_error("Not enough physical qubits");
                 } else if (!allocated_[i]) {
                     ret[ap] = i;
@@ -156,7 +158,7 @@ class BestFit final : public ast::Traverse {
 };
 
 /** \brief Generates a best-fit layout for a program on a physical device */
-layout compute_bestfit_layout(Device& device, ast::Program& prog) {
+layout compute_bestfit_layout(const Device& device, ast::Program& prog) {
     BestFit gen(device);
     return gen.generate(prog);
 }
@@ -35,6 +35,7 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <list>
 
 namespace staq {
 namespace mapping {
@@ -49,14 +50,14 @@ namespace mapping {
  */
 class EagerLayout final : public ast::Traverse {
   public:
-    EagerLayout(Device& device) : Traverse(), device_(device) {
-        couplings_ = device_.couplings();
-    }
+    EagerLayout(const Device& device)
+        : Traverse(), device_(device),
+          couplings_(device.couplings().begin(), device.couplings().end()) {}
 
     /** \brief Main generation method */
     layout generate(ast::Program& prog) {
         layout_ = layout();
-        allocated_ = std::vector<bool>(device_.qubits_, false);
+        allocated_ = std::vector<bool>(device_.qubits(), false);
         access_paths_.clear();
 
         prog.accept(*this);
@@ -65,7 +66,7 @@ class EagerLayout final : public ast::Traverse {
             auto i = 0;
             bool cont = layout_.find(ap) == layout_.end();
             while (cont) {
-                if (i >= device_.qubits_) {
+                if (i >= device_.qubits()) {
                     throw std::logic_error("Not enough physical qubits");
                 } else if (!allocated_[i]) {
                     layout_[ap] = i;
@@ -97,7 +98,8 @@ class EagerLayout final : public ast::Traverse {
 
         size_t ctrl_bit;
         size_t tgt_bit;
-        for (auto& [coupling, f] : couplings_) {
+        for (auto it = couplings_.begin(); it != couplings_.end(); it++) {
+            auto& [coupling, f] = *it;
             if (auto it = layout_.find(ctrl); it != layout_.end()) {
                 if (it->second != coupling.first)
                     continue;
@@ -124,21 +126,21 @@ class EagerLayout final : public ast::Traverse {
             layout_[tgt] = tgt_bit;
             allocated_[ctrl_bit] = true;
             allocated_[tgt_bit] = true;
-            couplings_.erase(std::make_pair(coupling, f));
+            couplings_.erase(it);
             break;
         }
     }
 
   private:
-    Device device_;
+    const Device& device_;
     layout layout_;
     std::vector<bool> allocated_;
     std::set<ast::VarAccess> access_paths_;
-    std::set<std::pair<coupling, double>, cmp_couplings> couplings_;
+    std::list<std::pair<coupling, double>> couplings_;
 };
 
 /** \brief Generates an eager layout for a program on a physical device */
-layout compute_eager_layout(Device& device, ast::Program& prog) {
+layout compute_eager_layout(const Device& device, ast::Program& prog) {
     EagerLayout gen(device);
     return gen.generate(prog);
 }
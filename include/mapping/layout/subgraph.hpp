@@ -0,0 +1,416 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * \file mapping/layout/subgraph.hpp
+ * \brief Subgraph-isomorphism layout generation
+ */
+
+#include "ast/traversal.hpp"
+#include "mapping/device.hpp"
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+
+namespace staq {
+namespace mapping {
+
+/**
+ * \class staq::mapping::SubgraphLayout
+ * \brief An initial layout embedding the interaction graph into the device
+ *
+ * Builds the weighted graph of two-qubit interactions in the circuit and
+ * searches for an embedding of it into the (undirected) coupling graph of the
+ * device with a VF2-style backtracking search. Logical qubits are matched in
+ * a connectivity-first order, most heavily interacting first, and candidates
+ * are pruned by degree, by adjacency to the already matched neighbours and by
+ * a one-step lookahead on the number of unmatched neighbours.
+ *
+ * The search is bounded by a step budget. If no full embedding is found
+ * within it, the deepest partial embedding reached is kept and the remaining
+ * qubits are placed greedily, each on the free physical qubit minimizing the
+ * interaction-weighted distance to its already placed neighbours.
+ */
+class SubgraphLayout final : public ast::Traverse {
+  public:
+    /**
+     * \class staq::mapping::SubgraphLayout::config
+     * \brief Holds configuration options
+     */
+    struct config {
+        std::size_t max_steps = 100000; ///< candidate budget of the search
+    };
+
+    SubgraphLayout(const Device& device) : Traverse(), device_(device) {}
+    SubgraphLayout(const Device& device, const config& params)
+        : Traverse(), device_(device), config_(params) {}
+    ~SubgraphLayout() = default;
+
+    /** \brief Main generation method */
+    layout generate(ast::Program& prog) {
+        qubits_.clear();
+        index_.clear();
+        weights_.clear();
+
+        prog.accept(*this);
+
+        auto n = static_cast<int>(qubits_.size());
+        if (n > device_.qubits())
+            throw std::logic_error("Not enough physical qubits");
+
+        init_device();
+        compute_order();
+
+        l2p_.assign(n, -1);
+        p2l_.assign(device_.qubits(), -1);
+        pending_.resize(n);
+        for (auto i = 0; i < n; i++)
+            pending_[i] = weights_[i].size();
+        free_.resize(device_.qubits());
+        for (auto i = 0; i < device_.qubits(); i++)
+            free_[i] = neighbours_[i].size();
+        best_.assign(n, -1);
+        best_depth_ = 0;
+        steps_ = 0;
+
+        if (!match(0)) {
+            // Keep the deepest partial embedding & place the rest greedily
+            std::fill(p2l_.begin(), p2l_.end(), -1);
+            l2p_ = best_;
+            for (auto i = 0; i < n; i++) {
+                if (l2p_[i] != -1)
+                    p2l_[l2p_[i]] = i;
+            }
+            for (auto k = best_depth_; k < order_.size(); k++)
+                place_greedy(order_[k]);
+        }
+
+        // Qubits with no interactions get the remaining physical qubits
+        layout ret;
+        auto next = 0;
+        for (auto i = 0; i < n; i++) {
+            if (l2p_[i] == -1) {
+                while (p2l_[next] != -1)
+                    next++;
+                l2p_[i] = next;
+                p2l_[next] = i;
+            }
+            ret[qubits_[i]] = l2p_[i];
+        }
+
+        return ret;
+    }
+
+    /** \brief Whether the last layout generated embeds every interaction */
+    bool embedded() const { return best_depth_ == order_.size(); }
+
+    // Ignore gate & oracle declarations
+    void visit(ast::GateDecl&) override {}
+    void visit(ast::OracleDecl&) override {}
+
+    void visit(ast::RegisterDecl& decl) override {
+        if (decl.is_quantum()) {
+            for (int i = 0; i < decl.size(); i++) {
+                ast::VarAccess ap(decl.pos(), decl.id(), i);
+                index_[ap] = qubits_.size();
+                qubits_.push_back(ap);
+                weights_.emplace_back();
+            }
+        }
+    }
+
+    void visit(ast::CNOTGate& gate) override {
+        interact(gate.ctrl(), gate.tgt());
+    }
+
+    void visit(ast::DeclaredGate& gate) override {
+        for (auto i = 0; i < gate.num_qargs(); i++) {
+            for (auto j = i + 1; j < gate.num_qargs(); j++)
+                interact(gate.qarg(i), gate.qarg(j));
+        }
+    }
+
+  private:
+    const Device& device_;
+    config config_;
+
+    // Interaction graph
+    std::vector<ast::VarAccess> qubits_;
+    std::unordered_map<ast::VarAccess, int> index_;
+    std::vector<std::map<int, int>> weights_;
+
+    // Undirected coupling graph, neighbours by decreasing fidelity
+    std::vector<std::vector<bool>> adjacent_;
+    std::vector<std::vector<int>> neighbours_;
+    std::vector<int> by_degree_;
+
+    // Search state
+    std::vector<int> order_;
+    std::vector<int> l2p_;
+    std::vector<int> p2l_;
+    std::vector<int> pending_; ///< unmatched neighbours of each logical qubit
+    std::vector<int> free_;    ///< free neighbours of each physical qubit
+    std::vector<int> best_;
+    std::size_t best_depth_ = 0;
+    std::size_t steps_ = 0;
+
+    void interact(const ast::VarAccess& a, const ast::VarAccess& b) {
+        auto i = index_.find(a);
+        auto j = index_.find(b);
+        if (i == index_.end() || j == index_.end() || i->second == j->second)
+            return;
+        weights_[i->second][j->second] += 1;
+        weights_[j->second][i->second] += 1;
+    }
+
+    double fidelity(int i, int j) const {
+        auto ret = 0.0;
+        if (device_.coupled(i, j))
+            ret = device_.tq_fidelity(i, j);
+        if (device_.coupled(j, i))
+            ret = std::max(ret, device_.tq_fidelity(j, i));
+        return ret;
+    }
+
+    void init_device() {
+        auto m = device_.qubits();
+        adjacent_.assign(m, std::vector<bool>(m, false));
+        neighbours_.assign(m, {});
+        for (auto i = 0; i < m; i++) {
+            for (auto j = 0; j < m; j++) {
+                if (i != j &&
+                    (device_.coupled(i, j) || device_.coupled(j, i))) {
+                    adjacent_[i][j] = true;
+                    neighbours_[i].push_back(j);
+                }
+            }
+            std::stable_sort(neighbours_[i].begin(), neighbours_[i].end(),
+                             [this, i](int a, int b) {
+                                 return fidelity(i, a) > fidelity(i, b);
+                             });
+        }
+
+        by_degree_.resize(m);
+        std::iota(by_degree_.begin(), by_degree_.end(), 0);
+        std::stable_sort(by_degree_.begin(), by_degree_.end(),
+                         [this](int a, int b) {
+                             return neighbours_[a].size() >
+                                    neighbours_[b].size();
+                         });
+    }
+
+    /**
+     * \brief Orders the interacting qubits for matching
+     *
+     * Each step picks the qubit with the most already ordered neighbours,
+     * breaking ties by total interaction weight, so that every qubit after
+     * the first of its connected component is constrained by a neighbour
+     */
+    void compute_order() {
+        auto n = static_cast<int>(qubits_.size());
+        std::vector<int> total(n, 0), connected(n, 0);
+        std::vector<bool> ordered(n, false);
+        for (auto i = 0; i < n; i++) {
+            for (auto& [j, w] : weights_[i])
+                total[i] += w;
+        }
+
+        order_.clear();
+        while (true) {
+            auto next = -1;
+            for (auto i = 0; i < n; i++) {
+                if (ordered[i] || weights_[i].empty())
+                    continue;
+                if (next == -1 || connected[i] > connected[next] ||
+                    (connected[i] == connected[next] &&
+                     total[i] > total[next]))
+                    next = i;
+            }
+            if (next == -1)
+                break;
+
+            ordered[next] = true;
+            order_.push_back(next);
+            for (auto& [j, w] : weights_[next])
+                connected[j] += 1;
+        }
+    }
+
+    void assign(int u, int v) {
+        l2p_[u] = v;
+        p2l_[v] = u;
+        for (auto& [x, w] : weights_[u])
+            pending_[x]--;
+        for (auto y : neighbours_[v])
+            free_[y]--;
+    }
+
+    void unassign(int u, int v) {
+        l2p_[u] = -1;
+        p2l_[v] = -1;
+        for (auto& [x, w] : weights_[u])
+            pending_[x]++;
+        for (auto y : neighbours_[v])
+            free_[y]++;
+    }
+
+    /**
+     * \brief Checks whether logical qubit u can be matched to physical qubit v
+     *
+     * Besides adjacency to the matched neighbours of u, v must have enough
+     * free neighbours for the unmatched neighbours of u, and taking v must
+     * leave enough free neighbours around every matched physical neighbour
+     *
+     * \return The number of free neighbours of v left over once the unmatched
+     * neighbours of u are accounted for, or -1 if v is not a candidate
+     */
+    int slack(int u, int v) const {
+        if (p2l_[v] != -1 || neighbours_[v].size() < weights_[u].size() ||
+            free_[v] < pending_[u])
+            return -1;
+
+        for (auto& [x, w] : weights_[u]) {
+            if (l2p_[x] != -1 && !adjacent_[v][l2p_[x]])
+                return -1;
+        }
+
+        for (auto y : neighbours_[v]) {
+            auto x = p2l_[y];
+            if (x == -1)
+                continue;
+            auto needed = pending_[x] - (weights_[x].count(u) ? 1 : 0);
+            if (free_[y] - 1 < needed)
+                return -1;
+        }
+
+        return free_[v] - pending_[u];
+    }
+
+    /**
+     * \brief Backtracking search over the k-th and later qubits
+     *
+     * Candidates are tried tightest fit first, which keeps well connected
+     * regions of the device free for the qubits that need them
+     */
+    bool match(std::size_t k) {
+        if (k == order_.size()) {
+            best_depth_ = k;
+            return true;
+        }
+
+        auto u = order_[k];
+
+        // Candidates are the neighbours of a matched neighbour, if any
+        const std::vector<int>* neighbourhood = &by_degree_;
+        for (auto& [x, w] : weights_[u]) {
+            if (l2p_[x] != -1) {
+                neighbourhood = &neighbours_[l2p_[x]];
+                break;
+            }
+        }
+
+        std::vector<std::pair<int, int>> candidates;
+        for (auto v : *neighbourhood) {
+            if (auto s = slack(u, v); s >= 0)
+                candidates.emplace_back(s, v);
+        }
+        std::stable_sort(
+            candidates.begin(), candidates.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        for (auto& [s, v] : candidates) {
+            if (steps_++ >= config_.max_steps)
+                return false;
+
+            assign(u, v);
+            if (k + 1 > best_depth_) {
+                best_depth_ = k + 1;
+                best_ = l2p_;
+            }
+
+            if (match(k + 1))
+                return true;
+
+            unassign(u, v);
+        }
+
+        return false;
+    }
+
+    /**
+     * \brief Places u near its placed neighbours
+     *
+     * Distances are found by breadth-first search from each placed neighbour
+     * rather than from the device's all-pairs tables, which are cubic to
+     * compute on large devices
+     */
+    void place_greedy(int u) {
+        auto m = device_.qubits();
+        std::vector<double> cost(m, 0.0);
+        std::vector<int> dist(m), queue(m);
+        for (auto& [x, w] : weights_[u]) {
+            if (l2p_[x] == -1)
+                continue;
+
+            // Unreachable qubits cost more than any path
+            std::fill(dist.begin(), dist.end(), -1);
+            auto head = 0, tail = 0;
+            dist[l2p_[x]] = 0;
+            queue[tail++] = l2p_[x];
+            while (head < tail) {
+                auto y = queue[head++];
+                for (auto z : neighbours_[y]) {
+                    if (dist[z] == -1) {
+                        dist[z] = dist[y] + 1;
+                        queue[tail++] = z;
+                    }
+                }
+            }
+            for (auto v = 0; v < m; v++)
+                cost[v] += w * (dist[v] == -1 ? m : dist[v]);
+        }
+
+        auto best = -1;
+        for (auto v : by_degree_) {
+            if (p2l_[v] == -1 && (best == -1 || cost[v] < cost[best]))
+                best = v;
+        }
+
+        l2p_[u] = best;
+        p2l_[best] = u;
+    }
+};
+
+/** \brief Generates a subgraph-isomorphism layout for a program on a device */
+inline layout compute_subgraph_layout(const Device& device,
+                                      ast::Program& prog) {
+    SubgraphLayout gen(device);
+    return gen.generate(prog);
+}
+
+} // namespace mapping
+} // namespace staq
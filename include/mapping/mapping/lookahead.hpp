@@ -0,0 +1,428 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * \file mapping/mapping/lookahead.hpp
+ * \brief Lookahead swap-inserting hardware mapper
+ */
+
+#include "ast/replacer.hpp"
+#include "ast/traversal.hpp"
+#include "mapping/device.hpp"
+#include "mapping/mapping/swap.hpp"
+
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace staq {
+namespace mapping {
+
+/**
+ * \class staq::mapping::LookaheadMapper
+ * \brief Swap-inserting mapping algorithm with lookahead
+ * \note Assumes the circuit has a single global register with the configured
+ * name
+ *
+ * Maps an AST to a given device following the SABRE algorithm of
+ * arXiv:1809.02573. Statements are arranged in a dependency DAG, and every
+ * statement in the front layer which is executable under the current qubit
+ * permutation is emitted. When no front layer CNOT is executable, a swap on
+ * a coupling adjacent to the front layer is chosen by a heuristic weighing
+ * the front layer against an extended set of upcoming CNOTs, with a decay
+ * term discouraging repeated swaps on the same qubits.
+ *
+ * Before emitting, the initial placement is refined by alternately routing
+ * the circuit forwards and backwards and keeping the final permutation of
+ * each pass as the initial permutation of the next.
+ */
+class LookaheadMapper final : public ast::Replacer {
+  public:
+    struct config {
+        std::string register_name = "q";
+        std::size_t extended_set_size = 20; ///< CNOTs in the lookahead window
+        double extended_set_weight = 0.5;   ///< weight of the lookahead cost
+        double decay_delta = 0.001;         ///< decay increment per swap
+        unsigned decay_reset = 5;           ///< swaps between decay resets
+        unsigned refinement_passes = 1;     ///< forward-backward passes
+    };
+
+    LookaheadMapper(const Device& device) : LookaheadMapper(device, config()) {}
+    LookaheadMapper(const Device& device, const config& params)
+        : Replacer(), device_(device), config_(params),
+          distance_(device.hop_distances()) {
+        n_ = device_.qubits();
+        l2p_.resize(n_);
+        p2l_.resize(n_);
+    }
+
+    void run(ast::Program& prog) {
+        build_dag(prog);
+
+        // Refine the initial placement
+        for (auto i = 0; i < n_; i++)
+            l2p_[i] = p2l_[i] = i;
+        for (auto pass = 0u; pass < config_.refinement_passes; pass++) {
+            route(true, false);
+            route(false, false);
+        }
+
+        // Route for real
+        initial_ = l2p_;
+        std::list<ast::ptr<ast::Stmt>> body;
+        body_ = &body;
+        route(true, true);
+        body_ = nullptr;
+
+        body.splice(body.begin(), decls_);
+        prog.body() = std::move(body);
+        nodes_.clear();
+    }
+
+    /** \brief Number of swaps inserted by the last run */
+    std::size_t num_swaps() const { return swaps_; }
+    /** \brief Initial physical location of each qubit in the last run */
+    const std::vector<int>& initial_layout() const { return initial_; }
+    /** \brief Final physical location of each qubit in the last run */
+    const std::vector<int>& final_layout() const { return l2p_; }
+
+    std::optional<ast::VarAccess> replace(ast::VarAccess& va) override {
+        if (va.var() == config_.register_name && va.offset())
+            return ast::VarAccess(va.pos(), va.var(), l2p_[*va.offset()]);
+        else
+            return std::nullopt;
+    }
+
+  private:
+    /** \brief A statement in the dependency DAG */
+    struct dag_node {
+        ast::ptr<ast::Stmt> stmt;
+        std::vector<int> qubits; ///< logical qubits acted on
+        bool is_cnot = false;    ///< whether qubits[0,1] must be adjacent
+        std::vector<int> succs;
+        std::vector<int> preds;
+    };
+
+    /** \brief Collects the qubit and classical wires of a statement */
+    class WireCollector final : public ast::Traverse {
+      public:
+        WireCollector(const std::string& reg, int n) : reg_(reg), n_(n) {}
+
+        std::vector<int> qubits;
+        std::vector<std::string> bits;
+        bool is_cnot = false;
+
+        void visit(ast::VarAccess& va) override {
+            if (va.var() != reg_) {
+                bits.push_back(va.var());
+            } else if (va.offset()) {
+                if (*va.offset() < 0 || *va.offset() >= n_)
+                    throw std::logic_error(
+                        "Qubit argument out of device bounds!");
+                qubits.push_back(*va.offset());
+            } else {
+                for (auto i = 0; i < n_; i++)
+                    qubits.push_back(i);
+            }
+        }
+        void visit(ast::IfStmt& stmt) override {
+            bits.push_back(stmt.var());
+            stmt.then().accept(*this);
+        }
+        void visit(ast::CNOTGate& gate) override {
+            is_cnot = true;
+            ast::Traverse::visit(gate);
+        }
+        void visit(ast::GateDecl&) override {}
+        void visit(ast::OracleDecl&) override {}
+
+      private:
+        const std::string& reg_;
+        int n_;
+    };
+
+    const Device& device_;
+    config config_;
+
+    int n_;
+    std::vector<int> l2p_; ///< logical to physical
+    std::vector<int> p2l_; ///< physical to logical
+    std::vector<int> initial_; ///< l2p_ at the start of the emitting pass
+    const std::vector<int>& distance_; ///< hop distances, row-major
+
+    std::vector<dag_node> nodes_;
+    std::list<ast::ptr<ast::Stmt>> decls_;
+    std::list<ast::ptr<ast::Stmt>>* body_ = nullptr;
+    std::size_t swaps_ = 0;
+
+    int dist(int i, int j) const {
+        return distance_[static_cast<std::size_t>(i) * n_ + j];
+    }
+
+    void build_dag(ast::Program& prog) {
+        nodes_.clear();
+        decls_.clear();
+
+        std::vector<int> last_qubit(n_, -1);
+        std::unordered_map<std::string, int> last_bit;
+
+        for (auto& stmt : prog.body()) {
+            auto kind = stmt->kind();
+            if (kind == ast::NodeKind::GateDecl ||
+                kind == ast::NodeKind::OracleDecl ||
+                kind == ast::NodeKind::RegisterDecl) {
+                decls_.emplace_back(std::move(stmt));
+                continue;
+            }
+
+            WireCollector wires(config_.register_name, n_);
+            stmt->accept(wires);
+
+            int idx = static_cast<int>(nodes_.size());
+            auto& node = nodes_.emplace_back();
+            node.stmt = std::move(stmt);
+            node.qubits = std::move(wires.qubits);
+            node.is_cnot = wires.is_cnot && node.qubits.size() == 2 &&
+                           node.qubits[0] != node.qubits[1];
+
+            auto depend = [this, idx](int pred) {
+                if (pred == -1)
+                    return;
+                auto& preds = nodes_[idx].preds;
+                if (std::find(preds.begin(), preds.end(), pred) ==
+                    preds.end()) {
+                    preds.push_back(pred);
+                    nodes_[pred].succs.push_back(idx);
+                }
+            };
+            for (auto q : nodes_[idx].qubits) {
+                depend(last_qubit[q]);
+                last_qubit[q] = idx;
+            }
+            for (auto& bit : wires.bits) {
+                auto it = last_bit.find(bit);
+                if (it != last_bit.end())
+                    depend(it->second);
+                last_bit[bit] = idx;
+            }
+        }
+        prog.body().clear();
+    }
+
+    /**
+     * \brief Routes the DAG, in either direction, from the current permutation
+     *
+     * Leaves the final permutation in l2p_ and p2l_. If emit is set, the
+     * statements and swaps are appended to body_
+     */
+    void route(bool forward, bool emit) {
+        auto num_nodes = static_cast<int>(nodes_.size());
+        std::vector<int> remaining(num_nodes);
+        std::vector<int> front, next;
+        for (auto i = 0; i < num_nodes; i++) {
+            remaining[i] = static_cast<int>(forward ? nodes_[i].preds.size()
+                                                    : nodes_[i].succs.size());
+            if (remaining[i] == 0)
+                front.push_back(i);
+        }
+
+        std::vector<double> decay(n_, 1.0);
+        std::vector<int> extended;
+        std::vector<unsigned> visited(num_nodes, 0);
+        unsigned stamp = 0;
+        std::size_t stalled = 0;
+        swaps_ = 0;
+
+        while (!front.empty()) {
+            // Execute everything executable in the front layer
+            bool progress = true;
+            bool executed = false;
+            while (progress) {
+                progress = false;
+                next.clear();
+                for (auto i : front) {
+                    if (executable(nodes_[i])) {
+                        if (emit)
+                            emit_node(nodes_[i]);
+                        const auto& out =
+                            forward ? nodes_[i].succs : nodes_[i].preds;
+                        for (auto j : out) {
+                            if (--remaining[j] == 0)
+                                next.push_back(j);
+                        }
+                        progress = executed = true;
+                    } else {
+                        next.push_back(i);
+                    }
+                }
+                std::swap(front, next);
+            }
+            if (front.empty())
+                break;
+            if (executed) {
+                std::fill(decay.begin(), decay.end(), 1.0);
+                stalled = 0;
+            }
+
+            // Guarantee progress by routing along a shortest path if the
+            // heuristic keeps failing to make a front layer CNOT executable
+            if (stalled > static_cast<std::size_t>(n_)) {
+                auto& node = nodes_[front.front()];
+                auto p = device_.shortest_path(l2p_[node.qubits[0]],
+                                               l2p_[node.qubits[1]]);
+                if (p.size() < 3)
+                    throw std::logic_error(
+                        "Could not find a connection between qubits!");
+                auto it = p.begin();
+                for (auto prev = *it++; std::next(it) != p.end(); it++) {
+                    apply_swap(prev, *it, emit);
+                    prev = *it;
+                }
+                stalled = 0;
+                continue;
+            }
+
+            // Extended set of upcoming CNOTs
+            extended.clear();
+            ++stamp;
+            std::vector<int> queue(front.begin(), front.end());
+            for (std::size_t head = 0;
+                 head < queue.size() &&
+                 extended.size() < config_.extended_set_size;
+                 head++) {
+                const auto& out = forward ? nodes_[queue[head]].succs
+                                          : nodes_[queue[head]].preds;
+                for (auto j : out) {
+                    if (visited[j] == stamp)
+                        continue;
+                    visited[j] = stamp;
+                    queue.push_back(j);
+                    if (nodes_[j].is_cnot)
+                        extended.push_back(j);
+                }
+            }
+
+            // Score the candidate swaps
+            auto best = std::make_pair(-1, -1);
+            auto best_score = std::numeric_limits<double>::max();
+            for (auto i : front) {
+                if (!nodes_[i].is_cnot)
+                    continue;
+                for (auto q : nodes_[i].qubits) {
+                    auto p1 = l2p_[q];
+                    for (auto p2 : device_.neighbours(p1)) {
+                        auto score = swap_score(p1, p2, front, extended) *
+                                     std::max(decay[p1], decay[p2]);
+                        if (score < best_score - 1e-12) {
+                            best_score = score;
+                            best = std::make_pair(p1, p2);
+                        }
+                    }
+                }
+            }
+
+            if (best.first == -1)
+                throw std::logic_error(
+                    "Could not find a connection between qubits!");
+            apply_swap(best.first, best.second, emit);
+            decay[best.first] += config_.decay_delta;
+            decay[best.second] += config_.decay_delta;
+            if (config_.decay_reset != 0 && swaps_ % config_.decay_reset == 0)
+                std::fill(decay.begin(), decay.end(), 1.0);
+            ++stalled;
+        }
+    }
+
+    bool executable(const dag_node& node) const {
+        if (!node.is_cnot)
+            return true;
+        auto p1 = l2p_[node.qubits[0]];
+        auto p2 = l2p_[node.qubits[1]];
+        return dist(p1, p2) == 1;
+    }
+
+    /** \brief Heuristic cost of the permutation after swapping p1 and p2 */
+    double swap_score(int p1, int p2, const std::vector<int>& front,
+                      const std::vector<int>& extended) const {
+        auto moved = [p1, p2](int p) {
+            return p == p1 ? p2 : (p == p2 ? p1 : p);
+        };
+        auto cost = [this, &moved](const dag_node& node) {
+            return dist(moved(l2p_[node.qubits[0]]),
+                        moved(l2p_[node.qubits[1]]));
+        };
+
+        double front_cost = 0;
+        int front_size = 0;
+        for (auto i : front) {
+            if (nodes_[i].is_cnot) {
+                front_cost += cost(nodes_[i]);
+                ++front_size;
+            }
+        }
+        double ret = front_cost / front_size;
+
+        if (!extended.empty()) {
+            double extended_cost = 0;
+            for (auto i : extended)
+                extended_cost += cost(nodes_[i]);
+            ret += config_.extended_set_weight * extended_cost /
+                   extended.size();
+        }
+
+        return ret;
+    }
+
+    void apply_swap(int p1, int p2, bool emit) {
+        if (emit)
+            emit_swap(p1, p2);
+        auto l1 = p2l_[p1];
+        auto l2 = p2l_[p2];
+        std::swap(p2l_[p1], p2l_[p2]);
+        l2p_[l1] = p2;
+        l2p_[l2] = p1;
+        ++swaps_;
+    }
+
+    void emit_node(dag_node& node) {
+        node.stmt->accept(*this);
+        body_->emplace_back(std::move(node.stmt));
+    }
+
+    void emit_swap(int i, int j) {
+        mapping::emit_swap(device_, config_.register_name, i, j,
+                           parser::Position(), *body_);
+    }
+};
+
+/** \brief Applies the lookahead mapper to an AST given a physical device */
+void lookahead_mapping(const Device& device, ast::Program& prog) {
+    LookaheadMapper mapper(device);
+    mapper.run(prog);
+}
+
+} // namespace mapping
+} // namespace staq
@@ -0,0 +1,326 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+/**
+ * \file mapping/mapping/parallel.hpp
+ * \brief Partitioned parallel hardware mapping
+ */
+
+#include "mapping/mapping/lookahead.hpp"
+#include "mapping/mapping/steiner.hpp"
+#include "mapping/mapping/swap.hpp"
+
+#include <atomic>
+#include <thread>
+
+namespace staq {
+namespace mapping {
+
+/** \brief Mapping algorithms usable by the parallel mapper */
+enum class mapping_algorithm { swap, steiner, lookahead };
+
+/**
+ * \class staq::mapping::ParallelMapper
+ * \brief Maps a program in independent blocks on a pool of threads
+ * \note Assumes the circuit has a single global register with the configured
+ * name, as for the underlying mappers
+ *
+ * Splits the body of a laid out program into consecutive blocks, maps each
+ * block with its own mapper starting from the identity permutation, and
+ * concatenates the results.
+ *
+ * The Steiner mapper resets its state at every statement which ends a
+ * cnot-dihedral chunk, so blocks are cut just after such statements and the
+ * result is identical to mapping the program serially. The swap-inserting
+ * mappers instead leave the qubits permuted at the end of a block; a network
+ * of swaps is inserted after each block but the last to return every qubit to
+ * its initial location. The network is found by first making every swap that
+ * moves both of its qubits closer to their destinations, then routing the
+ * remaining qubits home leaf by leaf along a breadth-first spanning tree.
+ * Since each block boundary costs swaps, these mappers use one block per
+ * thread.
+ */
+class ParallelMapper {
+  public:
+    /**
+     * \class staq::mapping::ParallelMapper::config
+     * \brief Holds configuration options
+     */
+    struct config {
+        mapping_algorithm algorithm = mapping_algorithm::steiner;
+        unsigned num_threads = std::thread::hardware_concurrency();
+        std::size_t min_block_size = 256; ///< fewest statements per block
+        std::string register_name = "q";
+    };
+
+    ParallelMapper(const Device& device) : ParallelMapper(device, config()) {}
+    ParallelMapper(const Device& device, const config& params)
+        : device_(device), config_(params) {}
+
+    /** \brief Main mapping method */
+    void run(ast::Program& prog) {
+        // Declarations stay in front & are shared by every block
+        std::list<ast::ptr<ast::Stmt>> decls;
+        std::vector<ast::ptr<ast::Stmt>> stmts;
+        for (auto& stmt : prog.body()) {
+            if (is_decl(*stmt))
+                decls.emplace_back(std::move(stmt));
+            else
+                stmts.emplace_back(std::move(stmt));
+        }
+        prog.body().clear();
+
+        auto blocks = split(stmts);
+
+        // Map each block
+        std::vector<ast::ptr<ast::Program>> results(blocks.size());
+        std::vector<std::vector<int>> layouts(blocks.size());
+        swaps_ = 0;
+        initial_.resize(device_.qubits());
+        for (auto i = 0; i < device_.qubits(); i++)
+            initial_[i] = i;
+        std::atomic<std::size_t> next = 0;
+        auto worker = [&]() {
+            for (auto i = next++; i < blocks.size(); i = next++) {
+                std::list<ast::ptr<ast::Stmt>> body;
+                for (auto& decl : decls)
+                    body.emplace_back(decl->clone());
+                for (auto j = blocks[i].first; j < blocks[i].second; j++)
+                    body.emplace_back(std::move(stmts[j]));
+                results[i] = ast::Program::create(prog.pos(), false,
+                                                  std::move(body));
+                layouts[i] = map_block(*results[i], i == 0);
+            }
+        };
+
+        auto num_workers = std::min<std::size_t>(
+            std::max(config_.num_threads, 1u), blocks.size());
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < num_workers; i++)
+            workers.emplace_back(worker);
+        worker();
+        for (auto& thread : workers)
+            thread.join();
+
+        // Stitch the blocks together
+        final_ = layouts.back().empty() ? initial_ : layouts.back();
+        prog.body() = std::move(decls);
+        for (std::size_t i = 0; i < results.size(); i++) {
+            for (auto& stmt : results[i]->body()) {
+                if (!is_decl(*stmt))
+                    prog.body().emplace_back(std::move(stmt));
+            }
+            if (i + 1 < results.size() && !layouts[i].empty())
+                restore(layouts[i], prog.body());
+        }
+    }
+
+    /** \brief Number of swaps inserted between blocks by the last run */
+    std::size_t num_restoring_swaps() const { return swaps_; }
+    /** \brief Initial physical location of each qubit in the last run */
+    const std::vector<int>& initial_layout() const { return initial_; }
+    /** \brief Final physical location of each qubit in the last run */
+    const std::vector<int>& final_layout() const { return final_; }
+
+  private:
+    const Device& device_;
+    config config_;
+    std::size_t swaps_ = 0;
+    std::vector<int> initial_;
+    std::vector<int> final_;
+
+    static bool is_decl(ast::Stmt& stmt) {
+        switch (stmt.kind()) {
+            case ast::NodeKind::GateDecl:
+            case ast::NodeKind::OracleDecl:
+            case ast::NodeKind::RegisterDecl:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /** \brief Splits the statements into [begin, end) ranges */
+    std::vector<std::pair<std::size_t, std::size_t>>
+    split(std::vector<ast::ptr<ast::Stmt>>& stmts) const {
+        auto n = stmts.size();
+        auto threads = std::max<std::size_t>(config_.num_threads, 1);
+        auto size = std::max<std::size_t>(config_.min_block_size, 1);
+
+        // Extra Steiner blocks are free, so use a few per thread to balance
+        // the load
+        auto num_blocks = std::max<std::size_t>(n / size, 1);
+        if (config_.algorithm == mapping_algorithm::steiner)
+            num_blocks = std::min(num_blocks, 4 * threads);
+        else
+            num_blocks = std::min(num_blocks, threads);
+
+        std::vector<std::pair<std::size_t, std::size_t>> ret;
+        std::size_t begin = 0;
+        for (std::size_t k = 1; k <= num_blocks && begin < n; k++) {
+            auto end = k == num_blocks ? n : k * n / num_blocks;
+            if (config_.algorithm == mapping_algorithm::steiner) {
+                while (end < n && !SteinerMapper::ends_chunk(*stmts[end - 1]))
+                    end++;
+            }
+            if (end > begin) {
+                ret.emplace_back(begin, end);
+                begin = end;
+            }
+        }
+        if (ret.empty())
+            ret.emplace_back(0, n);
+
+        return ret;
+    }
+
+    /**
+     * \brief Maps a single block
+     * \return The final physical location of each qubit, or empty if the
+     * block leaves the qubits in place
+     */
+    std::vector<int> map_block(ast::Program& block, bool first) {
+        switch (config_.algorithm) {
+            case mapping_algorithm::swap: {
+                SwapMapper mapper(device_);
+                block.accept(mapper);
+                return mapper.final_layout();
+            }
+            case mapping_algorithm::steiner: {
+                SteinerMapper mapper(device_);
+                block.accept(mapper);
+                return {};
+            }
+            case mapping_algorithm::lookahead: {
+                // Only the first block may choose its initial placement
+                LookaheadMapper::config params;
+                params.register_name = config_.register_name;
+                if (!first)
+                    params.refinement_passes = 0;
+                LookaheadMapper mapper(device_, params);
+                mapper.run(block);
+                if (first)
+                    initial_ = mapper.initial_layout();
+                return mapper.final_layout();
+            }
+        }
+        return {};
+    }
+
+    int distance(int i, int j) const {
+        auto n = static_cast<std::size_t>(device_.qubits());
+        return device_.hop_distances()[i * n + j];
+    }
+
+    /** \brief Appends swaps returning each qubit i from l2p[i] to i */
+    void restore(std::vector<int> l2p, std::list<ast::ptr<ast::Stmt>>& body) {
+        auto n = device_.qubits();
+
+        std::vector<int> p2l(n);
+        for (auto i = 0; i < n; i++)
+            p2l[l2p[i]] = i;
+        auto apply_swap = [&](int p, int q) {
+            emit_swap(device_, config_.register_name, p, q, parser::Position(),
+                      body);
+            std::swap(p2l[p], p2l[q]);
+            l2p[p2l[p]] = p;
+            l2p[p2l[q]] = q;
+            ++swaps_;
+        };
+
+        // Swaps moving both qubits closer to home
+        for (auto progress = true; progress;) {
+            progress = false;
+            for (auto p = 0; p < n; p++) {
+                for (auto q : device_.neighbours(p)) {
+                    auto a = p2l[p], b = p2l[q];
+                    if (distance(q, a) < distance(p, a) &&
+                        distance(p, b) < distance(q, b)) {
+                        apply_swap(p, q);
+                        progress = true;
+                    }
+                }
+            }
+        }
+
+        // Breadth-first spanning forest
+        std::vector<int> parent(n, -1), order, depth(n, -1);
+        for (auto root = 0; root < n; root++) {
+            if (depth[root] != -1)
+                continue;
+            depth[root] = 0;
+            order.push_back(root);
+            for (auto head = order.size() - 1; head < order.size(); head++) {
+                auto u = order[head];
+                for (auto v : device_.neighbours(u)) {
+                    if (depth[v] == -1) {
+                        depth[v] = depth[u] + 1;
+                        parent[v] = u;
+                        order.push_back(v);
+                    }
+                }
+            }
+        }
+
+        // Route each qubit home, deepest first, along the tree. The path
+        // between two remaining vertices only passes through their
+        // ancestors, which are all still remaining
+        std::vector<int> up, down;
+        for (auto it = order.rbegin(); it != order.rend(); it++) {
+            auto v = *it;
+            auto p = l2p[v];
+            up.clear();
+            down.clear();
+            for (auto a = p, b = v; a != b;) {
+                if (depth[a] >= depth[b]) {
+                    up.push_back(a = parent[a]);
+                } else {
+                    down.push_back(b);
+                    b = parent[b];
+                }
+            }
+            auto at = p;
+            for (auto q : up) {
+                apply_swap(at, q);
+                at = q;
+            }
+            for (auto q = down.rbegin(); q != down.rend(); q++) {
+                apply_swap(at, *q);
+                at = *q;
+            }
+        }
+    }
+};
+
+/** \brief Maps a program onto a device in parallel blocks */
+inline void parallel_mapping(const Device& device, ast::Program& prog,
+                             const ParallelMapper::config& params) {
+    ParallelMapper mapper(device, params);
+    mapper.run(prog);
+}
+
+} // namespace mapping
+} // namespace staq
@@ -31,7 +31,7 @@
 
 #include "ast/traversal.hpp"
 #include "synthesis/linear_reversible.hpp"
-#include "synthesis/cnot_dihedral.hpp"
+#include "synthesis/cnot_dihedral_cache.hpp"
 #include "mapping/device.hpp"
 #include "utils/templates.hpp"
 
@@ -56,14 +56,45 @@ class SteinerMapper final : public ast::Replacer {
         std::string register_name = "q";
     };
 
-    SteinerMapper(Device& device) : Replacer(), device_(device) {
+    SteinerMapper(const Device& device) : Replacer(), device_(device) {
         permutation_ = synthesis::linear_op<bool>(
-            device.qubits_, std::vector<bool>(device.qubits_, false));
-        for (auto i = 0; i < device.qubits_; i++) {
+            device.qubits(), std::vector<bool>(device.qubits(), false));
+        for (auto i = 0; i < device.qubits(); i++) {
             permutation_[i][i] = true;
         }
     }
 
+    /**
+     * \brief Whether the mapper ends a cnot-dihedral chunk at a statement
+     *
+     * The accumulated chunk is reset after each such statement, so a
+     * program split just after one maps to the same circuit piecewise
+     */
+    static bool ends_chunk(ast::Stmt& stmt) {
+        switch (stmt.kind()) {
+            case ast::NodeKind::CNOTGate:
+            case ast::NodeKind::GateDecl:
+            case ast::NodeKind::OracleDecl:
+            case ast::NodeKind::RegisterDecl:
+            case ast::NodeKind::AncillaDecl:
+                return false;
+            case ast::NodeKind::UGate: {
+                auto& gate = static_cast<ast::UGate&>(stmt);
+                auto theta = gate.theta().constant_eval();
+                auto phi = gate.phi().constant_eval();
+                return !(theta && *theta == 0 && phi && *phi == 0);
+            }
+            case ast::NodeKind::DeclaredGate: {
+                auto& name = static_cast<ast::DeclaredGate&>(stmt).name();
+                return !(name == "rz" || name == "u1" || name == "z" ||
+                         name == "s" || name == "sdg" || name == "t" ||
+                         name == "tdg");
+            }
+            default:
+                return true;
+        }
+    }
+
     // Ignore declarations if they were left in during inlining
     void visit(ast::GateDecl&) override {}
     void visit(ast::OracleDecl&) override {}
@@ -73,7 +104,8 @@ class SteinerMapper final : public ast::Replacer {
 
         // Synthesize the last leg
         for (auto& gate :
-             synthesis::gray_steiner(phases_, permutation_, device_)) {
+             synthesis::cnot_dihedral_cache::shared().gray_steiner(
+                 phases_, permutation_, device_)) {
             std::visit(
                 utils::overloaded{
                     [this, &prog](std::pair<int, int>& cx) {
@@ -238,7 +270,7 @@ class SteinerMapper final : public ast::Replacer {
     }
 
   private:
-    Device device_;
+    const Device& device_;
     config config_;
 
     // Accumulating data
@@ -267,7 +299,8 @@ class SteinerMapper final : public ast::Replacer {
 
         // Synthesize circuit
         for (auto& gate :
-             synthesis::gray_steiner(phases_, permutation_, device_)) {
+             synthesis::cnot_dihedral_cache::shared().gray_steiner(
+                 phases_, permutation_, device_)) {
             std::visit(
                 utils::overloaded{
                     [&ret, this, &node](std::pair<int, int>& cx) {
@@ -301,8 +334,8 @@ class SteinerMapper final : public ast::Replacer {
 
         // Reset the cnot-dihedral circuit
         phases_.clear();
-        for (auto i = 0; i < device_.qubits_; i++) {
-            for (auto j = 0; j < device_.qubits_; j++) {
+        for (auto i = 0; i < device_.qubits(); i++) {
+            for (auto j = 0; j < device_.qubits(); j++) {
                 permutation_[i][j] = i == j ? true : false;
             }
         }
@@ -310,7 +343,7 @@ class SteinerMapper final : public ast::Replacer {
         return ret;
     }
 
-    bool in_bounds(int i) { return 0 <= i && i < device_.qubits_; }
+    bool in_bounds(int i) { return 0 <= i && i < device_.qubits(); }
 
     bool is_zero(ast::Expr& expr) {
         auto val = expr.constant_eval();
@@ -372,10 +405,10 @@ class SteinerMapper final : public ast::Replacer {
  */
 class SteinerDry final : public ast::Traverse {
   public:
-    SteinerDry(Device& device) : Traverse(), device_(device) {
+    SteinerDry(const Device& device) : Traverse(), device_(device) {
         permutation_ = synthesis::linear_op<bool>(
-            device.qubits_, std::vector<bool>(device.qubits_, false));
-        for (auto i = 0; i < device.qubits_; i++) {
+            device.qubits(), std::vector<bool>(device.qubits(), false));
+        for (auto i = 0; i < device.qubits(); i++) {
             permutation_[i][i] = true;
         }
     }
@@ -394,22 +427,7 @@ class SteinerDry final : public ast::Traverse {
         Traverse::visit(prog);
 
         // Synthesize the last leg
-        for (auto& gate :
-             synthesis::gray_steiner(phases_, permutation_, device_)) {
-            std::visit(
-                utils::overloaded{
-                    [this, &prog](std::pair<int, int>& cx) {
-                        if (device_.coupled(cx.first, cx.second) ||
-                            device_.coupled(cx.second, cx.first)) {
-                            cnots_++;
-                        } else {
-                            throw std::logic_error(
-                                "CNOT between non-coupled vertices!");
-                        }
-                    },
-                    [this, &prog](std::pair<ast::ptr<ast::Expr>, int>& rz) {}},
-                gate);
-        }
+        count();
     }
 
     void visit(ast::CNOTGate& gate) override {
@@ -519,7 +537,7 @@ class SteinerDry final : public ast::Traverse {
     void visit(ast::ResetStmt& stmt) override { return flush<ast::Stmt>(stmt); }
 
   private:
-    Device device_;
+    const Device& device_;
     layout layout_;
     int cnots_ = 0;
 
@@ -537,38 +555,38 @@ class SteinerDry final : public ast::Traverse {
         phases_.push_back(std::make_pair(parity, std::move(angle)));
     }
 
+    // Counts the CNOTs synthesized for the cnot-dihedral operator
+    void count() {
+        synthesis::cnot_dihedral_cache::shared().gray_steiner(
+            phases_, permutation_, device_,
+            [this](int ctrl, int tgt) {
+                if (device_.coupled(ctrl, tgt) || device_.coupled(tgt, ctrl)) {
+                    cnots_++;
+                } else {
+                    throw std::logic_error(
+                        "CNOT between non-coupled vertices!");
+                }
+            },
+            [](int, int) {});
+    }
+
     // Flushes a cnot-dihedral operator (i.e. phases + permutation) to the
     // circuit before the given node
     template <typename T>
     void flush(T& node) {
-        // Synthesize circuit
-        for (auto& gate :
-             synthesis::gray_steiner(phases_, permutation_, device_)) {
-            std::visit(
-                utils::overloaded{
-                    [this, &node](std::pair<int, int>& cx) {
-                        if (device_.coupled(cx.first, cx.second) ||
-                            device_.coupled(cx.second, cx.first)) {
-                            cnots_++;
-                        } else {
-                            throw std::logic_error(
-                                "CNOT between non-coupled vertices!");
-                        }
-                    },
-                    [this, &node](std::pair<ast::ptr<ast::Expr>, int>& rz) {}},
-                gate);
-        }
+        // Count the synthesized CNOTs
+        count();
 
         // Reset the cnot-dihedral circuit
         phases_.clear();
-        for (auto i = 0; i < device_.qubits_; i++) {
-            for (auto j = 0; j < device_.qubits_; j++) {
+        for (auto i = 0; i < device_.qubits(); i++) {
+            for (auto j = 0; j < device_.qubits(); j++) {
                 permutation_[i][j] = i == j ? true : false;
             }
         }
     }
 
-    bool in_bounds(int i) { return 0 <= i && i < device_.qubits_; }
+    bool in_bounds(int i) { return 0 <= i && i < device_.qubits(); }
 
     bool is_zero(ast::Expr& expr) {
         auto val = expr.constant_eval();
@@ -582,7 +600,7 @@ class SteinerDry final : public ast::Traverse {
  * Repeatedly performs dry-runs, modifying the qubit mapping with a
  * single swap each time.
  */
-void optimize_steiner_layout(Device& device, layout& init, ast::Program& prog) {
+void optimize_steiner_layout(const Device& device, layout& init, ast::Program& prog) {
     SteinerDry alg(device);
     int current_min = alg.get_cnot_count(prog, init);
 
@@ -601,7 +619,7 @@ outer:
 }
 
 /** \brief Applies the Steiner mapper to an AST given a physical device */
-void steiner_mapping(Device& device, ast::Program& prog) {
+void steiner_mapping(const Device& device, ast::Program& prog) {
     SteinerMapper mapper(device);
     prog.accept(mapper);
 }
@@ -33,13 +33,68 @@
 #include "transformations/substitution.hpp"
 #include "mapping/device.hpp"
 
-#include <map>
+#include <vector>
 
 // TODO: figure out what to do with if statements
 
 namespace staq {
 namespace mapping {
 
+/** \brief A CNOT gate between two qubits of a register */
+inline ast::ptr<ast::CNOTGate> generate_cnot(const std::string& reg, int i,
+                                             int j, parser::Position pos) {
+    auto ctrl = ast::VarAccess(pos, reg, i);
+    auto tgt = ast::VarAccess(pos, reg, j);
+    return std::make_unique<ast::CNOTGate>(
+        ast::CNOTGate(pos, std::move(ctrl), std::move(tgt)));
+}
+
+/** \brief A Hadamard gate on a qubit of a register, as a U gate */
+inline ast::ptr<ast::UGate> generate_hadamard(const std::string& reg, int i,
+                                              parser::Position pos) {
+    auto tgt = ast::VarAccess(pos, reg, i);
+
+    auto tmp1 = std::make_unique<ast::PiExpr>(ast::PiExpr(pos));
+    auto tmp2 = std::make_unique<ast::IntExpr>(ast::IntExpr(pos, 2));
+    auto theta = std::make_unique<ast::BExpr>(ast::BExpr(
+        pos, std::move(tmp1), ast::BinaryOp::Divide, std::move(tmp2)));
+    auto phi = std::make_unique<ast::IntExpr>(ast::IntExpr(pos, 0));
+    auto lambda = std::make_unique<ast::PiExpr>(ast::PiExpr(pos));
+
+    return std::make_unique<ast::UGate>(ast::UGate(pos, std::move(theta),
+                                                   std::move(phi),
+                                                   std::move(lambda),
+                                                   std::move(tgt)));
+}
+
+/**
+ * \brief Appends a swap of two coupled qubits of a register
+ *
+ * Three CNOTs, the middle one reversed with Hadamard gates if the device
+ * only couples the qubits in one direction
+ *
+ * \param body The gates or statements to append to
+ */
+template <typename Node>
+inline void emit_swap(const Device& device, const std::string& reg, int i,
+                      int j, parser::Position pos,
+                      std::list<ast::ptr<Node>>& body) {
+    if (!device.coupled(i, j))
+        std::swap(i, j);
+
+    body.emplace_back(generate_cnot(reg, i, j, pos));
+    if (device.coupled(j, i)) {
+        body.emplace_back(generate_cnot(reg, j, i, pos));
+    } else {
+        body.emplace_back(generate_hadamard(reg, i, pos));
+        body.emplace_back(generate_hadamard(reg, j, pos));
+        body.emplace_back(generate_cnot(reg, i, j, pos));
+        body.emplace_back(generate_hadamard(reg, i, pos));
+        body.emplace_back(generate_hadamard(reg, j, pos));
+    }
+    body.emplace_back(generate_cnot(reg, i, j, pos));
+}
+
 /**
  * \class staq::mapping::SwapMapper
  * \brief Simple swap-inserting mapping algorithm
@@ -55,20 +110,25 @@ class SwapMapper final : public ast::Replacer {
         std::string register_name = "q";
     };
 
-    SwapMapper(Device& device) : Replacer(), device_(device) {
-        for (auto i = 0; i < device.qubits_; i++) {
-            permutation_[i] = i;
+    SwapMapper(const Device& device)
+        : Replacer(), device_(device), l2p_(device.qubits()),
+          p2l_(device.qubits()) {
+        for (auto i = 0; i < device.qubits(); i++) {
+            l2p_[i] = i;
+            p2l_[i] = i;
         }
     }
 
+    /** \brief Current physical location of each qubit */
+    const std::vector<int>& final_layout() const { return l2p_; }
+
     // Ignore declarations if they were left in during inlining
     void visit(ast::GateDecl&) override {}
     void visit(ast::OracleDecl&) override {}
 
     std::optional<ast::VarAccess> replace(ast::VarAccess& va) override {
         if (va.var() == config_.register_name)
-            return ast::VarAccess(va.pos(), va.var(),
-                                  permutation_[*va.offset()]);
+            return ast::VarAccess(va.pos(), va.var(), l2p_[*va.offset()]);
         else
             return std::nullopt;
     }
@@ -94,43 +154,18 @@ class SwapMapper final : public ast::Replacer {
             auto i = ctrl;
             for (auto j : cnot_chain) {
                 if (j == tgt) {
-                    ret.emplace_back(generate_cnot(i, j, gate.pos()));
+                    ret.emplace_back(generate_cnot(config_.register_name, i,
+                                                   j, gate.pos()));
                     break;
                 } else if (j != i) {
                     // Swap i and j
-                    auto swap_i = i;
-                    auto swap_j = j;
-                    if (!device_.coupled(i, j)) {
-                        swap_i = j;
-                        swap_j = i;
-                    }
-
-                    // CNOT 1
-                    ret.emplace_back(generate_cnot(swap_i, swap_j, gate.pos()));
-
-                    // CNOT 2
-                    if (device_.coupled(swap_j, swap_i)) {
-                        ret.emplace_back(
-                            generate_cnot(swap_j, swap_i, gate.pos()));
-                    } else {
-                        ret.emplace_back(generate_hadamard(swap_i, gate.pos()));
-                        ret.emplace_back(generate_hadamard(swap_j, gate.pos()));
-                        ret.emplace_back(
-                            generate_cnot(swap_i, swap_j, gate.pos()));
-                        ret.emplace_back(generate_hadamard(swap_i, gate.pos()));
-                        ret.emplace_back(generate_hadamard(swap_j, gate.pos()));
-                    }
-
-                    // CNOT 3
-                    ret.emplace_back(generate_cnot(swap_i, swap_j, gate.pos()));
+                    emit_swap(device_, config_.register_name, i, j, gate.pos(),
+                              ret);
 
                     // Adjust permutation
-                    for (auto& [q_init, q] : permutation_) {
-                        if (q == i)
-                            q = j;
-                        else if (q == j)
-                            q = i;
-                    }
+                    std::swap(p2l_[i], p2l_[j]);
+                    l2p_[p2l_[i]] = i;
+                    l2p_[p2l_[j]] = j;
                 }
                 i = j;
             }
@@ -139,35 +174,14 @@ class SwapMapper final : public ast::Replacer {
     }
 
   private:
-    Device device_;
-    std::map<int, int> permutation_;
+    const Device& device_;
+    std::vector<int> l2p_; ///< initial (logical) to current physical qubits
+    std::vector<int> p2l_; ///< current physical to initial (logical) qubits
     config config_;
-
-    ast::ptr<ast::CNOTGate> generate_cnot(int i, int j, parser::Position pos) {
-        auto ctrl = ast::VarAccess(pos, config_.register_name, i);
-        auto tgt = ast::VarAccess(pos, config_.register_name, j);
-        return std::make_unique<ast::CNOTGate>(
-            ast::CNOTGate(pos, std::move(ctrl), std::move(tgt)));
-    }
-
-    ast::ptr<ast::UGate> generate_hadamard(int i, parser::Position pos) {
-        auto tgt = ast::VarAccess(pos, config_.register_name, i);
-
-        auto tmp1 = std::make_unique<ast::PiExpr>(ast::PiExpr(pos));
-        auto tmp2 = std::make_unique<ast::IntExpr>(ast::IntExpr(pos, 2));
-        auto theta = std::make_unique<ast::BExpr>(ast::BExpr(
-            pos, std::move(tmp1), ast::BinaryOp::Divide, std::move(tmp2)));
-        auto phi = std::make_unique<ast::IntExpr>(ast::IntExpr(pos, 0));
-        auto lambda = std::make_unique<ast::PiExpr>(ast::PiExpr(pos));
-
-        return std::make_unique<ast::UGate>(
-            ast::UGate(pos, std::move(theta), std::move(phi), std::move(lambda),
-                       std::move(tgt)));
-    }
 };
 
 /** \brief Applies the swap mapper to an AST given a physical device */
-void map_onto_device(Device& device, ast::Program& prog) {
+void map_onto_device(const Device& device, ast::Program& prog) {
     SwapMapper mapper(device);
     prog.accept(mapper);
 }
@@ -30,7 +30,7 @@
 
 #include "ast/visitor.hpp"
 #include "ast/replacer.hpp"
-#include "synthesis/cnot_dihedral.hpp"
+#include "synthesis/cnot_dihedral_cache.hpp"
 
 #include <list>
 #include <unordered_map>
@@ -46,6 +46,10 @@ namespace optimization {
 class CNOTOptimizer final : public ast::Replacer {
   public:
     struct config {
+        /// Synthesis method for the residual linear transformation
+        synthesis::linear_synth linear_method =
+            synthesis::linear_synth::gauss_jordan;
+        int section_size = 0; ///< Patel-Markov-Hayes section size, 0 = auto
     };
 
     CNOTOptimizer() = default;
@@ -258,7 +262,9 @@ class CNOTOptimizer final : public ast::Replacer {
         parser::Position pos;
 
         // Synthesize circuit
-        for (auto& gate : synthesis::gray_synth(phases_, permutation_)) {
+        for (auto& gate : synthesis::cnot_dihedral_cache::shared().gray_synth(
+                 phases_, permutation_, config_.linear_method,
+                 config_.section_size)) {
             std::visit(
                 utils::overloaded{
                   [&ret, this](std::pair<int, int>& cx) {
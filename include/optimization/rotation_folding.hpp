@@ -28,13 +28,18 @@
  */
 #pragma once
 
-#include "ast/visitor.hpp"
+#include "ast/static_visitor.hpp"
 #include "ast/replacer.hpp"
 #include "gates/channel.hpp"
 
+#include <atomic>
 #include <list>
+#include <map>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <sstream>
+#include <vector>
 
 namespace staq {
 namespace optimization {
@@ -44,23 +49,40 @@ namespace optimization {
  * \brief Rotation gate merging algorithm based on arXiv:1903.12456
  *
  * Returns a replacement list giving the nodes to the be replaced (or erased)
+ *
+ * Gate declaration bodies and the program body are folded independently, and
+ * each is further split into blocks of qubits which never interact. Blocks
+ * can be folded concurrently by setting config::num_threads
+ *
+ * Setting config::window instead folds rotations as they are read, each
+ * looking back over at most that many earlier rotations. Older rotations are
+ * finalized as they leave the window, as is the oldest rotation whenever the
+ * window holds more than operators_per_rotation operators per rotation of
+ * the window, so that a long run of Cliffords & uninterpreted gates can't
+ * grow it. The circuit held in memory, and the time spent folding each
+ * rotation, are thus bounded by the window rather than the length of the
+ * program
  */
-class RotationOptimizer final : public ast::Visitor {
+class RotationOptimizer final
+    : public ast::StaticVisitor<RotationOptimizer> {
     using Gatelib = gates::ChannelRepr<ast::VarAccess>;
 
   public:
     struct config {
         bool correct_global_phase = true;
+        unsigned num_threads = 1; ///< worker threads used for folding
+        std::size_t window = 0;   ///< rotations to look back over, 0 = all
     };
 
     RotationOptimizer() = default;
-    RotationOptimizer(const config& params) : Visitor(), config_(params) {}
+    RotationOptimizer(const config& params) : config_(params) {}
     ~RotationOptimizer() = default;
 
     std::unordered_map<int, std::list<ast::ptr<ast::Gate>>>
     run(ast::ASTNode& node) {
         reset();
-        node.accept(*this);
+        dispatch(node);
+        fold_all();
         return std::move(replacement_list_);
     }
 
@@ -84,7 +106,7 @@ class RotationOptimizer final : public ast::Visitor {
     }
     void visit(ast::IfStmt& stmt) {
         mergeable_ = false;
-        stmt.then().accept(*this);
+        dispatch(stmt.then());
         mergeable_ = true;
     }
 
@@ -127,14 +149,12 @@ class RotationOptimizer final : public ast::Visitor {
                 auto rot = Gatelib::Rotation::t(gate.qarg(0));
                 rotation_info info{gate.uid(), rotation_info::axis::z,
                                    gate.qarg(0)};
-                accum_.push_back(
-                    std::make_pair(info, rot.commute_left(current_clifford_)));
+                push_rotation(info, rot.commute_left(current_clifford_));
             } else if (name == "tdg") {
                 auto rot = Gatelib::Rotation::tdg(gate.qarg(0));
                 rotation_info info{gate.uid(), rotation_info::axis::z,
                                    gate.qarg(0)};
-                accum_.push_back(
-                    std::make_pair(info, rot.commute_left(current_clifford_)));
+                push_rotation(info, rot.commute_left(current_clifford_));
             } else if (name == "rz") {
                 auto angle = gate.carg(0).constant_eval();
 
@@ -143,8 +163,7 @@ class RotationOptimizer final : public ast::Visitor {
                                                      gate.qarg(0));
                     rotation_info info{gate.uid(), rotation_info::axis::z,
                                        gate.qarg(0)};
-                    accum_.push_back(std::make_pair(
-                        info, rot.commute_left(current_clifford_)));
+                    push_rotation(info, rot.commute_left(current_clifford_));
                 } else {
                     push_uninterp(Gatelib::Uninterp(gate.qargs()));
                 }
@@ -156,8 +175,7 @@ class RotationOptimizer final : public ast::Visitor {
                                                      gate.qarg(0));
                     rotation_info info{gate.uid(), rotation_info::axis::x,
                                        gate.qarg(0)};
-                    accum_.push_back(std::make_pair(
-                        info, rot.commute_left(current_clifford_)));
+                    push_rotation(info, rot.commute_left(current_clifford_));
                 } else {
                     push_uninterp(Gatelib::Uninterp(gate.qargs()));
                 }
@@ -169,8 +187,7 @@ class RotationOptimizer final : public ast::Visitor {
                                                      gate.qarg(0));
                     rotation_info info{gate.uid(), rotation_info::axis::y,
                                        gate.qarg(0)};
-                    accum_.push_back(std::make_pair(
-                        info, rot.commute_left(current_clifford_)));
+                    push_rotation(info, rot.commute_left(current_clifford_));
                 } else {
                     push_uninterp(Gatelib::Uninterp(gate.qargs()));
                 }
@@ -186,19 +203,25 @@ class RotationOptimizer final : public ast::Visitor {
         // Initialize a new local state
         circuit_callback local_state;
         Gatelib::Clifford local_clifford;
+        window_state local_window;
         std::swap(accum_, local_state);
         std::swap(current_clifford_, local_clifford);
+        std::swap(window_, local_window);
 
         // Process gate body
-        decl.foreach_stmt([this](auto& stmt) { stmt.accept(*this); });
+        decl.foreach_stmt([this](auto& stmt) { dispatch(stmt); });
         accum_.push_back(current_clifford_);
 
-        // Fold the gate body
-        fold(accum_, true);
+        // Queue the gate body for folding
+        if (config_.window > 0)
+            flush_window(true);
+        else
+            jobs_.push_back({std::move(accum_), true});
 
         // Reset the state
         std::swap(accum_, local_state);
         std::swap(current_clifford_, local_clifford);
+        std::swap(window_, local_window);
     }
     void visit(ast::OracleDecl&) {}
     void visit(ast::RegisterDecl&) {}
@@ -206,10 +229,13 @@ class RotationOptimizer final : public ast::Visitor {
 
     /* Program */
     void visit(ast::Program& prog) {
-        prog.foreach_stmt([this](auto& stmt) { stmt.accept(*this); });
+        prog.foreach_stmt([this](auto& stmt) { dispatch(stmt); });
         accum_.push_back(current_clifford_);
 
-        fold(accum_, config_.correct_global_phase);
+        if (config_.window > 0)
+            flush_window(config_.correct_global_phase);
+        else
+            jobs_.push_back({std::move(accum_), config_.correct_global_phase});
     }
 
   private:
@@ -227,8 +253,32 @@ class RotationOptimizer final : public ast::Visitor {
         std::list<std::variant<Gatelib::Uninterp, Gatelib::Clifford,
                                std::pair<rotation_info, Gatelib::Rotation>>>;
 
+    // A circuit to be folded, independently of all others
+    struct fold_job {
+        circuit_callback circuit;
+        bool phase_correction;
+    };
+
+    // The outcome of folding a circuit. Rotations are only allocated once
+    // all circuits are folded, so that folding needs no shared state
+    struct fold_result {
+        std::list<std::pair<rotation_info, utils::Angle>> changes;
+        utils::Angle global_phase = utils::angles::zero;
+        std::optional<rotation_info> phase_target; // first rotation changed
+    };
+
+    // Folding state of a bounded window
+    struct window_state {
+        std::size_t rotations = 0;      // rotations currently in the window
+        std::unordered_set<int> merged; // rotations in the window changed
+        utils::Angle global_phase = utils::angles::zero;
+        std::optional<rotation_info> phase_target; // first rotation changed
+    };
+
     config config_;
     std::unordered_map<int, std::list<ast::ptr<ast::Gate>>> replacement_list_;
+    std::list<fold_job> jobs_;
+    window_state window_;
 
     /* Algorithm state */
     circuit_callback
@@ -247,16 +297,202 @@ class RotationOptimizer final : public ast::Visitor {
 
     void reset() {
         replacement_list_.clear();
+        jobs_.clear();
+        window_ = window_state();
         accum_.clear();
         mergeable_ = true;
         current_clifford_ = Gatelib::Clifford();
     }
 
     /* Phase two of the algorithm */
-    void fold(circuit_callback& circuit, bool phase_correction) {
-        auto global_phase = utils::angles::zero;
-        ast::VarAccess* tgt = nullptr;
-        std::list<ast::ptr<ast::Gate>>* subst_ref = nullptr;
+    void fold_all() {
+        // Split into independent blocks
+        std::vector<circuit_callback> blocks;
+        std::vector<fold_job*> owners;
+        for (auto& job : jobs_) {
+            for (auto& block : split(job.circuit)) {
+                blocks.emplace_back(std::move(block));
+                owners.push_back(&job);
+            }
+        }
+
+        // Fold each block
+        std::vector<fold_result> results(blocks.size());
+        std::atomic<std::size_t> next = 0;
+        auto worker = [this, &blocks, &results, &next]() {
+            for (auto i = next++; i < blocks.size(); i = next++)
+                results[i] = fold(blocks[i]);
+        };
+
+        auto num_workers = std::min<std::size_t>(
+            std::max(config_.num_threads, 1u), blocks.size());
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < num_workers; i++)
+            workers.emplace_back(worker);
+        worker();
+        for (auto& thread : workers)
+            thread.join();
+
+        // Merge the results in order
+        auto it = results.begin();
+        for (auto& job : jobs_) {
+            auto global_phase = utils::angles::zero;
+            std::optional<rotation_info> tgt;
+            std::optional<std::size_t> tgt_position;
+            auto positions = rotation_positions(job.circuit);
+
+            for (; it != results.end() && owners[it - results.begin()] == &job;
+                 it++) {
+                for (auto& [rinfo, theta] : it->changes) {
+                    std::list<ast::ptr<ast::Gate>> subst;
+
+                    auto rot = alloc_rot(rinfo, theta);
+                    if (rot)
+                        subst.emplace_back(rot);
+                    replacement_list_[rinfo.uid] = std::move(subst);
+                }
+
+                global_phase += it->global_phase;
+                if (auto& target = it->phase_target) {
+                    auto position = positions[target->uid];
+                    if (!tgt_position || position < *tgt_position) {
+                        tgt = target;
+                        tgt_position = position;
+                    }
+                }
+            }
+
+            if (job.phase_correction &&
+                (global_phase != utils::angles::zero)) {
+                correct_phase(replacement_list_[tgt->uid], tgt->arg,
+                              global_phase);
+            }
+        }
+    }
+
+    // Splits a circuit into blocks acting on disjoint sets of qubits.
+    // Operators with no support commute with everything, so are dropped,
+    // except for rotations about the identity which may still merge together
+    std::vector<circuit_callback> split(const circuit_callback& circuit) {
+        std::unordered_map<ast::VarAccess, int> ids;
+        std::vector<int> parent;
+
+        auto id = [&ids, &parent](const ast::VarAccess& q) {
+            auto [it, inserted] = ids.try_emplace(q, (int)parent.size());
+            if (inserted)
+                parent.push_back(it->second);
+            return it->second;
+        };
+        auto find = [&parent](int x) {
+            while (parent[x] != x)
+                x = parent[x] = parent[parent[x]];
+            return x;
+        };
+        auto unite = [&find, &parent](int x, int y) {
+            parent[find(x)] = find(y);
+        };
+
+        // Builds the union-find over qubits for a Pauli, returning a
+        // representative qubit, or -1 if the Pauli is trivial
+        auto join = [&id, &unite](const Gatelib::Pauli& P, int rep) {
+            P.foreach ([&id, &unite, &rep](auto& p) {
+                if (p.second == Gatelib::PauliOp::i)
+                    return;
+                auto q = id(p.first);
+                if (rep < 0)
+                    rep = q;
+                else
+                    unite(rep, q);
+            });
+            return rep;
+        };
+
+        // Union qubits interacting within an operator
+        for (auto& op : circuit) {
+            std::visit(
+                utils::overloaded{
+                    [&id, &unite](const Gatelib::Uninterp& U) {
+                        int rep = -1;
+                        U.foreach_qubit([&id, &unite, &rep](auto& q) {
+                            if (rep < 0)
+                                rep = id(q);
+                            else
+                                unite(rep, id(q));
+                        });
+                    },
+                    [&id, &join](const Gatelib::Clifford& C) {
+                        C.foreach ([&id, &join](auto& in, auto& out) {
+                            join(out, id(in.first));
+                        });
+                    },
+                    [&join](const std::pair<rotation_info, Gatelib::Rotation>&
+                                R) { join(R.second.pauli(), -1); }},
+                op);
+        }
+
+        // Distribute operators among blocks, in order of first appearance
+        std::vector<circuit_callback> blocks;
+        std::unordered_map<int, std::size_t> block_of;
+        auto block = [&find, &blocks, &block_of](int q) -> circuit_callback& {
+            auto [it, inserted] =
+                block_of.try_emplace(q < 0 ? q : find(q), blocks.size());
+            if (inserted)
+                blocks.emplace_back();
+            return blocks[it->second];
+        };
+
+        for (auto& op : circuit) {
+            std::visit(
+                utils::overloaded{
+                    [&op, &id, &block](const Gatelib::Uninterp& U) {
+                        std::optional<int> q;
+                        U.foreach_qubit([&q, &id](auto& arg) { q = id(arg); });
+                        if (q)
+                            block(*q).push_back(op);
+                    },
+                    [&id, &find, &block](const Gatelib::Clifford& C) {
+                        std::map<int, std::map<std::pair<ast::VarAccess,
+                                                         Gatelib::PauliOp>,
+                                               Gatelib::Pauli>>
+                            parts;
+                        C.foreach ([&id, &find, &parts](auto& in, auto& out) {
+                            parts[find(id(in.first))][in] = out;
+                        });
+                        for (auto& [q, perm] : parts)
+                            block(q).push_back(Gatelib::Clifford(perm));
+                    },
+                    [&op, &id, &block](
+                        const std::pair<rotation_info, Gatelib::Rotation>& R) {
+                        std::optional<int> q;
+                        R.second.pauli().foreach ([&q, &id](auto& p) {
+                            if (p.second != Gatelib::PauliOp::i)
+                                q = id(p.first);
+                        });
+                        block(q ? *q : -1).push_back(op);
+                    }},
+                op);
+        }
+
+        return blocks;
+    }
+
+    // Position of each rotation in a circuit
+    std::unordered_map<int, std::size_t>
+    rotation_positions(const circuit_callback& circuit) {
+        std::unordered_map<int, std::size_t> ret;
+        std::size_t i = 0;
+        for (auto& op : circuit) {
+            if (auto tmp =
+                    std::get_if<std::pair<rotation_info, Gatelib::Rotation>>(
+                        &op))
+                ret[tmp->first.uid] = i;
+            i++;
+        }
+        return ret;
+    }
+
+    fold_result fold(circuit_callback& circuit) {
+        fold_result ret;
 
         for (auto it = circuit.rbegin(); it != circuit.rend(); it++) {
             auto& op = *it;
@@ -264,16 +500,12 @@ class RotationOptimizer final : public ast::Visitor {
                     std::get_if<std::pair<rotation_info, Gatelib::Rotation>>(
                         &op)) {
                 auto [new_phase, new_R] =
-                    fold_forward(circuit, std::next(it), tmp->second);
+                    fold_forward(circuit, std::next(it), tmp->second, ret);
 
-                global_phase += new_phase;
+                ret.global_phase += new_phase;
                 if (!(new_R == tmp->second)) {
-                    std::list<ast::ptr<ast::Gate>> subst;
-
-                    auto rot = alloc_rot(tmp->first, new_R.rotation_angle());
-                    if (rot)
-                        subst.emplace_back(rot);
-                    replacement_list_[tmp->first.uid] = std::move(subst);
+                    ret.changes.emplace_back(tmp->first,
+                                             new_R.rotation_angle());
 
                     // WARNING: this is a massive hack so that the global phase
                     // correction can be performed by the replacement engine. We
@@ -281,87 +513,92 @@ class RotationOptimizer final : public ast::Visitor {
                     // substitution in-place in the replacement list. Since we
                     // need a qubit to apply the phase correction on, we select
                     // the qubit on which the rotation itself was applied.
-                    tgt = &(tmp->first.arg);
-                    subst_ref = &(replacement_list_[tmp->first.uid]);
+                    ret.phase_target = tmp->first;
                 }
             }
         }
 
-        if (phase_correction && (global_phase != utils::angles::zero)) {
-            if (global_phase == utils::angles::pi) {
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "z", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "x", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "z", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "x", {}, {*tgt}));
-            } else if (global_phase == utils::angles::pi_half) {
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "s", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "x", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "s", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "x", {}, {*tgt}));
-            } else if (global_phase == -utils::angles::pi_half) {
-                subst_ref->emplace_back(new ast::DeclaredGate(
-                    parser::Position(), "sdg", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "x", {}, {*tgt}));
-                subst_ref->emplace_back(new ast::DeclaredGate(
-                    parser::Position(), "sdg", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "x", {}, {*tgt}));
-            } else if (global_phase == utils::angles::pi_quarter) {
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "h", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "s", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "h", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "s", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "h", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "s", {}, {*tgt}));
-            } else if (global_phase == -utils::angles::pi_quarter) {
-                subst_ref->emplace_back(new ast::DeclaredGate(
-                    parser::Position(), "sdg", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "h", {}, {*tgt}));
-                subst_ref->emplace_back(new ast::DeclaredGate(
-                    parser::Position(), "sdg", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "h", {}, {*tgt}));
-                subst_ref->emplace_back(new ast::DeclaredGate(
-                    parser::Position(), "sdg", {}, {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "h", {}, {*tgt}));
-            } else {
-                std::vector<ast::ptr<ast::Expr>> tmp1;
-                std::vector<ast::ptr<ast::Expr>> tmp2;
-                tmp1.emplace_back(ast::angle_to_expr(global_phase));
-                tmp2.emplace_back(ast::angle_to_expr(global_phase));
-
-                subst_ref->emplace_back(new ast::DeclaredGate(
-                    parser::Position(), "rz", std::move(tmp1), {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "x", {}, {*tgt}));
-                subst_ref->emplace_back(new ast::DeclaredGate(
-                    parser::Position(), "rz", std::move(tmp2), {*tgt}));
-                subst_ref->emplace_back(
-                    new ast::DeclaredGate(parser::Position(), "x", {}, {*tgt}));
-            }
+        return ret;
+    }
+
+    // Appends a global phase correction on the qubit tgt to subst
+    void correct_phase(std::list<ast::ptr<ast::Gate>>& subst,
+                       const ast::VarAccess& tgt,
+                       const utils::Angle& global_phase) {
+        if (global_phase == utils::angles::pi) {
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "z", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "x", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "z", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "x", {}, {tgt}));
+        } else if (global_phase == utils::angles::pi_half) {
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "s", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "x", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "s", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "x", {}, {tgt}));
+        } else if (global_phase == -utils::angles::pi_half) {
+            subst.emplace_back(new ast::DeclaredGate(
+                parser::Position(), "sdg", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "x", {}, {tgt}));
+            subst.emplace_back(new ast::DeclaredGate(
+                parser::Position(), "sdg", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "x", {}, {tgt}));
+        } else if (global_phase == utils::angles::pi_quarter) {
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "h", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "s", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "h", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "s", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "h", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "s", {}, {tgt}));
+        } else if (global_phase == -utils::angles::pi_quarter) {
+            subst.emplace_back(new ast::DeclaredGate(
+                parser::Position(), "sdg", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "h", {}, {tgt}));
+            subst.emplace_back(new ast::DeclaredGate(
+                parser::Position(), "sdg", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "h", {}, {tgt}));
+            subst.emplace_back(new ast::DeclaredGate(
+                parser::Position(), "sdg", {}, {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "h", {}, {tgt}));
+        } else {
+            std::vector<ast::ptr<ast::Expr>> tmp1;
+            std::vector<ast::ptr<ast::Expr>> tmp2;
+            tmp1.emplace_back(ast::angle_to_expr(global_phase));
+            tmp2.emplace_back(ast::angle_to_expr(global_phase));
+
+            subst.emplace_back(new ast::DeclaredGate(
+                parser::Position(), "rz", std::move(tmp1), {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "x", {}, {tgt}));
+            subst.emplace_back(new ast::DeclaredGate(
+                parser::Position(), "rz", std::move(tmp2), {tgt}));
+            subst.emplace_back(
+                new ast::DeclaredGate(parser::Position(), "x", {}, {tgt}));
         }
     }
 
     std::pair<utils::Angle, Gatelib::Rotation>
     fold_forward(circuit_callback& circuit,
-                 circuit_callback::reverse_iterator it, Gatelib::Rotation R) {
+                 circuit_callback::reverse_iterator it, Gatelib::Rotation R,
+                 fold_result& result) {
         // Tries to commute op backward as much as possible, merging with
         // applicable gates and deleting them as it goes Note: We go backwards
         // so that we only commute **left** past C^*/**right** past C
@@ -371,8 +608,8 @@ class RotationOptimizer final : public ast::Visitor {
 
         for (; cont && it != circuit.rend(); it++) {
             auto visitor = utils::overloaded{
-                [this, it, &R, &phase,
-                 &circuit](std::pair<rotation_info, Gatelib::Rotation>& P) {
+                [it, &R, &phase, &circuit,
+                 &result](std::pair<rotation_info, Gatelib::Rotation>& P) {
                     auto res = R.try_merge(P.second);
                     if (res) {
                         auto& [new_phase, new_R] = res.value();
@@ -380,8 +617,8 @@ class RotationOptimizer final : public ast::Visitor {
                         R = new_R;
 
                         // Delete R in circuit & the node
-                        replacement_list_[P.first.uid] =
-                            std::move(std::list<ast::ptr<ast::Gate>>());
+                        result.changes.emplace_back(P.first,
+                                                    utils::angles::zero);
                         circuit.erase(std::next(it).base());
 
                         return false;
@@ -408,12 +645,123 @@ class RotationOptimizer final : public ast::Visitor {
         return std::make_pair(phase, R);
     }
 
+    /* Windowed folding */
+    static constexpr std::size_t operators_per_rotation = 4;
+
+    // Merges the newest rotation with the nearest mergeable rotation among
+    // the last config_.window, then retires rotations leaving the window
+    void fold_window() {
+        auto it = std::prev(accum_.end());
+        auto& [rinfo, R] =
+            std::get<std::pair<rotation_info, Gatelib::Rotation>>(*it);
+        window_.rotations++;
+
+        auto walker = R;
+        std::size_t seen = 0;
+        for (auto jt = std::make_reverse_iterator(it);
+             jt != accum_.rend() && seen < config_.window; jt++) {
+            if (auto P =
+                    std::get_if<std::pair<rotation_info, Gatelib::Rotation>>(
+                        &(*jt))) {
+                seen++;
+                if (auto res = walker.try_merge(P->second)) {
+                    auto& [new_phase, new_R] = res.value();
+                    window_.global_phase += new_phase;
+                    R = Gatelib::Rotation(new_R.rotation_angle(), R.pauli());
+                    window_.merged.insert(rinfo.uid);
+
+                    // Delete P in circuit & the node
+                    window_.merged.erase(P->first.uid);
+                    replacement_list_[P->first.uid] =
+                        std::list<ast::ptr<ast::Gate>>();
+                    accum_.erase(std::next(jt).base());
+                    window_.rotations--;
+                    break;
+                } else if (!walker.commutes_with(P->second)) {
+                    break;
+                }
+            } else if (auto C = std::get_if<Gatelib::Clifford>(&(*jt))) {
+                walker = walker.commute_left(*C);
+            } else if (auto U = std::get_if<Gatelib::Uninterp>(&(*jt));
+                       !walker.commutes_with(*U)) {
+                break;
+            }
+        }
+
+        bound_window();
+    }
+
+    // Retires the oldest rotations until the window is within its rotation
+    // & operator budgets
+    void bound_window() {
+        while (window_.rotations > config_.window ||
+               (window_.rotations > 0 &&
+                accum_.size() > operators_per_rotation * config_.window))
+            retire();
+        trim_window();
+    }
+
+    // Finalizes the oldest rotation in the window
+    void retire() {
+        trim_window();
+
+        auto& [rinfo, R] =
+            std::get<std::pair<rotation_info, Gatelib::Rotation>>(
+                accum_.front());
+        if (window_.merged.erase(rinfo.uid) > 0) {
+            std::list<ast::ptr<ast::Gate>> subst;
+
+            auto rot = alloc_rot(rinfo, R.rotation_angle());
+            if (rot)
+                subst.emplace_back(rot);
+            replacement_list_[rinfo.uid] = std::move(subst);
+
+            if (!window_.phase_target)
+                window_.phase_target = rinfo;
+        }
+
+        accum_.pop_front();
+        window_.rotations--;
+    }
+
+    // Drops operators ahead of the oldest rotation, which no rotation can
+    // merge past
+    void trim_window() {
+        while (!accum_.empty() &&
+               !std::holds_alternative<
+                   std::pair<rotation_info, Gatelib::Rotation>>(
+                   accum_.front()))
+            accum_.pop_front();
+    }
+
+    // Retires all rotations and corrects the global phase
+    void flush_window(bool phase_correction) {
+        while (window_.rotations > 0)
+            retire();
+        accum_.clear();
+
+        if (phase_correction &&
+            (window_.global_phase != utils::angles::zero)) {
+            auto& tgt = *window_.phase_target;
+            correct_phase(replacement_list_[tgt.uid], tgt.arg,
+                          window_.global_phase);
+        }
+    }
+
     /* Utilities */
+    void push_rotation(const rotation_info& rinfo, Gatelib::Rotation R) {
+        accum_.push_back(std::make_pair(rinfo, R));
+        if (config_.window > 0)
+            fold_window();
+    }
+
     void push_uninterp(Gatelib::Uninterp op) {
         accum_.push_back(current_clifford_);
         accum_.push_back(op);
         // Clear the current clifford
         current_clifford_ = Gatelib::Clifford();
+        if (config_.window > 0)
+            bound_window();
     }
 
     // Assumes basic gates (x, y, z, s, sdg, t, tdg, rx, ry, rz) are defined
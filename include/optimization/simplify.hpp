@@ -28,7 +28,7 @@
  */
 #pragma once
 
-#include "ast/visitor.hpp"
+#include "ast/static_visitor.hpp"
 #include "ast/replacer.hpp"
 
 #include <tuple>
@@ -43,21 +43,21 @@ namespace optimization {
  */
 
 // TODO: Add option for global phase correction
-class Simplifier final : public ast::Visitor {
+class Simplifier final : public ast::StaticVisitor<Simplifier> {
   public:
     struct config {
         bool fixpoint = true;
     };
 
     Simplifier() = default;
-    Simplifier(const config& params) : Visitor(), config_(params) {}
+    Simplifier(const config& params) : config_(params) {}
     ~Simplifier() = default;
 
     void run(ast::ASTNode& node) {
         do {
             replace_gates(node, std::move(erasures_));
             reset();
-            node.accept(*this);
+            dispatch(node);
         } while (!erasures_.empty());
     }
 
@@ -81,7 +81,7 @@ class Simplifier final : public ast::Visitor {
     }
     void visit(ast::IfStmt& stmt) {
         mergeable_ = false;
-        stmt.then().accept(*this);
+        dispatch(stmt.then());
         mergeable_ = true;
     }
 
@@ -272,7 +272,7 @@ class Simplifier final : public ast::Visitor {
         std::swap(last_, local_state);
 
         // Process gate body
-        decl.foreach_stmt([this](auto& stmt) { stmt.accept(*this); });
+        decl.foreach_stmt([this](auto& stmt) { dispatch(stmt); });
 
         // Reset the state
         std::swap(last_, local_state);
@@ -283,7 +283,7 @@ class Simplifier final : public ast::Visitor {
 
     /* Program */
     void visit(ast::Program& prog) {
-        prog.foreach_stmt([this](auto& stmt) { stmt.accept(*this); });
+        prog.foreach_stmt([this](auto& stmt) { dispatch(stmt); });
     }
 
   private:
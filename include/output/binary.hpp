@@ -0,0 +1,278 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file output/binary.hpp
+ * \brief Binary circuit outputter
+ *
+ * See parser/binary.hpp for the format
+ */
+#pragma once
+
+#include "ast/ast.hpp"
+#include "parser/binary.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace staq {
+namespace output {
+
+/**
+ * \class staq::output::BinaryOutputter
+ * \brief Visitor serializing a QASM AST in the binary circuit format
+ *
+ * Unlike QASM output, declarations of standard library gates are kept, so
+ * reading the file back gives the same AST as parsing the source did
+ */
+class BinaryOutputter final : public ast::Visitor {
+  public:
+    BinaryOutputter(std::ostream& os) : Visitor(), os_(os) {}
+    ~BinaryOutputter() = default;
+
+    void run(ast::Program& prog) {
+        body_.clear();
+        strings_.clear();
+        string_ids_.clear();
+        reals_.clear();
+        real_ids_.clear();
+
+        prog.accept(*this);
+
+        // Header & tables, followed by the body
+        std::string header(parser::binary::magic,
+                           parser::binary::magic_size);
+        varint(header, parser::binary::version);
+        header.push_back(prog.std_include() ? parser::binary::std_include
+                                            : 0);
+        varint(header, strings_.size());
+        for (auto& str : strings_) {
+            varint(header, str.size());
+            header.append(str);
+        }
+        varint(header, reals_.size());
+        for (auto bits : reals_) {
+            for (auto i = 0; i < 8; i++)
+                header.push_back(static_cast<char>(bits >> (8 * i)));
+        }
+
+        os_.write(header.data(), header.size());
+        os_.write(body_.data(), body_.size());
+    }
+
+    // Variables
+    void visit(ast::VarAccess& ap) {
+        string(ap.var());
+        auto offset = ap.offset();
+        varint(body_, offset ? *offset + 1 : 0);
+    }
+
+    // Expressions
+    void visit(ast::BExpr& expr) {
+        tag(parser::binary::tag::bexpr);
+        body_.push_back(static_cast<char>(expr.op()));
+        expr.lexp().accept(*this);
+        expr.rexp().accept(*this);
+    }
+
+    void visit(ast::UExpr& expr) {
+        tag(parser::binary::tag::uexpr);
+        body_.push_back(static_cast<char>(expr.op()));
+        expr.subexp().accept(*this);
+    }
+
+    void visit(ast::PiExpr&) { tag(parser::binary::tag::pi); }
+
+    void visit(ast::IntExpr& expr) {
+        tag(parser::binary::tag::integer);
+        integer(expr.value());
+    }
+
+    void visit(ast::RealExpr& expr) {
+        tag(parser::binary::tag::real);
+        auto value = expr.value();
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        auto [it, inserted] = real_ids_.try_emplace(bits, reals_.size());
+        if (inserted)
+            reals_.push_back(bits);
+        varint(body_, it->second);
+    }
+
+    void visit(ast::VarExpr& expr) {
+        tag(parser::binary::tag::var);
+        string(expr.var());
+    }
+
+    // Statements
+    void visit(ast::MeasureStmt& stmt) {
+        tag(parser::binary::tag::measure);
+        stmt.q_arg().accept(*this);
+        stmt.c_arg().accept(*this);
+    }
+
+    void visit(ast::ResetStmt& stmt) {
+        tag(parser::binary::tag::reset);
+        stmt.arg().accept(*this);
+    }
+
+    void visit(ast::IfStmt& stmt) {
+        tag(parser::binary::tag::if_stmt);
+        string(stmt.var());
+        integer(stmt.cond());
+        stmt.then().accept(*this);
+    }
+
+    // Gates
+    void visit(ast::UGate& gate) {
+        tag(parser::binary::tag::ugate);
+        gate.theta().accept(*this);
+        gate.phi().accept(*this);
+        gate.lambda().accept(*this);
+        gate.arg().accept(*this);
+    }
+
+    void visit(ast::CNOTGate& gate) {
+        tag(parser::binary::tag::cnot);
+        gate.ctrl().accept(*this);
+        gate.tgt().accept(*this);
+    }
+
+    void visit(ast::BarrierGate& gate) {
+        tag(parser::binary::tag::barrier);
+        varint(body_, gate.num_args());
+        gate.foreach_arg([this](auto& arg) { arg.accept(*this); });
+    }
+
+    void visit(ast::DeclaredGate& gate) {
+        tag(parser::binary::tag::declared_gate);
+        string(gate.name());
+        varint(body_, gate.num_cargs());
+        gate.foreach_carg([this](auto& arg) { arg.accept(*this); });
+        varint(body_, gate.num_qargs());
+        gate.foreach_qarg([this](auto& arg) { arg.accept(*this); });
+    }
+
+    // Declarations
+    void visit(ast::GateDecl& decl) {
+        tag(parser::binary::tag::gate_decl);
+        body_.push_back(decl.is_opaque() ? 1 : 0);
+        string(decl.id());
+        strings(decl.c_params());
+        strings(decl.q_params());
+        if (!decl.is_opaque()) {
+            varint(body_, decl.body().size());
+            decl.foreach_stmt([this](auto& gate) { gate.accept(*this); });
+        }
+    }
+
+    void visit(ast::OracleDecl& decl) {
+        tag(parser::binary::tag::oracle_decl);
+        string(decl.id());
+        strings(decl.params());
+        string(decl.fname());
+    }
+
+    void visit(ast::RegisterDecl& decl) {
+        tag(parser::binary::tag::register_decl);
+        body_.push_back(decl.is_quantum() ? 1 : 0);
+        string(decl.id());
+        integer(decl.size());
+    }
+
+    void visit(ast::AncillaDecl& decl) {
+        tag(parser::binary::tag::ancilla_decl);
+        body_.push_back(decl.is_dirty() ? 1 : 0);
+        string(decl.id());
+        integer(decl.size());
+    }
+
+    // Program
+    void visit(ast::Program& prog) {
+        varint(body_, prog.body().size());
+        prog.foreach_stmt([this](auto& stmt) { stmt.accept(*this); });
+    }
+
+  private:
+    std::ostream& os_;
+    std::string body_;
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, std::size_t> string_ids_;
+    std::vector<uint64_t> reals_;
+    std::unordered_map<uint64_t, std::size_t> real_ids_;
+
+    static void varint(std::string& buf, uint64_t value) {
+        while (value >= 0x80) {
+            buf.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        buf.push_back(static_cast<char>(value));
+    }
+
+    void integer(int value) {
+        auto v = static_cast<int64_t>(value);
+        varint(body_, (static_cast<uint64_t>(v) << 1) ^
+                          static_cast<uint64_t>(v >> 63));
+    }
+
+    void tag(parser::binary::tag t) { body_.push_back(static_cast<char>(t)); }
+
+    void string(const std::string& str) {
+        auto [it, inserted] = string_ids_.try_emplace(str, strings_.size());
+        if (inserted)
+            strings_.push_back(str);
+        varint(body_, it->second);
+    }
+
+    void strings(const std::vector<ast::symbol>& strs) {
+        varint(body_, strs.size());
+        for (auto& str : strs)
+            string(str);
+    }
+};
+
+/** \brief Writes an AST in the binary circuit format to stdout */
+inline void output_binary(ast::Program& prog) {
+    BinaryOutputter outputter(std::cout);
+    outputter.run(prog);
+}
+
+/** \brief Writes an AST in the binary circuit format to a given file */
+inline void write_binary(ast::Program& prog, std::string fname) {
+    std::ofstream ofs;
+    ofs.open(fname, std::ofstream::binary);
+
+    if (!ofs.good()) {
+        std::cerr << "Error: failed to open output file " << fname << "\n";
+    } else {
+        BinaryOutputter outputter(ofs);
+        outputter.run(prog);
+    }
+
+    ofs.close();
+}
+
+} // namespace output
+} // namespace staq
@@ -29,6 +29,7 @@
 #pragma once
 
 #include "ast/ast.hpp"
+#include "output/loops.hpp"
 
 #include <typeinfo>
 
@@ -52,6 +53,7 @@ class CirqOutputter final : public ast::Visitor {
   public:
     struct config {
         std::string circuit_name = "circuit";
+        bool loops = false; ///< fold repeated operations into comprehensions
     };
 
     CirqOutputter(std::ostream& os) : Visitor(), os_(os) {}
@@ -62,12 +64,14 @@ class CirqOutputter final : public ast::Visitor {
     void run(ast::Program& prog) {
         prefix_ = "";
         ambiguous_ = false;
+        loop_ = nullptr;
+        index_ = loop_variable(prog);
 
         prog.accept(*this);
     }
 
     // Variables
-    void visit(ast::VarAccess& ap) { os_ << ap; }
+    void visit(ast::VarAccess& ap) { print_access(os_, ap, loop_, index_); }
 
     // Expressions
     void visit(ast::BExpr& expr) {
@@ -116,9 +120,18 @@ class CirqOutputter final : public ast::Visitor {
 
     // Statements
     void visit(ast::MeasureStmt& stmt) {
-        os_ << prefix_ << "cirq.measure(" << stmt.q_arg() << ", key=\""
-            << stmt.c_arg() << "\")";
-        os_ << ",\n";
+        os_ << prefix_ << "cirq.measure(";
+        stmt.q_arg().accept(*this);
+        os_ << ", key=";
+        if (loop_ && loop_->strides.count(&stmt.c_arg())) {
+            os_ << "\"" << stmt.c_arg().var() << "[{}]\".format(";
+            os_ << loop_index(*stmt.c_arg().offset(),
+                              loop_->strides.at(&stmt.c_arg()), index_);
+            os_ << ")";
+        } else {
+            os_ << "\"" << stmt.c_arg() << "\"";
+        }
+        os_ << "),\n";
     }
 
     void visit(ast::ResetStmt& stmt) {
@@ -327,11 +340,19 @@ class CirqOutputter final : public ast::Visitor {
         prefix_ = "    ";
 
         // Program body
-        prog.foreach_stmt([this](auto& stmt) {
+        std::vector<ast::Stmt*> stmts;
+        prog.foreach_stmt([&stmts](auto& stmt) {
             if (typeid(stmt) != typeid(ast::GateDecl) &&
                 typeid(stmt) != typeid(ast::RegisterDecl))
-                stmt.accept(*this);
+                stmts.push_back(&stmt);
         });
+        if (config_.loops) {
+            for (auto& block : find_loops(stmts))
+                emit(block);
+        } else {
+            for (auto stmt : stmts)
+                stmt->accept(*this);
+        }
 
         os_ << "])\n\nprint(" << config_.circuit_name << ")";
         prefix_ = "";
@@ -343,6 +364,26 @@ class CirqOutputter final : public ast::Visitor {
 
     std::string prefix_ = "";
     bool ambiguous_ = false;
+    const loop* loop_ = nullptr; ///< the loop being printed, if any
+    std::string index_ = "i";    ///< the loop variable
+
+    /** \brief Prints a block of operations, as a comprehension if repeated */
+    void emit(const loop& block) {
+        if (block.count == 1) {
+            block.body.front()->accept(*this);
+            return;
+        }
+
+        os_ << prefix_ << "[(\n";
+        prefix_ += "    ";
+        loop_ = &block;
+        for (auto stmt : block.body)
+            stmt->accept(*this);
+        loop_ = nullptr;
+        prefix_.resize(prefix_.size() - 4);
+        os_ << prefix_ << ") for " << index_ << " in range(" << block.count
+            << ")],\n";
+    }
 
     // Hack because lambda is reserved by python
     std::string sanitize(const std::string& id) {
@@ -354,20 +395,22 @@ class CirqOutputter final : public ast::Visitor {
 };
 
 /** \brief Writes an AST in Cirq format to a stdout */
-void output_cirq(ast::Program& prog) {
-    CirqOutputter outputter(std::cout);
+void output_cirq(ast::Program& prog,
+                 const CirqOutputter::config& params = {}) {
+    CirqOutputter outputter(std::cout, params);
     outputter.run(prog);
 }
 
 /** \brief Writes an AST in Cirq format to a given output stream */
-void write_cirq(ast::Program& prog, std::string fname) {
+void write_cirq(ast::Program& prog, std::string fname,
+                const CirqOutputter::config& params = {}) {
     std::ofstream ofs;
     ofs.open(fname);
 
     if (!ofs.good()) {
         std::cerr << "Error: failed to open output file " << fname << "\n";
     } else {
-        CirqOutputter outputter(ofs);
+        CirqOutputter outputter(ofs, params);
         outputter.run(prog);
     }
 
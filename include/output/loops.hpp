@@ -0,0 +1,248 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file output/loops.hpp
+ * \brief Detection of loops in straight-line circuits
+ *
+ * Used by the source-code outputters to fold the statements produced by
+ * expanding register arguments or inlining repeated gates back into loops
+ */
+#pragma once
+
+#include "ast/traversal.hpp"
+
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace staq {
+namespace output {
+
+/**
+ * \brief A block of statements executed count times
+ *
+ * On iteration i, each access of the body listed in strides is offset by
+ * i times its stride. A block with a count of 1 is the body as is.
+ */
+struct loop {
+    std::vector<ast::Stmt*> body;
+    int count = 1;
+    std::unordered_map<const ast::VarAccess*, int> strides{};
+};
+
+/**
+ * \brief Formats the index base + stride * var
+ */
+inline std::string loop_index(int base, int stride, const std::string& var) {
+    std::string ret;
+    if (stride == 0)
+        return std::to_string(base);
+    if (stride == 1)
+        ret = var;
+    else if (stride == -1)
+        ret = "-" + var;
+    else
+        ret = std::to_string(stride) + "*" + var;
+
+    if (base > 0)
+        ret += " + " + std::to_string(base);
+    else if (base < 0)
+        ret += " - " + std::to_string(-base);
+    return ret;
+}
+
+/**
+ * \brief Prints a variable access inside a loop
+ *
+ * Accesses moving with the loop are indexed by the loop variable var
+ */
+inline void print_access(std::ostream& os, const ast::VarAccess& ap,
+                         const loop* block, const std::string& var) {
+    if (block) {
+        if (auto it = block->strides.find(&ap); it != block->strides.end()) {
+            os << ap.var() << "[" << loop_index(*ap.offset(), it->second, var)
+               << "]";
+            return;
+        }
+    }
+    os << ap;
+}
+
+/**
+ * \brief Picks a loop variable not declared at the top level of a program
+ */
+inline std::string loop_variable(ast::Program& prog) {
+    std::unordered_set<std::string> ids;
+    prog.foreach_stmt([&ids](auto& stmt) {
+        if (auto decl = dynamic_cast<ast::Decl*>(&stmt))
+            ids.insert(decl->id());
+    });
+
+    std::string ret = "i";
+    while (ids.find(ret) != ids.end())
+        ret += "_";
+    return ret;
+}
+
+/**
+ * \brief Groups a sequence of statements into loops
+ *
+ * A loop is a block of up to max_period consecutive statements repeated
+ * with every index moving by a constant stride, at least one of which is
+ * non-zero. Only gates, measurements and resets applied to individual
+ * qubits & bits are folded. Blocks are only folded when it shortens the
+ * output, and the shortest block covering the most statements is chosen.
+ */
+inline std::vector<loop> find_loops(const std::vector<ast::Stmt*>& stmts,
+                                    std::size_t max_period = 16) {
+    /* Collects the variable accesses of a statement in order */
+    class access_collector final : public ast::Traverse {
+      public:
+        std::vector<ast::VarAccess*> accesses;
+
+        void visit(ast::VarAccess& ap) override { accesses.push_back(&ap); }
+    };
+
+    /* Statements of a given shape, with the indices it is applied to */
+    struct shape {
+        int id = -1; // equal for statements differing only in indices
+        std::vector<ast::VarAccess*> accesses;
+    };
+
+    // Classify statements by their text with indices removed
+    std::vector<shape> shapes(stmts.size());
+    std::unordered_map<std::string, int> ids;
+    for (std::size_t i = 0; i < stmts.size(); i++) {
+        auto& stmt = *stmts[i];
+        if (typeid(stmt) == typeid(ast::IfStmt) ||
+            typeid(stmt) == typeid(ast::BarrierGate) ||
+            dynamic_cast<ast::Decl*>(&stmt))
+            continue;
+
+        access_collector collector;
+        stmt.accept(collector);
+        auto indexed = true;
+        for (auto ap : collector.accesses)
+            indexed = indexed && ap->offset();
+        if (!indexed)
+            continue;
+
+        std::ostringstream text;
+        text.precision(17);
+        text << stmt;
+        std::string key;
+        auto str = text.str();
+        for (std::size_t j = 0; j < str.size(); j++) {
+            key.push_back(str[j]);
+            if (str[j] == '[')
+                j = str.find(']', j) - 1;
+        }
+
+        shapes[i].id = ids.try_emplace(key, ids.size()).first->second;
+        shapes[i].accesses = std::move(collector.accesses);
+    }
+
+    auto offset = [&shapes](std::size_t i, std::size_t j) {
+        return *shapes[i].accesses[j]->offset();
+    };
+
+    std::vector<loop> ret;
+    for (std::size_t start = 0; start < stmts.size();) {
+        std::size_t best_period = 1;
+        std::size_t best_count = 1;
+        for (std::size_t period = 1;
+             period <= max_period && start + 2 * period <= stmts.size();
+             period++) {
+            // The strides, from the first two iterations
+            auto moves = false;
+            auto matches = true;
+            for (std::size_t j = start; matches && j < start + period; j++) {
+                auto& cur = shapes[j];
+                auto& next = shapes[j + period];
+                matches = cur.id != -1 && cur.id == next.id;
+                for (std::size_t k = 0; matches && k < cur.accesses.size();
+                     k++) {
+                    matches = cur.accesses[k]->var() ==
+                              next.accesses[k]->var();
+                    moves = moves || offset(j, k) != offset(j + period, k);
+                }
+            }
+            if (!matches || !moves)
+                continue;
+
+            // Extend to as many iterations as follow the pattern
+            std::size_t count = 2;
+            for (; matches && start + (count + 1) * period <= stmts.size();
+                 count++) {
+                for (std::size_t j = start; matches && j < start + period;
+                     j++) {
+                    auto& cur = shapes[j];
+                    auto k = j + count * period;
+                    matches = shapes[k].id == cur.id;
+                    for (std::size_t l = 0;
+                         matches && l < cur.accesses.size(); l++) {
+                        auto stride = offset(j + period, l) - offset(j, l);
+                        matches = shapes[k].accesses[l]->var() ==
+                                      cur.accesses[l]->var() &&
+                                  offset(k, l) ==
+                                      offset(j, l) +
+                                          static_cast<int>(count) * stride;
+                    }
+                }
+                if (!matches)
+                    break;
+            }
+
+            // A loop takes one line more than its body
+            if ((count - 1) * period > 1 &&
+                count * period > best_count * best_period) {
+                best_period = period;
+                best_count = count;
+            }
+        }
+
+        loop block;
+        block.count = static_cast<int>(best_count);
+        for (auto j = start; j < start + best_period; j++) {
+            block.body.push_back(stmts[j]);
+            if (best_count == 1)
+                continue;
+            for (std::size_t k = 0; k < shapes[j].accesses.size(); k++) {
+                auto stride = offset(j + best_period, k) - offset(j, k);
+                if (stride != 0)
+                    block.strides[shapes[j].accesses[k]] = stride;
+            }
+        }
+        ret.emplace_back(std::move(block));
+        start += best_period * best_count;
+    }
+
+    return ret;
+}
+
+} // namespace output
+} // namespace staq
@@ -29,6 +29,7 @@
 #pragma once
 
 #include "ast/ast.hpp"
+#include "output/loops.hpp"
 
 #include <typeinfo>
 
@@ -53,6 +54,7 @@ class ProjectQOutputter final : public ast::Visitor {
     struct config {
         bool standalone = true;
         std::string circuit_name = "qasmcircuit";
+        bool loops = false; ///< fold repeated statements into for loops
     };
 
     ProjectQOutputter(std::ostream& os) : Visitor(), os_(os) {}
@@ -64,12 +66,14 @@ class ProjectQOutputter final : public ast::Visitor {
         prefix_ = "";
         ambiguous_ = false;
         ancillas_.clear();
+        loop_ = nullptr;
+        index_ = loop_variable(prog);
 
         prog.accept(*this);
     }
 
     // Variables
-    void visit(ast::VarAccess& ap) { os_ << ap; }
+    void visit(ast::VarAccess& ap) { print_access(os_, ap, loop_, index_); }
 
     // Expressions
     void visit(ast::BExpr& expr) {
@@ -118,12 +122,19 @@ class ProjectQOutputter final : public ast::Visitor {
 
     // Statements
     void visit(ast::MeasureStmt& stmt) {
-        os_ << prefix_ << "ops.Measure | " << stmt.q_arg() << "\n";
-        os_ << prefix_ << stmt.c_arg() << " = int(" << stmt.q_arg() << ")\n";
+        os_ << prefix_ << "ops.Measure | ";
+        stmt.q_arg().accept(*this);
+        os_ << "\n" << prefix_;
+        stmt.c_arg().accept(*this);
+        os_ << " = int(";
+        stmt.q_arg().accept(*this);
+        os_ << ")\n";
     }
 
     void visit(ast::ResetStmt& stmt) {
-        os_ << prefix_ << "Reset | " << stmt.arg() << "\n";
+        os_ << prefix_ << "Reset | ";
+        stmt.arg().accept(*this);
+        os_ << "\n";
     }
 
     void visit(ast::IfStmt& stmt) {
@@ -380,10 +391,18 @@ class ProjectQOutputter final : public ast::Visitor {
         prefix_ = "    ";
 
         // Program body
-        prog.foreach_stmt([this](auto& stmt) {
+        std::vector<ast::Stmt*> stmts;
+        prog.foreach_stmt([&stmts](auto& stmt) {
             if (typeid(stmt) != typeid(ast::GateDecl))
-                stmt.accept(*this);
+                stmts.push_back(&stmt);
         });
+        if (config_.loops) {
+            for (auto& block : find_loops(stmts))
+                emit(block);
+        } else {
+            for (auto stmt : stmts)
+                stmt->accept(*this);
+        }
 
         os_ << "\n";
         prefix_ = "";
@@ -397,6 +416,25 @@ class ProjectQOutputter final : public ast::Visitor {
     std::string eng_ = "eng";
     std::list<std::pair<std::string, int>> ancillas_{};
     bool ambiguous_ = false;
+    const loop* loop_ = nullptr; ///< the loop being printed, if any
+    std::string index_ = "i";    ///< the loop variable
+
+    /** \brief Prints a block of statements, as a loop if repeated */
+    void emit(const loop& block) {
+        if (block.count == 1) {
+            block.body.front()->accept(*this);
+            return;
+        }
+
+        os_ << prefix_ << "for " << index_ << " in range(" << block.count
+            << "):\n";
+        prefix_ += "    ";
+        loop_ = &block;
+        for (auto stmt : block.body)
+            stmt->accept(*this);
+        loop_ = nullptr;
+        prefix_.resize(prefix_.size() - 4);
+    }
 
     // Hack because lambda is reserved by python
     std::string sanitize(const std::string& id) {
@@ -408,20 +446,22 @@ class ProjectQOutputter final : public ast::Visitor {
 };
 
 /** \brief Writes an AST in ProjectQ format to a stdout */
-void output_projectq(ast::Program& prog) {
-    ProjectQOutputter outputter(std::cout);
+void output_projectq(ast::Program& prog,
+                     const ProjectQOutputter::config& params = {}) {
+    ProjectQOutputter outputter(std::cout, params);
     outputter.run(prog);
 }
 
 /** \brief Writes an AST in ProjectQ format to a given output stream */
-void write_projectq(ast::Program& prog, std::string fname) {
+void write_projectq(ast::Program& prog, std::string fname,
+                    const ProjectQOutputter::config& params = {}) {
     std::ofstream ofs;
     ofs.open(fname);
 
     if (!ofs.good()) {
         std::cerr << "Error: failed to open output file " << fname << "\n";
     } else {
-        ProjectQOutputter outputter(ofs);
+        ProjectQOutputter outputter(ofs, params);
         outputter.run(prog);
     }
 
@@ -0,0 +1,432 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file output/qasm.hpp
+ * \brief Buffered QASM outputter
+ */
+#pragma once
+
+#ifndef FMT_HEADER_ONLY
+#define FMT_HEADER_ONLY = true
+#endif
+#include <fmt/format.h>
+
+#include "ast/ast.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace staq {
+namespace output {
+
+/**
+ * \class staq::output::QASMFormatter
+ * \brief Visitor formatting a QASM AST into a memory buffer
+ *
+ * Produces the same text as pretty printing the AST, without going through
+ * std::ostream insertions
+ */
+class QASMFormatter final : public ast::Visitor {
+  public:
+    /**
+     * \param buf The buffer to append to
+     * \param suppress_std Whether to omit declarations of qelib1 gates
+     */
+    QASMFormatter(fmt::memory_buffer& buf, bool suppress_std = false)
+        : Visitor(), buf_(buf), suppress_std_(suppress_std) {}
+    ~QASMFormatter() = default;
+
+    // Variables
+    void visit(ast::VarAccess& ap) {
+        append(ap.var());
+        if (auto offset = ap.offset()) {
+            append("[");
+            append(*offset);
+            append("]");
+        }
+    }
+
+    // Expressions
+    void visit(ast::BExpr& expr) {
+        auto tmp = ctx_;
+        ctx_ = true;
+        if (tmp)
+            append("(");
+        expr.lexp().accept(*this);
+        append(binary_op(expr.op()));
+        ctx_ = true;
+        expr.rexp().accept(*this);
+        if (tmp)
+            append(")");
+        ctx_ = tmp;
+    }
+
+    void visit(ast::UExpr& expr) {
+        auto tmp = ctx_;
+        append(unary_op(expr.op()));
+        if (expr.op() == ast::UnaryOp::Neg) {
+            ctx_ = true;
+            expr.subexp().accept(*this);
+        } else {
+            ctx_ = false;
+            append("(");
+            expr.subexp().accept(*this);
+            append(")");
+        }
+        ctx_ = tmp;
+    }
+
+    void visit(ast::PiExpr&) { append("pi"); }
+    void visit(ast::IntExpr& expr) { append(expr.value()); }
+    void visit(ast::RealExpr& expr) {
+        // Matches the default floating point format of std::ostream
+        fmt::format_to(buf_, "{:g}", expr.value());
+    }
+    void visit(ast::VarExpr& expr) { append(expr.var()); }
+
+    // Statements
+    void visit(ast::MeasureStmt& stmt) {
+        append("measure ");
+        stmt.q_arg().accept(*this);
+        append(" -> ");
+        stmt.c_arg().accept(*this);
+        append(";\n");
+    }
+
+    void visit(ast::ResetStmt& stmt) {
+        append("reset ");
+        stmt.arg().accept(*this);
+        append(";\n");
+    }
+
+    void visit(ast::IfStmt& stmt) {
+        append("if (");
+        append(stmt.var());
+        append("==");
+        append(stmt.cond());
+        append(") ");
+        stmt.then().accept(*this);
+    }
+
+    // Gates
+    void visit(ast::UGate& gate) {
+        append("U(");
+        expression(gate.theta());
+        append(",");
+        expression(gate.phi());
+        append(",");
+        expression(gate.lambda());
+        append(") ");
+        gate.arg().accept(*this);
+        append(";\n");
+    }
+
+    void visit(ast::CNOTGate& gate) {
+        append("CX ");
+        gate.ctrl().accept(*this);
+        append(",");
+        gate.tgt().accept(*this);
+        append(";\n");
+    }
+
+    void visit(ast::BarrierGate& gate) {
+        append("barrier ");
+        auto first = true;
+        gate.foreach_arg([this, &first](auto& arg) {
+            if (!first)
+                append(",");
+            first = false;
+            arg.accept(*this);
+        });
+        append(";\n");
+    }
+
+    void visit(ast::DeclaredGate& gate) {
+        append(gate.name());
+        if (gate.num_cargs() > 0) {
+            append("(");
+            auto first = true;
+            gate.foreach_carg([this, &first](auto& arg) {
+                if (!first)
+                    append(",");
+                first = false;
+                expression(arg);
+            });
+            append(")");
+        }
+        append(" ");
+        auto first = true;
+        gate.foreach_qarg([this, &first](auto& arg) {
+            if (!first)
+                append(",");
+            first = false;
+            arg.accept(*this);
+        });
+        append(";\n");
+    }
+
+    // Declarations
+    void visit(ast::GateDecl& decl) {
+        if (suppress_std_ && ast::is_std_qelib(decl.id()))
+            return;
+
+        append(decl.is_opaque() ? "opaque " : "gate ");
+        append(decl.id());
+        if (decl.c_params().size() > 0) {
+            append("(");
+            list(decl.c_params());
+            append(")");
+        }
+        append(" ");
+        list(decl.q_params());
+        if (decl.is_opaque()) {
+            append(";\n");
+        } else {
+            append(" {\n");
+            decl.foreach_stmt([this](auto& gate) {
+                append("\t");
+                gate.accept(*this);
+            });
+            append("}\n");
+        }
+    }
+
+    void visit(ast::OracleDecl& decl) {
+        append("oracle ");
+        append(decl.id());
+        append(" ");
+        list(decl.params());
+        append(" { \"");
+        append(decl.fname());
+        append("\" }\n");
+    }
+
+    void visit(ast::RegisterDecl& decl) {
+        append(decl.is_quantum() ? "qreg " : "creg ");
+        append(decl.id());
+        append("[");
+        append(decl.size());
+        append("];\n");
+    }
+
+    void visit(ast::AncillaDecl& decl) {
+        if (decl.is_dirty())
+            append("dirty ");
+        append("ancilla ");
+        append(decl.id());
+        append("[");
+        append(decl.size());
+        append("];\n");
+    }
+
+    // Program
+    void visit(ast::Program& prog) {
+        header(prog);
+        prog.foreach_stmt([this](auto& stmt) { stmt.accept(*this); });
+    }
+
+    /** \brief Formats the preamble of a program */
+    void header(const ast::Program& prog) {
+        append("OPENQASM 2.0;\n");
+        if (prog.std_include())
+            append("include \"qelib1.inc\";\n");
+        append("\n");
+    }
+
+  private:
+    fmt::memory_buffer& buf_;
+    bool suppress_std_;
+    bool ctx_ = false; ///< whether a binary expression needs parentheses
+
+    void append(std::string_view str) {
+        buf_.append(str.data(), str.data() + str.size());
+    }
+    void append(int value) {
+        fmt::format_int str(value);
+        buf_.append(str.data(), str.data() + str.size());
+    }
+
+    void expression(ast::Expr& expr) {
+        ctx_ = false;
+        expr.accept(*this);
+    }
+
+    void list(const std::vector<ast::symbol>& ids) {
+        for (auto it = ids.begin(); it != ids.end(); it++) {
+            if (it != ids.begin())
+                append(",");
+            append(*it);
+        }
+    }
+
+    static std::string_view binary_op(ast::BinaryOp op) {
+        switch (op) {
+            case ast::BinaryOp::Plus:
+                return "+";
+            case ast::BinaryOp::Minus:
+                return "-";
+            case ast::BinaryOp::Times:
+                return "*";
+            case ast::BinaryOp::Divide:
+                return "/";
+            case ast::BinaryOp::Pow:
+                return "^";
+        }
+        return "";
+    }
+
+    static std::string_view unary_op(ast::UnaryOp op) {
+        switch (op) {
+            case ast::UnaryOp::Neg:
+                return "-";
+            case ast::UnaryOp::Sin:
+                return "sin";
+            case ast::UnaryOp::Cos:
+                return "cos";
+            case ast::UnaryOp::Tan:
+                return "tan";
+            case ast::UnaryOp::Ln:
+                return "ln";
+            case ast::UnaryOp::Sqrt:
+                return "sqrt";
+            case ast::UnaryOp::Exp:
+                return "exp";
+        }
+        return "";
+    }
+};
+
+/**
+ * \class staq::output::QASMOutputter
+ * \brief Writes a QASM AST through large contiguous buffers
+ *
+ * Statements are formatted into memory and written out a buffer at a time.
+ * With several threads, consecutive blocks of statements are formatted
+ * concurrently and written in order, so the output does not depend on the
+ * number of threads.
+ */
+class QASMOutputter {
+  public:
+    struct config {
+        unsigned num_threads = 1;          ///< threads formatting statements
+        std::size_t block_size = 1 << 14;  ///< statements per formatting task
+        std::size_t buffer_size = 1 << 20; ///< bytes buffered between writes
+    };
+
+    QASMOutputter(std::ostream& os) : os_(os) {}
+    QASMOutputter(std::ostream& os, const config& params)
+        : os_(os), config_(params) {}
+
+    void run(ast::Program& prog) {
+        auto suppress_std = prog.std_include();
+        fmt::memory_buffer buf;
+        QASMFormatter formatter(buf, suppress_std);
+        formatter.header(prog);
+
+        if (config_.num_threads <= 1) {
+            prog.foreach_stmt([this, &buf, &formatter](auto& stmt) {
+                stmt.accept(formatter);
+                if (buf.size() >= config_.buffer_size)
+                    flush(buf);
+            });
+            flush(buf);
+            return;
+        }
+        flush(buf);
+
+        std::vector<ast::Stmt*> stmts;
+        prog.foreach_stmt([&stmts](auto& stmt) { stmts.push_back(&stmt); });
+
+        // Format one block per thread at a time, then write them in order
+        auto block_size = std::max<std::size_t>(config_.block_size, 1);
+        std::vector<fmt::memory_buffer> bufs(config_.num_threads);
+        for (std::size_t start = 0; start < stmts.size();
+             start += bufs.size() * block_size) {
+            auto remaining = stmts.size() - start;
+            auto num_blocks = std::min(
+                bufs.size(), (remaining + block_size - 1) / block_size);
+
+            std::atomic<std::size_t> next = 0;
+            auto worker = [&]() {
+                for (auto i = next++; i < num_blocks; i = next++) {
+                    QASMFormatter block_formatter(bufs[i], suppress_std);
+                    auto first = start + i * block_size;
+                    auto last = std::min(first + block_size, stmts.size());
+                    for (auto j = first; j < last; j++)
+                        stmts[j]->accept(block_formatter);
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (std::size_t i = 1; i < num_blocks; i++)
+                workers.emplace_back(worker);
+            worker();
+            for (auto& thread : workers)
+                thread.join();
+
+            for (std::size_t i = 0; i < num_blocks; i++)
+                flush(bufs[i]);
+        }
+    }
+
+  private:
+    std::ostream& os_;
+    config config_;
+
+    void flush(fmt::memory_buffer& buf) {
+        os_.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        buf.clear();
+    }
+};
+
+/** \brief Writes an AST in QASM format to stdout */
+inline void output_qasm(ast::Program& prog,
+                        const QASMOutputter::config& params = {}) {
+    QASMOutputter outputter(std::cout, params);
+    outputter.run(prog);
+}
+
+/** \brief Writes an AST in QASM format to a given output file */
+inline void write_qasm(ast::Program& prog, std::string fname,
+                       const QASMOutputter::config& params = {}) {
+    std::ofstream ofs;
+    ofs.open(fname);
+
+    if (!ofs.good()) {
+        std::cerr << "Error: failed to open output file " << fname << "\n";
+    } else {
+        QASMOutputter outputter(ofs, params);
+        outputter.run(prog);
+    }
+
+    ofs.close();
+}
+
+} // namespace output
+} // namespace staq
@@ -29,6 +29,7 @@
 #pragma once
 
 #include "ast/ast.hpp"
+#include "output/loops.hpp"
 
 #include <typeinfo>
 #include <iomanip>
@@ -68,6 +69,7 @@ class QSharpOutputter final : public ast::Visitor {
         bool driver = false;
         std::string ns = "Quantum.staq";
         std::string opname = "Circuit";
+        bool loops = false; ///< fold repeated statements into for loops
     };
 
     QSharpOutputter(std::ostream& os) : Visitor(), os_(os) {}
@@ -79,12 +81,14 @@ class QSharpOutputter final : public ast::Visitor {
         prefix_ = "";
         ambiguous_ = false;
         locals_.clear();
+        loop_ = nullptr;
+        index_ = loop_variable(prog);
 
         prog.accept(*this);
     }
 
     // Variables
-    void visit(ast::VarAccess& ap) { os_ << ap; }
+    void visit(ast::VarAccess& ap) { print_access(os_, ap, loop_, index_); }
 
     // Expressions
     void visit(ast::BExpr& expr) {
@@ -176,13 +180,21 @@ class QSharpOutputter final : public ast::Visitor {
     // Statements
     void visit(ast::MeasureStmt& stmt) {
         // Arrays are immutable in Q#
-        os_ << prefix_ << "set " << stmt.c_arg().var();
-        os_ << " w/= " << *(stmt.c_arg().offset());
-        os_ << " <- M(" << stmt.q_arg() << ");\n";
+        os_ << prefix_ << "set " << stmt.c_arg().var() << " w/= ";
+        if (loop_ && loop_->strides.count(&stmt.c_arg()))
+            os_ << loop_index(*stmt.c_arg().offset(),
+                              loop_->strides.at(&stmt.c_arg()), index_);
+        else
+            os_ << *(stmt.c_arg().offset());
+        os_ << " <- M(";
+        stmt.q_arg().accept(*this);
+        os_ << ");\n";
     }
 
     void visit(ast::ResetStmt& stmt) {
-        os_ << prefix_ << "Reset(" << stmt.arg() << ");\n";
+        os_ << prefix_ << "Reset(";
+        stmt.arg().accept(*this);
+        os_ << ");\n";
     }
 
     void visit(ast::IfStmt& stmt) {
@@ -334,10 +346,18 @@ class QSharpOutputter final : public ast::Visitor {
         // Program body
         os_ << prefix_ << "operation " << config_.opname << "() : Unit {\n";
         prefix_ += "    ";
-        prog.foreach_stmt([this](auto& stmt) {
+        std::vector<ast::Stmt*> stmts;
+        prog.foreach_stmt([&stmts](auto& stmt) {
             if (typeid(stmt) != typeid(ast::GateDecl))
-                stmt.accept(*this);
+                stmts.push_back(&stmt);
         });
+        if (config_.loops) {
+            for (auto& block : find_loops(stmts))
+                emit(block);
+        } else {
+            for (auto stmt : stmts)
+                stmt->accept(*this);
+        }
 
         // Reset all qubits
         os_ << "\n";
@@ -364,23 +384,45 @@ class QSharpOutputter final : public ast::Visitor {
     std::string prefix_ = "";
     std::list<std::string> locals_{};
     bool ambiguous_ = false;
+    const loop* loop_ = nullptr; ///< the loop being printed, if any
+    std::string index_ = "i";    ///< the loop variable
+
+    /** \brief Prints a block of statements, as a loop if repeated */
+    void emit(const loop& block) {
+        if (block.count == 1) {
+            block.body.front()->accept(*this);
+            return;
+        }
+
+        os_ << prefix_ << "for (" << index_ << " in 0 .. " << block.count - 1
+            << ") {\n";
+        prefix_ += "    ";
+        loop_ = &block;
+        for (auto stmt : block.body)
+            stmt->accept(*this);
+        loop_ = nullptr;
+        prefix_.resize(prefix_.size() - 4);
+        os_ << prefix_ << "}\n";
+    }
 };
 
 /** \brief Writes an AST in Q# format to a stdout */
-void output_qsharp(ast::Program& prog) {
-    QSharpOutputter outputter(std::cout);
+void output_qsharp(ast::Program& prog,
+                   const QSharpOutputter::config& params = {}) {
+    QSharpOutputter outputter(std::cout, params);
     outputter.run(prog);
 }
 
 /** \brief Writes an AST in Q# format to a given output stream */
-void write_qsharp(ast::Program& prog, std::string fname) {
+void write_qsharp(ast::Program& prog, std::string fname,
+                  const QSharpOutputter::config& params = {}) {
     std::ofstream ofs;
     ofs.open(fname);
 
     if (!ofs.good()) {
         std::cerr << "Error: failed to open output file " << fname << "\n";
     } else {
-        QSharpOutputter outputter(ofs);
+        QSharpOutputter outputter(ofs, params);
         outputter.run(prog);
     }
 
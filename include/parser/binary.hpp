@@ -0,0 +1,352 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file parser/binary.hpp
+ * \brief Reader for the binary circuit format
+ *
+ * A binary file is the magic string, the format version and a flags byte,
+ * followed by a table of strings, a table of real numbers and the program
+ * body. Identifiers and reals are indices into the tables, integers are
+ * LEB128 varints (zigzag encoded if signed) and reals are little-endian
+ * IEEE doubles. Each node is a tag byte followed by its fields in the
+ * order of its constructor. Source positions are not stored.
+ */
+#pragma once
+
+#include "parser/parser.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace staq {
+namespace parser {
+namespace binary {
+
+/** \brief Leading bytes of a binary file. Never valid QASM */
+constexpr char magic[] = {'\0', 'S', 'Q', 'B'};
+constexpr std::size_t magic_size = sizeof(magic);
+/** \brief Current format version */
+constexpr uint64_t version = 1;
+
+/** \brief Program flags */
+enum flags : uint8_t { std_include = 1 };
+
+/** \brief Node tags */
+enum class tag : uint8_t {
+    // Expressions
+    bexpr,
+    uexpr,
+    pi,
+    integer,
+    real,
+    var,
+    // Statements
+    measure,
+    reset,
+    if_stmt,
+    ugate,
+    cnot,
+    barrier,
+    declared_gate,
+    // Declarations
+    gate_decl,
+    oracle_decl,
+    register_decl,
+    ancilla_decl,
+};
+
+/** \brief Checks whether a buffer starts with the binary magic string */
+inline bool is_binary(const char* data, std::size_t size) {
+    return size >= magic_size && std::memcmp(data, magic, magic_size) == 0;
+}
+
+/**
+ * \class staq::parser::binary::Reader
+ * \brief Deserializes a program from an in-memory binary file
+ */
+class Reader {
+  public:
+    /**
+     * \param data The file contents
+     * \param name The name reported in source positions
+     * \param quiet Whether to throw on errors without reporting them
+     */
+    Reader(const std::string& data, std::string name, bool quiet = false)
+        : pos_(name, 0, 0), cur_(data.data()),
+          end_(data.data() + data.size()), quiet_(quiet) {}
+
+    /**
+     * \brief Reads the program
+     * \note Performs no semantic analysis, see parse_binary
+     */
+    ast::ptr<ast::Program> read() {
+        if (!is_binary(cur_, end_ - cur_))
+            fail("not a binary circuit file");
+        cur_ += magic_size;
+        if (auto v = varint(); v != version)
+            fail("unsupported format version " + std::to_string(v));
+        auto fl = byte();
+
+        strings_.resize(count());
+        for (auto& str : strings_) {
+            auto len = count();
+            str.assign(take(len), len);
+        }
+        reals_.resize(count());
+        for (auto& real : reals_) {
+            uint64_t bits = 0;
+            auto bytes = take(8);
+            for (auto i = 0; i < 8; i++)
+                bits |= uint64_t(static_cast<uint8_t>(bytes[i])) << (8 * i);
+            std::memcpy(&real, &bits, sizeof(real));
+        }
+
+        std::list<ast::ptr<ast::Stmt>> body;
+        for (auto n = count(); n > 0; n--)
+            body.emplace_back(stmt());
+        if (cur_ != end_)
+            fail("trailing data");
+
+        return ast::Program::create(pos_, fl & flags::std_include,
+                                    std::move(body));
+    }
+
+  private:
+    parser::Position pos_;
+    const char* cur_;
+    const char* end_;
+    std::vector<std::string> strings_;
+    std::vector<double> reals_;
+    bool quiet_;
+
+    [[noreturn]] void fail(const std::string& msg) {
+        if (!quiet_)
+            std::cerr << pos_.get_filename() << ": error: " << msg << "\n";
+        throw ParseError();
+    }
+
+    const char* take(std::size_t n) {
+        if (static_cast<std::size_t>(end_ - cur_) < n)
+            fail("unexpected end of file");
+        auto ret = cur_;
+        cur_ += n;
+        return ret;
+    }
+
+    uint8_t byte() { return static_cast<uint8_t>(*take(1)); }
+
+    uint64_t varint() {
+        uint64_t ret = 0;
+        for (auto shift = 0; shift < 64; shift += 7) {
+            auto b = byte();
+            ret |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return ret;
+        }
+        fail("malformed varint");
+    }
+
+    /** \brief A length, bounded by the remaining input */
+    std::size_t count() {
+        auto ret = varint();
+        if (ret > static_cast<uint64_t>(end_ - cur_))
+            fail("length exceeds file size");
+        return ret;
+    }
+
+    int integer() {
+        auto v = varint();
+        return static_cast<int>(static_cast<int64_t>(v >> 1) ^
+                                -static_cast<int64_t>(v & 1));
+    }
+
+    const std::string& string() {
+        auto i = varint();
+        if (i >= strings_.size())
+            fail("string index out of range");
+        return strings_[i];
+    }
+
+    std::vector<ast::symbol> strings() {
+        std::vector<ast::symbol> ret(count());
+        for (auto& str : ret)
+            str = string();
+        return ret;
+    }
+
+    /** \brief A byte no greater than max */
+    uint8_t bounded(uint8_t max) {
+        auto ret = byte();
+        if (ret > max)
+            fail("unknown operator or tag " + std::to_string(ret));
+        return ret;
+    }
+
+    tag read_tag() {
+        return static_cast<tag>(
+            bounded(static_cast<uint8_t>(tag::ancilla_decl)));
+    }
+
+    ast::VarAccess var() {
+        auto& id = string();
+        if (auto offset = varint(); offset > 0)
+            return ast::VarAccess(pos_, id, static_cast<int>(offset - 1));
+        return ast::VarAccess(pos_, id);
+    }
+
+    std::vector<ast::VarAccess> vars() {
+        std::vector<ast::VarAccess> ret;
+        for (auto n = count(); n > 0; n--)
+            ret.emplace_back(var());
+        return ret;
+    }
+
+    ast::ptr<ast::Expr> expr() {
+        switch (read_tag()) {
+            case tag::bexpr: {
+                auto op = static_cast<ast::BinaryOp>(
+                    bounded(static_cast<uint8_t>(ast::BinaryOp::Pow)));
+                auto lexp = expr();
+                return ast::BExpr::create(pos_, std::move(lexp), op, expr());
+            }
+            case tag::uexpr: {
+                auto op = static_cast<ast::UnaryOp>(
+                    bounded(static_cast<uint8_t>(ast::UnaryOp::Exp)));
+                return ast::UExpr::create(pos_, op, expr());
+            }
+            case tag::pi:
+                return ast::PiExpr::create(pos_);
+            case tag::integer:
+                return ast::IntExpr::create(pos_, integer());
+            case tag::real: {
+                auto i = varint();
+                if (i >= reals_.size())
+                    fail("real index out of range");
+                return ast::RealExpr::create(pos_, reals_[i]);
+            }
+            case tag::var:
+                return ast::VarExpr::create(pos_, string());
+            default:
+                fail("expected an expression");
+        }
+    }
+
+    ast::ptr<ast::Gate> gate() {
+        auto ret = stmt();
+        if (!dynamic_cast<ast::Gate*>(ret.get()))
+            fail("expected a gate");
+        return ast::ptr<ast::Gate>(static_cast<ast::Gate*>(ret.release()));
+    }
+
+    ast::ptr<ast::Stmt> stmt() {
+        switch (read_tag()) {
+            case tag::measure: {
+                auto q_arg = var();
+                return ast::MeasureStmt::create(pos_, std::move(q_arg), var());
+            }
+            case tag::reset:
+                return ast::ResetStmt::create(pos_, var());
+            case tag::if_stmt: {
+                auto id = string();
+                auto cond = integer();
+                return ast::IfStmt::create(pos_, id, cond, gate());
+            }
+            case tag::ugate: {
+                auto theta = expr();
+                auto phi = expr();
+                auto lambda = expr();
+                return ast::UGate::create(pos_, std::move(theta),
+                                          std::move(phi), std::move(lambda),
+                                          var());
+            }
+            case tag::cnot: {
+                auto ctrl = var();
+                return ast::CNOTGate::create(pos_, std::move(ctrl), var());
+            }
+            case tag::barrier:
+                return ast::BarrierGate::create(pos_, vars());
+            case tag::declared_gate: {
+                auto name = string();
+                std::vector<ast::ptr<ast::Expr>> c_args(count());
+                for (auto& arg : c_args)
+                    arg = expr();
+                return ast::DeclaredGate::create(pos_, name, std::move(c_args),
+                                                 vars());
+            }
+            case tag::gate_decl: {
+                auto opaque = byte() != 0;
+                auto id = string();
+                auto c_params = strings();
+                auto q_params = strings();
+                std::list<ast::ptr<ast::Gate>> body;
+                if (!opaque) {
+                    for (auto n = count(); n > 0; n--)
+                        body.emplace_back(gate());
+                }
+                return ast::GateDecl::create(pos_, id, opaque, c_params,
+                                             q_params, std::move(body));
+            }
+            case tag::oracle_decl: {
+                auto id = string();
+                auto params = strings();
+                return ast::OracleDecl::create(pos_, id, params, string());
+            }
+            case tag::register_decl: {
+                auto quantum = byte() != 0;
+                auto id = string();
+                return ast::RegisterDecl::create(pos_, id, quantum, integer());
+            }
+            case tag::ancilla_decl: {
+                auto dirty = byte() != 0;
+                auto id = string();
+                return ast::AncillaDecl::create(pos_, id, dirty, integer());
+            }
+            default:
+                fail("expected a statement");
+        }
+    }
+};
+
+} // namespace binary
+
+inline ast::ptr<ast::Program> parse_binary(std::istream& is,
+                                           std::string name, bool check) {
+    std::string data{std::istreambuf_iterator<char>(is),
+                     std::istreambuf_iterator<char>()};
+    auto result = binary::Reader(data, name).read();
+
+    // Perform semantic analysis before returning
+    if (check)
+        ast::check_source(*result);
+
+    return result;
+}
+
+} // namespace parser
+} // namespace staq
@@ -976,8 +976,29 @@ class Parser {
     }
 };
 
+/**
+ * \brief Read a program in the binary circuit format from a stream
+ *
+ * \param is The input stream, positioned at the start of the file
+ * \param name The name reported in source positions
+ * \param check Whether to perform semantic analysis, as for text input.
+ * Only trusted input, e.g. written by staq itself, should skip it
+ */
+inline ast::ptr<ast::Program> parse_binary(std::istream& is,
+                                           std::string name = "",
+                                           bool check = true);
+
+/**
+ * \brief Checks whether the next bytes of a stream start a binary circuit
+ */
+inline bool is_binary_stream(std::istream& is) {
+    return is.peek() == '\0';
+}
+
 /**
  * \brief Parse a specified file
+ *
+ * Files in the binary circuit format are detected & read directly
  */
 inline ast::ptr<ast::Program> parse_file(std::string fname) {
     Preprocessor pp;
@@ -985,13 +1006,16 @@ inline ast::ptr<ast::Program> parse_file(std::string fname) {
 
     std::shared_ptr<std::ifstream> ifs(new std::ifstream);
 
-    ifs->open(fname, std::ifstream::in);
+    ifs->open(fname, std::ifstream::in | std::ifstream::binary);
     if (!ifs->good()) {
         ifs->close();
         std::cerr << "File \"" << fname << "\" not found!\n";
         throw ParseError();
     }
 
+    if (is_binary_stream(*ifs))
+        return parse_binary(*ifs, fname);
+
     pp.add_target_stream(ifs, fname);
 
     return parser.parse();
@@ -999,8 +1023,13 @@ inline ast::ptr<ast::Program> parse_file(std::string fname) {
 
 /**
  * \brief Parse input from stdin
+ *
+ * Input in the binary circuit format is detected & read directly
  */
 inline ast::ptr<ast::Program> parse_stdin(std::string name = "") {
+    if (is_binary_stream(std::cin))
+        return parse_binary(std::cin, name);
+
     Preprocessor pp;
     Parser parser(pp);
 
@@ -1030,3 +1059,5 @@ inline ast::ptr<ast::Program> parse_string(const std::string& str,
 
 } // namespace parser
 } // namespace staq
+
+#include "parser/binary.hpp"
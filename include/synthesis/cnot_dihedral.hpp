@@ -33,6 +33,8 @@
 #include "ast/expr.hpp"
 #include "utils/templates.hpp"
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <list>
 #include <variant>
@@ -45,177 +47,196 @@ using phase_term = std::pair<std::vector<bool>, ast::ptr<ast::Expr>>;
 using cx_dihedral = std::variant<std::pair<int, int>,
                                  std::pair<ast::ptr<ast::Expr>, int>>;
 
-struct partition {
-    std::optional<int> target;
-    std::set<int> remaining_indices;
-    std::list<phase_term> terms;
-
-    partition(std::optional<int> t,
-              std::set<int> r,
-              std::list<phase_term>&& tm)
-      : target(t)
-      , remaining_indices(r)
-      , terms(std::move(tm))
-    {}
-};
-
-static void print_partition(const partition& part) {
-    std::cout << "{";
-    if (part.target)
-        std::cout << *(part.target);
-    else
-        std::cout << "_";
-    std::cout << ", [";
-    for (auto i : part.remaining_indices)
-        std::cout << i << ",";
-    std::cout << "], {";
-    for (auto& [vec, angle] : part.terms) {
-        std::cout << *angle << "*(";
-        for (auto i = 0; i < vec.size(); i++)
-            std::cout << (vec[i] ? "1" : "0");
-        std::cout << "), ";
-    }
-    std::cout << "}}\n";
-}
-
 /**
- * \brief Adjusts a list of partitions according to a CNOT between ctrl and tgt
+ * \class staq::synthesis::partition_stack
+ * \brief Stack of partitions of a set of phase terms
+ *
+ * The parities are stored column-major, one packed row per qubit, so a CNOT
+ * updates every term with a single row addition. Partitions are nested
+ * ranges of one shared array of term indices, and their remaining indices
+ * are bitmasks in a shared pool indexed by stack position. Storage is kept
+ * between uses, so a thread-local stack stops allocating once warm.
  */
-static void adjust_vectors(int ctrl, int tgt, std::list<partition>& stack) {
-    for (auto& part : stack) {
-        for (auto& [vec, angle] : part.terms) {
-            vec[ctrl] = vec[ctrl] ^ vec[tgt];
+class partition_stack {
+  public:
+    /** \brief Starts a single partition of all terms of f, on n qubits */
+    void reset(const std::list<phase_term>& f, int n) {
+        auto m = static_cast<int>(f.size());
+        n_ = n;
+        words_ = (n + 63) / 64;
+
+        parities_.reset(n, m);
+        auto t = 0;
+        for (auto& [vec, angle] : f) {
+            for (auto i = 0; i < n; i++) {
+                if (vec[i])
+                    parities_.set(i, t);
+            }
+            t++;
         }
+
+        terms_.resize(m);
+        for (t = 0; t < m; t++)
+            terms_[t] = t;
+
+        stack_.clear();
+        push({-1, 0, m});
+        refill();
     }
-}
 
-/**
- * \brief Alternate adjustment to deal with depencies on non-partitioned
- *        indicies, necessary for steiner synthesis
- */
-static void adjust_vectors_and_indices(int ctrl, 
-                                        int tgt, 
-                                        std::list<partition>& stack) 
-{
-    for (auto& part : stack) {
-        for (auto& [vec, angle] : part.terms) {
-            vec[ctrl] = vec[ctrl] ^ vec[tgt];
-        }
-    
-        // Index adjustment
-        if (part.remaining_indices.find(tgt) != part.remaining_indices.end())
-          part.remaining_indices.insert(ctrl);
+    bool empty() const { return stack_.empty(); }
+    void pop() { stack_.pop_back(); }
+
+    /** \brief Number of terms in the top partition */
+    int size() const { return stack_.back().end - stack_.back().begin; }
+    /** \brief Target of the top partition, or -1 if it has none */
+    int target() const { return stack_.back().target; }
+    /** \brief First term of the top partition */
+    int front() const { return terms_[stack_.back().begin]; }
+    /** \brief Entry i of the parity of term t */
+    bool parity(int t, int i) const { return parities_.get(i, t); }
+
+    /** \brief Adjusts every parity according to a CNOT between ctrl and tgt */
+    void cnot(int ctrl, int tgt) { parities_.add_row(tgt, ctrl); }
+
+    /** \brief Whether the top partition has indices left to split on */
+    bool has_remaining() const {
+        auto mask = mask_at(stack_.size() - 1);
+        return std::any_of(mask, mask + words_, [](auto w) { return w != 0; });
     }
 
-}
+    /** \brief Makes every index remaining in the top partition */
+    void refill() {
+        auto mask = mask_at(stack_.size() - 1);
+        std::fill(mask, mask + words_, ~uint64_t(0));
+        if (n_ % 64 != 0)
+            mask[words_ - 1] = (uint64_t(1) << (n_ % 64)) - 1;
+    }
 
-/**
- * \brief Finds the best index to split on given a list of phase terms
- */
-static int find_best_split(const std::list<phase_term>& terms,
-                           const std::set<int>& indices) {
-    int max = -1;
-    int max_i = -1;
-    for (auto i : indices) {
-        auto num_zeros = 0;
-        auto num_ones = 0;
-
-        for (auto& [vec, angle] : terms) {
-            if (vec[i])
-                num_ones++;
-            else
-                num_zeros++;
+    /**
+     * \brief Splits the top partition into the terms which are 0 and 1 on
+     * the best remaining index, leaving the zeros on top
+     *
+     * The ones take the index as their target if they have none yet
+     */
+    void split() {
+        auto k = stack_.size() - 1;
+        auto [target, begin, end] = stack_[k];
+        auto mask = mask_at(k);
+
+        // Find the index with the most zeros or ones
+        auto max = -1;
+        auto max_i = -1;
+        for (auto i = 0; i < n_; i++) {
+            if (!((mask[i / 64] >> (i % 64)) & 1))
+                continue;
+
+            auto num_ones = 0;
+            for (auto j = begin; j < end; j++)
+                num_ones += parities_.get(i, terms_[j]);
+            auto num_zeros = (end - begin) - num_ones;
+
+            if (max_i == -1 || num_zeros > max || num_ones > max) {
+                max = std::max(num_zeros, num_ones);
+                max_i = i;
+            }
         }
 
-        if (max_i == -1 || num_zeros > max || num_ones > max) {
-            max = num_zeros > num_ones ? num_zeros : num_ones;
-            max_i = i;
+        // Stable split of the range into zeros then ones
+        ones_.clear();
+        auto mid = begin;
+        for (auto j = begin; j < end; j++) {
+            if (parities_.get(max_i, terms_[j]))
+                ones_.push_back(terms_[j]);
+            else
+                terms_[mid++] = terms_[j];
         }
+        std::copy(ones_.begin(), ones_.end(), terms_.begin() + mid);
+
+        // The ones reuse the slot, the zeros copy its mask
+        mask[max_i / 64] &= ~(uint64_t(1) << (max_i % 64));
+        stack_[k] = {target == -1 ? max_i : target, mid, end};
+        push({target, begin, mid});
+        auto top = mask_at(k + 1);
+        std::copy(mask_at(k), mask_at(k) + words_, top);
     }
 
-    return max_i;
-}
-
-/**
- * \brief Splits a list of phase terms into those which are 0 and 1 in
- * entry i, respectively
- */
-static std::pair<std::list<phase_term>, std::list<phase_term>>
-split(std::list<phase_term>& terms, int i) {
-    std::list<phase_term> zeros;
-    std::list<phase_term> ones;
-
-    while (!terms.empty()) {
-        if (terms.front().first[i])
-            ones.splice(ones.end(), terms, terms.begin());
-        else
-            zeros.splice(zeros.end(), terms, terms.begin());
+  private:
+    struct entry {
+        int target;
+        int begin;
+        int end;
+    };
+
+    int n_ = 0;                      ///< number of qubits
+    int words_ = 0;                  ///< words per index mask
+    packed_linear_op parities_;      ///< parity of each term, column-major
+    std::vector<int> terms_;         ///< term indices, grouped by partition
+    std::vector<int> ones_;          ///< scratch space for splitting
+    std::vector<entry> stack_;       ///< the partitions, top last
+    std::vector<uint64_t> masks_;    ///< remaining indices by stack position
+
+    void push(entry e) {
+        stack_.push_back(e);
+        auto needed = stack_.size() * words_;
+        if (masks_.size() < needed)
+            masks_.resize(std::max(needed, 2 * masks_.size()));
     }
 
-    return std::make_pair(std::move(zeros), std::move(ones));
-}
+    uint64_t* mask_at(std::size_t k) { return masks_.data() + k * words_; }
+    const uint64_t* mask_at(std::size_t k) const {
+        return masks_.data() + k * words_;
+    }
+};
 
 /**
  * \brief The gray-synth algorith of arXiv:1712.01859
+ *
+ * The residual linear transformation is synthesized with the given method
  */
-static std::list<cx_dihedral> gray_synth(std::list<phase_term>& f,
-                                         linear_op<bool> A) {
-    // Initialize
+static std::list<cx_dihedral>
+gray_synth(std::list<phase_term>& f, const linear_op<bool>& A,
+           linear_synth method = linear_synth::gauss_jordan,
+           int section_size = 0) {
+    // Working storage, reused across calls
+    thread_local partition_stack stack;
+    thread_local std::vector<ast::ptr<ast::Expr>> angles;
+
+    // Initialize. Column operations on A are tracked as row operations on
+    // its transpose
+    auto n = static_cast<int>(A.size());
     std::list<cx_dihedral> ret;
-    std::list<partition> stack;
-
-    std::set<int> indices;
-    for (auto i = 0; i < A.size(); i++)
-        indices.insert(i);
+    auto At = packed_linear_op(A).transpose();
 
-    stack.emplace_front(partition(std::nullopt, indices, std::move(f)));
+    stack.reset(f, n);
+    angles.clear();
+    for (auto& [vec, angle] : f)
+        angles.emplace_back(std::move(angle));
+    f.clear();
 
     while (!stack.empty()) {
-        auto part = std::move(stack.front());
-        stack.pop_front();
-
-        if (part.terms.size() == 0)
-            continue;
-        else if (part.terms.size() == 1 && part.target) {
+        if (stack.size() == 0) {
+            stack.pop();
+        } else if (stack.size() == 1 && stack.target() != -1) {
             // This case allows us to shortcut a lot of partitions
+            auto tgt = stack.target();
+            auto t = stack.front();
+            stack.pop();
 
-            auto tgt = *(part.target);
-            auto& [vec, angle] = part.terms.front();
-
-            for (auto ctrl = 0; ctrl < vec.size(); ctrl++) {
-                if (ctrl != tgt && vec[ctrl]) {
-                    ret.push_back(std::make_pair((int) ctrl, (int) tgt));
+            for (auto ctrl = 0; ctrl < n; ctrl++) {
+                if (ctrl != tgt && stack.parity(t, ctrl)) {
+                    ret.push_back(std::make_pair(ctrl, tgt));
 
                     // Adjust remaining vectors & output function
-                    adjust_vectors(ctrl, tgt, stack);
-                    for (auto i = 0; i < A.size(); i++) {
-                        A[i][ctrl] = A[i][ctrl] ^ A[i][tgt];
-                    }
+                    stack.cnot(ctrl, tgt);
+                    At.add_row(tgt, ctrl);
                 }
             }
 
-            ret.push_back(std::make_pair(std::move(angle), tgt));
-        } else if (!part.remaining_indices.empty()) {
+            ret.push_back(std::make_pair(std::move(angles[t]), tgt));
+        } else if (stack.has_remaining()) {
             // Divide into the zeros and ones of some row
-            auto i = find_best_split(part.terms, part.remaining_indices);
-            auto [zeros, ones] = split(part.terms, i);
-
-            // Remove i from the remaining indices
-            part.remaining_indices.erase(i);
-
-            // Add the new partitions on the stack
-            if (part.target) {
-                stack.emplace_front(partition(part.target,
-                                              part.remaining_indices,
-                                              std::move(ones)));
-            } else {
-                stack.emplace_front(partition(i,
-                                              part.remaining_indices,
-                                              std::move(ones)));
-            }
-            stack.emplace_front(partition(part.target,
-                                          part.remaining_indices,
-                                          std::move(zeros)));
+            stack.split();
         } else {
             throw std::logic_error(
                 "No indices left to pivot on, but multiple vectors remain!\n");
@@ -223,7 +244,8 @@ static std::list<cx_dihedral> gray_synth(std::list<phase_term>& f,
     }
 
     // Synthesize the overall linear transformation
-    auto linear_trans = gauss_jordan(A);
+    auto linear_trans =
+        synthesize_linear(At.transpose().unpack(), method, section_size);
     for (auto gate : linear_trans)
         ret.push_back(gate);
 
@@ -232,97 +254,119 @@ static std::list<cx_dihedral> gray_synth(std::list<phase_term>& f,
 
 /**
  * \brief Gray-synth with topological constraints
+ *
+ * Streaming form, passing each CNOT to cx(ctrl, tgt) and each rotation to
+ * rz(term, tgt) in circuit order, where term is the index of the rotated
+ * term in f. Only the parities of f are read
  */
-static std::list<cx_dihedral> gray_steiner(std::list<phase_term>& f,
-                                           linear_op<bool> A, Device& d) {
-    // Initialize
-    std::list<cx_dihedral> ret;
-    std::list<partition> stack;
-
-    std::set<int> indices;
-    for (auto i = 0; i < A.size(); i++)
-        indices.insert(i);
-
-    stack.emplace_front(partition(std::nullopt, indices, std::move(f)));
+template <typename CxFn, typename RzFn>
+static void gray_steiner(const std::list<phase_term>& f,
+                         const linear_op<bool>& A, const Device& d, CxFn&& cx,
+                         RzFn&& rz) {
+    // Working storage, reused across calls
+    thread_local partition_stack stack;
+    thread_local std::vector<bool> vec;
+    thread_local std::vector<int> terminals;
+    thread_local std::vector<coupling> s_tree;
+    thread_local std::vector<std::pair<int, int>> linear_trans;
+
+    // Initialize. Column operations on A are tracked as row operations on
+    // its transpose
+    auto n = static_cast<int>(A.size());
+    auto At = packed_linear_op(A).transpose();
+
+    stack.reset(f, n);
 
     while (!stack.empty()) {
-        auto part = std::move(stack.front());
-        stack.pop_front();
-
-        if (part.terms.size() == 0)
-            continue;
-        else if (part.terms.size() == 1 && part.target) {
+        if (stack.size() == 0) {
+            stack.pop();
+        } else if (stack.size() == 1 && stack.target() != -1) {
             // This case allows us to shortcut a lot of partitions
-
-            auto tgt = *(part.target);
-            auto& [vec, angle] = part.terms.front();
-
-            std::list<int> terminals;
-            for (auto ctrl = 0; ctrl < vec.size(); ctrl++) {
+            auto tgt = stack.target();
+            auto t = stack.front();
+            stack.pop();
+
+            vec.assign(n, false);
+            terminals.clear();
+            for (auto ctrl = 0; ctrl < n; ctrl++) {
+                vec[ctrl] = stack.parity(t, ctrl);
                 if (ctrl != tgt && vec[ctrl])
                     terminals.push_back(ctrl);
             }
 
-            auto s_tree = d.steiner(terminals, tgt);
+            d.steiner(terminals, tgt, s_tree);
 
             // Fill each steiner point with a one
             for (auto it = s_tree.begin(); it != s_tree.end(); it++) {
                 if (vec[it->second] == 0) {
-                    ret.push_back(
-                        std::make_pair((int) (it->second), (int) (it->first)));
-                    adjust_vectors(it->second, it->first, stack);
-                    for (auto i = 0; i < A.size(); i++) {
-                        A[i][it->second] = A[i][it->second] ^ A[i][it->first];
-                    }
+                    cx(it->second, it->first);
+                    stack.cnot(it->second, it->first);
+                    At.add_row(it->first, it->second);
                 }
             }
 
             // Zero out each row except for the root
             for (auto it = s_tree.rbegin(); it != s_tree.rend(); it++) {
-                ret.push_back(
-                    std::make_pair((int) (it->second), (int) (it->first)));
-                adjust_vectors(it->second, it->first, stack);
-                for (auto i = 0; i < A.size(); i++) {
-                    A[i][it->second] = A[i][it->second] ^ A[i][it->first];
-                }
+                cx(it->second, it->first);
+                stack.cnot(it->second, it->first);
+                At.add_row(it->first, it->second);
             }
 
-            ret.push_back(std::make_pair(std::move(angle), tgt));
-        } else if (!part.remaining_indices.empty()) {
+            rz(t, tgt);
+        } else if (stack.has_remaining()) {
             // Divide into the zeros and ones of some row
-            auto i = find_best_split(part.terms, part.remaining_indices);
-            auto [zeros, ones] = split(part.terms, i);
-
-            // Remove i from the remaining indices
-            part.remaining_indices.erase(i);
-
-            // Add the new partitions on the stack
-            if (part.target) {
-                stack.emplace_front(partition(part.target,
-                                              part.remaining_indices,
-                                              std::move(ones)));
-            } else {
-                stack.emplace_front(partition(i,
-                                              part.remaining_indices,
-                                              std::move(ones)));
-            }
-            stack.emplace_front(partition(part.target,
-                                          part.remaining_indices,
-                                          std::move(zeros)));
+            stack.split();
         } else {
             // The previously partitioned rows have gotten mangled. Start
             // again from scratch for this partition
-            for (auto i = 0; i < A.size(); i++)
-                part.remaining_indices.insert(i);
-            stack.emplace_front(std::move(part));
+            stack.refill();
         }
     }
 
     // Synthesize the overall linear transformation
-    auto linear_trans = steiner_gauss(A, d);
-    for (auto gate : linear_trans)
-        ret.push_back(gate);
+    auto B = At.transpose();
+    linear_trans.clear();
+    steiner_gauss(B, d, [](int ctrl, int tgt) {
+        linear_trans.emplace_back(ctrl, tgt);
+    });
+    for (auto it = linear_trans.rbegin(); it != linear_trans.rend(); it++)
+        cx(it->first, it->second);
+}
+
+/**
+ * \brief Gray-synth with topological constraints
+ */
+static std::list<cx_dihedral> gray_steiner(std::list<phase_term>& f,
+                                           const linear_op<bool>& A,
+                                           const Device& d) {
+    std::vector<ast::ptr<ast::Expr>> angles;
+    angles.reserve(f.size());
+    for (auto& [vec, angle] : f)
+        angles.emplace_back(std::move(angle));
 
+    std::list<cx_dihedral> ret;
+    gray_steiner(
+        f, A, d,
+        [&ret](int ctrl, int tgt) {
+            ret.push_back(std::make_pair(ctrl, tgt));
+        },
+        [&ret, &angles](int t, int tgt) {
+            ret.push_back(std::make_pair(std::move(angles[t]), tgt));
+        });
+    f.clear();
+    return ret;
+}
+
+/**
+ * \brief Number of CNOTs gray-steiner would synthesize
+ *
+ * Counting-only variant for dry runs, which builds no circuit
+ */
+static int gray_steiner_count(std::list<phase_term>& f,
+                              const linear_op<bool>& A, const Device& d) {
+    int ret = 0;
+    gray_steiner(f, A, d, [&ret](int, int) { ret++; }, [](int, int) {});
+    f.clear();
     return ret;
 }
 
@@ -0,0 +1,344 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file synthesis/cnot_dihedral_cache.hpp
+ * \brief Memoized synthesis of CNOT-dihedral circuits
+ */
+#pragma once
+
+#include "synthesis/cnot_dihedral.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace staq {
+namespace synthesis {
+
+/**
+ * \class staq::synthesis::cnot_dihedral_cache
+ * \brief Cache of synthesized cnot-dihedral circuits
+ *
+ * Circuits are stored with each rotation angle replaced by the index of the
+ * phase term it came from, and keyed on a canonical form of the operator:
+ * the qubits it acts on non-trivially, followed by the parities in order and
+ * the linear transformation, both restricted to those qubits.
+ *
+ * Gray-synth does not depend on the device, so its circuits are synthesized
+ * on the restricted operator and keyed on the relative order of the qubits
+ * only. A block recurring on a different set of qubits is then relabeled
+ * rather than synthesized again. Gray-steiner circuits are keyed on the
+ * qubits themselves and on the device's fingerprint.
+ *
+ * The cache is safe to share between threads.
+ */
+class cnot_dihedral_cache {
+  public:
+    /** \brief Lookup counters */
+    struct statistics {
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+    };
+
+    cnot_dihedral_cache(std::size_t capacity = 1 << 16)
+        : capacity_(capacity) {}
+
+    /** \brief The cache shared by the CNOT optimizer & the Steiner mapper */
+    static cnot_dihedral_cache& shared() {
+        static cnot_dihedral_cache cache;
+        return cache;
+    }
+
+    /** \brief Lookup counters since construction or the last clear */
+    statistics stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    /** \brief Empties the cache & resets the counters */
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        stats_ = statistics();
+    }
+
+    /** \brief Gray-synth through the cache, see synthesis::gray_synth */
+    std::list<cx_dihedral>
+    gray_synth(std::list<phase_term>& f, const linear_op<bool>& A,
+               linear_synth method = linear_synth::gauss_jordan,
+               int section_size = 0) {
+        std::string key(1, 'g');
+        append(key, static_cast<int>(method));
+        append(key, section_size);
+
+        std::vector<int> labels;
+        auto circuit = lookup(
+            std::move(key), f, A, true, labels,
+            [method, section_size](const std::list<phase_term>& g,
+                                   const linear_op<bool>& B, entry& result) {
+                // Each angle replaced by its term's index
+                parser::Position pos;
+                std::list<phase_term> h;
+                auto index = 0;
+                for (auto& [vec, angle] : g)
+                    h.emplace_back(vec, ast::IntExpr::create(pos, index++));
+                record(synthesis::gray_synth(h, B, method, section_size),
+                       result);
+            });
+        return replay(*circuit, labels, f);
+    }
+
+    /** \brief Gray-steiner through the cache, see synthesis::gray_steiner */
+    std::list<cx_dihedral> gray_steiner(std::list<phase_term>& f,
+                                        const linear_op<bool>& A,
+                                        const Device& d) {
+        return replay(*lookup_steiner(f, A, d), {}, f);
+    }
+
+    /**
+     * \brief Gray-steiner through the cache, streaming form
+     *
+     * Passes each CNOT to cx(ctrl, tgt) and each rotation to rz(term, tgt)
+     * in circuit order, as the streaming synthesis::gray_steiner does.
+     * Consumes the phase terms. A miss is synthesized with the streaming
+     * gray-steiner, so no gates are built
+     */
+    template <typename CxFn, typename RzFn>
+    void gray_steiner(std::list<phase_term>& f, const linear_op<bool>& A,
+                      const Device& d, CxFn&& cx, RzFn&& rz) {
+        for (auto& o : *lookup_steiner(f, A, d)) {
+            if (o.rz)
+                rz(o.a, o.b);
+            else
+                cx(o.a, o.b);
+        }
+        f.clear();
+    }
+
+    /**
+     * \brief Number of CNOTs gray-steiner would synthesize
+     *
+     * Consumes the phase terms, as gray_steiner does
+     */
+    int gray_steiner_count(std::list<phase_term>& f, const linear_op<bool>& A,
+                           const Device& d) {
+        int ret = 0;
+        gray_steiner(f, A, d, [&ret](int, int) { ret++; }, [](int, int) {});
+        return ret;
+    }
+
+  private:
+    /** \brief A CNOT from a to b, or the rotation of term a on qubit b */
+    struct op {
+        bool rz;
+        int a;
+        int b;
+    };
+    using entry = std::vector<op>;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const entry>> entries_;
+    statistics stats_;
+    std::size_t capacity_;
+
+    template <typename T>
+    static void append(std::string& key, T value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    std::shared_ptr<const entry> lookup_steiner(std::list<phase_term>& f,
+                                                const linear_op<bool>& A,
+                                                const Device& d) {
+        std::string key(1, 's');
+        append(key, d.fingerprint());
+
+        std::vector<int> labels;
+        return lookup(
+            std::move(key), f, A, false, labels,
+            [&d](const std::list<phase_term>& g, const linear_op<bool>& B,
+                 entry& result) {
+                synthesis::gray_steiner(
+                    g, B, d,
+                    [&result](int ctrl, int tgt) {
+                        result.push_back({false, ctrl, tgt});
+                    },
+                    [&result](int term, int tgt) {
+                        result.push_back({true, term, tgt});
+                    });
+            });
+    }
+
+    /** \brief Appends bits to the key, packed eight to a byte */
+    template <typename Fn>
+    static void append_bits(std::string& key, std::size_t n, Fn&& bit) {
+        for (std::size_t i = 0; i < n; i += 8) {
+            unsigned char byte = 0;
+            for (std::size_t j = i; j < n && j < i + 8; j++)
+                byte |= bit(j) << (j - i);
+            key.push_back(static_cast<char>(byte));
+        }
+    }
+
+    /**
+     * \brief Looks up or synthesizes a circuit
+     * \param key The key prefix identifying the synthesis method
+     * \param relabel Whether to synthesize on the restricted operator
+     * \param labels Set to the qubit of each label in the circuit, if
+     * relabeling, or left empty
+     * \param synth The uncached synthesis function, recording the circuit
+     * of the given terms & operator into an entry. The angles of the terms
+     * passed to it are unspecified
+     */
+    template <typename Synth>
+    std::shared_ptr<const entry> lookup(std::string key,
+                                        const std::list<phase_term>& f,
+                                        const linear_op<bool>& A, bool relabel,
+                                        std::vector<int>& labels,
+                                        Synth&& synth) {
+        auto n = static_cast<int>(A.size());
+
+        // The qubits acted on non-trivially
+        std::vector<bool> is_active(n, false);
+        for (auto& [vec, angle] : f) {
+            for (auto i = 0; i < n; i++)
+                is_active[i] = is_active[i] || vec[i];
+        }
+        for (auto i = 0; i < n; i++) {
+            for (auto j = 0; j < n; j++) {
+                if (A[i][j] != (i == j))
+                    is_active[i] = is_active[j] = true;
+            }
+        }
+        std::vector<int> active;
+        for (auto i = 0; i < n; i++) {
+            if (is_active[i])
+                active.push_back(i);
+        }
+        if (active.empty() && f.empty()) {
+            static const auto identity = std::make_shared<const entry>();
+            return identity;
+        }
+
+        // Canonical form
+        auto k = active.size();
+        append(key, k);
+        if (relabel) {
+            labels = active;
+        } else {
+            for (auto i : active)
+                append(key, i);
+        }
+        append(key, f.size());
+        for (auto& [vec, angle] : f)
+            append_bits(key, k, [&](auto i) { return vec[active[i]]; });
+        for (auto i : active)
+            append_bits(key, k, [&](auto j) { return A[i][active[j]]; });
+
+        std::shared_ptr<const entry> circuit;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (auto it = entries_.find(key); it != entries_.end()) {
+                circuit = it->second;
+                stats_.hits++;
+            } else {
+                stats_.misses++;
+            }
+        }
+
+        if (!circuit) {
+            auto result = std::make_shared<entry>();
+            if (relabel) {
+                std::list<phase_term> g;
+                for (auto& [vec, angle] : f) {
+                    std::vector<bool> restricted(k);
+                    for (std::size_t i = 0; i < k; i++)
+                        restricted[i] = vec[active[i]];
+                    g.emplace_back(std::move(restricted), nullptr);
+                }
+                linear_op<bool> B(k, std::vector<bool>(k));
+                for (std::size_t i = 0; i < k; i++) {
+                    for (std::size_t j = 0; j < k; j++)
+                        B[i][j] = A[active[i]][active[j]];
+                }
+                synth(g, B, *result);
+            } else {
+                synth(f, A, *result);
+            }
+
+            circuit = result;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (entries_.size() < capacity_)
+                entries_.emplace(std::move(key), circuit);
+        }
+
+        return circuit;
+    }
+
+    /** \brief Records a synthesized circuit whose angles are term indices */
+    static void record(std::list<cx_dihedral> circuit, entry& result) {
+        for (auto& gate : circuit) {
+            std::visit(
+                utils::overloaded{
+                    [&result](std::pair<int, int>& cx) {
+                        result.push_back({false, cx.first, cx.second});
+                    },
+                    [&result](std::pair<ast::ptr<ast::Expr>, int>& rz) {
+                        auto& term = static_cast<ast::IntExpr&>(*rz.first);
+                        result.push_back({true, term.value(), rz.second});
+                    }},
+                gate);
+        }
+    }
+
+    /** \brief Instantiates a cached circuit with the angles of f */
+    static std::list<cx_dihedral> replay(const entry& circuit,
+                                         const std::vector<int>& labels,
+                                         std::list<phase_term>& f) {
+        auto qubit = [&labels](int i) {
+            return labels.empty() ? i : labels[i];
+        };
+
+        std::vector<ast::ptr<ast::Expr>> angles;
+        angles.reserve(f.size());
+        for (auto& [vec, angle] : f)
+            angles.emplace_back(std::move(angle));
+        f.clear();
+
+        std::list<cx_dihedral> ret;
+        for (auto& o : circuit) {
+            if (o.rz)
+                ret.emplace_back(
+                    std::make_pair(std::move(angles[o.a]), qubit(o.b)));
+            else
+                ret.emplace_back(std::make_pair(qubit(o.a), qubit(o.b)));
+        }
+        return ret;
+    }
+};
+
+} // namespace synthesis
+} // namespace staq
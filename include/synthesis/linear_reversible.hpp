@@ -30,6 +30,9 @@
 
 #include "mapping/device.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 #include <list>
 
@@ -58,6 +61,101 @@ static void print_linop(const linear_op<bool>& mat) {
     }
 }
 
+/**
+ * \class staq::synthesis::packed_linear_op
+ * \brief GF(2) matrix with rows packed into 64-bit words
+ *
+ * Row additions are done a word at a time, which is what dominates the
+ * running time of elimination-based synthesis on wide operators
+ */
+class packed_linear_op {
+    int rows_;                   ///< number of rows
+    int cols_;                   ///< number of columns
+    int words_;                  ///< words per row
+    std::vector<uint64_t> data_; ///< row-major packed entries
+
+  public:
+    packed_linear_op(int rows, int cols)
+        : rows_(rows), cols_(cols), words_((cols + 63) / 64),
+          data_(static_cast<std::size_t>(rows) * ((cols + 63) / 64), 0) {}
+    packed_linear_op() : packed_linear_op(0, 0) {}
+    explicit packed_linear_op(int n) : packed_linear_op(n, n) {}
+
+    explicit packed_linear_op(const linear_op<bool>& mat)
+        : packed_linear_op(static_cast<int>(mat.size()),
+                           mat.empty() ? 0 : static_cast<int>(mat[0].size())) {
+        for (int i = 0; i < rows_; i++) {
+            for (int j = 0; j < cols_; j++) {
+                if (mat[i][j])
+                    set(i, j);
+            }
+        }
+    }
+
+    int size() const { return rows_; }
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+
+    /** \brief Resizes to the rows x cols zero matrix, reusing storage */
+    void reset(int rows, int cols) {
+        rows_ = rows;
+        cols_ = cols;
+        words_ = (cols + 63) / 64;
+        data_.assign(static_cast<std::size_t>(rows) * words_, 0);
+    }
+
+    bool get(int i, int j) const {
+        return (row(i)[j / 64] >> (j % 64)) & 1;
+    }
+    void set(int i, int j) { row(i)[j / 64] |= uint64_t(1) << (j % 64); }
+
+    /** \brief Adds row src to row dst */
+    void add_row(int src, int dst) {
+        const uint64_t* s = row(src);
+        uint64_t* d = row(dst);
+        for (int w = 0; w < words_; w++)
+            d[w] ^= s[w];
+    }
+
+    /** \brief Returns the len <= 64 entries of row i starting at column lo */
+    uint64_t slice(int i, int lo, int len) const {
+        const uint64_t* r = row(i);
+        int w = lo / 64, off = lo % 64;
+        uint64_t ret = r[w] >> off;
+        if (off != 0 && off + len > 64)
+            ret |= r[w + 1] << (64 - off);
+        return len == 64 ? ret : ret & ((uint64_t(1) << len) - 1);
+    }
+
+    packed_linear_op transpose() const {
+        packed_linear_op ret(cols_, rows_);
+        for (int i = 0; i < rows_; i++) {
+            for (int j = 0; j < cols_; j++) {
+                if (get(i, j))
+                    ret.set(j, i);
+            }
+        }
+        return ret;
+    }
+
+    linear_op<bool> unpack() const {
+        linear_op<bool> ret(rows_, std::vector<bool>(cols_));
+        for (int i = 0; i < rows_; i++) {
+            for (int j = 0; j < cols_; j++)
+                ret[i][j] = get(i, j);
+        }
+        return ret;
+    }
+
+  private:
+    uint64_t* row(int i) {
+        return data_.data() + static_cast<std::size_t>(i) * words_;
+    }
+    const uint64_t* row(int i) const {
+        return data_.data() + static_cast<std::size_t>(i) * words_;
+    }
+};
+
 /**
  * \brief Linear reversible synthesis from Gauss-Jordan elimination
  */
@@ -154,6 +252,126 @@ static std::list<std::pair<int, int>> gaussian_elim(linear_op<bool> mat) {
     return ret;
 }
 
+/**
+ * \brief Lower triangular elimination pass of Patel-Markov-Hayes
+ *
+ * Reduces mat to unit upper triangular form, appending the row additions
+ * (ctrl, tgt) performed to ret. Columns are processed in sections of
+ * section_size, and duplicate sub-rows within a section are cancelled
+ * against each other before the section is eliminated. Returns false if
+ * mat is not invertible
+ */
+static bool pmh_lower(packed_linear_op& mat, int section_size,
+                      std::list<std::pair<int, int>>& ret) {
+    int n = mat.size();
+    std::vector<int> patterns(std::size_t(1) << section_size, -1);
+
+    for (int lo = 0; lo < n; lo += section_size) {
+        int len = std::min(section_size, n - lo);
+
+        // Cancel duplicate sub-rows
+        for (int i = lo; i < n; i++) {
+            auto pattern = mat.slice(i, lo, len);
+            if (pattern == 0)
+                continue;
+            if (patterns[pattern] == -1) {
+                patterns[pattern] = i;
+            } else {
+                mat.add_row(patterns[pattern], i);
+                ret.push_back(std::make_pair(patterns[pattern], i));
+            }
+        }
+        for (int i = lo; i < n; i++)
+            patterns[mat.slice(i, lo, len)] = -1;
+
+        // Gaussian elimination on the section
+        for (int col = lo; col < lo + len; col++) {
+            if (!mat.get(col, col)) {
+                int pivot = -1;
+                for (int i = col + 1; i < n; i++) {
+                    if (mat.get(i, col)) {
+                        pivot = i;
+                        break;
+                    }
+                }
+                if (pivot == -1)
+                    return false;
+                mat.add_row(pivot, col);
+                ret.push_back(std::make_pair(pivot, col));
+            }
+
+            for (int i = col + 1; i < n; i++) {
+                if (mat.get(i, col)) {
+                    mat.add_row(col, i);
+                    ret.push_back(std::make_pair(col, i));
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * \brief Linear reversible synthesis from Patel-Markov-Hayes
+ *
+ * Asymptotically optimal O(n^2/log n) CNOT synthesis (see
+ * arXiv:quant-ph/0302002). A section_size of 0 selects log2(n)/2
+ */
+static std::list<std::pair<int, int>> pmh(const linear_op<bool>& mat,
+                                          int section_size = 0) {
+    std::list<std::pair<int, int>> ret;
+
+    int n = static_cast<int>(mat.size());
+    if (n == 0)
+        return ret;
+    if (mat[0].size() != mat.size())
+        return gauss_jordan(mat);
+
+    if (section_size <= 0)
+        section_size = static_cast<int>(std::round(std::log2(n) / 2));
+    section_size = std::max(1, std::min(section_size, 16));
+
+    // Lower pass on the operator, then on the transpose of the remaining
+    // upper triangular part
+    packed_linear_op A(mat);
+    std::list<std::pair<int, int>> lower, upper;
+    if (!pmh_lower(A, section_size, lower)) {
+        std::cerr << "Error: linear operator is not invertible\n";
+        return ret;
+    }
+    A = A.transpose();
+    pmh_lower(A, section_size, upper);
+
+    // Row operations on the transpose are column operations on the
+    // original, so they are applied with control and target exchanged
+    for (auto& [ctrl, tgt] : upper)
+        ret.push_back(std::make_pair(tgt, ctrl));
+    lower.reverse();
+    ret.splice(ret.end(), lower);
+    return ret;
+}
+
+/**
+ * \brief Selectable linear reversible synthesis methods
+ */
+enum class linear_synth { gauss_jordan, pmh };
+
+/**
+ * \brief Linear reversible synthesis with a given method
+ */
+static std::list<std::pair<int, int>>
+synthesize_linear(const linear_op<bool>& mat, linear_synth method,
+                  int section_size = 0) {
+    switch (method) {
+        case linear_synth::pmh:
+            return pmh(mat, section_size);
+        case linear_synth::gauss_jordan:
+        default:
+            return gauss_jordan(mat);
+    }
+}
+
 /** 
  * \brief Steiner tree based device constrained CNOT synthesis
  *
@@ -184,23 +402,37 @@ static std::list<std::pair<int, int>> gaussian_elim(linear_op<bool> mat) {
    00101            00101             10001             00011
    00010            00010             00010             00010
    \endverbatim
+ *
+ * This overload eliminates mat in place, passing each row addition
+ * (ctrl, tgt) to emit in elimination order, i.e. the reverse of the
+ * synthesized circuit. Returns false if mat is not invertible
  */
-static std::list<std::pair<int, int>> steiner_gauss(linear_op<bool> mat,
-                                                    mapping::Device& d) {
-    std::list<std::pair<int, int>> ret;
+template <typename Fn>
+static bool steiner_gauss(packed_linear_op& mat, const mapping::Device& d,
+                          Fn&& emit) {
+    // Working storage, reused across calls
+    thread_local std::vector<std::pair<int, int>> swap;
+    thread_local std::vector<std::pair<int, int>> compute;
+    thread_local std::vector<int> pivots;
+    thread_local std::vector<std::pair<int, int>> s_tree;
+
+    auto add = [&mat, &emit](int ctrl, int tgt) {
+        mat.add_row(ctrl, tgt);
+        emit(ctrl, tgt);
+    };
 
     // Whether or not a row has a dependence on a row above the diagonal
-    std::vector<bool> above_diagonal_dep(mat.size(), false);
+    std::vector<bool> above_diagonal_dep(mat.rows(), false);
 
-    for (auto i = 0; i < mat[0].size(); i++) {
+    for (auto i = 0; i < mat.cols(); i++) {
 
         std::fill(above_diagonal_dep.begin(), above_diagonal_dep.end(), false);
 
         // Phase 0: Find a pivot
         int pivot = -1;
         int dist;
-        for (auto j = i; j < mat.size(); j++) {
-            if (mat[j][i] == true) {
+        for (auto j = i; j < mat.rows(); j++) {
+            if (mat.get(j, i)) {
                 if (pivot == -1 || d.distance(j, i) < dist) {
                     pivot = j;
                     dist = d.distance(j, i);
@@ -209,20 +441,19 @@ static std::list<std::pair<int, int>> steiner_gauss(linear_op<bool> mat,
         }
         if (pivot == -1) {
             std::cerr << "Error: linear operator is not invertible\n";
-            return ret;
+            return false;
         }
 
-        std::list<std::pair<int, int>> swap;
-        std::list<std::pair<int, int>> uncompute_swap;
+        swap.clear();
         bool crossed_diag = false;
         auto path = d.shortest_path(pivot, i);
         int ctrl = pivot;
 
         // Phase 1: Fill 1's in column i along shortest path to row i
         for (auto tgt : path) {
-            if (tgt != ctrl && mat[tgt][i] == false) {
-                mat[tgt] ^= mat[ctrl];
-                swap.push_back(std::make_pair(ctrl, tgt));
+            if (tgt != ctrl && !mat.get(tgt, i)) {
+                add(ctrl, tgt);
+                swap.emplace_back(ctrl, tgt);
                 if (ctrl < i)
                     crossed_diag = true;
                 above_diagonal_dep[tgt] = above_diagonal_dep[tgt] ||
@@ -240,8 +471,8 @@ static std::list<std::pair<int, int>> steiner_gauss(linear_op<bool> mat,
             for (auto it = std::next(path.rbegin()); it != path.rend(); it++) {
                 auto ctrl = *it;
                 if (tgt != i) {
-                    mat[tgt] ^= mat[ctrl];
-                    swap.push_back(std::make_pair(ctrl, tgt));
+                    add(ctrl, tgt);
+                    swap.emplace_back(ctrl, tgt);
                     above_diagonal_dep[tgt] = above_diagonal_dep[tgt] ||
                                               above_diagonal_dep[ctrl] ||
                                               (ctrl < i);
@@ -251,12 +482,9 @@ static std::list<std::pair<int, int>> steiner_gauss(linear_op<bool> mat,
 
             // Now repeat the computation to remove above diagonals
             for (auto it = swap.rbegin(); it != swap.rend(); it++) {
-                auto ctrl = it->first;
-                auto tgt = it->second;
-                if (above_diagonal_dep[tgt] && it->first != pivot) {
-                    mat[tgt] ^= mat[ctrl];
-                    uncompute_swap.push_back(std::make_pair(ctrl, tgt));
-                }
+                auto [ctrl, tgt] = *it;
+                if (above_diagonal_dep[tgt] && ctrl != pivot)
+                    add(ctrl, tgt);
             }
         }
 
@@ -265,19 +493,19 @@ static std::list<std::pair<int, int>> steiner_gauss(linear_op<bool> mat,
         std::fill(above_diagonal_dep.begin(), above_diagonal_dep.end(), false);
 
         // Phase 3: Compute steiner tree covering the 1's in column i
-        std::list<int> pivots;
-        for (auto j = 0; j < mat.size(); j++) {
-            if (j != i && mat[j][i] == true)
+        pivots.clear();
+        for (auto j = 0; j < mat.rows(); j++) {
+            if (j != i && mat.get(j, i))
                 pivots.push_back(j);
         }
-        auto s_tree = d.steiner(pivots, pivot);
+        d.steiner(pivots, pivot, s_tree);
 
-        std::list<std::pair<int, int>> compute;
+        compute.clear();
         // Phase 4: Propagate 1's to column i for each Steiner point
         for (auto& [ctrl, tgt] : s_tree) {
-            if (mat[tgt][i] == false) {
-                mat[tgt] ^= mat[ctrl];
-                compute.push_back(std::make_pair(ctrl, tgt));
+            if (!mat.get(tgt, i)) {
+                add(ctrl, tgt);
+                compute.emplace_back(ctrl, tgt);
 
                 above_diagonal_dep[tgt] = above_diagonal_dep[tgt] ||
                                           above_diagonal_dep[ctrl] ||
@@ -287,11 +515,10 @@ static std::list<std::pair<int, int>> steiner_gauss(linear_op<bool> mat,
 
         // Phase 5: Empty all 1's from column i in the Steiner tree
         for (auto it = s_tree.rbegin(); it != s_tree.rend(); it++) {
-            auto ctrl = it->first;
-            auto tgt = it->second;
+            auto [ctrl, tgt] = *it;
 
-            mat[tgt] ^= mat[ctrl];
-            compute.push_back(std::make_pair(ctrl, tgt));
+            add(ctrl, tgt);
+            compute.emplace_back(ctrl, tgt);
 
             above_diagonal_dep[tgt] = above_diagonal_dep[tgt] ||
                                       above_diagonal_dep[ctrl] ||
@@ -300,23 +527,30 @@ static std::list<std::pair<int, int>> steiner_gauss(linear_op<bool> mat,
 
         // Phase 6: For each node that has an above diagonal dependency,
         // reverse the previous steps to undo the additions
-        std::list<std::pair<int, int>> uncompute;
         for (auto it = compute.rbegin(); it != compute.rend(); it++) {
-            auto ctrl = it->first;
-            auto tgt = it->second;
-            if (above_diagonal_dep[tgt] && it->first != pivot) {
-                mat[tgt] ^= mat[ctrl];
-                uncompute.push_back(std::make_pair(ctrl, tgt));
-            }
+            auto [ctrl, tgt] = *it;
+            if (above_diagonal_dep[tgt] && ctrl != pivot)
+                add(ctrl, tgt);
         }
-
-        ret.splice(ret.end(), swap);
-        ret.splice(ret.end(), uncompute_swap);
-        ret.splice(ret.end(), compute);
-        ret.splice(ret.end(), uncompute);
     }
 
-    ret.reverse();
+    return true;
+}
+
+/**
+ * \brief Steiner tree based device constrained CNOT synthesis
+ * \see steiner_gauss(packed_linear_op&, const mapping::Device&, Fn&&)
+ */
+static std::list<std::pair<int, int>> steiner_gauss(linear_op<bool> mat,
+                                                    const mapping::Device& d) {
+    std::list<std::pair<int, int>> ret;
+
+    if (mat.size() == 0)
+        return ret;
+
+    packed_linear_op packed(mat);
+    steiner_gauss(packed, d,
+                  [&ret](int ctrl, int tgt) { ret.emplace_front(ctrl, tgt); });
     return ret;
 }
 
@@ -36,9 +36,20 @@
 #include <caterpillar/synthesis/lhrs.hpp>
 #include <caterpillar/synthesis/strategies/bennett_mapping_strategy.hpp>
 #include <caterpillar/synthesis/strategies/eager_mapping_strategy.hpp>
+#include <kitty/isop.hpp>
+#include <mockturtle/io/pla_reader.hpp>
 
-#include <unordered_map>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <chrono>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "parser/position.hpp"
 #include "ast/stmt.hpp"
@@ -56,7 +67,7 @@ enum class Format {
     verilog,
 };
 
-std::unordered_map<std::string, Format> ext_to_format({
+inline std::unordered_map<std::string, Format> ext_to_format({
     {"aig", Format::binary_aiger},
     {"aag", Format::ascii_aiger},
     {"bench", Format::bench},
@@ -65,10 +76,214 @@ std::unordered_map<std::string, Format> ext_to_format({
     {"v", Format::verilog},
 });
 
+namespace detail {
+
+using mig_signal = mockturtle::mig_network::signal;
+
+/**
+ * \brief Builds a function given by a cover
+ *
+ * Each cube is a string over {0,1,-}, one character per input. The
+ * function is the sum of the cubes if onset is true, and its complement
+ * otherwise
+ */
+inline mig_signal create_cover(mockturtle::mig_network& mig,
+                               const std::vector<mig_signal>& inputs,
+                               const std::vector<std::string>& cubes,
+                               bool onset) {
+    std::vector<mig_signal> products;
+    for (auto& cube : cubes) {
+        std::vector<mig_signal> literals;
+        for (std::size_t i = 0; i < cube.size() && i < inputs.size(); i++) {
+            if (cube[i] == '1')
+                literals.push_back(inputs[i]);
+            else if (cube[i] == '0')
+                literals.push_back(mig.create_not(inputs[i]));
+        }
+        products.push_back(mig.create_nary_and(literals));
+    }
+    auto ret = mig.create_nary_or(products);
+    return onset ? ret : mig.create_not(ret);
+}
+
+/**
+ * \class staq::synthesis::detail::bench_reader
+ * \brief Builds a MIG from a BENCH file
+ *
+ * Handles the standard gates as well as LUTs given in hexadecimal. Outputs
+ * are created by finish, once the whole file has been read
+ */
+class bench_reader : public lorina::bench_reader {
+  public:
+    bench_reader(mockturtle::mig_network& mig) : mig_(mig) {
+        signals_["gnd"] = mig_.get_constant(false);
+        signals_["vdd"] = mig_.get_constant(true);
+    }
+
+    void on_input(const std::string& name) const override {
+        signals_[name] = mig_.create_pi(name);
+    }
+
+    void on_output(const std::string& name) const override {
+        outputs_.push_back(name);
+    }
+
+    void on_assign(const std::string& input,
+                   const std::string& output) const override {
+        signals_[output] = signals_[input];
+    }
+
+    void on_gate(const std::vector<std::string>& inputs,
+                 const std::string& output,
+                 const std::string& type) const override {
+        std::vector<mig_signal> args;
+        for (auto& input : inputs)
+            args.push_back(signals_[input]);
+
+        auto op = type;
+        std::transform(op.begin(), op.end(), op.begin(), ::toupper);
+        auto& ret = signals_[output];
+        if (op.size() > 2 && op.substr(0, 2) == "0X") {
+            kitty::dynamic_truth_table tt(static_cast<int>(args.size()));
+            kitty::create_from_hex_string(tt, op.substr(2));
+            std::vector<std::string> cubes;
+            for (auto& cube : kitty::isop(tt)) {
+                std::string str;
+                for (std::size_t i = 0; i < args.size(); i++)
+                    str.push_back(!cube.get_mask(i) ? '-'
+                                  : cube.get_bit(i) ? '1'
+                                                    : '0');
+                cubes.push_back(str);
+            }
+            ret = create_cover(mig_, args, cubes, true);
+        } else if (op == "AND" || op == "NAND") {
+            ret = mig_.create_nary_and(args);
+        } else if (op == "OR" || op == "NOR") {
+            ret = mig_.create_nary_or(args);
+        } else if (op == "XOR" || op == "XNOR") {
+            ret = mig_.create_nary_xor(args);
+        } else if ((op == "NOT" || op == "BUF" || op == "BUFF") &&
+                   args.size() == 1) {
+            ret = args[0];
+        } else {
+            std::cerr << "Unsupported BENCH gate \"" << type << "\""
+                      << std::endl;
+            failed_ = true;
+            return;
+        }
+
+        if (op == "NAND" || op == "NOR" || op == "XNOR" || op == "NOT")
+            ret = mig_.create_not(ret);
+    }
+
+    /** \brief Creates the outputs. Returns false on an unsupported gate */
+    bool finish() {
+        for (auto& output : outputs_)
+            mig_.create_po(signals_[output], output);
+        return !failed_;
+    }
+
+  private:
+    mockturtle::mig_network& mig_;
+    mutable std::unordered_map<std::string, mig_signal> signals_;
+    mutable std::vector<std::string> outputs_;
+    mutable bool failed_ = false;
+};
+
+/**
+ * \class staq::synthesis::detail::blif_reader
+ * \brief Builds a MIG from a combinational BLIF file
+ *
+ * BLIF gates may be listed in any order, so gates are only built once the
+ * whole file has been read, by finish
+ */
+class blif_reader : public lorina::blif_reader {
+  public:
+    blif_reader(mockturtle::mig_network& mig) : mig_(mig) {}
+
+    void on_input(const std::string& name) const override {
+        signals_[name] = mig_.create_pi(name);
+    }
+
+    void on_output(const std::string& name) const override {
+        outputs_.push_back(name);
+    }
+
+    void on_gate(const std::vector<std::string>& inputs,
+                 const std::string& output,
+                 const output_cover_t& cover) const override {
+        gates_[output] = {inputs, cover};
+    }
+
+    /** \brief Builds the gates & outputs. Returns false on a bad network */
+    bool finish() {
+        for (auto& output : outputs_) {
+            auto f = signal(output);
+            if (!f)
+                return false;
+            mig_.create_po(*f, output);
+        }
+        return true;
+    }
+
+  private:
+    mockturtle::mig_network& mig_;
+    mutable std::unordered_map<std::string, mig_signal> signals_;
+    mutable std::vector<std::string> outputs_;
+    mutable std::unordered_map<
+        std::string, std::pair<std::vector<std::string>, output_cover_t>>
+        gates_;
+    std::unordered_set<std::string> visiting_;
+
+    std::optional<mig_signal> signal(const std::string& name) {
+        if (auto it = signals_.find(name); it != signals_.end())
+            return it->second;
+
+        auto it = gates_.find(name);
+        if (it == gates_.end()) {
+            std::cerr << "Undefined BLIF signal \"" << name << "\""
+                      << std::endl;
+            return std::nullopt;
+        }
+        if (!visiting_.insert(name).second) {
+            std::cerr << "Combinational cycle through BLIF signal \"" << name
+                      << "\"" << std::endl;
+            return std::nullopt;
+        }
+
+        auto& [inputs, cover] = it->second;
+        std::vector<mig_signal> args;
+        for (auto& input : inputs) {
+            auto f = signal(input);
+            if (!f)
+                return std::nullopt;
+            args.push_back(*f);
+        }
+
+        std::vector<std::string> cubes;
+        auto onset = true;
+        for (auto& [cube, value] : cover) {
+            // A single column is the output of a constant gate
+            if (inputs.empty()) {
+                onset = value.empty() ? cube == "1" : value == "1";
+                cubes.push_back("");
+            } else {
+                onset = value == "1";
+                cubes.push_back(cube);
+            }
+        }
+
+        visiting_.erase(name);
+        return signals_[name] = create_cover(mig_, args, cubes, onset);
+    }
+};
+
+} // namespace detail
+
 /**
  * \brief Read in a classical logic network
  */
-mockturtle::mig_network read_network(const std::string& fname) {
+inline mockturtle::mig_network read_network(const std::string& fname) {
     mockturtle::mig_network mig;
 
     std::ifstream ifs;
@@ -98,11 +313,34 @@ mockturtle::mig_network read_network(const std::string& fname) {
         case Format::ascii_aiger:
             lorina::read_ascii_aiger(fname, mockturtle::aiger_reader(mig));
             break;
+        case Format::bench: {
+            detail::bench_reader reader(mig);
+            if (lorina::read_bench(fname, reader) !=
+                    lorina::return_code::success ||
+                !reader.finish()) {
+                std::cerr << "Could not read BENCH file \"" << fname << "\""
+                          << std::endl;
+                return mockturtle::mig_network();
+            }
+            break;
+        }
+        case Format::blif: {
+            detail::blif_reader reader(mig);
+            if (lorina::read_blif(fname, reader) !=
+                    lorina::return_code::success ||
+                !reader.finish()) {
+                std::cerr << "Could not read BLIF file \"" << fname << "\""
+                          << std::endl;
+                return mockturtle::mig_network();
+            }
+            break;
+        }
+        case Format::pla:
+            lorina::read_pla(fname, mockturtle::pla_reader(mig));
+            break;
         case Format::verilog:
             lorina::read_verilog(fname, mockturtle::verilog_reader(mig));
             break;
-        default:
-            std::cerr << "File type not currently cupported" << std::endl;
     }
 
     return mig;
@@ -110,70 +348,287 @@ mockturtle::mig_network read_network(const std::string& fname) {
 
 /** \brief Wrapper around ast::angle_to_expr to convert tweedledum angles to
  * ours */
-ast::ptr<ast::Expr> angle_to_expr(parser::Position pos,
-                                  tweedledum::angle angle) {
+inline ast::ptr<ast::Expr> angle_to_expr(parser::Position pos,
+                                         tweedledum::angle angle) {
     if (angle.is_numerically_defined())
         return ast::angle_to_expr(utils::Angle(angle.numeric_value()));
     else
         return ast::angle_to_expr(utils::Angle(*(angle.symbolic_value())));
 }
 
+/** \brief Mapping strategies of hierarchical synthesis */
+enum class mapping_strategy { eager, bennett, bennett_inplace };
+
+/** \brief Synthesis methods for single-target gates */
+enum class stg_method { pkrm, pprm, spectrum };
+
+/** \brief Costs minimized by automatic parameter selection */
+enum class synthesis_objective { qubits, t_count };
+
 /**
- * \brief LUT-based hierarchical logic synthesis (arXiv:1706.02721)
- * \note Based on an example given in the caterpillar synthesis library
+ * \brief Parameters of synthesize_net
+ *
+ * In automatic mode, every combination of parameters with cut sizes up to
+ * 6 is tried, starting from the given ones, while the budget allows. A
+ * combination is skipped if it is expected to overrun the budget, judging
+ * by the slowest synthesis of the same or a smaller cut size so far. The
+ * network minimizing the objective is kept, with the other costs breaking
+ * ties. Rotations outside Clifford+T count for more than any number of T
+ * gates. A budget of 0 tries every combination.
  */
-template <typename T>
-std::list<ast::ptr<ast::Gate>>
-synthesize_net(parser::Position pos, T& l_net,
-               const std::vector<ast::symbol>& params,
-               std::string anc = "anc") {
-    std::list<ast::ptr<ast::Gate>> ret;
+struct synthesis_params {
+    unsigned cut_size = 3; ///< inputs of the LUTs the network is mapped to
+    mapping_strategy strategy = mapping_strategy::eager;
+    stg_method stg = stg_method::pkrm;
+    unsigned toffoli_bound = 3; ///< max. controls before Clifford+T, 2 to 4
+    bool automatic = false;
+    synthesis_objective objective = synthesis_objective::qubits;
+    double budget = 1.0; ///< seconds of automatic search
+};
+
+/**
+ * \brief Identifies the parameters used by synthesize_net
+ *
+ * Part of the key of cached oracles, so must change whenever the synthesis
+ * pipeline does
+ */
+inline std::string synthesis_id(const synthesis_params& ps) {
+    if (ps.automatic) {
+        return "auto/" +
+               std::string(ps.objective == synthesis_objective::qubits
+                               ? "qubits/"
+                               : "t/") +
+               std::to_string(ps.budget) + "/" + std::to_string(ps.cut_size) +
+               "/" + std::to_string(static_cast<int>(ps.strategy)) + "/" +
+               std::to_string(static_cast<int>(ps.stg)) + "/" +
+               std::to_string(ps.toffoli_bound);
+    }
+    return "lut" + std::to_string(ps.cut_size) + "/" +
+           std::to_string(static_cast<int>(ps.strategy)) + "/" +
+           std::to_string(static_cast<int>(ps.stg)) + "/barenco" +
+           std::to_string(ps.toffoli_bound) + "/dt";
+}
+
+namespace detail {
+
+using quantum_network = tweedledum::gg_network<tweedledum::mcmt_gate>;
 
-    // Map network into lut with "cut size" 4
+/** \brief A synthesized network, with its inputs & outputs */
+struct synthesized_net {
+    quantum_network q_net;
+    std::vector<uint32_t> inputs;
+    std::vector<uint32_t> outputs;
+};
+
+/**
+ * \brief Non-Clifford cost of a network
+ *
+ * The number of z-rotations by angles other than multiples of pi/4, which
+ * need approximating, followed by the T-count
+ */
+inline std::pair<std::size_t, std::size_t>
+non_clifford_cost(const quantum_network& q_net) {
+    std::size_t rotations = 0;
+    std::size_t t = 0;
+    q_net.foreach_gate([&rotations, &t](auto const& node) {
+        auto const& gate = node.gate;
+        switch (gate.operation()) {
+            case tweedledum::gate_lib::t:
+            case tweedledum::gate_lib::t_dagger:
+                t++;
+                break;
+            case tweedledum::gate_lib::rotation_x:
+            case tweedledum::gate_lib::rotation_y:
+            case tweedledum::gate_lib::rotation_z: {
+                auto eighths =
+                    gate.rotation_angle().numeric_value() / (utils::pi / 4);
+                auto n = std::llround(eighths);
+                if (std::abs(eighths - n) > 1e-9)
+                    rotations++;
+                else if (n % 2 != 0)
+                    t++;
+                break;
+            }
+            default:
+                break;
+        }
+    });
+    return {rotations, t};
+}
+
+/** \brief Synthesizes a Clifford+T network with the given parameters */
+template <typename T>
+std::optional<synthesized_net> synthesize_qnet(T& l_net,
+                                               const synthesis_params& ps) {
+    // Map network into luts with at most cut_size inputs
     mockturtle::mapping_view<T, true> mapped_network{l_net};
-    mockturtle::lut_mapping_params ps;
-    ps.cut_enumeration_ps.cut_size = 3;
+    mockturtle::lut_mapping_params lut_ps;
+    lut_ps.cut_enumeration_ps.cut_size = ps.cut_size;
     mockturtle::lut_mapping<mockturtle::mapping_view<T, true>, true>(
-        mapped_network, ps);
+        mapped_network, lut_ps);
 
     // Collapse network into a klut network
     auto lutn = mockturtle::collapse_mapped_network<mockturtle::klut_network>(
         mapped_network);
-    tweedledum::gg_network<tweedledum::mcmt_gate> q_net;
     if (!lutn) {
         std::cerr << "Could not map network into klut network" << std::endl;
-        return std::move(ret);
+        return std::nullopt;
     }
 
-    // Synthesize a gate graph network with 1, 2, and 3 qubit gates using
-    // hierarchical synthesis and spectral analysis for klut synthesis.
-    // Mapping strategy is eager.
+    // Synthesize a gate graph network with multiple-controlled Toffolis
+    // using hierarchical synthesis
+    std::unique_ptr<caterpillar::mapping_strategy<mockturtle::klut_network>>
+        strategy;
+    switch (ps.strategy) {
+        case mapping_strategy::eager:
+            strategy = std::make_unique<caterpillar::eager_mapping_strategy<
+                mockturtle::klut_network>>();
+            break;
+        case mapping_strategy::bennett:
+            strategy = std::make_unique<caterpillar::bennett_mapping_strategy<
+                mockturtle::klut_network>>();
+            break;
+        case mapping_strategy::bennett_inplace:
+            strategy =
+                std::make_unique<caterpillar::bennett_inplace_mapping_strategy<
+                    mockturtle::klut_network>>();
+            break;
+    }
 
-    auto strategy =
-        caterpillar::eager_mapping_strategy<mockturtle::klut_network>();
+    synthesized_net ret;
     caterpillar::logic_network_synthesis_params p;
     caterpillar::logic_network_synthesis_stats stats;
-    caterpillar::logic_network_synthesis(
-        q_net, *lutn, strategy, tweedledum::stg_from_pkrm(), p, &stats);
+    auto synthesize = [&](auto&& stg) {
+        return caterpillar::logic_network_synthesis(ret.q_net, *lutn,
+                                                    *strategy, stg, p, &stats);
+    };
+    bool success = false;
+    switch (ps.stg) {
+        case stg_method::pkrm:
+            success = synthesize(tweedledum::stg_from_pkrm());
+            break;
+        case stg_method::pprm:
+            success = synthesize(tweedledum::stg_from_pprm());
+            break;
+        case stg_method::spectrum:
+            success = synthesize(tweedledum::stg_from_spectrum());
+            break;
+    }
+    if (!success)
+        return std::nullopt;
 
-    // Decompose Toffolis in terms of at most 3-control Toffolis
-    q_net = tweedledum::barenco_decomposition(q_net, {3});
+    // Decompose Toffolis in terms of at most toffoli_bound-control Toffolis
+    ret.q_net = tweedledum::barenco_decomposition(ret.q_net,
+                                                  {ps.toffoli_bound});
     // Decompose further into Clifford + T
-    q_net = tweedledum::dt_decomposition(q_net);
+    ret.q_net = tweedledum::dt_decomposition(ret.q_net);
+
+    ret.inputs = stats.i_indexes;
+    ret.outputs = stats.o_indexes;
+    return ret;
+}
+
+/** \brief Synthesizes with the best parameters found within the budget */
+template <typename T>
+std::optional<synthesized_net> search_qnet(T& l_net,
+                                           const synthesis_params& ps) {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+
+    // The given parameters first, then by increasing cut size
+    std::vector<synthesis_params> candidates{ps};
+    for (unsigned cut_size = 2; cut_size <= 6; cut_size++) {
+        for (auto strategy :
+             {mapping_strategy::eager, mapping_strategy::bennett,
+              mapping_strategy::bennett_inplace}) {
+            for (auto stg :
+                 {stg_method::pkrm, stg_method::pprm, stg_method::spectrum}) {
+                for (unsigned bound = 2; bound <= 4; bound++) {
+                    auto candidate = ps;
+                    candidate.cut_size = cut_size;
+                    candidate.strategy = strategy;
+                    candidate.stg = stg;
+                    candidate.toffoli_bound = bound;
+                    if (cut_size != ps.cut_size || strategy != ps.strategy ||
+                        stg != ps.stg || bound != ps.toffoli_bound)
+                        candidates.push_back(candidate);
+                }
+            }
+        }
+    }
+
+    // Slowest synthesis of each cut size so far. Synthesis time grows
+    // exponentially with the cut size, so an untried size is estimated at
+    // double the time per extra input of the largest smaller size tried
+    std::map<unsigned, double> slowest;
+    auto estimate = [&slowest](unsigned cut_size) {
+        auto it = slowest.upper_bound(cut_size);
+        if (it == slowest.begin())
+            return 0.0;
+        --it;
+        return it->second * (1u << (cut_size - it->first));
+    };
+
+    std::optional<synthesized_net> ret;
+    std::tuple<std::size_t, std::size_t, std::size_t> best_cost;
+    for (auto& candidate : candidates) {
+        std::chrono::duration<double> elapsed = clock::now() - start;
+        if (ret && ps.budget > 0 &&
+            elapsed.count() + estimate(candidate.cut_size) > ps.budget)
+            continue;
+
+        auto net = synthesize_qnet(l_net, candidate);
+        std::chrono::duration<double> time = clock::now() - start - elapsed;
+        auto& slowest_time = slowest[candidate.cut_size];
+        slowest_time = std::max(slowest_time, time.count());
+        if (!net)
+            continue;
+        std::size_t qubits = net->q_net.num_qubits();
+        auto [rotations, t] = non_clifford_cost(net->q_net);
+        auto cost = ps.objective == synthesis_objective::qubits
+                        ? std::make_tuple(qubits, rotations, t)
+                        : std::make_tuple(rotations, t, qubits);
+        if (!ret || cost < best_cost) {
+            ret = std::move(net);
+            best_cost = cost;
+        }
+    }
+
+    return ret;
+}
+
+} // namespace detail
+
+/**
+ * \brief LUT-based hierarchical logic synthesis (arXiv:1706.02721)
+ * \note Based on an example given in the caterpillar synthesis library
+ */
+template <typename T>
+std::list<ast::ptr<ast::Gate>>
+synthesize_net(parser::Position pos, T& l_net,
+               const std::vector<ast::symbol>& params,
+               std::string anc = "anc", const synthesis_params& ps = {}) {
+    std::list<ast::ptr<ast::Gate>> ret;
+
+    auto net = ps.automatic ? detail::search_qnet(l_net, ps)
+                            : detail::synthesize_qnet(l_net, ps);
+    if (!net)
+        return std::move(ret);
+    auto& q_net = net->q_net;
 
     /* AST building */
 
     // Allocate ancillas
     int num_qubits = q_net.num_qubits();
-    int num_inputs = stats.i_indexes.size() + stats.o_indexes.size();
+    int num_inputs = net->inputs.size() + net->outputs.size();
 
     ret.emplace_back(std::make_unique<ast::AncillaDecl>(
         ast::AncillaDecl(pos, anc, false, num_qubits - num_inputs)));
 
     // Create a mapping from qubits to functions generating declaration
     // references
-    auto inputs = stats.i_indexes;
-    inputs.insert(inputs.end(), stats.o_indexes.begin(), stats.o_indexes.end());
+    auto inputs = net->inputs;
+    inputs.insert(inputs.end(), net->outputs.begin(), net->outputs.end());
     if (params.size() != inputs.size()) {
         std::cerr << "Error: expected .v file with " << params.size()
                   << " inputs, got " << inputs.size() << "\n";
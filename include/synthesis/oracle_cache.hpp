@@ -0,0 +1,245 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file synthesis/oracle_cache.hpp
+ * \brief On-disk cache of synthesized oracles
+ */
+#pragma once
+
+#include "output/binary.hpp"
+#include "parser/binary.hpp"
+#include "transformations/substitution.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace staq {
+namespace synthesis {
+
+/**
+ * \class staq::synthesis::oracle_cache
+ * \brief Content-addressed cache of oracle gate bodies
+ *
+ * Entries are keyed on an FNV-1a hash of the logic file's contents & format,
+ * the ancilla name and a description of the synthesis parameters, and hold
+ * the synthesized body as a gate declaration in the binary circuit format.
+ * The declaration's parameters are the names the oracle was synthesized
+ * with, so an entry can be reused by any oracle on the same file.
+ *
+ * Entries are written to a temporary file and renamed into place, so the
+ * directory can be shared between concurrent runs. Entries which fail to
+ * load are removed silently, to be synthesized & stored again.
+ */
+class oracle_cache {
+  public:
+    /** \brief Lookup counters */
+    struct statistics {
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+    };
+
+    /** \param dir The cache directory, created on the first store */
+    oracle_cache(std::string dir) : dir_(std::move(dir)) {}
+
+    /**
+     * \brief The default cache directory
+     *
+     * $STAQ_CACHE_DIR if set, otherwise staq/ in $XDG_CACHE_HOME or
+     * $HOME/.cache. Empty if none of these are set.
+     */
+    static std::string default_directory() {
+        if (auto dir = std::getenv("STAQ_CACHE_DIR"))
+            return dir;
+        if (auto dir = std::getenv("XDG_CACHE_HOME"))
+            return std::string(dir) + "/staq";
+        if (auto dir = std::getenv("HOME"))
+            return std::string(dir) + "/.cache/staq";
+        return "";
+    }
+
+    /**
+     * \brief The key of an oracle
+     * \param contents The contents of the logic file
+     * \param format The file's extension
+     * \param anc The name of the local ancilla register
+     * \param params A description of the synthesis parameters
+     */
+    static uint64_t key(const std::string& contents, const std::string& format,
+                        const std::string& anc, const std::string& params) {
+        uint64_t hash = 14695981039346656037ull;
+        auto append = [&hash](const std::string& str) {
+            for (auto ch : str) {
+                hash ^= static_cast<unsigned char>(ch);
+                hash *= 1099511628211ull;
+            }
+            // Separator, so that fields can't run into each other
+            hash ^= 0xff;
+            hash *= 1099511628211ull;
+        };
+        append(std::to_string(parser::binary::version));
+        append(format);
+        append(anc);
+        append(params);
+        append(contents);
+        return hash;
+    }
+
+    /** \brief Lookup counters since construction */
+    statistics stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    /**
+     * \brief Loads a cached gate body
+     * \param params The oracle's parameters, substituted for the stored ones
+     * \return The body, or nullopt if there is no valid entry
+     */
+    std::optional<std::list<ast::ptr<ast::Gate>>>
+    load(uint64_t key, const std::vector<ast::symbol>& params) {
+        auto ret = read(key, params);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ret)
+            stats_.hits++;
+        else
+            stats_.misses++;
+        return ret;
+    }
+
+    /**
+     * \brief Stores a gate body
+     *
+     * Failures to write the entry are ignored, the cache being only an
+     * optimization
+     */
+    void store(uint64_t key, const std::vector<ast::symbol>& params,
+               const std::list<ast::ptr<ast::Gate>>& body) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        fs::create_directories(dir_, ec);
+        if (ec)
+            return;
+
+        parser::Position pos;
+        std::list<ast::ptr<ast::Gate>> gates;
+        for (auto& gate : body)
+            gates.emplace_back(ast::ptr<ast::Gate>(gate->clone()));
+        std::list<ast::ptr<ast::Stmt>> stmts;
+        stmts.emplace_back(ast::GateDecl::create(pos, "oracle", false, {},
+                                                 params, std::move(gates)));
+        auto prog = ast::Program::create(pos, false, std::move(stmts));
+
+        std::random_device rd;
+        auto tmp = path(key) + ".tmp" + std::to_string(rd());
+        {
+            std::ofstream ofs(tmp, std::ofstream::binary);
+            if (!ofs)
+                return;
+            output::BinaryOutputter(ofs).run(*prog);
+            if (!ofs) {
+                ofs.close();
+                fs::remove(tmp, ec);
+                return;
+            }
+        }
+        fs::rename(tmp, path(key), ec);
+        if (ec)
+            fs::remove(tmp, ec);
+    }
+
+  private:
+    std::string dir_;
+    mutable std::mutex mutex_;
+    statistics stats_;
+
+    std::string path(uint64_t key) const {
+        std::ostringstream ss;
+        ss << dir_ << "/" << std::hex;
+        ss.width(16);
+        ss.fill('0');
+        ss << key << ".sqb";
+        return ss.str();
+    }
+
+    // Removes an invalid entry
+    std::nullopt_t evict(uint64_t key) {
+        std::error_code ec;
+        std::filesystem::remove(path(key), ec);
+        return std::nullopt;
+    }
+
+    std::optional<std::list<ast::ptr<ast::Gate>>>
+    read(uint64_t key, const std::vector<ast::symbol>& params) {
+        std::ifstream ifs(path(key), std::ifstream::binary);
+        if (!ifs)
+            return std::nullopt;
+        std::string data{std::istreambuf_iterator<char>(ifs),
+                         std::istreambuf_iterator<char>()};
+        ifs.close();
+        if (!parser::binary::is_binary(data.data(), data.size()))
+            return evict(key);
+
+        // Entries are written by store, so skip semantic analysis. The
+        // entry's shape is checked below
+        ast::ptr<ast::Program> prog;
+        try {
+            prog = parser::binary::Reader(data, path(key), true).read();
+        } catch (parser::ParseError&) {
+            return evict(key);
+        }
+
+        auto& body = prog->body();
+        if (body.size() != 1)
+            return evict(key);
+        auto decl = dynamic_cast<ast::GateDecl*>(body.front().get());
+        if (!decl || decl->q_params().size() != params.size())
+            return evict(key);
+
+        // Rename the stored parameters
+        std::unordered_map<ast::VarAccess, ast::VarAccess> subst;
+        parser::Position pos;
+        for (std::size_t i = 0; i < params.size(); i++)
+            subst.emplace(ast::VarAccess(pos, decl->q_params()[i]),
+                          ast::VarAccess(pos, params[i]));
+
+        std::list<ast::ptr<ast::Gate>> ret;
+        for (auto& gate : decl->body()) {
+            transformations::subst_ap_ap(subst, *gate);
+            ret.emplace_back(std::move(gate));
+        }
+        return ret;
+    }
+};
+
+} // namespace synthesis
+} // namespace staq
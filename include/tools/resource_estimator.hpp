@@ -28,22 +28,45 @@
  */
 #pragma once
 
-// TODO: Account for compound gates, i.e. qreg q[n]; reset q;
-
 #include "ast/ast.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <optional>
+#include <sstream>
 
 namespace staq {
 namespace tools {
 
-using resource_count = std::unordered_map<std::string, int>;
+using resource_count = std::unordered_map<std::string, long long>;
 
-void add_counts(resource_count& A, const resource_count& B) {
+inline void add_counts(resource_count& A, const resource_count& B,
+                       long long mult = 1) {
     for (auto& [gate, num] : B)
-        A[gate] += num;
+        A[gate] += mult * num;
 }
 
+/**
+ * \class staq::tools::ResourceEstimator
+ * \brief Gate count and depth estimation
+ *
+ * Declared gates are summarized by their gate counts and, for each output
+ * qubit, the length of the longest path to it from each input qubit and
+ * from the local ancillas, together with the longest path ending in an
+ * ancilla. Applications of a gate compose its summary with the depths of
+ * its arguments. Summaries are computed once per gate & distinct tuple of
+ * classical arguments.
+ *
+ * For gates without local ancillas this gives the same depth as inlining
+ * would. Local ancillas are taken to be fresh for each application, while
+ * the inliner reuses one global ancilla register across applications,
+ * which may serialize them, so the depth is then a lower bound on that of
+ * the inlined program.
+ *
+ * Gates applied to whole registers are counted as one application per
+ * register index, so programs need not be desugared first. Registers only
+ * ever used as a whole keep a single depth for all their qubits.
+ */
 class ResourceEstimator final : public ast::Visitor {
   public:
     struct config {
@@ -61,17 +84,15 @@ class ResourceEstimator final : public ast::Visitor {
 
         node.accept(*this);
 
-        // Unboxing the running estimate
-        auto& [counts, depths] = running_estimate_;
-
         // Get maximum critical path length
-        int depth = 0;
-        for (auto& [id, length] : depths) {
-            if (length > depth)
-                depth = length;
+        long long depth = std::max(0LL, context_.sink[0]);
+        for (auto& [id, reg] : context_.wires) {
+            for (auto& wire : reg.wires)
+                depth = std::max(depth, wire[0]);
         }
 
         // Set depth and return
+        auto& counts = context_.counts;
         counts["depth"] = depth;
         return counts;
     }
@@ -80,109 +101,131 @@ class ResourceEstimator final : public ast::Visitor {
     void visit(ast::VarAccess&) {}
 
     /* Expressions */
-    void visit(ast::BExpr&) {}
-    void visit(ast::UExpr&) {}
-    void visit(ast::PiExpr&) {}
-    void visit(ast::IntExpr&) {}
-    void visit(ast::RealExpr&) {}
-    void visit(ast::VarExpr&) {}
+    void visit(ast::BExpr& expr) {
+        auto lexp = evaluate(expr.lexp());
+        auto rexp = evaluate(expr.rexp());
+        value_ = std::nullopt;
+        if (!lexp || !rexp)
+            return;
+
+        switch (expr.op()) {
+            case ast::BinaryOp::Plus:
+                value_ = *lexp + *rexp;
+                break;
+            case ast::BinaryOp::Minus:
+                value_ = *lexp - *rexp;
+                break;
+            case ast::BinaryOp::Times:
+                value_ = *lexp * *rexp;
+                break;
+            case ast::BinaryOp::Divide:
+                value_ = *lexp / *rexp;
+                break;
+            case ast::BinaryOp::Pow:
+                value_ = pow(*lexp, *rexp);
+                break;
+        }
+    }
+    void visit(ast::UExpr& expr) {
+        auto subexp = evaluate(expr.subexp());
+        value_ = std::nullopt;
+        if (!subexp)
+            return;
+
+        switch (expr.op()) {
+            case ast::UnaryOp::Neg:
+                value_ = -*subexp;
+                break;
+            case ast::UnaryOp::Sin:
+                value_ = sin(*subexp);
+                break;
+            case ast::UnaryOp::Cos:
+                value_ = cos(*subexp);
+                break;
+            case ast::UnaryOp::Tan:
+                value_ = tan(*subexp);
+                break;
+            case ast::UnaryOp::Ln:
+                value_ = log(*subexp);
+                break;
+            case ast::UnaryOp::Sqrt:
+                value_ = sqrt(*subexp);
+                break;
+            case ast::UnaryOp::Exp:
+                value_ = exp(*subexp);
+                break;
+        }
+    }
+    void visit(ast::PiExpr& expr) { value_ = expr.constant_eval(); }
+    void visit(ast::IntExpr& expr) { value_ = expr.constant_eval(); }
+    void visit(ast::RealExpr& expr) { value_ = expr.constant_eval(); }
+    void visit(ast::VarExpr& expr) {
+        auto it = context_.env.find(expr.var());
+        if (it != context_.env.end())
+            value_ = it->second;
+        else
+            value_ = std::nullopt;
+    }
 
     /* Statements */
     void visit(ast::MeasureStmt& stmt) {
-        auto& [counts, depths] = running_estimate_;
-
-        // Gate count
-        counts["measurement"] += 1;
-
-        // Depth
-        int in_depth = std::max(depths[stmt.c_arg()], depths[stmt.q_arg()]);
-        depths[stmt.c_arg()] = in_depth + 1;
-        depths[stmt.q_arg()] = in_depth + 1;
+        auto num = apply({stmt.q_arg(), stmt.c_arg()}, nullptr);
+        context_.counts["measurement"] += num;
     }
     void visit(ast::ResetStmt& stmt) {
-        auto& [counts, depths] = running_estimate_;
-
-        // Gate count
-        counts["reset"] += 1;
-
-        // Depth
-        depths[stmt.arg()] += 1;
+        auto num = apply({stmt.arg()}, nullptr);
+        context_.counts["reset"] += num;
     }
     void visit(ast::IfStmt& stmt) { stmt.then().accept(*this); }
 
     /* Gates */
     void visit(ast::UGate& gate) {
-        auto& [counts, depths] = running_estimate_;
-
         // Gate count
         std::stringstream ss;
-        auto theta = gate.theta().constant_eval();
-        auto phi = gate.phi().constant_eval();
-        auto lambda = gate.lambda().constant_eval();
+        auto theta = evaluate(gate.theta());
+        auto phi = evaluate(gate.phi());
+        auto lambda = evaluate(gate.lambda());
 
         if (theta && phi && lambda)
             ss << "U(" << *theta << "," << *phi << "," << *lambda << ")";
         else
             ss << "U";
 
-        counts[ss.str()] += 1;
-
-        // Depth
-        depths[gate.arg()] += 1;
+        auto num = apply({gate.arg()}, nullptr);
+        context_.counts[ss.str()] += num;
     }
     void visit(ast::CNOTGate& gate) {
-        auto& [counts, depths] = running_estimate_;
-
-        // Gate count
-        counts["CX"] += 1;
-
-        // Depth
-        int in_depth = std::max(depths[gate.ctrl()], depths[gate.tgt()]);
-        depths[gate.ctrl()] = in_depth + 1;
-        depths[gate.tgt()] = in_depth + 1;
+        auto num = apply({gate.ctrl(), gate.tgt()}, nullptr);
+        context_.counts["CX"] += num;
     }
     void visit(ast::BarrierGate& gate) {
-        auto& [counts, depths] = running_estimate_;
-
-        // Gate count
-        counts["barrier"] += 1;
-
-        // Depth
-        int in_depth = -1;
-        gate.foreach_arg([&in_depth, this](auto& arg) {
-            in_depth = std::max(in_depth, running_estimate_.second[arg]);
-        });
-        gate.foreach_arg([in_depth, this](auto& arg) {
-            running_estimate_.second[arg] = in_depth + 1;
-        });
+        auto num = apply(gate.args(), nullptr);
+        context_.counts["barrier"] += num;
     }
     void visit(ast::DeclaredGate& gate) {
-        auto& [counts, depths] = running_estimate_;
-
         // Gate count
         auto tmp = gate.name();
         if (config_.merge_dagger)
             strip_dagger(tmp);
 
+        std::vector<std::optional<double>> args;
+        gate.foreach_carg(
+            [this, &args](auto& arg) { args.push_back(evaluate(arg)); });
+
         std::stringstream ss;
         bool all_constant = true;
         if (gate.num_cargs() > 0) {
-            bool flag = true;
             ss << "(";
-            gate.foreach_carg([&ss, &flag, &all_constant](auto& arg) {
-                auto val = arg.constant_eval();
-
+            for (std::size_t i = 0; i < args.size(); i++) {
                 // Correct commas
-                if (flag)
-                    flag = false;
-                else
+                if (i > 0)
                     ss << ",";
 
-                if (val)
-                    ss << *val;
+                if (args[i])
+                    ss << *args[i];
                 else
                     all_constant = false;
-            });
+            }
             ss << ")";
         }
 
@@ -192,65 +235,40 @@ class ResourceEstimator final : public ast::Visitor {
         else
             name = tmp;
 
-        auto& [gate_counts, depth_counts] = resource_map_[name];
+        auto it = decls_.find(gate.name());
         if (config_.unbox &&
-            (config_.overrides.find(name) == config_.overrides.end()) &&
-            (gate.num_cargs() == 0)) {
-            add_counts(counts, gate_counts);
-
-            // Note that this gives the "boxed" depth, which is not really
-            // optimal In the future this should be changed
-            int in_depth = -1;
-            int gate_depth = gate_counts["depth"];
-            gate.foreach_qarg([&in_depth, this](auto& arg) {
-                in_depth = std::max(in_depth, running_estimate_.second[arg]);
-            });
-            gate.foreach_qarg([in_depth, this, gate_depth](auto& arg) {
-                running_estimate_.second[arg] = in_depth + gate_depth;
-            });
+            (config_.overrides.find(tmp) == config_.overrides.end()) &&
+            it != decls_.end()) {
+            auto& gate_summary = summarize(*it->second, args);
+            auto num = apply(gate.qargs(), &gate_summary);
+            add_counts(context_.counts, gate_summary.counts, num);
         } else {
-            counts[name] += 1;
-            gate.foreach_qarg(
-                [this](auto& arg) { running_estimate_.second[arg] += 1; });
+            auto num = apply(gate.qargs(), nullptr);
+            context_.counts[name] += num;
         }
     }
 
     /* Declarations */
     void visit(ast::GateDecl& decl) {
-        // Initialize a new resource count
-        auto& local_state = resource_map_[decl.id()];
-        std::swap(running_estimate_, local_state);
-
-        decl.foreach_stmt([this](auto& gate) { gate.accept(*this); });
-
-        // Get maximum critical path length
-        auto& [counts, depths] = running_estimate_;
-        int depth = 0;
-        for (auto& [id, length] : depths) {
-            if (length > depth)
-                depth = length;
-        }
-
-        // Set depth and return
-        counts["depth"] = depth;
-
-        std::swap(running_estimate_, local_state);
+        // Summarized on use, once the classical arguments are known
+        if (!decl.is_opaque())
+            decls_[decl.id()] = &decl;
     }
     void visit(ast::OracleDecl&) {}
     void visit(ast::RegisterDecl& decl) {
-        auto& [counts, depths] = running_estimate_;
+        declare(decl.id(), decl.size());
 
         if (decl.is_quantum()) {
-            counts["qubits"] += decl.size();
+            context_.counts["qubits"] += decl.size();
         } else {
-            counts["cbits"] += decl.size();
+            context_.counts["cbits"] += decl.size();
         }
     }
     void visit(ast::AncillaDecl& decl) {
-        auto& [counts, depths] = running_estimate_;
+        declare(decl.id(), decl.size());
 
         if (!decl.is_dirty())
-            counts["ancillas"] += decl.size();
+            context_.counts["ancillas"] += decl.size();
     }
 
     /* Program */
@@ -259,18 +277,228 @@ class ResourceEstimator final : public ast::Visitor {
     }
 
   private:
-    using depth_count = std::unordered_map<ast::VarAccess, int>;
-    using resource_state = std::pair<resource_count, depth_count>;
+    /**
+     * \brief Longest paths into a wire, from each input of the enclosing
+     * gate and lastly from its local ancillas
+     *
+     * Paths that do not exist have length none
+     */
+    using profile = std::vector<long long>;
+    static constexpr long long none = -1;
+
+    /** \brief The wires of a register, or one wire shared by all */
+    struct wire_set {
+        int size = 0;
+        bool uniform = false;
+        std::vector<profile> wires{};
+    };
+
+    /**
+     * \brief The resources used by a gate
+     *
+     * The profile of each parameter at the end of the gate, followed by the
+     * longest paths ending in a local ancilla
+     */
+    struct summary {
+        resource_count counts;
+        std::vector<profile> outputs;
+    };
+
+    /** \brief The state of the gate body or program being estimated */
+    struct context {
+        int num_inputs = 0;
+        resource_count counts{};
+        std::unordered_map<std::string, wire_set> wires{};
+        profile sink{none}; ///< paths ending in a discarded wire
+        std::unordered_map<std::string_view, double> env{};
+    };
 
     config config_;
-    std::unordered_map<std::string_view, resource_state> resource_map_;
+    std::unordered_map<std::string_view, ast::GateDecl*> decls_;
+    std::unordered_map<std::string, summary> summaries_;
 
-    resource_state running_estimate_;
+    context context_;
+    std::optional<double> value_;
 
     void reset() {
-        resource_map_.clear();
-        running_estimate_.first.clear();
-        running_estimate_.second.clear();
+        decls_.clear();
+        summaries_.clear();
+        context_ = context();
+    }
+
+    std::optional<double> evaluate(ast::Expr& expr) {
+        expr.accept(*this);
+        return value_;
+    }
+
+    // A wire starting in the enclosing gate
+    profile fresh() const {
+        profile ret(context_.num_inputs + 1, none);
+        ret.back() = 0;
+        return ret;
+    }
+
+    void declare(const std::string& id, int size) {
+        auto& reg = context_.wires[id];
+        reg.size = size;
+        reg.uniform = true;
+        reg.wires.assign(1, fresh());
+    }
+
+    // The wire of the i-th application's argument. Whole registers of more
+    // than one qubit are expanded, gate parameters are single qubits
+    profile& wire(const ast::VarAccess& arg, int i) {
+        auto& reg = context_.wires[arg.var()];
+        std::size_t index = arg.offset() ? *arg.offset() : reg.size > 1 ? i : 0;
+        if (reg.uniform) {
+            reg.uniform = false;
+            reg.wires.resize(reg.size, reg.wires.front());
+        }
+        if (index >= reg.wires.size())
+            reg.wires.resize(index + 1, fresh());
+        return reg.wires[index];
+    }
+
+    /**
+     * \brief Applies a gate to its arguments
+     *
+     * Applies a summarized gate, or a primitive gate if gate is null, once
+     * per register index if applied to whole registers. Returns the number
+     * of applications
+     */
+    int apply(const std::vector<ast::VarAccess>& args, const summary* gate) {
+        // Compute the number of times a gate is applied, i.e. the size of
+        // any register it is applied to as a whole
+        int num = 1;
+        std::vector<profile*> wires;
+        std::vector<int> sizes;
+        for (auto& arg : args) {
+            auto it = context_.wires.find(arg.var());
+            if (it != context_.wires.end() && !arg.offset()) {
+                num = std::max(num, it->second.size);
+                if (it->second.uniform) {
+                    wires.push_back(&it->second.wires.front());
+                    sizes.push_back(it->second.size);
+                }
+            }
+        }
+
+        // Registers used as a whole stay uniform
+        if (wires.size() == args.size() &&
+            std::all_of(sizes.begin(), sizes.end(),
+                        [num](int size) { return size == num; })) {
+            apply(wires, gate);
+            return num;
+        }
+
+        for (int i = 0; i < num; i++) {
+            for (auto& arg : args)
+                wire(arg, i);
+            wires.clear();
+            for (auto& arg : args)
+                wires.push_back(&wire(arg, i));
+            apply(wires, gate);
+        }
+        return num;
+    }
+
+    void apply(const std::vector<profile*>& wires, const summary* gate) {
+        auto size = context_.num_inputs + 1;
+
+        // Primitive gates synchronize their arguments
+        if (!gate) {
+            profile out(size, none);
+            for (auto wire : wires) {
+                for (int x = 0; x < size; x++)
+                    out[x] = std::max(out[x], (*wire)[x]);
+            }
+            for (auto& len : out) {
+                if (len != none)
+                    len++;
+            }
+            for (auto wire : wires)
+                *wire = out;
+            return;
+        }
+
+        // Otherwise compose the longest paths through the gate
+        auto m = wires.size();
+        std::vector<profile> outs(m + 1, profile(size, none));
+        for (std::size_t j = 0; j <= m; j++) {
+            auto& through = gate->outputs[j];
+            for (std::size_t y = 0; y < m; y++) {
+                if (through[y] == none)
+                    continue;
+                for (int x = 0; x < size; x++) {
+                    if ((*wires[y])[x] != none)
+                        outs[j][x] = std::max(outs[j][x],
+                                              (*wires[y])[x] + through[y]);
+                }
+            }
+            if (through[m] != none)
+                outs[j][size - 1] = std::max(outs[j][size - 1], through[m]);
+        }
+
+        for (std::size_t j = 0; j < m; j++)
+            *wires[j] = std::move(outs[j]);
+        for (int x = 0; x < size; x++)
+            context_.sink[x] = std::max(context_.sink[x], outs[m][x]);
+    }
+
+    // Summarize a gate, given its classical arguments
+    const summary& summarize(ast::GateDecl& decl,
+                             const std::vector<std::optional<double>>& args) {
+        std::stringstream key;
+        key.precision(17);
+        key << decl.id();
+        for (auto& arg : args) {
+            key << ",";
+            if (arg)
+                key << *arg;
+        }
+        if (auto it = summaries_.find(key.str()); it != summaries_.end())
+            return it->second;
+
+        // Initialize a new context with the parameters as inputs
+        context local_state;
+        auto m = static_cast<int>(decl.q_params().size());
+        local_state.num_inputs = m;
+        local_state.sink.assign(m + 1, none);
+        for (int i = 0; i < m; i++) {
+            auto& param = local_state.wires[decl.q_params()[i]];
+            param.size = 1;
+            param.uniform = true;
+            param.wires.assign(1, profile(m + 1, none));
+            param.wires.front()[i] = 0;
+        }
+        for (std::size_t i = 0; i < decl.c_params().size(); i++) {
+            if (i < args.size() && args[i])
+                local_state.env[decl.c_params()[i]] = *args[i];
+        }
+        std::swap(context_, local_state);
+
+        decl.foreach_stmt([this](auto& gate) { gate.accept(*this); });
+
+        // Ancillas end inside the gate
+        summary ret;
+        for (int i = 0; i < m; i++)
+            ret.outputs.push_back(
+                context_.wires[decl.q_params()[i]].wires.front());
+        auto sink = context_.sink;
+        for (auto& [id, reg] : context_.wires) {
+            if (std::find(decl.q_params().begin(), decl.q_params().end(),
+                          id) != decl.q_params().end())
+                continue;
+            for (auto& wire : reg.wires) {
+                for (int x = 0; x <= m; x++)
+                    sink[x] = std::max(sink[x], wire[x]);
+            }
+        }
+        ret.outputs.push_back(std::move(sink));
+        ret.counts = std::move(context_.counts);
+
+        std::swap(context_, local_state);
+        return summaries_.emplace(key.str(), std::move(ret)).first->second;
     }
 
     void strip_dagger(std::string& str) {
@@ -282,13 +510,14 @@ class ResourceEstimator final : public ast::Visitor {
     }
 };
 
-resource_count estimate_resources(ast::ASTNode& node) {
+inline resource_count estimate_resources(ast::ASTNode& node) {
     ResourceEstimator estimator;
     return estimator.run(node);
 }
 
-resource_count estimate_resources(ast::ASTNode& node,
-                                  const ResourceEstimator::config& params) {
+inline resource_count
+estimate_resources(ast::ASTNode& node,
+                   const ResourceEstimator::config& params) {
     ResourceEstimator estimator(params);
     return estimator.run(node);
 }
@@ -0,0 +1,537 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tools/scheduler.hpp
+ * \brief Latency scheduling
+ */
+#pragma once
+
+#include "ast/ast.hpp"
+#include "mapping/device.hpp"
+#include "tools/resource_estimator.hpp"
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace staq {
+namespace tools {
+
+/** \brief Timing of one qubit or bit */
+struct wire_timing {
+    std::string name;
+    double busy = 0;      ///< total duration of the operations on it
+    double idle_asap = 0; ///< idle time between its first & last operations
+    double idle_alap = 0; ///< as above, when scheduled as late as possible
+};
+
+/** \brief An operation on the critical path */
+struct scheduled_op {
+    std::string text;
+    double start;
+    double duration;
+};
+
+/** \brief Results of scheduling a program */
+struct schedule_report {
+    double latency = 0;
+    int t_depth = 0;
+    int cnot_depth = 0;
+    std::vector<wire_timing> wires{};
+    std::vector<scheduled_op> critical_path{};
+};
+
+/**
+ * \class staq::tools::Scheduler
+ * \brief ASAP & ALAP scheduling with gate durations
+ *
+ * Operations are scheduled in program order, each starting once all of
+ * its qubits & bits are free. Gates applied to whole registers are
+ * scheduled once per register index, except barriers which synchronize
+ * every qubit of their registers at once, and classically controlled gates
+ * wait on every bit of their register. Declared gates are scheduled
+ * through their bodies, at the granularity ResourceEstimator counts the
+ * depth at: gates in the overrides (by default the standard library), opaque
+ * gates and gates given a duration are single operations. Local ancillas are
+ * fresh wires for each application of a gate and are left out of the
+ * per-wire timings.
+ *
+ * Durations are looked up by gate name ("U", "CX", "measure", "reset" or
+ * the name of a declared gate), falling back to a default duration.
+ * Barriers synchronize their arguments and take no time. If a device with
+ * gate durations is given and the program has a single quantum register,
+ * as mapped programs do, gates on one or two qubits take the duration the
+ * device gives for the corresponding physical qubits, if any.
+ *
+ * T-depth & CNOT-depth are the largest number of t/tdg and CX/cx
+ * operations on any path through the circuit, so that with unit durations
+ * neither exceeds the latency.
+ */
+class Scheduler final : public ast::Visitor {
+  public:
+    struct config {
+        std::unordered_map<std::string, double> durations{};
+        double default_duration = 1;
+        const mapping::Device* device = nullptr;
+        std::set<std::string_view> overrides = ast::qelib_defs;
+    };
+
+    Scheduler() = default;
+    Scheduler(const config& params) : Visitor(), config_(params) {}
+    ~Scheduler() = default;
+
+    schedule_report run(ast::Program& prog) {
+        registers_.clear();
+        wire_ids_.clear();
+        wires_.clear();
+        ops_.clear();
+        decls_.clear();
+        num_ancillas_ = 0;
+
+        num_qregs_ = 0;
+        prog.foreach_stmt([this](auto& stmt) {
+            if (auto decl = dynamic_cast<ast::RegisterDecl*>(&stmt))
+                num_qregs_ += decl->is_quantum();
+        });
+        prog.accept(*this);
+
+        schedule_report ret;
+        int last = -1;
+        for (std::size_t i = 0; i < ops_.size(); i++) {
+            if (ops_[i].start + ops_[i].duration > ret.latency || last == -1) {
+                ret.latency = ops_[i].start + ops_[i].duration;
+                last = static_cast<int>(i);
+            }
+        }
+        for (auto& wire : wires_) {
+            ret.t_depth = std::max(ret.t_depth, wire.t_depth);
+            ret.cnot_depth = std::max(ret.cnot_depth, wire.cnot_depth);
+        }
+
+        // ALAP: schedule backwards from the end of the program
+        std::vector<double> tail(wires_.size(), 0);
+        std::vector<double> alap_first(wires_.size(), ret.latency);
+        std::vector<double> alap_last(wires_.size(), 0);
+        for (auto it = ops_.rbegin(); it != ops_.rend(); it++) {
+            double end = ret.latency;
+            for (auto w : it->wires)
+                end = std::min(end, ret.latency - tail[w]);
+            auto start = end - it->duration;
+            for (auto w : it->wires) {
+                tail[w] = ret.latency - start;
+                alap_first[w] = std::min(alap_first[w], start);
+                alap_last[w] = std::max(alap_last[w], end);
+            }
+        }
+
+        for (std::size_t w = 0; w < wires_.size(); w++) {
+            auto& wire = wires_[w];
+            if (!wire.listed)
+                continue;
+            wire_timing timing;
+            timing.name = wire.name;
+            timing.busy = wire.busy;
+            if (wire.first >= 0) {
+                timing.idle_asap = wire.ready - wire.first - wire.busy;
+                timing.idle_alap = alap_last[w] - alap_first[w] - wire.busy;
+            }
+            ret.wires.push_back(timing);
+        }
+
+        // Walk back along the operations which delayed each other
+        for (auto i = last; i != -1; i = ops_[i].pred)
+            ret.critical_path.push_back(
+                {ops_[i].text, ops_[i].start, ops_[i].duration});
+        std::reverse(ret.critical_path.begin(), ret.critical_path.end());
+
+        return ret;
+    }
+
+    /* Variables */
+    void visit(ast::VarAccess&) {}
+
+    /* Expressions */
+    void visit(ast::BExpr&) {}
+    void visit(ast::UExpr&) {}
+    void visit(ast::PiExpr&) {}
+    void visit(ast::IntExpr&) {}
+    void visit(ast::RealExpr&) {}
+    void visit(ast::VarExpr&) {}
+
+    /* Statements */
+    void visit(ast::MeasureStmt& stmt) {
+        schedule("measure", {stmt.q_arg(), stmt.c_arg()});
+    }
+    void visit(ast::ResetStmt& stmt) { schedule("reset", {stmt.arg()}); }
+    void visit(ast::IfStmt& stmt) {
+        control_ = stmt.var();
+        stmt.then().accept(*this);
+        control_.clear();
+    }
+
+    /* Gates */
+    void visit(ast::UGate& gate) { schedule("U", {gate.arg()}); }
+    void visit(ast::CNOTGate& gate) {
+        schedule("CX", {gate.ctrl(), gate.tgt()});
+    }
+    void visit(ast::BarrierGate& gate) { schedule("barrier", gate.args()); }
+    void visit(ast::DeclaredGate& gate) {
+        schedule(gate.name(), gate.qargs());
+    }
+
+    /* Declarations */
+    void visit(ast::GateDecl& decl) {
+        if (!decl.is_opaque())
+            decls_[decl.id()] = &decl;
+    }
+    void visit(ast::OracleDecl&) {}
+    void visit(ast::RegisterDecl& decl) {
+        registers_[decl.id()] = decl.size();
+    }
+    void visit(ast::AncillaDecl& decl) {
+        registers_[decl.id()] = decl.size();
+    }
+
+    /* Program */
+    void visit(ast::Program& prog) {
+        prog.foreach_stmt([this](auto& stmt) { stmt.accept(*this); });
+    }
+
+  private:
+    struct wire {
+        std::string name;
+        double ready = 0;  ///< end of the last operation
+        double first = -1; ///< start of the first operation
+        double busy = 0;
+        int t_depth = 0;
+        int cnot_depth = 0;
+        int last = -1;   ///< index of the last operation
+        int qubit = -1;  ///< index in its register, if not a local ancilla
+        bool listed = true; ///< false for the local ancillas of a gate
+    };
+
+    struct op {
+        std::string text;
+        std::vector<int> wires;
+        double start;
+        double duration;
+        int pred; ///< the operation it waited on, or -1
+    };
+
+    config config_;
+    std::unordered_map<std::string, int> registers_; // sizes
+    std::unordered_map<std::string, int> wire_ids_;
+    std::vector<wire> wires_;
+    std::vector<op> ops_;
+    std::string control_; // register controlling the current gate
+    int num_qregs_ = 0;
+    int num_ancillas_ = 0; // local ancilla registers allocated so far
+    std::unordered_map<std::string, ast::GateDecl*> decls_;
+
+    int wire_id(const std::string& name) {
+        auto [it, inserted] = wire_ids_.try_emplace(name, wires_.size());
+        if (inserted) {
+            wires_.emplace_back();
+            wires_.back().name = name;
+        }
+        return it->second;
+    }
+
+    // The wire of the i-th application's argument
+    int wire_id(const ast::VarAccess& arg, int i) {
+        auto offset = arg.offset();
+        if (!offset && registers_.find(arg.var()) != registers_.end())
+            offset = i;
+        if (!offset)
+            return wire_id(arg.var());
+        auto ret = wire_id(arg.var() + "[" + std::to_string(*offset) + "]");
+        wires_[ret].qubit = *offset;
+        return ret;
+    }
+
+    /** \brief Whether a declared gate is scheduled through its body */
+    bool expands(const std::string& name) const {
+        return decls_.find(name) != decls_.end() &&
+               config_.overrides.find(name) == config_.overrides.end() &&
+               config_.durations.find(name) == config_.durations.end();
+    }
+
+    double duration(const std::string& name, const std::vector<int>& wires) {
+        if (name == "barrier")
+            return 0;
+
+        // Physical durations from the device
+        if (config_.device && num_qregs_ == 1 && name != "measure" &&
+            name != "reset") {
+            std::vector<int> qubits;
+            for (auto w : wires)
+                qubits.push_back(wires_[w].qubit);
+            // Local ancillas have no physical qubit
+            auto local =
+                std::find(qubits.begin(), qubits.end(), -1) != qubits.end();
+            double time = 0;
+            if (!local && qubits.size() == 1)
+                time = config_.device->sq_duration(qubits[0]);
+            else if (!local && qubits.size() == 2)
+                time = config_.device->tq_duration(qubits[0], qubits[1]);
+            if (time > 0)
+                return time;
+        }
+
+        if (auto it = config_.durations.find(name);
+            it != config_.durations.end())
+            return it->second;
+        return config_.default_duration;
+    }
+
+    /**
+     * \brief The wires of each application of a gate
+     *
+     * A gate applied to whole registers is applied once per index, except
+     * a barrier which is applied once, to every qubit of its registers
+     */
+    template <typename Resolve>
+    static std::vector<std::vector<int>>
+    applications(const std::string& name,
+                 const std::vector<ast::VarAccess>& args, Resolve&& resolve) {
+        std::vector<std::vector<std::vector<int>>> regs;
+        std::size_t num = 1;
+        for (auto& arg : args) {
+            regs.push_back(resolve(arg));
+            if (!arg.offset() && regs.back().size() > 1)
+                num = regs.back().size();
+        }
+
+        std::vector<std::vector<int>> ret;
+        if (name == "barrier") {
+            ret.emplace_back();
+            for (auto& reg : regs)
+                for (auto& w : reg)
+                    ret.back().insert(ret.back().end(), w.begin(), w.end());
+            return ret;
+        }
+        for (std::size_t i = 0; i < num; i++) {
+            ret.emplace_back();
+            for (auto& reg : regs) {
+                auto& w = reg[reg.size() > 1 ? i : 0];
+                ret.back().insert(ret.back().end(), w.begin(), w.end());
+            }
+        }
+        return ret;
+    }
+
+    void schedule(const std::string& name,
+                  const std::vector<ast::VarAccess>& args) {
+        auto resolve = [this](const ast::VarAccess& arg) {
+            std::vector<std::vector<int>> ret;
+            auto it = registers_.find(arg.var());
+            auto size = it != registers_.end() && !arg.offset() ? it->second
+                                                                : 1;
+            for (auto i = 0; i < size; i++)
+                ret.push_back({wire_id(arg, i)});
+            return ret;
+        };
+        for (auto& wires : applications(name, args, resolve))
+            dispatch(name, wires);
+    }
+
+    void dispatch(const std::string& name, const std::vector<int>& wires) {
+        if (expands(name))
+            expand(*decls_[name], wires);
+        else
+            emit(name, wires);
+    }
+
+    /**
+     * \brief Schedules the body of a declared gate on the given wires
+     *
+     * Local ancillas are fresh wires for each application of the gate
+     */
+    void expand(ast::GateDecl& decl, const std::vector<int>& wires) {
+        std::unordered_map<std::string, std::vector<int>> locals;
+        for (std::size_t j = 0; j < decl.q_params().size(); j++)
+            locals[decl.q_params()[j]] = {wires[j]};
+
+        auto resolve = [&locals](const ast::VarAccess& arg) {
+            std::vector<std::vector<int>> ret;
+            auto& reg = locals[arg.var()];
+            if (arg.offset())
+                ret.push_back({reg[*arg.offset()]});
+            else
+                for (auto w : reg)
+                    ret.push_back({w});
+            return ret;
+        };
+        auto run = [&](const std::string& name,
+                       const std::vector<ast::VarAccess>& args) {
+            for (auto& app : applications(name, args, resolve))
+                dispatch(name, app);
+        };
+
+        for (auto& gate : decl.body()) {
+            if (auto u = dynamic_cast<ast::UGate*>(gate.get())) {
+                run("U", {u->arg()});
+            } else if (auto cx = dynamic_cast<ast::CNOTGate*>(gate.get())) {
+                run("CX", {cx->ctrl(), cx->tgt()});
+            } else if (auto b = dynamic_cast<ast::BarrierGate*>(gate.get())) {
+                run("barrier", b->args());
+            } else if (auto g = dynamic_cast<ast::DeclaredGate*>(gate.get())) {
+                run(g->name(), g->qargs());
+            } else if (auto a = dynamic_cast<ast::AncillaDecl*>(gate.get())) {
+                auto prefix = decl.id() + "." + a->id() + "#" +
+                              std::to_string(num_ancillas_++);
+                auto& reg = locals[a->id()];
+                reg.clear();
+                for (auto i = 0; i < a->size(); i++) {
+                    reg.push_back(
+                        wire_id(prefix + "[" + std::to_string(i) + "]"));
+                    wires_[reg.back()].listed = false;
+                }
+            }
+        }
+    }
+
+    /** \brief Schedules a single operation */
+    void emit(const std::string& name, const std::vector<int>& wires) {
+        op next;
+        next.text = name;
+        next.wires = wires;
+        for (std::size_t j = 0; j < wires.size(); j++)
+            next.text += (j == 0 ? " " : ",") + wires_[wires[j]].name;
+        if (!control_.empty()) {
+            for (auto j = 0; j < registers_[control_]; j++)
+                next.wires.push_back(
+                    wire_id(control_ + "[" + std::to_string(j) + "]"));
+            next.text = "if(" + control_ + ") " + next.text;
+        }
+        next.duration = duration(name, wires);
+
+        // ASAP: start once every wire is free
+        next.start = 0;
+        next.pred = -1;
+        for (auto w : next.wires)
+            next.start = std::max(next.start, wires_[w].ready);
+        for (auto w : next.wires) {
+            if (wires_[w].last != -1 && wires_[w].ready == next.start) {
+                next.pred = wires_[w].last;
+                break;
+            }
+        }
+
+        // Every wire of an operation, classical controls included, waits
+        // on all the others
+        int t_depth = 0;
+        int cnot_depth = 0;
+        for (auto w : next.wires) {
+            t_depth = std::max(t_depth, wires_[w].t_depth);
+            cnot_depth = std::max(cnot_depth, wires_[w].cnot_depth);
+        }
+        t_depth += name == "t" || name == "tdg";
+        cnot_depth += name == "CX" || name == "cx";
+
+        auto index = static_cast<int>(ops_.size());
+        for (auto w : next.wires) {
+            auto& state = wires_[w];
+            if (state.first < 0)
+                state.first = next.start;
+            state.ready = next.start + next.duration;
+            state.busy += next.duration;
+            state.t_depth = t_depth;
+            state.cnot_depth = cnot_depth;
+            state.last = index;
+        }
+        ops_.emplace_back(std::move(next));
+    }
+};
+
+/** \brief Schedules a program with the default durations */
+inline schedule_report schedule(ast::Program& prog) {
+    Scheduler scheduler;
+    return scheduler.run(prog);
+}
+
+/** \brief Schedules a program with the given durations */
+inline schedule_report schedule(ast::Program& prog,
+                                const Scheduler::config& params) {
+    Scheduler scheduler(params);
+    return scheduler.run(prog);
+}
+
+/** \brief Escapes a string for a JSON document */
+inline std::string json_string(const std::string& str) {
+    std::string ret = "\"";
+    for (auto ch : str) {
+        if (ch == '"' || ch == '\\')
+            ret.push_back('\\');
+        ret.push_back(ch);
+    }
+    return ret + "\"";
+}
+
+/**
+ * \brief Writes resource estimates & a schedule as a JSON document
+ */
+inline void write_json(std::ostream& os, const resource_count& counts,
+                       const schedule_report& report) {
+    std::vector<std::pair<std::string, long long>> sorted(counts.begin(),
+                                                          counts.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    os << "{\n  \"counts\": {";
+    for (std::size_t i = 0; i < sorted.size(); i++) {
+        os << (i == 0 ? "\n" : ",\n") << "    " << json_string(sorted[i].first)
+           << ": " << sorted[i].second;
+    }
+    os << "\n  },\n";
+
+    os << "  \"latency\": " << report.latency << ",\n";
+    os << "  \"t_depth\": " << report.t_depth << ",\n";
+    os << "  \"cnot_depth\": " << report.cnot_depth << ",\n";
+
+    os << "  \"wires\": [";
+    for (std::size_t i = 0; i < report.wires.size(); i++) {
+        auto& wire = report.wires[i];
+        os << (i == 0 ? "\n" : ",\n") << "    {\"name\": "
+           << json_string(wire.name) << ", \"busy\": " << wire.busy
+           << ", \"idle_asap\": " << wire.idle_asap
+           << ", \"idle_alap\": " << wire.idle_alap << "}";
+    }
+    os << "\n  ],\n";
+
+    os << "  \"critical_path\": [";
+    for (std::size_t i = 0; i < report.critical_path.size(); i++) {
+        auto& step = report.critical_path[i];
+        os << (i == 0 ? "\n" : ",\n") << "    {\"op\": "
+           << json_string(step.text) << ", \"start\": " << step.start
+           << ", \"duration\": " << step.duration << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+} // namespace tools
+} // namespace staq
@@ -0,0 +1,471 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tools/simulator.hpp
+ * \brief State vector simulation
+ */
+#pragma once
+
+#include "ast/ast.hpp"
+#include "transformations/desugar.hpp"
+#include "transformations/inline.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace staq {
+namespace tools {
+
+using amplitude = std::complex<double>;
+
+/**
+ * \brief A single-qubit unitary applied to target, controlled on controls
+ *
+ * The matrix is in row-major order
+ */
+struct sim_gate {
+    int target;
+    std::vector<int> controls;
+    std::array<amplitude, 4> matrix;
+};
+
+/**
+ * \class staq::tools::StateVector
+ * \brief A state vector of up to ~30 qubits
+ *
+ * Amplitudes are stored as separate arrays of real & imaginary parts, with
+ * qubit i the i-th least significant bit of an index. Gates are applied by
+ * kernels specialized to diagonal, anti-diagonal & general matrices, whose
+ * inner loops run over contiguous amplitudes so they can be vectorized.
+ *
+ * To stay in cache, runs of gates acting only on the lowest block_qubits
+ * qubits are applied one block of amplitudes at a time, and blocks are
+ * spread over num_threads threads. Other gates are applied to the whole
+ * vector, also split between threads.
+ */
+class StateVector {
+  public:
+    /**
+     * \class staq::tools::StateVector::config
+     * \brief Holds configuration options
+     */
+    struct config {
+        unsigned num_threads = 1; ///< worker threads used for gates
+        int block_qubits = 12;    ///< qubits of a cache block
+    };
+
+    StateVector(int num_qubits) : StateVector(num_qubits, config()) {}
+    StateVector(int num_qubits, const config& params)
+        : num_qubits_(num_qubits), config_(params) {
+        if (num_qubits < 0 || num_qubits > 40)
+            throw std::length_error("Too many qubits to simulate");
+        re_.assign(std::size_t(1) << num_qubits, 0);
+        im_.assign(std::size_t(1) << num_qubits, 0);
+        re_[0] = 1;
+    }
+
+    int num_qubits() const { return num_qubits_; }
+    std::size_t size() const { return re_.size(); }
+
+    amplitude operator[](std::size_t i) const { return {re_[i], im_[i]}; }
+    void set(std::size_t i, amplitude a) {
+        re_[i] = a.real();
+        im_[i] = a.imag();
+    }
+
+    /** \brief Applies gates in order */
+    void run(const std::vector<sim_gate>& gates) {
+        if (num_qubits_ == 0)
+            return;
+        auto block = std::min(num_qubits_, std::max(config_.block_qubits, 1));
+        auto in_block = [block](const sim_gate& gate) {
+            if (gate.target >= block)
+                return false;
+            for (auto c : gate.controls) {
+                if (c >= block)
+                    return false;
+            }
+            return true;
+        };
+
+        for (std::size_t i = 0; i < gates.size();) {
+            if (!in_block(gates[i])) {
+                // Split the pairs of amplitudes between threads
+                auto chunk = std::size_t(1) << (block - 1);
+                auto pairs = size() / 2;
+                parallel_for(pairs / chunk, [&](std::size_t j) {
+                    apply(gates[i], j * chunk, (j + 1) * chunk);
+                });
+                i++;
+                continue;
+            }
+
+            // Apply a run of low gates block by block
+            auto j = i;
+            while (j < gates.size() && in_block(gates[j]))
+                j++;
+            auto half = std::size_t(1) << (block - 1);
+            parallel_for(size() >> block, [&](std::size_t b) {
+                for (auto k = i; k < j; k++)
+                    apply(gates[k], b * half, (b + 1) * half);
+            });
+            i = j;
+        }
+    }
+
+  private:
+    int num_qubits_;
+    config config_;
+    std::vector<double> re_;
+    std::vector<double> im_;
+
+    /** \brief Calls fn(0), ..., fn(n - 1) on the worker threads */
+    template <typename Fn>
+    void parallel_for(std::size_t n, Fn&& fn) {
+        // Small states aren't worth starting threads for
+        auto num_workers = size() < (std::size_t(1) << 16)
+                               ? 1
+                               : std::min<std::size_t>(
+                                     std::max(config_.num_threads, 1u), n);
+        std::atomic<std::size_t> next = 0;
+        auto worker = [&fn, &next, n]() {
+            for (auto i = next++; i < n; i = next++)
+                fn(i);
+        };
+
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < num_workers; i++)
+            workers.emplace_back(worker);
+        worker();
+        for (auto& thread : workers)
+            thread.join();
+    }
+
+    /**
+     * \brief Applies a gate to a range of amplitude pairs
+     *
+     * Pair k is made of the indices obtained by inserting a 0, respectively
+     * a 1, at the target bit of k
+     */
+    void apply(const sim_gate& gate, std::size_t k0, std::size_t k1) {
+        auto bit = std::size_t(1) << gate.target;
+        auto low = bit - 1;
+        std::size_t mask = 0;
+        for (auto c : gate.controls)
+            mask |= std::size_t(1) << c;
+        auto high_mask = mask & ~low;
+        auto low_mask = mask & low;
+
+        auto& m = gate.matrix;
+        auto diagonal = m[1] == 0.0 && m[2] == 0.0;
+        auto anti_diagonal = m[0] == 0.0 && m[3] == 0.0;
+        auto phase = diagonal && m[0] == 1.0;
+
+        for (auto k = k0; k < k1;) {
+            // A run of contiguous pairs
+            auto a = ((k & ~low) << 1) | (k & low);
+            auto len = std::min(k1 - k, bit - (k & low));
+            k += len;
+            if ((a & high_mask) != high_mask)
+                continue;
+
+            auto r0 = re_.data() + a;
+            auto i0 = im_.data() + a;
+            auto r1 = r0 + bit;
+            auto i1 = i0 + bit;
+            if (low_mask != 0) {
+                for (std::size_t j = 0; j < len; j++) {
+                    if (((a + j) & low_mask) == low_mask)
+                        general(m, r0 + j, i0 + j, r1 + j, i1 + j, 1);
+                }
+            } else if (phase) {
+                multiply(m[3], r1, i1, len);
+            } else if (diagonal) {
+                multiply(m[0], r0, i0, len);
+                multiply(m[3], r1, i1, len);
+            } else if (anti_diagonal) {
+                cross(m[1], m[2], r0, i0, r1, i1, len);
+            } else {
+                general(m, r0, i0, r1, i1, len);
+            }
+        }
+    }
+
+    static void multiply(amplitude c, double* re, double* im,
+                         std::size_t len) {
+        if (c == 1.0)
+            return;
+        auto cr = c.real();
+        auto ci = c.imag();
+        for (std::size_t j = 0; j < len; j++) {
+            auto r = re[j];
+            re[j] = cr * r - ci * im[j];
+            im[j] = cr * im[j] + ci * r;
+        }
+    }
+
+    static void cross(amplitude c01, amplitude c10, double* r0, double* i0,
+                      double* r1, double* i1, std::size_t len) {
+        auto ar = c01.real(), ai = c01.imag();
+        auto br = c10.real(), bi = c10.imag();
+        for (std::size_t j = 0; j < len; j++) {
+            auto x = r0[j], y = i0[j];
+            r0[j] = ar * r1[j] - ai * i1[j];
+            i0[j] = ar * i1[j] + ai * r1[j];
+            r1[j] = br * x - bi * y;
+            i1[j] = br * y + bi * x;
+        }
+    }
+
+    static void general(const std::array<amplitude, 4>& m, double* r0,
+                        double* i0, double* r1, double* i1, std::size_t len) {
+        auto m0r = m[0].real(), m0i = m[0].imag();
+        auto m1r = m[1].real(), m1i = m[1].imag();
+        auto m2r = m[2].real(), m2i = m[2].imag();
+        auto m3r = m[3].real(), m3i = m[3].imag();
+        for (std::size_t j = 0; j < len; j++) {
+            auto xr = r0[j], xi = i0[j];
+            auto yr = r1[j], yi = i1[j];
+            r0[j] = m0r * xr - m0i * xi + m1r * yr - m1i * yi;
+            i0[j] = m0r * xi + m0i * xr + m1r * yi + m1i * yr;
+            r1[j] = m2r * xr - m2i * xi + m3r * yr - m3i * yi;
+            i1[j] = m2r * xi + m2i * xr + m3r * yi + m3i * yr;
+        }
+    }
+};
+
+/** \brief A program as a flat sequence of gates */
+struct circuit {
+    std::vector<ast::VarAccess> qubits; ///< the qubit at each index
+    std::vector<sim_gate> gates;
+};
+
+/**
+ * \class staq::tools::CircuitBuilder
+ * \brief Flattens a program into a circuit
+ *
+ * The program is copied, desugared & fully inlined, except for the
+ * standard library gates with dedicated matrices. Qubits are numbered in
+ * order of declaration, including the ancillas hoisted by inlining.
+ * Barriers are skipped, as are measurements, so that a circuit measured at
+ * the end is simulated up to its measurements. Resets, classical control &
+ * unsynthesized oracles can't be simulated and are rejected.
+ */
+class CircuitBuilder final : public ast::Visitor {
+  public:
+    CircuitBuilder() = default;
+    ~CircuitBuilder() = default;
+
+    circuit run(const ast::Program& prog) {
+        ast::ptr<ast::Program> copy(prog.clone());
+        transformations::desugar(*copy);
+        auto overrides = transformations::default_overrides;
+        transformations::inline_ast(
+            *copy, {false, overrides, fresh_name(*copy, "anc")});
+
+        ret_ = circuit();
+        offsets_.clear();
+        copy->accept(*this);
+        return std::move(ret_);
+    }
+
+    void visit(ast::VarAccess&) override {}
+    void visit(ast::BExpr&) override {}
+    void visit(ast::UExpr&) override {}
+    void visit(ast::PiExpr&) override {}
+    void visit(ast::IntExpr&) override {}
+    void visit(ast::RealExpr&) override {}
+    void visit(ast::VarExpr&) override {}
+
+    void visit(ast::MeasureStmt&) override {}
+    void visit(ast::ResetStmt&) override {
+        throw std::invalid_argument("Can't simulate resets");
+    }
+    void visit(ast::IfStmt&) override {
+        throw std::invalid_argument("Can't simulate classical control");
+    }
+
+    void visit(ast::UGate& gate) override {
+        auto theta = eval(gate.theta());
+        auto phi = eval(gate.phi());
+        auto lambda = eval(gate.lambda());
+        emit(u(theta, phi, lambda), gate.arg());
+    }
+
+    void visit(ast::CNOTGate& gate) override {
+        emit(x(), gate.tgt(), {&gate.ctrl()});
+    }
+
+    void visit(ast::BarrierGate&) override {}
+
+    void visit(ast::DeclaredGate& gate) override {
+        static const amplitude i(0, 1);
+        static const auto r = 1 / std::sqrt(2.0);
+        auto& name = gate.name();
+        auto arg = [&gate](int j) -> ast::VarAccess& { return gate.qarg(j); };
+
+        if (name == "x")
+            emit(x(), arg(0));
+        else if (name == "y")
+            emit({0, -i, i, 0}, arg(0));
+        else if (name == "z")
+            emit(phase(-1), arg(0));
+        else if (name == "h")
+            emit({r, r, r, -r}, arg(0));
+        else if (name == "s")
+            emit(phase(i), arg(0));
+        else if (name == "sdg")
+            emit(phase(-i), arg(0));
+        else if (name == "t")
+            emit(phase({r, r}), arg(0));
+        else if (name == "tdg")
+            emit(phase({r, -r}), arg(0));
+        else if (name == "rx")
+            emit(u(eval(gate.carg(0)), -pi / 2, pi / 2), arg(0));
+        else if (name == "ry")
+            emit(u(eval(gate.carg(0)), 0, 0), arg(0));
+        else if (name == "rz")
+            emit(phase(std::polar(1.0, eval(gate.carg(0)))), arg(0));
+        else if (name == "cx")
+            emit(x(), arg(1), {&arg(0)});
+        else if (name == "cy")
+            emit({0, -i, i, 0}, arg(1), {&arg(0)});
+        else if (name == "cz")
+            emit(phase(-1), arg(1), {&arg(0)});
+        else if (name == "swap") {
+            emit(x(), arg(1), {&arg(0)});
+            emit(x(), arg(0), {&arg(1)});
+            emit(x(), arg(1), {&arg(0)});
+        } else {
+            throw std::invalid_argument("Can't simulate gate \"" + name +
+                                        "\"");
+        }
+    }
+
+    void visit(ast::GateDecl&) override {}
+    void visit(ast::OracleDecl& decl) override {
+        throw std::invalid_argument("Can't simulate oracle \"" + decl.id() +
+                                    "\" before synthesis");
+    }
+
+    void visit(ast::RegisterDecl& decl) override {
+        if (decl.is_quantum())
+            declare(decl.id(), decl.size());
+    }
+
+    void visit(ast::AncillaDecl& decl) override {
+        declare(decl.id(), decl.size());
+    }
+
+    void visit(ast::Program& prog) override {
+        prog.foreach_stmt([this](auto& stmt) { stmt.accept(*this); });
+    }
+
+  private:
+    static constexpr double pi = 3.141592653589793238462643383279502884;
+
+    circuit ret_;
+    std::unordered_map<std::string, int> offsets_;
+
+    /** \brief An identifier not declared at the top level of a program */
+    static std::string fresh_name(ast::Program& prog, std::string name) {
+        std::vector<std::string> ids;
+        prog.foreach_stmt([&ids](auto& stmt) {
+            if (auto decl = dynamic_cast<ast::Decl*>(&stmt))
+                ids.push_back(decl->id());
+        });
+        while (std::find(ids.begin(), ids.end(), name) != ids.end())
+            name += "_";
+        return name;
+    }
+
+    static double eval(ast::Expr& expr) {
+        auto ret = expr.constant_eval();
+        if (!ret)
+            throw std::invalid_argument("Can't evaluate gate parameter");
+        return *ret;
+    }
+
+    static std::array<amplitude, 4> x() { return {0, 1, 1, 0}; }
+    static std::array<amplitude, 4> phase(amplitude p) { return {1, 0, 0, p}; }
+    static std::array<amplitude, 4> u(double theta, double phi,
+                                      double lambda) {
+        auto c = std::cos(theta / 2);
+        auto s = std::sin(theta / 2);
+        return {c, -std::polar(s, lambda), std::polar(s, phi),
+                std::polar(c, phi + lambda)};
+    }
+
+    void declare(const std::string& id, int size) {
+        offsets_[id] = static_cast<int>(ret_.qubits.size());
+        for (auto j = 0; j < size; j++)
+            ret_.qubits.emplace_back(parser::Position(), id, j);
+    }
+
+    int index(const ast::VarAccess& ap) {
+        auto it = offsets_.find(ap.var());
+        if (it == offsets_.end() || !ap.offset())
+            throw std::invalid_argument("Unresolved qubit access");
+        return it->second + *ap.offset();
+    }
+
+    void emit(std::array<amplitude, 4> matrix, const ast::VarAccess& tgt,
+              std::vector<const ast::VarAccess*> ctrls = {}) {
+        sim_gate gate{index(tgt), {}, matrix};
+        for (auto ctrl : ctrls)
+            gate.controls.push_back(index(*ctrl));
+        ret_.gates.emplace_back(std::move(gate));
+    }
+};
+
+/** \brief Flattens a program into a circuit */
+inline circuit flatten(const ast::Program& prog) {
+    CircuitBuilder builder;
+    return builder.run(prog);
+}
+
+/**
+ * \brief Simulates a program from the all-zero state
+ * \param params Configuration of the state vector
+ */
+inline StateVector simulate(const ast::Program& prog,
+                            const StateVector::config& params = {}) {
+    auto circ = flatten(prog);
+    StateVector ret(static_cast<int>(circ.qubits.size()), params);
+    ret.run(circ.gates);
+    return ret;
+}
+
+} // namespace tools
+} // namespace staq
@@ -0,0 +1,577 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tools/stabilizer.hpp
+ * \brief Stabilizer simulation of Clifford circuits
+ */
+#pragma once
+
+#include "gates/channel.hpp"
+#include "tools/simulator.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <unordered_set>
+
+namespace staq {
+namespace tools {
+
+/**
+ * \class staq::tools::Tableau
+ * \brief A Clifford operator, or stabilizer state, on thousands of qubits
+ *
+ * Stores the images of the generators \f$X_q\f$ & \f$Z_q\f$ of the Pauli
+ * group under conjugation, as in
+ * [Improved simulation of stabilizer circuits](https://arxiv.org/abs/quant-ph/0406196).
+ * Row q is the image of \f$X_q\f$ (the destabilizers) and row n + q the
+ * image of \f$Z_q\f$ (the stabilizers), so that the initial tableau is both
+ * the identity and the state \f$|0\cdots 0\rangle\f$.
+ *
+ * Paulis are encoded as in gates::ChannelRepr, one x and one z bit per
+ * qubit. The bits are stored by qubit, 64 rows to a word, so a gate
+ * updates every row with a few word operations per 64 rows.
+ */
+class Tableau {
+  public:
+    using channel = gates::ChannelRepr<int>;
+
+    Tableau(int num_qubits)
+        : n_(num_qubits), words_((2 * std::size_t(num_qubits) + 63) / 64),
+          x_(n_ * words_, 0), z_(n_ * words_, 0), r_(words_, 0) {
+        for (auto q = 0; q < n_; q++) {
+            set(x_col(q), q);
+            set(z_col(q), n_ + q);
+        }
+    }
+
+    int num_qubits() const { return n_; }
+
+    /** @name Gates */
+    /**@{*/
+    void x(int q) { apply(q, pauli_x, pauli_z, false, true); }
+    void y(int q) { apply(q, pauli_x, pauli_z, true, true); }
+    void z(int q) { apply(q, pauli_x, pauli_z, true, false); }
+    void h(int q) { apply(q, pauli_z, pauli_x, false, false); }
+    void s(int q) { apply(q, pauli_y, pauli_z, false, false); }
+    void sdg(int q) { apply(q, pauli_y, pauli_z, true, false); }
+
+    void cx(int ctrl, int tgt) {
+        auto xc = x_col(ctrl), zc = z_col(ctrl);
+        auto xt = x_col(tgt), zt = z_col(tgt);
+        for (std::size_t w = 0; w < words_; w++) {
+            r_[w] ^= xc[w] & zt[w] & ~(xt[w] ^ zc[w]);
+            xt[w] ^= xc[w];
+            zc[w] ^= zt[w];
+        }
+    }
+    void cz(int a, int b) {
+        h(b);
+        cx(a, b);
+        h(b);
+    }
+    void cy(int ctrl, int tgt) {
+        sdg(tgt);
+        cx(ctrl, tgt);
+        s(tgt);
+    }
+    void swap(int a, int b) {
+        std::swap_ranges(x_col(a), x_col(a) + words_, x_col(b));
+        std::swap_ranges(z_col(a), z_col(a) + words_, z_col(b));
+    }
+
+    /**
+     * \brief Applies a Clifford in the channel representation
+     *
+     * Each row is restricted to the qubits the Clifford acts on &
+     * conjugated by it
+     */
+    void apply(const channel::Clifford& clifford) {
+        std::unordered_set<int> support;
+        clifford.foreach ([&support](auto& in, auto& out) {
+            support.insert(in.first);
+            out.foreach ([&support](auto& p) { support.insert(p.first); });
+        });
+
+        for (std::size_t row = 0; row < 2 * std::size_t(n_); row++) {
+            std::unordered_map<int, channel::PauliOp> ops;
+            for (auto q : support) {
+                if (auto op = get(row, q); op != channel::PauliOp::i)
+                    ops[q] = op;
+            }
+            auto image = clifford.conjugate(channel::Pauli(ops));
+            for (auto q : support) {
+                clear(x_col(q), row);
+                clear(z_col(q), row);
+            }
+            image.foreach ([this, row](auto& p) {
+                auto bits = static_cast<unsigned short>(p.second);
+                if (bits & 1)
+                    set(x_col(p.first), row);
+                if (bits & 2)
+                    set(z_col(p.first), row);
+            });
+            if (image.phase() == channel::IPhase::two)
+                r_[row / 64] ^= std::uint64_t(1) << (row % 64);
+        }
+    }
+
+    /**
+     * \brief Applies a gate of a flattened circuit
+     * \throws std::invalid_argument If the gate isn't a Clifford
+     */
+    void apply(const sim_gate& gate) {
+        if (gate.controls.empty()) {
+            auto px = image(gate.matrix, pauli_matrix(pauli_x));
+            auto pz = image(gate.matrix, pauli_matrix(pauli_z));
+            if (!px || !pz)
+                throw std::invalid_argument("Gate isn't a Clifford");
+            apply(gate.target, px->first, pz->first, px->second, pz->second);
+            return;
+        }
+
+        // A controlled Pauli with a phase kicked back onto the control
+        auto controlled = controlled_pauli(gate);
+        if (!controlled)
+            throw std::invalid_argument("Gate isn't a Clifford");
+        auto ctrl = gate.controls.front();
+        switch (controlled->first) {
+            case channel::PauliOp::x:
+                cx(ctrl, gate.target);
+                break;
+            case channel::PauliOp::y:
+                cy(ctrl, gate.target);
+                break;
+            case channel::PauliOp::z:
+                cz(ctrl, gate.target);
+                break;
+            case channel::PauliOp::i:
+                break;
+        }
+        switch (controlled->second) {
+            case 1:
+                s(ctrl);
+                break;
+            case 2:
+                z(ctrl);
+                break;
+            case 3:
+                sdg(ctrl);
+                break;
+        }
+    }
+
+    /** \brief Whether a gate of a flattened circuit is a Clifford */
+    static bool is_clifford(const sim_gate& gate) {
+        if (gate.controls.empty())
+            return image(gate.matrix, pauli_matrix(pauli_x)) &&
+                   image(gate.matrix, pauli_matrix(pauli_z));
+        return controlled_pauli(gate).has_value();
+    }
+
+    /** \brief Applies gates in order */
+    void run(const std::vector<sim_gate>& gates) {
+        for (auto& gate : gates)
+            apply(gate);
+    }
+
+    /** \brief Applies the inverse of a sequence of gates */
+    void run_inverse(const std::vector<sim_gate>& gates) {
+        for (auto it = gates.rbegin(); it != gates.rend(); it++) {
+            auto& m = it->matrix;
+            apply(sim_gate{it->target,
+                           it->controls,
+                           {std::conj(m[0]), std::conj(m[2]), std::conj(m[1]),
+                            std::conj(m[3])}});
+        }
+    }
+
+    /** \brief Moves the state of each qubit q to qubit perm[q] */
+    void permute(const std::vector<int>& perm) {
+        std::vector<std::uint64_t> x(x_.size()), z(z_.size());
+        for (auto q = 0; q < n_; q++) {
+            std::copy_n(x_col(q), words_, x.data() + perm[q] * words_);
+            std::copy_n(z_col(q), words_, z.data() + perm[q] * words_);
+        }
+        x_ = std::move(x);
+        z_ = std::move(z);
+    }
+    /**@}*/
+
+    /** @name Queries */
+    /**@{*/
+    /** \brief The image of \f$X_q\f$ */
+    channel::Pauli destabilizer(int q) const { return pauli(q); }
+    /** \brief The image of \f$Z_q\f$ */
+    channel::Pauli stabilizer(int q) const { return pauli(n_ + q); }
+
+    bool operator==(const Tableau& other) const {
+        return n_ == other.n_ && x_ == other.x_ && z_ == other.z_ &&
+               r_ == other.r_;
+    }
+    bool operator!=(const Tableau& other) const { return !(*this == other); }
+
+    /**
+     * \brief Whether the tableau acts as the identity on some qubits
+     *
+     * The other qubits are taken to be ancillas, started in & returned to
+     * \f$|0\rangle\f$. Equivalently, \f$X_q\f$ & \f$Z_q\f$ are mapped to
+     * themselves for every given q, and \f$Z_a\f$ to a product of Z's for
+     * every ancilla a, in both cases up to Z's on the ancillas.
+     */
+    bool is_identity_on(const std::vector<int>& qubits) const {
+        std::vector<bool> kept(n_, false);
+        for (auto q : qubits)
+            kept[q] = true;
+
+        // The rows with constraints: all but the destabilizers of ancillas
+        std::vector<std::uint64_t> rows(words_, 0);
+        for (auto q = 0; q < n_; q++) {
+            set(rows.data(), n_ + q);
+            if (kept[q])
+                set(rows.data(), q);
+        }
+
+        for (std::size_t w = 0; w < words_; w++) {
+            if (r_[w] & rows[w])
+                return false;
+        }
+        for (auto q = 0; q < n_; q++) {
+            for (std::size_t w = 0; w < words_; w++) {
+                auto x = x_col(q)[w] & rows[w];
+                auto z = z_col(q)[w] & rows[w];
+                if (!kept[q]) {
+                    if (x != 0)
+                        return false;
+                } else if (x != unit(q, w) || z != unit(n_ + q, w)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /** \brief Whether the tableau is the identity */
+    bool is_identity() const {
+        std::vector<int> qubits(n_);
+        for (auto q = 0; q < n_; q++)
+            qubits[q] = q;
+        return is_identity_on(qubits);
+    }
+    /**@}*/
+
+    /**
+     * \brief Measures a qubit in the computational basis
+     *
+     * Treats the tableau as a state. Rows multiplied by a random outcome's
+     * stabilizer are updated together, with their phases accumulated in
+     * two bit planes
+     *
+     * \param gen A uniform random bit generator
+     * \return The outcome
+     */
+    template <typename Gen>
+    bool measure(int q, Gen& gen) {
+        auto xq = x_col(q);
+        auto p = -1;
+        for (auto row = n_; row < 2 * n_; row++) {
+            if (test(xq, row)) {
+                p = row;
+                break;
+            }
+        }
+
+        if (p == -1) {
+            // Deterministic: the product of the stabilizers whose
+            // destabilizers anticommute with Z_q
+            auto phase = 0;
+            std::vector<std::uint64_t> rows(words_, 0);
+            for (auto row = 0; row < n_; row++) {
+                if (test(xq, row)) {
+                    set(rows.data(), n_ + row);
+                    phase += 2 * test(r_.data(), n_ + row);
+                }
+            }
+
+            // Qubits are independent, so each column is multiplied out in
+            // row order over the rows acting on it
+            for (auto c = 0; c < n_; c++) {
+                auto xc = x_col(c), zc = z_col(c);
+                bool x = false, z = false;
+                for (std::size_t w = 0; w < words_; w++) {
+                    auto bits = (xc[w] | zc[w]) & rows[w];
+                    for (std::size_t b = 0; bits != 0; b++, bits >>= 1) {
+                        if (!(bits & 1))
+                            continue;
+                        auto row = 64 * w + b;
+                        bool xi = test(xc, row), zi = test(zc, row);
+                        phase += g(xi, zi, x, z);
+                        x ^= xi;
+                        z ^= zi;
+                    }
+                }
+            }
+            return ((phase % 4) + 4) % 4 == 2;
+        }
+
+        // Random: multiply every other row anticommuting with Z_q by row p
+        std::vector<std::uint64_t> rows(xq, xq + words_);
+        clear(rows.data(), p);
+        std::vector<std::uint64_t> lo(words_, 0), hi(words_, 0);
+        for (auto c = 0; c < n_; c++) {
+            auto xc = x_col(c), zc = z_col(c);
+            bool xi = test(xc, p), zi = test(zc, p);
+            if (!xi && !zi)
+                continue;
+            for (std::size_t w = 0; w < words_; w++) {
+                auto x = xc[w], z = zc[w];
+                std::uint64_t plus, minus;
+                if (xi && zi) {
+                    plus = z & ~x;
+                    minus = x & ~z;
+                } else if (xi) {
+                    plus = z & x;
+                    minus = z & ~x;
+                } else {
+                    plus = x & ~z;
+                    minus = x & z;
+                }
+                plus &= rows[w];
+                minus &= rows[w];
+                hi[w] ^= lo[w] & plus;
+                lo[w] ^= plus;
+                hi[w] ^= ~lo[w] & minus;
+                lo[w] ^= minus;
+                if (xi)
+                    xc[w] ^= rows[w];
+                if (zi)
+                    zc[w] ^= rows[w];
+            }
+        }
+        auto rp = test(r_.data(), p) ? ~std::uint64_t(0) : 0;
+        for (std::size_t w = 0; w < words_; w++)
+            r_[w] ^= rows[w] & (rp ^ hi[w]);
+
+        // The destabilizer takes row p's place, which becomes +-Z_q
+        auto outcome = std::uniform_int_distribution<int>(0, 1)(gen) == 1;
+        copy_row(p, p - n_);
+        for (auto c = 0; c < n_; c++) {
+            clear(x_col(c), p);
+            clear(z_col(c), p);
+        }
+        set(z_col(q), p);
+        clear(r_.data(), p);
+        if (outcome)
+            set(r_.data(), p);
+        return outcome;
+    }
+
+  private:
+    using matrix = std::array<amplitude, 4>;
+    static constexpr auto pauli_x = channel::PauliOp::x;
+    static constexpr auto pauli_z = channel::PauliOp::z;
+    static constexpr auto pauli_y = channel::PauliOp::y;
+
+    int n_;
+    std::size_t words_;
+    std::vector<std::uint64_t> x_; ///< x bits of each qubit, by row
+    std::vector<std::uint64_t> z_; ///< z bits of each qubit, by row
+    std::vector<std::uint64_t> r_; ///< signs, by row
+
+    std::uint64_t* x_col(int q) { return x_.data() + q * words_; }
+    std::uint64_t* z_col(int q) { return z_.data() + q * words_; }
+    const std::uint64_t* x_col(int q) const { return x_.data() + q * words_; }
+    const std::uint64_t* z_col(int q) const { return z_.data() + q * words_; }
+
+    static void set(std::uint64_t* bits, std::size_t row) {
+        bits[row / 64] |= std::uint64_t(1) << (row % 64);
+    }
+    static void clear(std::uint64_t* bits, std::size_t row) {
+        bits[row / 64] &= ~(std::uint64_t(1) << (row % 64));
+    }
+    static bool test(const std::uint64_t* bits, std::size_t row) {
+        return (bits[row / 64] >> (row % 64)) & 1;
+    }
+    /** \brief Word w of the indicator of a row */
+    static std::uint64_t unit(std::size_t row, std::size_t w) {
+        return row / 64 == w ? std::uint64_t(1) << (row % 64) : 0;
+    }
+
+    channel::PauliOp get(std::size_t row, int q) const {
+        return static_cast<channel::PauliOp>(test(x_col(q), row) |
+                                             (test(z_col(q), row) << 1));
+    }
+
+    channel::Pauli pauli(std::size_t row) const {
+        std::unordered_map<int, channel::PauliOp> ops;
+        for (auto q = 0; q < n_; q++) {
+            if (auto op = get(row, q); op != channel::PauliOp::i)
+                ops[q] = op;
+        }
+        channel::Pauli ret(ops);
+        if (test(r_.data(), row))
+            ret *= channel::IPhase::two;
+        return ret;
+    }
+
+    void copy_row(std::size_t from, std::size_t to) {
+        for (auto c = 0; c < n_; c++) {
+            test(x_col(c), from) ? set(x_col(c), to) : clear(x_col(c), to);
+            test(z_col(c), from) ? set(z_col(c), to) : clear(z_col(c), to);
+        }
+        test(r_.data(), from) ? set(r_.data(), to) : clear(r_.data(), to);
+    }
+
+    /** \brief Exponent of i picked up by multiplying row entries (x1,z1) */
+    static int g(bool x1, bool z1, bool x2, bool z2) {
+        if (x1 && z1)
+            return int(z2) - int(x2);
+        if (x1)
+            return z2 ? 2 * int(x2) - 1 : 0;
+        if (z1)
+            return x2 ? 1 - 2 * int(z2) : 0;
+        return 0;
+    }
+
+    /**
+     * \brief Applies a single-qubit Clifford
+     *
+     * Given by the images of X & Z, with their signs. The image of Y = iXZ
+     * follows from the phase of the product of those images
+     */
+    void apply(int q, channel::PauliOp img_x, channel::PauliOp img_z,
+               bool neg_x, bool neg_z) {
+        auto img_y = img_x * img_z;
+        auto phase = (1 + static_cast<int>(channel::normal_phase(img_x,
+                                                                 img_z))) %
+                     4;
+        bool neg_y = (phase == 2) ^ neg_x ^ neg_z;
+
+        auto bit = [](channel::PauliOp op, int b) {
+            return (static_cast<unsigned short>(op) >> b) & 1
+                       ? ~std::uint64_t(0)
+                       : 0;
+        };
+        auto all = [](bool b) { return b ? ~std::uint64_t(0) : 0; };
+        auto xx = bit(img_x, 0), xz = bit(img_x, 1);
+        auto zx = bit(img_z, 0), zz = bit(img_z, 1);
+        auto yx = bit(img_y, 0), yz = bit(img_y, 1);
+        auto sx = all(neg_x), sz = all(neg_z), sy = all(neg_y);
+
+        auto xq = x_col(q), zq = z_col(q);
+        for (std::size_t w = 0; w < words_; w++) {
+            auto mx = xq[w] & ~zq[w];
+            auto mz = ~xq[w] & zq[w];
+            auto my = xq[w] & zq[w];
+            xq[w] = (mx & xx) | (mz & zx) | (my & yx);
+            zq[w] = (mx & xz) | (mz & zz) | (my & yz);
+            r_[w] ^= (mx & sx) | (mz & sz) | (my & sy);
+        }
+    }
+
+    static matrix pauli_matrix(channel::PauliOp op) {
+        static const amplitude i(0, 1);
+        switch (op) {
+            case channel::PauliOp::x:
+                return {0, 1, 1, 0};
+            case channel::PauliOp::z:
+                return {1, 0, 0, -1};
+            case channel::PauliOp::y:
+                return {0, -i, i, 0};
+            default:
+                return {1, 0, 0, 1};
+        }
+    }
+
+    static bool close(const matrix& a, const matrix& b) {
+        for (auto k = 0; k < 4; k++) {
+            if (std::abs(a[k] - b[k]) > 1e-9)
+                return false;
+        }
+        return true;
+    }
+
+    /** \brief The signed Pauli \f$MPM^\dagger\f$, if it is one */
+    static std::optional<std::pair<channel::PauliOp, bool>>
+    image(const matrix& m, const matrix& p) {
+        matrix mp{m[0] * p[0] + m[1] * p[2], m[0] * p[1] + m[1] * p[3],
+                  m[2] * p[0] + m[3] * p[2], m[2] * p[1] + m[3] * p[3]};
+        matrix ret{mp[0] * std::conj(m[0]) + mp[1] * std::conj(m[1]),
+                   mp[0] * std::conj(m[2]) + mp[1] * std::conj(m[3]),
+                   mp[2] * std::conj(m[0]) + mp[3] * std::conj(m[1]),
+                   mp[2] * std::conj(m[2]) + mp[3] * std::conj(m[3])};
+        for (auto op : {pauli_x, pauli_z, pauli_y}) {
+            auto q = pauli_matrix(op);
+            if (close(ret, q))
+                return std::make_pair(op, false);
+            if (close(ret, {-q[0], -q[1], -q[2], -q[3]}))
+                return std::make_pair(op, true);
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * \brief Decomposes a singly-controlled gate
+     * \return The Pauli P & the power k of i such that the gate is a
+     * controlled P followed by \f$\mathrm{diag}(1, i^k)\f$ on the control
+     */
+    static std::optional<std::pair<channel::PauliOp, int>>
+    controlled_pauli(const sim_gate& gate) {
+        if (gate.controls.size() != 1)
+            return std::nullopt;
+        auto& m = gate.matrix;
+        for (auto op : {channel::PauliOp::i, pauli_x, pauli_z, pauli_y}) {
+            auto p = pauli_matrix(op);
+            for (auto k = 0; k < 4; k++) {
+                auto c = std::polar(1.0, k * 1.5707963267948966);
+                if (close(m, {c * p[0], c * p[1], c * p[2], c * p[3]}))
+                    return std::make_pair(op, k);
+            }
+        }
+        return std::nullopt;
+    }
+};
+
+/**
+ * \brief Simulates a Clifford program from the all-zero state
+ *
+ * Measurements are skipped, see CircuitBuilder
+ * \throws std::invalid_argument If the program isn't a Clifford circuit
+ */
+inline Tableau simulate_stabilizer(const ast::Program& prog) {
+    auto circ = flatten(prog);
+    Tableau ret(static_cast<int>(circ.qubits.size()));
+    ret.run(circ.gates);
+    return ret;
+}
+
+/** \brief Whether every gate of a flattened circuit is a Clifford */
+inline bool is_clifford(const circuit& circ) {
+    return std::all_of(circ.gates.begin(), circ.gates.end(),
+                       [](auto& gate) { return Tableau::is_clifford(gate); });
+}
+
+} // namespace tools
+} // namespace staq
@@ -0,0 +1,347 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * \file tools/verifier.hpp
+ * \brief Equivalence checking of compiled programs by simulation
+ */
+#pragma once
+
+#include "tools/stabilizer.hpp"
+
+#include <random>
+#include <set>
+#include <unordered_map>
+
+namespace staq {
+namespace tools {
+
+/** \brief Where a qubit is at the start & at the end of a compiled program */
+struct qubit_location {
+    ast::VarAccess input;
+    ast::VarAccess output;
+};
+
+/** \brief Locations of the qubits of a program after compilation */
+using qubit_correspondence =
+    std::unordered_map<ast::VarAccess, qubit_location>;
+
+/** \brief Outcome of an equivalence check */
+struct verification_result {
+    bool equivalent = true;
+    double fidelity = 1; ///< lowest fidelity over the random states
+    int num_qubits = 0;  ///< largest number of qubits simulated
+};
+
+/**
+ * \class staq::tools::EquivalenceChecker
+ * \brief Checks that a compiled program acts as the original one
+ *
+ * Both programs are simulated on random states of the original program's
+ * qubits, placed where the correspondence says the compiled program expects
+ * them and read back from where it leaves them. Qubits absent from the
+ * correspondence keep their names. Every other qubit of either program is
+ * an ancilla, which starts in the zero state & must be returned to it. The
+ * programs are equivalent if the resulting states agree up to a global
+ * phase on every random state.
+ *
+ * Only qubits acted on are simulated, so a circuit mapped onto a large
+ * device costs no more than the original. Measurements are skipped, see
+ * CircuitBuilder.
+ *
+ * If both programs are Clifford circuits, they are instead compared
+ * exactly with a stabilizer tableau, whatever their number of qubits. The
+ * fidelity is then either 1 or 0.
+ */
+class EquivalenceChecker {
+  public:
+    /**
+     * \class staq::tools::EquivalenceChecker::config
+     * \brief Holds configuration options
+     */
+    struct config {
+        int num_states = 2;      ///< random states compared
+        double tolerance = 1e-6; ///< allowed infidelity
+        int max_qubits = 30;     ///< largest state simulated
+        uint64_t seed = 0;       ///< seed of the random states
+        StateVector::config simulation{};
+    };
+
+    EquivalenceChecker() = default;
+    EquivalenceChecker(const config& params) : config_(params) {}
+
+    /**
+     * \brief Main checking method
+     * \throws std::invalid_argument If a program can't be simulated, or if
+     * the original program leaves its ancillas entangled
+     * \throws std::length_error If a program has too many qubits to simulate
+     */
+    verification_result run(ast::Program& original, ast::Program& compiled,
+                            const qubit_correspondence& qubits = {}) {
+        auto orig = flatten(original);
+        auto comp = flatten(compiled);
+
+        // The qubits compared, with their indices in each circuit
+        std::vector<int> orig_pos;
+        std::vector<int> comp_in;
+        std::vector<int> comp_out;
+        auto orig_index = indices(orig);
+        auto comp_index = indices(comp);
+        auto comp_qubit = [&comp, &comp_index](const ast::VarAccess& ap) {
+            if (auto it = comp_index.find(ap); it != comp_index.end())
+                return it->second;
+            // Idle in, and dropped from, the compiled program
+            comp.qubits.push_back(ap);
+            return comp_index[ap] = static_cast<int>(comp.qubits.size()) - 1;
+        };
+        original.foreach_stmt([&](auto& stmt) {
+            auto decl = dynamic_cast<ast::RegisterDecl*>(&stmt);
+            if (!decl || !decl->is_quantum())
+                return;
+            for (auto i = 0; i < decl->size(); i++) {
+                ast::VarAccess ap(parser::Position(), decl->id(), i);
+                orig_pos.push_back(orig_index.at(ap));
+                if (auto it = qubits.find(ap); it != qubits.end()) {
+                    comp_in.push_back(comp_qubit(it->second.input));
+                    comp_out.push_back(comp_qubit(it->second.output));
+                } else {
+                    comp_in.push_back(comp_qubit(ap));
+                    comp_out.push_back(comp_in.back());
+                }
+            }
+        });
+        if (std::set<int>(comp_in.begin(), comp_in.end()).size() !=
+                comp_in.size() ||
+            std::set<int>(comp_out.begin(), comp_out.end()).size() !=
+                comp_out.size())
+            throw std::invalid_argument(
+                "Qubit correspondence isn't one-to-one");
+
+        // Simulate only the qubits that matter
+        compact(orig, {&orig_pos});
+        compact(comp, {&comp_in, &comp_out});
+
+        if (is_clifford(orig) && is_clifford(comp))
+            return run_clifford(orig, comp, orig_pos, comp_in, comp_out);
+
+        verification_result ret;
+        ret.num_qubits = static_cast<int>(
+            std::max(orig.qubits.size(), comp.qubits.size()));
+        if (ret.num_qubits > config_.max_qubits)
+            throw std::length_error("Too many qubits to verify (" +
+                                    std::to_string(ret.num_qubits) + ")");
+
+        std::mt19937_64 gen(config_.seed);
+        std::normal_distribution<double> dist;
+        auto k = orig_pos.size();
+        for (auto s = 0; s < config_.num_states; s++) {
+            // A random state of the compared qubits
+            std::vector<amplitude> psi(std::size_t(1) << k);
+            double norm = 0;
+            for (auto& a : psi) {
+                a = {dist(gen), dist(gen)};
+                norm += std::norm(a);
+            }
+            norm = std::sqrt(norm);
+
+            StateVector orig_state(static_cast<int>(orig.qubits.size()),
+                                   config_.simulation);
+            StateVector comp_state(static_cast<int>(comp.qubits.size()),
+                                   config_.simulation);
+            orig_state.set(0, 0);
+            comp_state.set(0, 0);
+            for (std::size_t x = 0; x < psi.size(); x++) {
+                orig_state.set(scatter(x, orig_pos), psi[x] / norm);
+                comp_state.set(scatter(x, comp_in), psi[x] / norm);
+            }
+
+            orig_state.run(orig.gates);
+            comp_state.run(comp.gates);
+
+            amplitude overlap = 0;
+            double weight = 0;
+            for (std::size_t x = 0; x < psi.size(); x++) {
+                auto a = orig_state[scatter(x, orig_pos)];
+                overlap += std::conj(a) * comp_state[scatter(x, comp_out)];
+                weight += std::norm(a);
+            }
+            if (weight < 1 - config_.tolerance)
+                throw std::invalid_argument(
+                    "Original program doesn't return its ancillas to zero");
+            ret.fidelity = std::min(ret.fidelity, std::norm(overlap));
+        }
+
+        ret.equivalent = ret.fidelity >= 1 - config_.tolerance;
+        return ret;
+    }
+
+  private:
+    config config_;
+
+    /**
+     * \brief Compares Clifford circuits
+     *
+     * The original's ancillas are added to the compiled circuit's qubits.
+     * The compiled circuit is then followed by the permutation taking each
+     * qubit's output location back to its input location, and by the
+     * inverse of the original, which should leave the compared qubits
+     * untouched and the ancillas in the zero state
+     */
+    static verification_result
+    run_clifford(const circuit& orig, const circuit& comp,
+                 const std::vector<int>& orig_pos,
+                 const std::vector<int>& comp_in,
+                 const std::vector<int>& comp_out) {
+        auto m = static_cast<int>(comp.qubits.size());
+        std::vector<int> index(orig.qubits.size(), -1);
+        for (std::size_t j = 0; j < orig_pos.size(); j++)
+            index[orig_pos[j]] = comp_in[j];
+        auto n = m;
+        for (auto& i : index) {
+            if (i == -1)
+                i = n++;
+        }
+
+        // The original's ancillas can't hold the qubits' state at the end
+        Tableau inverse(static_cast<int>(orig.qubits.size()));
+        inverse.run_inverse(orig.gates);
+        std::vector<bool> compared(orig.qubits.size(), false);
+        for (auto i : orig_pos)
+            compared[i] = true;
+        for (std::size_t a = 0; a < orig.qubits.size(); a++) {
+            if (compared[a])
+                continue;
+            auto z = inverse.stabilizer(static_cast<int>(a));
+            auto clean = z.phase() == Tableau::channel::IPhase::zero;
+            z.foreach ([&clean, &compared](auto& p) {
+                clean &= p.second == Tableau::channel::PauliOp::z &&
+                         !compared[p.first];
+            });
+            if (!clean)
+                throw std::invalid_argument(
+                    "Original program doesn't return its ancillas to zero");
+        }
+
+        // Output locations back to input locations, ancillas filling in
+        std::vector<int> perm(n, -1);
+        std::vector<bool> taken(n, false);
+        for (std::size_t j = 0; j < comp_in.size(); j++) {
+            perm[comp_out[j]] = comp_in[j];
+            taken[comp_in[j]] = true;
+        }
+        auto next = 0;
+        for (auto& p : perm) {
+            if (p == -1) {
+                while (taken[next])
+                    next++;
+                p = next++;
+            }
+        }
+
+        auto gates = orig.gates;
+        for (auto& gate : gates) {
+            gate.target = index[gate.target];
+            for (auto& c : gate.controls)
+                c = index[c];
+        }
+
+        Tableau tableau(n);
+        tableau.run(comp.gates);
+        tableau.permute(perm);
+        tableau.run_inverse(gates);
+
+        verification_result ret;
+        ret.num_qubits = n;
+        ret.equivalent = tableau.is_identity_on(comp_in);
+        ret.fidelity = ret.equivalent ? 1 : 0;
+        return ret;
+    }
+
+    static std::unordered_map<ast::VarAccess, int>
+    indices(const circuit& circ) {
+        std::unordered_map<ast::VarAccess, int> ret;
+        for (std::size_t i = 0; i < circ.qubits.size(); i++)
+            ret[circ.qubits[i]] = static_cast<int>(i);
+        return ret;
+    }
+
+    /** \brief The index with bit j of x at position pos[j] */
+    static std::size_t scatter(std::size_t x, const std::vector<int>& pos) {
+        std::size_t ret = 0;
+        for (std::size_t j = 0; j < pos.size(); j++) {
+            if ((x >> j) & 1)
+                ret |= std::size_t(1) << pos[j];
+        }
+        return ret;
+    }
+
+    /**
+     * \brief Drops the qubits no gate acts on, other than those listed
+     *
+     * Renumbers the gates & the listed qubits
+     */
+    static void compact(circuit& circ, std::vector<std::vector<int>*> keep) {
+        std::vector<int> index(circ.qubits.size(), -1);
+        for (auto& gate : circ.gates) {
+            index[gate.target] = 0;
+            for (auto c : gate.controls)
+                index[c] = 0;
+        }
+        for (auto list : keep) {
+            for (auto i : *list)
+                index[i] = 0;
+        }
+
+        std::vector<ast::VarAccess> qubits;
+        for (std::size_t i = 0; i < index.size(); i++) {
+            if (index[i] == 0) {
+                index[i] = static_cast<int>(qubits.size());
+                qubits.push_back(circ.qubits[i]);
+            }
+        }
+
+        circ.qubits = std::move(qubits);
+        for (auto& gate : circ.gates) {
+            gate.target = index[gate.target];
+            for (auto& c : gate.controls)
+                c = index[c];
+        }
+        for (auto list : keep) {
+            for (auto& i : *list)
+                i = index[i];
+        }
+    }
+};
+
+/** \brief Checks that a compiled program acts as the original one */
+inline verification_result
+check_equivalence(ast::Program& original, ast::Program& compiled,
+                  const qubit_correspondence& qubits = {},
+                  const EquivalenceChecker::config& params = {}) {
+    EquivalenceChecker checker(params);
+    return checker.run(original, compiled, qubits);
+}
+
+} // namespace tools
+} // namespace staq
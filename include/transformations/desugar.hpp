@@ -44,7 +44,7 @@ namespace transformations {
  * applied to a register or registers of qubits at once --
  * with a sequence of individual gate applications
  */
-void desugar(ast::ASTNode& node);
+inline void desugar(ast::ASTNode& node);
 
 /* Implementation */
 class DesugarImpl final : public ast::Replacer {
@@ -284,7 +284,7 @@ class DesugarImpl final : public ast::Replacer {
     }
 };
 
-void desugar(ast::ASTNode& node) {
+inline void desugar(ast::ASTNode& node) {
     DesugarImpl alg;
     alg.run(node);
 }
@@ -33,6 +33,7 @@
 
 #include <unordered_map>
 #include <set>
+#include <vector>
 
 namespace staq {
 namespace transformations {
@@ -91,9 +92,8 @@ class Inliner final : public ast::Replacer {
             auto& tmp = gate_decls_[decl.id()];
             tmp.c_params = decl.c_params();
             tmp.q_params = decl.q_params();
-            decl.foreach_stmt(
-                [this, &tmp](auto& gate) { tmp.body.push_back(&gate); });
             tmp.ancillas.swap(current_ancillas);
+            compile_body(decl, tmp);
 
             return std::nullopt;
         }
@@ -120,86 +120,10 @@ class Inliner final : public ast::Replacer {
         }
 
         if (auto it = gate_decls_.find(gate.name()); it != gate_decls_.end()) {
-            // Substitute classical arguments
-            std::unordered_map<std::string_view, ast::Expr*> c_subst;
-            for (auto i = 0; i < gate.num_cargs(); i++) {
-                c_subst[it->second.c_params[i]] = &gate.carg(i);
-            }
-            SubstVar var_subst(c_subst);
-
-            // Substitute quantum arguments
-            std::unordered_map<ast::VarAccess, ast::VarAccess> q_subst;
-            for (auto i = 0; i < gate.num_qargs(); i++) {
-                q_subst.insert(
-                    {ast::VarAccess(gate.pos(), it->second.q_params[i]),
-                     gate.qarg(i)});
-            }
-
-            // For local ancillas
-            auto anc_offset = 0;
-            auto reg = registers_.begin();
-            auto reg_offset = 0;
-            for (auto& anc : it->second.ancillas) {
-              if (anc.dirty) {
-                // Try to find an unused qubit to use as a dirty ancilla
-                auto i = 0;
-
-                while (i < anc.size) {
-                  if (reg == registers_.end()) {
-                    // Switch to clean ancillas
-                    q_subst.insert(
-                        {ast::VarAccess(gate.pos(), anc.name, i++),
-                         ast::VarAccess(gate.pos(),
-                                        config_.ancilla_name,
-                                        anc_offset++)});
-
-                  } else if (reg_offset >= reg->second) {
-                    // Move to the next register
-                    reg++;
-                    reg_offset = 0;
-
-                  } else {
-                    // Check whether this qubit is used in the gate
-                    bool used = false;
-                    gate.foreach_qarg([&used,&reg,&reg_offset](auto& arg){
-                        used = used || (arg.var() == reg->first &&
-                                        arg.offset() == reg_offset);
-                      });
-
-                    if (!used) {
-                      q_subst.insert(
-                          {ast::VarAccess(gate.pos(), anc.name, i++),
-                           ast::VarAccess(gate.pos(), reg->first, reg_offset)});
-                    }
-
-                    reg_offset++;
-                  }
-                }
-              } else {
-                q_subst.insert(
-                    {ast::VarAccess(gate.pos(), anc.name),
-                     ast::VarAccess(gate.pos(),
-                                    config_.ancilla_name,
-                                    anc_offset)});
-                anc_offset += anc.size;
-              }
-            }
-            SubstAP ap_subst(q_subst);
-
-            // Adjust the number of ancillas used
-            if (anc_offset > max_ancilla_) {
-                max_ancilla_ = anc_offset;
-            }
-
-            // Clone & substitute the gate body
             std::list<ast::ptr<ast::Gate>> body;
-
-            for (auto gate : it->second.body) {
-                auto new_gate = gate->clone();
-                new_gate->accept(var_subst);
-                new_gate->accept(ap_subst);
+            instantiate(it->second, gate, [&body](ast::Gate* new_gate) {
                 body.emplace_back(ast::ptr<ast::Gate>(new_gate));
-            }
+            });
 
             return std::move(body);
         } else {
@@ -245,13 +169,216 @@ class Inliner final : public ast::Replacer {
         bool dirty;
     };
 
+    /**
+     * \brief Resolved quantum argument of a recorded gate body
+     *
+     * Follows the substitution rules of staq::transformations::SubstAP, with
+     * the lookup done once per declaration rather than once per call
+     */
+    struct arg_ref {
+        int slot = -1;             ///< slot index, or -1 if left unchanged
+        std::optional<int> offset; ///< offset of the original access
+        bool exact = false;        ///< whether the slot matched the offset
+
+        void apply(ast::VarAccess& va,
+                   const std::vector<ast::VarAccess>& slots) const {
+            if (slot < 0)
+                return;
+
+            auto& vp = slots[slot];
+            if (exact || (!offset && vp.offset()))
+                va = vp;
+            else if (offset && vp.offset())
+                va = ast::VarAccess(va.pos(), vp.var(), *offset + *vp.offset());
+            else
+                va = ast::VarAccess(va.pos(), vp.var(), offset);
+        }
+    };
+
+    struct body_gate {
+        ast::Gate* gate;           ///< the (already inlined) gate
+        std::vector<arg_ref> args; ///< quantum arguments, foreach_qubit order
+        bool has_cargs;            ///< whether the gate has classical arguments
+    };
+
     struct gate_info {
         std::vector<ast::symbol> c_params;
         std::vector<ast::symbol> q_params;
-        std::list<ast::Gate*> body;
+        std::vector<body_gate> body;
         std::list<ancilla_info> ancillas;
+        int num_slots = 0; ///< quantum parameters + local ancilla slots
     };
 
+    /**
+     * \brief Applies a function to each quantum argument of a gate
+     */
+    template <typename Fn>
+    static void foreach_qubit(ast::Gate& gate, Fn&& f) {
+        switch (gate.kind()) {
+            case ast::NodeKind::UGate:
+                f(static_cast<ast::UGate&>(gate).arg());
+                break;
+            case ast::NodeKind::CNOTGate: {
+                auto& cx = static_cast<ast::CNOTGate&>(gate);
+                f(cx.ctrl());
+                f(cx.tgt());
+                break;
+            }
+            case ast::NodeKind::BarrierGate:
+                static_cast<ast::BarrierGate&>(gate).foreach_arg(f);
+                break;
+            case ast::NodeKind::DeclaredGate:
+                static_cast<ast::DeclaredGate&>(gate).foreach_qarg(f);
+                break;
+            default:
+                break;
+        }
+    }
+
+    /**
+     * \brief Records a gate body against the slots of a declaration
+     *
+     * Slots are the quantum parameters followed by the local ancillas,
+     * one per clean ancilla register and one per dirty ancilla qubit
+     */
+    static void compile_body(ast::GateDecl& decl, gate_info& info) {
+        std::unordered_map<ast::VarAccess, int> formals;
+        auto slot = 0;
+        for (auto& param : info.q_params) {
+            formals.insert({ast::VarAccess(decl.pos(), param), slot++});
+        }
+        for (auto& anc : info.ancillas) {
+            if (anc.dirty) {
+                for (auto i = 0; i < anc.size; i++)
+                    formals.insert(
+                        {ast::VarAccess(decl.pos(), anc.name, i), slot++});
+            } else {
+                formals.insert({ast::VarAccess(decl.pos(), anc.name), slot++});
+            }
+        }
+        info.num_slots = slot;
+
+        info.body.clear();
+        decl.foreach_stmt([&formals, &info](auto& gate) {
+            body_gate entry{&gate, {}, false};
+            if (gate.kind() == ast::NodeKind::UGate) {
+                entry.has_cargs = true;
+            } else if (gate.kind() == ast::NodeKind::DeclaredGate) {
+                auto& dgate = static_cast<ast::DeclaredGate&>(gate);
+                entry.has_cargs = dgate.num_cargs() > 0;
+            }
+
+            foreach_qubit(gate, [&formals, &entry](ast::VarAccess& va) {
+                arg_ref ref;
+                ref.offset = va.offset();
+                if (auto it = formals.find(va); it != formals.end()) {
+                    ref.slot = it->second;
+                    ref.exact = true;
+                } else if (auto it =
+                               formals.find(ast::VarAccess(va.pos(), va.var()));
+                           it != formals.end()) {
+                    ref.slot = it->second;
+                }
+                entry.args.push_back(ref);
+            });
+            info.body.emplace_back(std::move(entry));
+        });
+    }
+
+    /**
+     * \brief Instantiates a recorded gate body at a call site
+     *
+     * Each instantiated gate is passed to the callback as soon as it is
+     * built, so the expansion can be consumed without an intermediate
+     * container. Quantum arguments are resolved through the slot indices
+     * computed once per declaration by compile_body
+     *
+     * \param info The recorded gate declaration
+     * \param gate The gate call being inlined
+     * \param emit Callback taking ownership of each new ast::Gate*
+     */
+    template <typename Fn>
+    void instantiate(gate_info& info, ast::DeclaredGate& gate, Fn&& emit) {
+        // Substitute classical arguments
+        std::unordered_map<std::string_view, ast::Expr*> c_subst;
+        for (auto i = 0; i < gate.num_cargs(); i++) {
+            c_subst[info.c_params[i]] = &gate.carg(i);
+        }
+        SubstVar var_subst(c_subst);
+
+        // Slot values, in the order assigned by compile_body
+        std::vector<ast::VarAccess> slots;
+        slots.reserve(info.num_slots);
+        for (auto i = 0; i < gate.num_qargs(); i++) {
+            slots.emplace_back(gate.qarg(i));
+        }
+
+        // For local ancillas
+        auto anc_offset = 0;
+        auto reg = registers_.begin();
+        auto reg_offset = 0;
+        for (auto& anc : info.ancillas) {
+            if (anc.dirty) {
+                // Try to find an unused qubit to use as a dirty ancilla
+                auto i = 0;
+
+                while (i < anc.size) {
+                    if (reg == registers_.end()) {
+                        // Switch to clean ancillas
+                        slots.emplace_back(gate.pos(), config_.ancilla_name,
+                                           anc_offset++);
+                        i++;
+
+                    } else if (reg_offset >= reg->second) {
+                        // Move to the next register
+                        reg++;
+                        reg_offset = 0;
+
+                    } else {
+                        // Check whether this qubit is used in the gate
+                        bool used = false;
+                        gate.foreach_qarg(
+                            [&used, &reg, &reg_offset](auto& arg) {
+                                used = used || (arg.var() == reg->first &&
+                                                arg.offset() == reg_offset);
+                            });
+
+                        if (!used) {
+                            slots.emplace_back(gate.pos(), reg->first,
+                                               reg_offset);
+                            i++;
+                        }
+
+                        reg_offset++;
+                    }
+                }
+            } else {
+                slots.emplace_back(gate.pos(), config_.ancilla_name,
+                                   anc_offset);
+                anc_offset += anc.size;
+            }
+        }
+
+        // Adjust the number of ancillas used
+        if (anc_offset > max_ancilla_) {
+            max_ancilla_ = anc_offset;
+        }
+
+        // Clone & substitute the gate body
+        for (auto& [body_gate, args, has_cargs] : info.body) {
+            auto new_gate = body_gate->clone();
+            if (has_cargs && !c_subst.empty())
+                new_gate->accept(var_subst);
+
+            auto arg = args.begin();
+            foreach_qubit(*new_gate, [&arg, &slots](ast::VarAccess& va) {
+                arg->apply(va, slots);
+                arg++;
+            });
+            emit(new_gate);
+        }
+    }
+
     config config_;
     std::unordered_map<std::string_view, gate_info> gate_decls_;
     Cleaner cleaner_;
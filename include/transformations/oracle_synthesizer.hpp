@@ -30,6 +30,14 @@
 
 #include "ast/replacer.hpp"
 #include "synthesis/logic_synthesis.hpp"
+#include "synthesis/oracle_cache.hpp"
+
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <unordered_map>
 
 namespace staq {
 namespace transformations {
@@ -39,30 +47,129 @@ namespace transformations {
  *
  * Visits an AST and synthesizes any declared oracles,
  * replacing them with regular gate declarations which may
- * optionally declare local ancillas
+ * optionally declare local ancillas. The oracles of a program
+ * are independent, and are synthesized concurrently by setting
+ * config::num_threads
  */
 
 /* Implementation */
 class OracleSynthesizer final : public ast::Replacer {
   public:
+    struct config {
+        std::string cache_dir = ""; ///< on-disk oracle cache, none if empty
+        unsigned num_threads = 1;   ///< worker threads used for synthesis
+        synthesis::synthesis_params synthesis{};
+    };
+
     OracleSynthesizer() = default;
+    OracleSynthesizer(const config& params) : Replacer(), config_(params) {
+        if (!config_.cache_dir.empty())
+            cache_.emplace(config_.cache_dir);
+    }
     ~OracleSynthesizer() = default;
 
+    /** \brief Lookup counters of the on-disk cache, if any */
+    synthesis::oracle_cache::statistics stats() const {
+        return cache_ ? cache_->stats() : synthesis::oracle_cache::statistics{};
+    }
+
+    void visit(ast::Program& prog) override {
+        // Synthesize every top-level oracle up front
+        std::vector<ast::OracleDecl*> decls;
+        prog.foreach_stmt([&decls](auto& stmt) {
+            if (auto decl = dynamic_cast<ast::OracleDecl*>(&stmt))
+                decls.push_back(decl);
+        });
+
+        std::vector<std::list<ast::ptr<ast::Gate>>> bodies(decls.size());
+        std::vector<std::exception_ptr> errors(decls.size());
+        std::atomic<std::size_t> next = 0;
+        auto worker = [this, &decls, &bodies, &errors, &next]() {
+            for (auto i = next++; i < decls.size(); i = next++) {
+                try {
+                    bodies[i] = synthesize(*decls[i]);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        };
+
+        auto num_workers = std::min<std::size_t>(
+            std::max(config_.num_threads, 1u), decls.size());
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < num_workers; i++)
+            workers.emplace_back(worker);
+        worker();
+        for (auto& thread : workers)
+            thread.join();
+
+        // Report the first failure in declaration order
+        for (auto& error : errors) {
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        for (std::size_t i = 0; i < decls.size(); i++)
+            synthesized_[decls[i]] = std::move(bodies[i]);
+        ast::Replacer::visit(prog);
+        synthesized_.clear();
+    }
+
     std::optional<std::list<ast::ptr<ast::Stmt>>>
     replace(ast::OracleDecl& decl) {
-        auto l_net = synthesis::read_network(decl.fname());
-        auto body = synthesis::synthesize_net(decl.pos(), l_net, decl.params());
+        std::list<ast::ptr<ast::Gate>> body;
+        if (auto it = synthesized_.find(&decl); it != synthesized_.end())
+            body = std::move(it->second);
+        else
+            body = synthesize(decl);
 
         std::list<ast::ptr<ast::Stmt>> ret;
         ret.emplace_back(std::make_unique<ast::GateDecl>(ast::GateDecl(
             decl.pos(), decl.id(), false, {}, decl.params(), std::move(body))));
         return std::move(ret);
     }
+
+  private:
+    config config_;
+    std::optional<synthesis::oracle_cache> cache_;
+    std::unordered_map<ast::OracleDecl*, std::list<ast::ptr<ast::Gate>>>
+        synthesized_;
+
+    std::list<ast::ptr<ast::Gate>> synthesize(ast::OracleDecl& decl) {
+        if (!cache_) {
+            auto l_net = synthesis::read_network(decl.fname());
+            return synthesis::synthesize_net(decl.pos(), l_net, decl.params(),
+                                             "anc", config_.synthesis);
+        }
+
+        std::ifstream ifs(decl.fname(), std::ifstream::binary);
+        std::string contents{std::istreambuf_iterator<char>(ifs),
+                             std::istreambuf_iterator<char>()};
+        auto ext = decl.fname().substr(decl.fname().find_last_of(".") + 1);
+        auto key = synthesis::oracle_cache::key(
+            contents, ext, "anc", synthesis::synthesis_id(config_.synthesis));
+        if (auto body = cache_->load(key, decl.params()))
+            return std::move(*body);
+
+        auto l_net = synthesis::read_network(decl.fname());
+        auto body = synthesis::synthesize_net(decl.pos(), l_net, decl.params(),
+                                              "anc", config_.synthesis);
+        if (ifs)
+            cache_->store(key, decl.params(), body);
+        return body;
+    }
 };
 
-void synthesize_oracles(ast::ASTNode& node) {
-    OracleSynthesizer alg;
+/**
+ * \brief Synthesizes all declared oracles
+ * \return The lookup counters of the on-disk cache
+ */
+inline synthesis::oracle_cache::statistics
+synthesize_oracles(ast::ASTNode& node,
+                   const OracleSynthesizer::config& params = {}) {
+    OracleSynthesizer alg(params);
     node.accept(alg);
+    return alg.stats();
 }
 
 } // namespace transformations
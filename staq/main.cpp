@@ -33,14 +33,22 @@
 #include "optimization/cnot_resynthesis.hpp"
 
 #include "mapping/device.hpp"
+#include "mapping/device_file.hpp"
 #include "mapping/layout/basic.hpp"
 #include "mapping/layout/eager.hpp"
 #include "mapping/layout/bestfit.hpp"
+#include "mapping/layout/subgraph.hpp"
 #include "mapping/mapping/swap.hpp"
+#include "mapping/mapping/lookahead.hpp"
 #include "mapping/mapping/steiner.hpp"
+#include "mapping/mapping/parallel.hpp"
 
 #include "tools/resource_estimator.hpp"
+#include "tools/scheduler.hpp"
+#include "tools/verifier.hpp"
 
+#include "output/qasm.hpp"
+#include "output/binary.hpp"
 #include "output/projectq.hpp"
 #include "output/qsharp.hpp"
 #include "output/quil.hpp"
@@ -51,13 +59,16 @@ using namespace staq;
 /**
  * \brief Compiler passes
  */
-enum class Pass { desugar, inln, synth, rotfold, cnotsynth, simplify, map };
+enum class Pass { inln, synth, rotfold, cnotsynth, simplify, map };
 
 /**
  * \brief Command-line options
  */
 enum class Option { no_op, i, S, r, c, s, m, O1, O2, O3, d, l, M,
-                    o, f, h, no_expand, disable_lo };
+                    o, f, h, no_expand, disable_lo, parallel_map, stats,
+                    loops, json, gate_time, oracle_cache, no_oracle_cache,
+                    cut_size, strategy, stg, toffoli_bound, auto_synth,
+                    synth_budget, verify };
 std::unordered_map<std::string_view, Option> cli_map{
     {"-i", Option::i},
     {"--inline", Option::i},
@@ -87,11 +98,25 @@ std::unordered_map<std::string_view, Option> cli_map{
     {"-h", Option::h},
     {"--help", Option::h},
     {"--no-expand-registers", Option::no_expand},
-    {"--disable-layout-optimization", Option::disable_lo}};
+    {"--disable-layout-optimization", Option::disable_lo},
+    {"--parallel-mapping", Option::parallel_map},
+    {"--stats", Option::stats},
+    {"--compress-loops", Option::loops},
+    {"--json", Option::json},
+    {"--gate-time", Option::gate_time},
+    {"--oracle-cache", Option::oracle_cache},
+    {"--no-oracle-cache", Option::no_oracle_cache},
+    {"--cut-size", Option::cut_size},
+    {"--mapping-strategy", Option::strategy},
+    {"--stg", Option::stg},
+    {"--toffoli-bound", Option::toffoli_bound},
+    {"--auto-synthesis", Option::auto_synth},
+    {"--synthesis-budget", Option::synth_budget},
+    {"--verify", Option::verify}};
 
-enum class Layout { linear, eager, bestfit };
-enum class Mapper { swap, steiner };
-enum class Format { qasm, quil, projectq, qsharp, cirq, resources };
+enum class Layout { linear, eager, bestfit, subgraph };
+enum class Mapper { swap, steiner, lookahead };
+enum class Format { qasm, quil, projectq, qsharp, cirq, resources, binary };
 
 void print_help() {
     int width = 40;
@@ -121,27 +146,67 @@ void print_help() {
     std::cout << std::setw(width) << std::left << "-o,--output FILE"
               << "Output filename. Otherwise prints to stdout.\n";
     std::cout << std::setw(width) << std::left
-              << "-f,--format (qasm|quil|projectq|qsharp|cirq|resources) "
+              << "-f,--format (qasm|quil|projectq|qsharp|cirq|resources|"
+                 "binary) "
               << "Output format. Default=qasm.\n";
     std::cout << std::setw(width) << std::left
-              << "-d,--device (tokyo|agave|aspen-4|square|fullycon) "
+              << "-d,--device (tokyo|agave|aspen-4|square|fullycon|"
+                 "grid:RxC|heavy-hex:RxC|FILE) "
               << "Device for physical mapping. Default=tokyo.\n";
     std::cout << std::setw(width) << std::left
-              << "-l,--layout (linear|eager|bestfit)"
+              << "-l,--layout (linear|eager|bestfit|subgraph)"
               << "Initial device layout algorithm. Default=bestfit.\n";
     std::cout << std::setw(width) << std::left
-              << "-M,--mapping-alg (swap|steiner)"
+              << "-M,--mapping-alg (swap|steiner|lookahead)"
               << "Algorithm to use for mapping CNOT gates. Default=steiner.\n";
     std::cout << std::setw(width) << std::left
               << "--disable_layout_optimization"
               << "Disables an expensive layout optimization pass when using the steiner mapper.\n";
+    std::cout << std::setw(width) << std::left << "--parallel-mapping"
+              << "Maps the swap & lookahead mappers' blocks in parallel, "
+                 "restoring the layout between blocks.\n";
     std::cout
         << std::setw(width) << std::left << "--no-expand-registers"
         << "Disables expanding gates applied to registers rather than qubits\n";
+    std::cout << std::setw(width) << std::left << "--stats"
+              << "Prints synthesis cache statistics to stderr\n";
+    std::cout << std::setw(width) << std::left << "--compress-loops"
+              << "Emits repeated gates as loops in projectq, qsharp & cirq "
+                 "output\n";
+    std::cout << std::setw(width) << std::left << "--json"
+              << "Prints resource estimates & the schedule as JSON\n";
+    std::cout << std::setw(width) << std::left << "--gate-time NAME=TIME"
+              << "Duration of a gate when scheduling resource estimates. "
+                 "Default=1\n";
+    std::cout << std::setw(width) << std::left << "--oracle-cache DIR"
+              << "Directory caching synthesized oracles. "
+                 "Default=$STAQ_CACHE_DIR or ~/.cache/staq\n";
+    std::cout << std::setw(width) << std::left << "--no-oracle-cache"
+              << "Always synthesizes oracles from scratch\n";
+    std::cout << std::setw(width) << std::left << "--cut-size N"
+              << "LUT size when synthesizing oracles, 2 to 6. Default=3\n";
+    std::cout << std::setw(width) << std::left
+              << "--mapping-strategy (eager|bennett|bennett-inplace) "
+              << "Oracle synthesis strategy. Default=eager\n";
+    std::cout << std::setw(width) << std::left << "--stg (pkrm|pprm|spectrum)"
+              << "Synthesis method for oracle LUTs. Default=pkrm\n";
+    std::cout << std::setw(width) << std::left << "--toffoli-bound (2|3|4)"
+              << "Controls of the Toffolis oracles are decomposed into. "
+                 "Default=3\n";
+    std::cout << std::setw(width) << std::left
+              << "--auto-synthesis (qubits|t-count)"
+              << "Searches oracle synthesis parameters minimizing a cost\n";
+    std::cout << std::setw(width) << std::left << "--synthesis-budget SECONDS"
+              << "Time spent searching per oracle, 0 for no limit. "
+                 "Default=1\n";
+    std::cout << std::setw(width) << std::left << "--verify"
+              << "Checks the compiled program against the input by "
+                 "simulation\n";
 }
 
 int main(int argc, char** argv) {
-    std::list<Pass> passes{Pass::desugar};
+    std::list<Pass> passes;
+    bool expand_registers = true;
 
     mapping::Device dev = mapping::tokyo;
     Layout layout_alg = Layout::bestfit;
@@ -149,6 +214,16 @@ int main(int argc, char** argv) {
     std::string ofile = "";
     Format format = Format::qasm;
     bool do_lo = true;
+    bool parallel_map = false;
+    bool print_stats = false;
+    bool compress_loops = false;
+    bool json = false;
+    bool verify = false;
+    tools::Scheduler::config schedule_params;
+    transformations::OracleSynthesizer::config synth_params{
+        synthesis::oracle_cache::default_directory(),
+        std::thread::hardware_concurrency()};
+    synthesis::oracle_cache::statistics oracle_stats;
 
     for (int i = 1; i < argc; i++) {
         switch (cli_map[std::string_view(argv[i])]) {
@@ -192,18 +267,8 @@ int main(int argc, char** argv) {
             /* Device configuration */
             case Option::d: {
                 std::string_view arg(argv[++i]);
-                if (arg == "tokyo")
-                    dev = mapping::tokyo;
-                else if (arg == "agave")
-                    dev = mapping::agave;
-                else if (arg == "aspen-4")
-                    dev = mapping::aspen4;
-                else if (arg == "singapore")
-                    dev = mapping::singapore;
-                else if (arg == "square")
-                    dev = mapping::square_9q;
-                else if (arg == "fullycon")
-                    dev = mapping::fully_connected(9);
+                if (auto device = mapping::get_device(arg))
+                    dev = std::move(*device);
                 else
                     std::cout << "Error: unrecognized device \"" << arg
                               << "\"\n";
@@ -217,6 +282,8 @@ int main(int argc, char** argv) {
                     layout_alg = Layout::eager;
                 else if (arg == "bestfit")
                     layout_alg = Layout::bestfit;
+                else if (arg == "subgraph")
+                    layout_alg = Layout::subgraph;
                 else
                     std::cout << "Unrecognized layout algorithm \"" << arg
                               << "\"\n";
@@ -228,6 +295,8 @@ int main(int argc, char** argv) {
                     mapper = Mapper::swap;
                 else if (arg == "steiner")
                     mapper = Mapper::steiner;
+                else if (arg == "lookahead")
+                    mapper = Mapper::lookahead;
                 else
                     std::cout << "Unrecognized mapping algorithm \"" << arg
                               << "\"\n";
@@ -251,6 +320,8 @@ int main(int argc, char** argv) {
                     format = Format::cirq;
                 else if (arg == "resources")
                     format = Format::resources;
+                else if (arg == "binary")
+                    format = Format::binary;
                 else
                     std::cout << "Unrecognized output format \"" << arg
                               << "\"\n";
@@ -258,11 +329,111 @@ int main(int argc, char** argv) {
             }
             /* Misc */
             case Option::no_expand:
-                passes.pop_front();
+                expand_registers = false;
                 break;
             case Option::disable_lo:
                 do_lo = false;
                 break;
+            case Option::parallel_map:
+                parallel_map = true;
+                break;
+            case Option::stats:
+                print_stats = true;
+                break;
+            case Option::loops:
+                compress_loops = true;
+                break;
+            case Option::json:
+                json = true;
+                break;
+            case Option::gate_time: {
+                std::string arg(argv[++i]);
+                auto pos = arg.find('=');
+                try {
+                    if (pos == std::string::npos)
+                        throw std::invalid_argument(arg);
+                    schedule_params.durations[arg.substr(0, pos)] =
+                        std::stod(arg.substr(pos + 1));
+                } catch (std::logic_error&) {
+                    std::cout << "Error: expected NAME=TIME, got \"" << arg
+                              << "\"\n";
+                }
+                break;
+            }
+            case Option::oracle_cache:
+                synth_params.cache_dir = argv[++i];
+                break;
+            case Option::no_oracle_cache:
+                synth_params.cache_dir.clear();
+                break;
+            case Option::cut_size: {
+                auto n = std::atoi(argv[++i]);
+                if (n >= 2 && n <= 6)
+                    synth_params.synthesis.cut_size = n;
+                else
+                    std::cout << "Error: cut size must be between 2 and 6\n";
+                break;
+            }
+            case Option::strategy: {
+                std::string_view arg(argv[++i]);
+                if (arg == "eager")
+                    synth_params.synthesis.strategy =
+                        synthesis::mapping_strategy::eager;
+                else if (arg == "bennett")
+                    synth_params.synthesis.strategy =
+                        synthesis::mapping_strategy::bennett;
+                else if (arg == "bennett-inplace")
+                    synth_params.synthesis.strategy =
+                        synthesis::mapping_strategy::bennett_inplace;
+                else
+                    std::cout << "Unrecognized mapping strategy \"" << arg
+                              << "\"\n";
+                break;
+            }
+            case Option::stg: {
+                std::string_view arg(argv[++i]);
+                if (arg == "pkrm")
+                    synth_params.synthesis.stg = synthesis::stg_method::pkrm;
+                else if (arg == "pprm")
+                    synth_params.synthesis.stg = synthesis::stg_method::pprm;
+                else if (arg == "spectrum")
+                    synth_params.synthesis.stg =
+                        synthesis::stg_method::spectrum;
+                else
+                    std::cout << "Unrecognized synthesis method \"" << arg
+                              << "\"\n";
+                break;
+            }
+            case Option::toffoli_bound: {
+                auto n = std::atoi(argv[++i]);
+                if (n >= 2 && n <= 4)
+                    synth_params.synthesis.toffoli_bound = n;
+                else
+                    std::cout << "Error: Toffoli bound must be 2, 3 or 4\n";
+                break;
+            }
+            case Option::auto_synth: {
+                std::string_view arg(argv[++i]);
+                synth_params.synthesis.automatic = true;
+                if (arg == "qubits")
+                    synth_params.synthesis.objective =
+                        synthesis::synthesis_objective::qubits;
+                else if (arg == "t-count")
+                    synth_params.synthesis.objective =
+                        synthesis::synthesis_objective::t_count;
+                else {
+                    synth_params.synthesis.automatic = false;
+                    std::cout << "Unrecognized synthesis objective \"" << arg
+                              << "\"\n";
+                }
+                break;
+            }
+            case Option::synth_budget:
+                synth_params.synthesis.budget = std::atof(argv[++i]);
+                break;
+            case Option::verify:
+                verify = true;
+                break;
             /* Help */
             case Option::h:
                 print_help();
@@ -270,7 +441,9 @@ int main(int argc, char** argv) {
             /* Default */
             case Option::no_op:
                 std::string_view str(argv[i]);
-                if (str.substr(str.find_last_of(".") + 1) == "qasm") {
+                std::ifstream probe(argv[i], std::ifstream::binary);
+                if (str.substr(str.find_last_of(".") + 1) == "qasm" ||
+                    (probe.good() && parser::is_binary_stream(probe))) {
 
                     /* Parsing */
                     auto prog = parser::parse_file(argv[i]);
@@ -280,12 +453,41 @@ int main(int argc, char** argv) {
                         exit(0);
                     }
 
+                    /* Reference for verification, with the location of its
+                     * qubits in the compiled program */
+                    ast::ptr<ast::Program> reference;
+                    tools::qubit_correspondence qubits;
+                    if (verify) {
+                        reference.reset(prog->clone());
+                        if (std::find(passes.begin(), passes.end(),
+                                      Pass::synth) != passes.end())
+                            transformations::synthesize_oracles(*reference,
+                                                                synth_params);
+                        reference->foreach_stmt([&qubits](auto& stmt) {
+                            auto decl = dynamic_cast<ast::RegisterDecl*>(&stmt);
+                            if (!decl || !decl->is_quantum())
+                                return;
+                            for (auto j = 0; j < decl->size(); j++) {
+                                ast::VarAccess ap(parser::Position(),
+                                                  decl->id(), j);
+                                qubits.insert_or_assign(
+                                    ap, tools::qubit_location{ap, ap});
+                            }
+                        });
+                    }
+
                     /* Passes */
-                    for (auto pass : passes)
+                    // Register-level gates are only expanded once a pass
+                    // that works on individual qubits is reached
+                    bool expanded = !expand_registers;
+                    bool mapped = false;
+                    for (auto pass : passes) {
+                        if (!expanded && pass != Pass::synth) {
+                            transformations::desugar(*prog);
+                            expanded = true;
+                        }
+
                         switch (pass) {
-                            case Pass::desugar:
-                                transformations::desugar(*prog);
-                                break;
                             case Pass::inln:
                                 transformations::inline_ast(
                                     *prog,
@@ -293,10 +495,14 @@ int main(int argc, char** argv) {
                                      "anc"});
                                 break;
                             case Pass::synth:
-                                transformations::synthesize_oracles(*prog);
+                                oracle_stats =
+                                    transformations::synthesize_oracles(
+                                        *prog, synth_params);
                                 break;
                             case Pass::rotfold:
-                                optimization::fold_rotations(*prog);
+                                optimization::fold_rotations(
+                                    *prog,
+                                    {true, std::thread::hardware_concurrency()});
                                 break;
                             case Pass::cnotsynth:
                                 optimization::optimize_CNOT(*prog);
@@ -327,6 +533,11 @@ int main(int argc, char** argv) {
                                             mapping::compute_bestfit_layout(
                                                 dev, *prog);
                                         break;
+                                    case Layout::subgraph:
+                                        initial_layout =
+                                            mapping::compute_subgraph_layout(
+                                                dev, *prog);
+                                        break;
                                 }
 
                                 /* (Optional) optimize the layout */
@@ -338,17 +549,53 @@ int main(int argc, char** argv) {
                                 mapping::apply_layout(initial_layout, dev,
                                                       *prog);
 
-                                /* Apply the mapping algorithm */
+                                /* Apply the mapping algorithm. Parallel
+                                 * Steiner mapping gives the same result */
+                                mapping::ParallelMapper::config params;
                                 switch (mapper) {
                                     case Mapper::swap:
-                                        mapping::map_onto_device(dev, *prog);
+                                        params.algorithm =
+                                            mapping::mapping_algorithm::swap;
                                         break;
                                     case Mapper::steiner:
-                                        mapping::steiner_mapping(dev, *prog);
+                                        params.algorithm =
+                                            mapping::mapping_algorithm::steiner;
+                                        break;
+                                    case Mapper::lookahead:
+                                        params.algorithm = mapping::
+                                            mapping_algorithm::lookahead;
                                         break;
                                 }
+                                if (mapper != Mapper::steiner && !parallel_map)
+                                    params.num_threads = 1;
+                                mapping::ParallelMapper parallel(dev, params);
+                                parallel.run(*prog);
+
+                                /* Track where the qubits moved */
+                                auto& init = parallel.initial_layout();
+                                auto& fin = parallel.final_layout();
+                                auto physical = [&initial_layout](
+                                                    const ast::VarAccess& ap,
+                                                    const std::vector<int>& l) {
+                                    return ast::VarAccess(
+                                        parser::Position(), "q",
+                                        l[initial_layout.at(ap)]);
+                                };
+                                for (auto& [ap, loc] : qubits) {
+                                    loc.input = physical(loc.input, init);
+                                    loc.output = physical(loc.output, fin);
+                                }
+                                mapped = true;
                             }
                         }
+                    }
+
+                    /* QASM, binary output and resource estimates handle
+                     * registers */
+                    if (!expanded && format != Format::qasm &&
+                        format != Format::binary &&
+                        format != Format::resources)
+                        transformations::desugar(*prog);
 
                     /* Output */
                     switch (format) {
@@ -358,56 +605,112 @@ int main(int argc, char** argv) {
                             else
                                 output::write_quil(*prog, ofile);
                             break;
-                        case Format::projectq:
+                        case Format::projectq: {
+                            output::ProjectQOutputter::config params;
+                            params.loops = compress_loops;
                             if (ofile == "")
-                                output::output_projectq(*prog);
+                                output::output_projectq(*prog, params);
                             else
-                                output::write_projectq(*prog, ofile);
+                                output::write_projectq(*prog, ofile, params);
                             break;
-                        case Format::qsharp:
+                        }
+                        case Format::qsharp: {
+                            output::QSharpOutputter::config params;
+                            params.loops = compress_loops;
                             if (ofile == "")
-                                output::output_qsharp(*prog);
+                                output::output_qsharp(*prog, params);
                             else
-                                output::write_qsharp(*prog, ofile);
+                                output::write_qsharp(*prog, ofile, params);
                             break;
-                        case Format::cirq:
+                        }
+                        case Format::cirq: {
+                            output::CirqOutputter::config params;
+                            params.loops = compress_loops;
                             if (ofile == "")
-                                output::output_cirq(*prog);
+                                output::output_cirq(*prog, params);
                             else
-                                output::write_cirq(*prog, ofile);
+                                output::write_cirq(*prog, ofile, params);
                             break;
+                        }
                         case Format::resources: {
                             auto count = tools::estimate_resources(*prog);
+                            /* Device durations only apply to a program
+                             * mapped onto the device */
+                            if (mapped)
+                                schedule_params.device = &dev;
+                            auto report =
+                                tools::schedule(*prog, schedule_params);
 
-                            if (ofile == "") {
-                                std::cout << "Resource estimates for " << str
-                                          << ":\n";
-                                for (auto& [name, num] : count)
-                                    std::cout << "  " << name << ": " << num
-                                              << "\n";
-                            } else {
-                                std::ofstream os;
-                                os.open(ofile);
+                            std::ofstream ofs;
+                            if (ofile != "")
+                                ofs.open(ofile);
+                            std::ostream& os = ofile == "" ? std::cout : ofs;
 
+                            if (json) {
+                                tools::write_json(os, count, report);
+                            } else {
                                 os << "Resource estimates for " << str << ":\n";
                                 for (auto& [name, num] : count)
                                     os << "  " << name << ": " << num << "\n";
-
-                                os.close();
+                                os << "  latency: " << report.latency << "\n";
+                                os << "  t-depth: " << report.t_depth << "\n";
+                                os << "  cnot-depth: " << report.cnot_depth
+                                   << "\n";
                             }
 
                             break;
                         }
-                        case Format::qasm:
-                        default:
+                        case Format::binary:
                             if (ofile == "")
-                                std::cout << *prog << "\n";
-                            else {
-                                std::ofstream os;
-                                os.open(ofile);
-                                os << *prog;
-                                os.close();
-                            }
+                                output::output_binary(*prog);
+                            else
+                                output::write_binary(*prog, ofile);
+                            break;
+                        case Format::qasm:
+                        default: {
+                            output::QASMOutputter::config params;
+                            params.num_threads =
+                                std::thread::hardware_concurrency();
+                            if (ofile == "") {
+                                output::output_qasm(*prog, params);
+                                std::cout << "\n";
+                            } else
+                                output::write_qasm(*prog, ofile, params);
+                        }
+                    }
+
+                    if (print_stats) {
+                        auto stats =
+                            synthesis::cnot_dihedral_cache::shared().stats();
+                        std::cerr << "cnot-dihedral synthesis cache: "
+                                  << stats.hits << " hits, " << stats.misses
+                                  << " misses\n";
+                        std::cerr << "oracle cache: " << oracle_stats.hits
+                                  << " hits, " << oracle_stats.misses
+                                  << " misses\n";
+                    }
+
+                    if (verify) {
+                        tools::EquivalenceChecker::config params;
+                        params.simulation.num_threads =
+                            std::thread::hardware_concurrency();
+                        try {
+                            auto result = tools::check_equivalence(
+                                *reference, *prog, qubits, params);
+                            std::cerr << "verification: "
+                                      << (result.equivalent
+                                              ? "equivalent"
+                                              : "NOT equivalent")
+                                      << " (fidelity " << result.fidelity
+                                      << ", " << result.num_qubits
+                                      << " qubits)\n";
+                            if (!result.equivalent)
+                                exit(1);
+                        } catch (std::exception& e) {
+                            std::cerr << "Error: can't verify \"" << str
+                                      << "\": " << e.what() << "\n";
+                            exit(1);
+                        }
                     }
                 } else {
                     std::cout << "Unrecognized option \"" << str << "\"\n";
@@ -32,19 +32,23 @@ using namespace staq;
 
 int main(int argc, char** argv) {
     std::string filename = "";
+    bool loops = false;
 
     CLI::App app{"QASM to cirq transpiler"};
 
     app.add_option("-o", filename, "Output to a file");
+    app.add_flag("--loops", loops, "Emit repeated gates as loops");
 
     CLI11_PARSE(app, argc, argv);
     auto program = parser::parse_stdin();
     if (program) {
         transformations::desugar(*program);
+        output::CirqOutputter::config params;
+        params.loops = loops;
         if (filename == "")
-            output::output_cirq(*program);
+            output::output_cirq(*program, params);
         else
-            output::write_cirq(*program, filename);
+            output::write_cirq(*program, filename, params);
     } else {
         std::cerr << "Parsing failed\n";
     }
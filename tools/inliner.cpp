@@ -23,6 +23,7 @@
  */
 
 #include "parser/parser.hpp"
+#include "output/binary.hpp"
 #include "transformations/inline.hpp"
 
 #include <CLI/CLI.hpp>
@@ -30,6 +31,7 @@
 using namespace staq;
 
 int main(int argc, char** argv) {
+    bool binary = false;
     bool clear_decls = false;
     bool inline_stdlib = false;
     std::string ancilla_name = "anc";
@@ -41,6 +43,8 @@ int main(int argc, char** argv) {
                  "Inline qelib1.inc declarations as well");
     app.add_option("--ancilla-name", ancilla_name,
                    "Name of the global ancilla register, if applicable");
+    app.add_flag("--binary", binary,
+                 "Output in the binary circuit format");
 
     CLI11_PARSE(app, argc, argv);
 
@@ -51,7 +55,10 @@ int main(int argc, char** argv) {
                           : transformations::default_overrides;
         transformations::inline_ast(*program,
                                     {!clear_decls, overrides, ancilla_name});
-        std::cout << *program;
+        if (binary)
+            output::output_binary(*program);
+        else
+            std::cout << *program;
     } else {
         std::cerr << "Parsing failed\n";
     }
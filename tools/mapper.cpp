@@ -23,23 +23,25 @@
  */
 
 #include "parser/parser.hpp"
+#include "output/binary.hpp"
 #include "transformations/inline.hpp"
 
 #include "mapping/device.hpp"
+#include "mapping/device_file.hpp"
 #include "mapping/layout/basic.hpp"
 #include "mapping/layout/eager.hpp"
 #include "mapping/layout/bestfit.hpp"
+#include "mapping/layout/subgraph.hpp"
 #include "mapping/mapping/swap.hpp"
 #include "mapping/mapping/steiner.hpp"
+#include "mapping/mapping/lookahead.hpp"
 
 #include <CLI/CLI.hpp>
 
 using namespace staq;
 
-// TODO: Find or create a format for reading machine definitions
-// and have this tool accept a machine definition as input for mapping
-
 int main(int argc, char** argv) {
+    bool binary = false;
     std::string device_name = "tokyo";
     std::string layout = "linear";
     std::string mapper = "swap";
@@ -47,10 +49,14 @@ int main(int argc, char** argv) {
     CLI::App app{"QASM physical mapper"};
 
     app.add_option("-d", device_name,
-                   "Device to map onto (tokyo|agave|aspen-4|square|fullycon)");
+                   "Device to map onto (tokyo|agave|aspen-4|square|fullycon|"
+                   "grid:RxC|heavy-hex:RxC|FILE)");
     app.add_option("-l", layout,
-                   "Layout algorithm to use (linear|eager|bestfit)");
-    app.add_option("-m", mapper, "Mapping algorithm to use (swap|steiner)");
+                   "Layout algorithm to use (linear|eager|bestfit|subgraph)");
+    app.add_option("-m", mapper,
+                   "Mapping algorithm to use (swap|steiner|lookahead)");
+    app.add_flag("--binary", binary,
+                 "Output in the binary circuit format");
 
     CLI11_PARSE(app, argc, argv);
 
@@ -61,21 +67,12 @@ int main(int argc, char** argv) {
         transformations::inline_ast(*program, {false, {}, "anc"});
 
         // Physical device
-        mapping::Device dev;
-        if (device_name == "tokyo") {
-            dev = mapping::tokyo;
-        } else if (device_name == "agave") {
-            dev = mapping::agave;
-        } else if (device_name == "aspen-4") {
-            dev = mapping::aspen4;
-        } else if (device_name == "square") {
-            dev = mapping::square_9q;
-        } else if (device_name == "fullycon") {
-            dev = mapping::fully_connected(9);
-        } else {
+        auto dev_opt = mapping::get_device(device_name);
+        if (!dev_opt) {
             std::cerr << "Error: invalid device name\n";
             return 0;
         }
+        auto& dev = *dev_opt;
 
         // Initial layout
         mapping::layout physical_layout;
@@ -85,6 +82,8 @@ int main(int argc, char** argv) {
             physical_layout = mapping::compute_eager_layout(dev, *program);
         } else if (layout == "bestfit") {
             physical_layout = mapping::compute_bestfit_layout(dev, *program);
+        } else if (layout == "subgraph") {
+            physical_layout = mapping::compute_subgraph_layout(dev, *program);
         } else {
             std::cerr << "Error: invalid layout algorithm\n";
             return 0;
@@ -96,13 +95,18 @@ int main(int argc, char** argv) {
             mapping::map_onto_device(dev, *program);
         } else if (mapper == "steiner") {
             mapping::steiner_mapping(dev, *program);
+        } else if (mapper == "lookahead") {
+            mapping::lookahead_mapping(dev, *program);
         } else {
             std::cerr << "Error: invalid mapping algorithm\n";
             return 0;
         }
 
         // Print result
-        std::cout << *program;
+        if (binary)
+            output::output_binary(*program);
+        else
+            std::cout << *program;
     } else {
         std::cerr << "Parsing failed\n";
     }
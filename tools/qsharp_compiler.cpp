@@ -32,19 +32,23 @@ using namespace staq;
 
 int main(int argc, char** argv) {
     std::string filename = "";
+    bool loops = false;
 
     CLI::App app{"QASM to Q# transpiler"};
 
     app.add_option("-o", filename, "Output to a file");
+    app.add_flag("--loops", loops, "Emit repeated gates as loops");
 
     CLI11_PARSE(app, argc, argv);
     auto program = parser::parse_stdin();
     if (program) {
         transformations::desugar(*program);
+        output::QSharpOutputter::config params;
+        params.loops = loops;
         if (filename == "")
-            output::output_qsharp(*program);
+            output::output_qsharp(*program, params);
         else
-            output::write_qsharp(*program, filename);
+            output::write_qsharp(*program, filename, params);
     } else {
         std::cerr << "Parsing failed\n";
     }
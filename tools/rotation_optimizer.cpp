@@ -23,6 +23,7 @@
  */
 
 #include "parser/parser.hpp"
+#include "output/binary.hpp"
 #include "optimization/rotation_folding.hpp"
 
 #include <CLI/CLI.hpp>
@@ -30,19 +31,29 @@
 using namespace staq;
 
 int main(int argc, char** argv) {
+    bool binary = false;
     bool no_correction = false;
+    std::size_t window = 0;
 
     CLI::App app{"QASM rotation optimizer"};
 
     app.add_flag("--no-phase-correction", no_correction,
                  "Turns off global phase corrections");
+    app.add_option("--window", window,
+                   "Only merge rotations at most this many rotations apart, "
+                   "folding in bounded memory");
+    app.add_flag("--binary", binary,
+                 "Output in the binary circuit format");
 
     CLI11_PARSE(app, argc, argv);
 
     auto program = parser::parse_stdin();
     if (program) {
-        optimization::fold_rotations(*program, {!no_correction});
-        std::cout << *program;
+        optimization::fold_rotations(*program, {!no_correction, 1, window});
+        if (binary)
+            output::output_binary(*program);
+        else
+            std::cout << *program;
     } else {
         std::cerr << "Parsing failed\n";
     }
@@ -23,6 +23,7 @@
  */
 
 #include "parser/parser.hpp"
+#include "output/binary.hpp"
 #include "optimization/simplify.hpp"
 
 #include <CLI/CLI.hpp>
@@ -30,19 +31,25 @@
 using namespace staq;
 
 int main(int argc, char** argv) {
+    bool binary = false;
     bool no_fixpoint = false;
 
     CLI::App app{"QASM simplifier"};
 
     app.add_flag("--no-fixpoint", no_fixpoint,
                  "Stops the simplifier after one iteration");
+    app.add_flag("--binary", binary,
+                 "Output in the binary circuit format");
 
     CLI11_PARSE(app, argc, argv);
 
     auto program = parser::parse_stdin();
     if (program) {
         optimization::simplify(*program, {!no_fixpoint});
-        std::cout << *program;
+        if (binary)
+            output::output_binary(*program);
+        else
+            std::cout << *program;
     } else {
         std::cerr << "Parsing failed\n";
     }
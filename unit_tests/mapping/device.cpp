@@ -24,7 +24,16 @@
 
 #include "gtest/gtest.h"
 #include "mapping/device.hpp"
+#include "mapping/device_file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <set>
+#include <sstream>
+#include <thread>
 
 using namespace staq;
 
@@ -139,3 +148,183 @@ TEST(Device, Steiner_tree) {
                        steiner_edges(tmp4.begin(), tmp4.end())));
 }
 /******************************************************************************/
+
+/******************************************************************************/
+TEST(Device, Grid) {
+    auto dev = mapping::grid(3, 4);
+    EXPECT_EQ(dev.qubits(), 12);
+    EXPECT_TRUE(dev.coupled(0, 1));
+    EXPECT_TRUE(dev.coupled(4, 0));
+    EXPECT_FALSE(dev.coupled(3, 4));
+    EXPECT_EQ(dev.distance(0, 11), 5);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Device, Heavy_Hex) {
+    auto dev = mapping::heavy_hex(3, 4);
+    // 12 sites, 9 horizontal and 4 vertical edges
+    EXPECT_EQ(dev.qubits(), 25);
+    for (auto i = 0; i < dev.qubits(); i++) {
+        int degree = 0;
+        for (auto j = 0; j < dev.qubits(); j++)
+            degree += dev.coupled(i, j);
+        EXPECT_LE(degree, 3);
+        if (i >= 12) {
+            EXPECT_EQ(degree, 2);
+        }
+    }
+    // Sites are never directly coupled
+    EXPECT_FALSE(dev.coupled(0, 1));
+    EXPECT_EQ(dev.distance(0, 1), 2);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Device, Description_File) {
+    std::string fname = testing::TempDir() + "staq_test_device.txt";
+    {
+        std::ofstream out(fname);
+        out << "# A small test device\n"
+            << "name Test line\n"
+            << "qubits 4\n"
+            << "qubit 0 0.9\n"
+            << "edge 0 1 0.95\n"
+            << "edge 1 2\n"
+            << "coupling 2 3 0.5 # directed\n";
+    }
+    std::remove((fname + ".cache").c_str());
+
+    auto dev = mapping::read_device_file(fname);
+    ASSERT_TRUE(dev);
+    EXPECT_EQ(dev->name(), "Test line");
+    EXPECT_EQ(dev->qubits(), 4);
+    EXPECT_TRUE(dev->coupled(1, 0));
+    EXPECT_TRUE(dev->coupled(2, 3));
+    EXPECT_FALSE(dev->coupled(3, 2));
+    EXPECT_DOUBLE_EQ(dev->sq_fidelity(0), 0.9);
+    EXPECT_DOUBLE_EQ(dev->tq_fidelity(1, 0), 0.95);
+    EXPECT_EQ(dev->shortest_path(0, 3), mapping::path({0, 1, 2, 3}));
+
+    // The second read is served from the sidecar cache
+    EXPECT_TRUE(std::ifstream(fname + ".cache").good());
+    auto cached = mapping::read_device_file(fname);
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(cached->shortest_path(0, 3), mapping::path({0, 1, 2, 3}));
+    EXPECT_EQ(cached->distance(3, 0), 3);
+
+    // A corrupted cache is recomputed. Next hops follow a header of 20 bytes
+    // & each row's four distances
+    auto corrupt = [&fname](std::streamoff offset, int32_t value) {
+        std::fstream cache(fname + ".cache",
+                           std::ios::binary | std::ios::in | std::ios::out);
+        cache.seekp(offset);
+        cache.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    auto next = [](int i, int j) { return 20 + 48 * i + 32 + 4 * j; };
+    corrupt(next(0, 3), 1000);
+    cached = mapping::read_device_file(fname);
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(cached->shortest_path(0, 3), mapping::path({0, 1, 2, 3}));
+
+    corrupt(next(0, 3), 1);
+    corrupt(next(1, 3), 0);
+    cached = mapping::read_device_file(fname);
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(cached->shortest_path(0, 3), mapping::path({0, 1, 2, 3}));
+    EXPECT_EQ(cached->distance(1, 3), 2);
+
+    std::remove(fname.c_str());
+    std::remove((fname + ".cache").c_str());
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Device, Disconnected_Qubits) {
+    // A line of 12 low-fidelity couplings & an isolated qubit
+    std::string text = "qubits 14\n";
+    for (auto i = 0; i < 12; i++)
+        text += "edge " + std::to_string(i) + " " + std::to_string(i + 1) +
+                " 0.01\n";
+    auto dev = mapping::parse_device(text, "disconnected");
+    ASSERT_TRUE(dev);
+
+    // Long paths are still paths
+    EXPECT_EQ(dev->shortest_path(0, 12).size(), 13);
+    EXPECT_EQ(dev->distance(0, 12), 12);
+    EXPECT_EQ(dev->shortest_path(0, 13), mapping::path({0}));
+
+    // Infinite distances survive the path cache
+    std::stringstream ss;
+    dev->write_paths(ss);
+    auto paths = mapping::Device::read_paths(ss, 14);
+    ASSERT_TRUE(paths);
+    EXPECT_TRUE(std::isinf(paths->dist[0][13]));
+    mapping::Device cached(*dev, paths);
+    EXPECT_EQ(cached.shortest_path(0, 12).size(), 13);
+    EXPECT_EQ(cached.shortest_path(13, 0), mapping::path({13}));
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Device, Description_Errors) {
+    testing::internal::CaptureStderr();
+    EXPECT_FALSE(mapping::parse_device("edge 0 1\n", "a"));
+    EXPECT_FALSE(mapping::parse_device("qubits 2\nedge 0 2\n", "b"));
+    EXPECT_FALSE(mapping::parse_device("qubits 2\nfoo\n", "c"));
+    EXPECT_FALSE(mapping::parse_device("qubits 2\nedge 0 1 high\n", "d"));
+    EXPECT_FALSE(mapping::parse_device("qubits 2\nedge 0 1 0.9 x\n", "e"));
+    EXPECT_FALSE(mapping::parse_device("qubits 2\nedge 0 1 1.5\n", "f"));
+    EXPECT_FALSE(mapping::parse_device("qubits 2\ncoupling 0 1 0\n", "g"));
+    EXPECT_FALSE(mapping::parse_device("qubits 2\nedge 0 1 1 -2\n", "h"));
+    EXPECT_FALSE(mapping::parse_device("qubits 2\nedge 0 1 1 2 3\n", "i"));
+    EXPECT_FALSE(mapping::parse_device("qubits 2\nqubit 0 -0.5\n", "j"));
+    EXPECT_FALSE(mapping::parse_device("qubits 2\nqubit 0 1 fast\n", "k"));
+    EXPECT_TRUE(mapping::parse_device("qubits 2\nqubit 0 1\nedge 0 1 1 2\n",
+                                      "l"));
+    EXPECT_FALSE(mapping::get_device("grid:3"));
+    testing::internal::GetCapturedStderr();
+
+    auto dev = mapping::get_device("heavy-hex:2x3");
+    ASSERT_TRUE(dev);
+    EXPECT_EQ(dev->qubits(), mapping::heavy_hex(2, 3).qubits());
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Device, Concurrent_Queries) {
+    const auto dev = mapping::grid(8, 8);
+
+    // Couplings are ordered by decreasing fidelity, then by qubits
+    auto& couplings = dev.couplings();
+    EXPECT_EQ(couplings.size(), 2u * (2 * 8 * 7));
+    EXPECT_TRUE(std::is_sorted(couplings.begin(), couplings.end(),
+                               [](const auto& a, const auto& b) {
+                                   if (a.second != b.second)
+                                       return a.second > b.second;
+                                   return a.first < b.first;
+                               }));
+
+    // Path tables are computed once, whichever thread gets there first
+    std::vector<long> sums(4, 0);
+    std::vector<std::thread> threads;
+    for (auto t = 0; t < 4; t++) {
+        threads.emplace_back([&dev, &sums, t]() {
+            for (auto i = 0; i < dev.qubits(); i++) {
+                for (auto j = 0; j < dev.qubits(); j++)
+                    sums[t] += dev.distance(i, j);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    long expected = 0;
+    for (auto i = 0; i < 64; i++) {
+        for (auto j = 0; j < 64; j++)
+            expected += std::abs(i / 8 - j / 8) + std::abs(i % 8 - j % 8);
+    }
+    for (auto t = 0; t < 4; t++)
+        EXPECT_EQ(sums[t], expected);
+}
+/******************************************************************************/
@@ -29,6 +29,7 @@
 #include "mapping/layout/basic.hpp"
 #include "mapping/layout/eager.hpp"
 #include "mapping/layout/bestfit.hpp"
+#include "mapping/layout/subgraph.hpp"
 
 using namespace staq;
 
@@ -159,3 +160,98 @@ TEST(Layout, Best_Fit) {
     EXPECT_EQ(ss.str(), post);
 }
 /******************************************************************************/
+
+// Checks that every CNOT in a mapped program acts on coupled qubits
+static bool all_coupled(const mapping::Device& device, ast::Program& prog) {
+    std::stringstream ss;
+    ss << prog;
+    std::string line;
+    while (std::getline(ss, line)) {
+        int ctrl, tgt;
+        if (std::sscanf(line.c_str(), "CX q[%d],q[%d];", &ctrl, &tgt) == 2 &&
+            !device.coupled(ctrl, tgt) && !device.coupled(tgt, ctrl))
+            return false;
+    }
+    return true;
+}
+
+/******************************************************************************/
+TEST(Layout, Subgraph) {
+    // A 6-cycle with a chord, which embeds in the test device
+    std::string pre = "OPENQASM 2.0;\n"
+                      "\n"
+                      "qreg orig[9];\n"
+                      "CX orig[0],orig[3];\n"
+                      "CX orig[3],orig[6];\n"
+                      "CX orig[6],orig[2];\n"
+                      "CX orig[2],orig[8];\n"
+                      "CX orig[8],orig[4];\n"
+                      "CX orig[4],orig[0];\n"
+                      "CX orig[3],orig[8];\n";
+
+    auto program = parser::parse_string(pre, "layout_subgraph.qasm");
+    mapping::SubgraphLayout gen(test_device);
+    auto layout = gen.generate(*program);
+    EXPECT_TRUE(gen.embedded());
+    EXPECT_EQ(layout.size(), 9u);
+
+    mapping::apply_layout(layout, test_device, *program);
+    EXPECT_TRUE(all_coupled(test_device, *program));
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Layout, Subgraph_Fallback) {
+    // A triangle has no embedding in a bipartite lattice
+    std::string pre = "OPENQASM 2.0;\n"
+                      "\n"
+                      "qreg orig[4];\n"
+                      "CX orig[0],orig[1];\n"
+                      "CX orig[1],orig[2];\n"
+                      "CX orig[2],orig[0];\n"
+                      "CX orig[2],orig[3];\n";
+
+    auto program = parser::parse_string(pre, "layout_subgraph.qasm");
+    auto device = mapping::grid(3, 3);
+    mapping::SubgraphLayout gen(device);
+    auto layout = gen.generate(*program);
+    EXPECT_FALSE(gen.embedded());
+
+    // Every qubit is placed on a distinct physical qubit, close together
+    std::set<int> physical;
+    for (auto& [ap, i] : layout)
+        physical.insert(i);
+    EXPECT_EQ(physical.size(), 4u);
+    for (auto& [a, i] : layout) {
+        for (auto& [b, j] : layout) {
+            if (a.offset() != 3 && b.offset() != 3) {
+                EXPECT_LE(device.distance(i, j), 2);
+            }
+        }
+    }
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Layout, Subgraph_Large) {
+    // A 10x20 lattice of interactions on a 20x20 device
+    auto device = mapping::grid(20, 20);
+    std::stringstream pre;
+    pre << "OPENQASM 2.0;\n\nqreg orig[200];\n";
+    for (auto i = 0; i < 200; i++) {
+        if (i % 20 != 19)
+            pre << "CX orig[" << i << "],orig[" << i + 1 << "];\n";
+        if (i + 20 < 200)
+            pre << "CX orig[" << i << "],orig[" << i + 20 << "];\n";
+    }
+
+    auto program = parser::parse_string(pre.str(), "layout_subgraph.qasm");
+    mapping::SubgraphLayout gen(device);
+    auto layout = gen.generate(*program);
+    EXPECT_TRUE(gen.embedded());
+    EXPECT_EQ(layout.size(), 200u);
+
+    mapping::apply_layout(layout, device, *program);
+    EXPECT_TRUE(all_coupled(device, *program));
+}
+/******************************************************************************/
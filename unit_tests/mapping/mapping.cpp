@@ -28,6 +28,8 @@
 
 #include "mapping/mapping/swap.hpp"
 #include "mapping/mapping/steiner.hpp"
+#include "mapping/mapping/lookahead.hpp"
+#include "mapping/mapping/parallel.hpp"
 
 using namespace staq;
 
@@ -215,3 +217,171 @@ TEST(Steiner_Mapper, Swap_No_Z) {
     EXPECT_EQ(ss.str(), post);
 }
 /******************************************************************************/
+
+// Linear reversible function of a CNOT-only program on 9 qubits
+static std::vector<std::vector<bool>> cnot_function(ast::Program& prog,
+                                                    bool mapped) {
+    std::vector<std::vector<bool>> mat(9, std::vector<bool>(9, false));
+    for (auto i = 0; i < 9; i++)
+        mat[i][i] = true;
+    for (auto& stmt : prog.body()) {
+        if (auto cx = dynamic_cast<ast::CNOTGate*>(stmt.get())) {
+            auto ctrl = *cx->ctrl().offset();
+            auto tgt = *cx->tgt().offset();
+            if (mapped) {
+                EXPECT_TRUE(test_device.coupled(ctrl, tgt));
+            }
+            for (auto j = 0; j < 9; j++)
+                mat[tgt][j] = mat[tgt][j] ^ mat[ctrl][j];
+        }
+    }
+    return mat;
+}
+
+/******************************************************************************/
+TEST(Lookahead_Mapper, Adjacent) {
+    std::string pre = "OPENQASM 2.0;\n"
+                      "\n"
+                      "qreg q[9];\n"
+                      "CX q[0],q[1];\n"
+                      "CX q[4],q[7];\n";
+
+    std::string post = "OPENQASM 2.0;\n"
+                       "\n"
+                       "qreg q[9];\n"
+                       "CX q[0],q[1];\n"
+                       "CX q[4],q[7];\n";
+
+    auto program = parser::parse_string(pre, "lookahead_adjacent.qasm");
+    mapping::lookahead_mapping(test_device, *program);
+    std::stringstream ss;
+    ss << *program;
+
+    EXPECT_EQ(ss.str(), post);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Lookahead_Mapper, Equivalence) {
+    std::string pre = "OPENQASM 2.0;\n"
+                      "\n"
+                      "qreg q[9];\n"
+                      "creg c[9];\n";
+    for (auto i = 0; i < 40; i++) {
+        auto ctrl = (7 * i + 3) % 9;
+        auto tgt = (5 * i + 1) % 9;
+        if (ctrl != tgt)
+            pre += "CX q[" + std::to_string(ctrl) + "],q[" +
+                   std::to_string(tgt) + "];\n";
+    }
+
+    auto program = parser::parse_string(pre, "lookahead_equivalence.qasm");
+    auto expected = cnot_function(*program, false);
+
+    mapping::LookaheadMapper mapper(test_device);
+    mapper.run(*program);
+    auto actual = cnot_function(*program, true);
+
+    auto& init = mapper.initial_layout();
+    auto& fin = mapper.final_layout();
+    for (auto i = 0; i < 9; i++) {
+        for (auto j = 0; j < 9; j++)
+            EXPECT_EQ(actual[fin[i]][init[j]], expected[i][j]);
+    }
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Lookahead_Mapper, Classical_Order) {
+    std::string pre = "OPENQASM 2.0;\n"
+                      "\n"
+                      "qreg q[9];\n"
+                      "creg c[1];\n"
+                      "measure q[0] -> c[0];\n"
+                      "if(c==1) CX q[0],q[2];\n"
+                      "measure q[2] -> c[0];\n";
+
+    auto program = parser::parse_string(pre, "lookahead_classical.qasm");
+    mapping::LookaheadMapper mapper(test_device);
+    mapper.run(*program);
+
+    std::vector<ast::NodeKind> kinds;
+    for (auto& stmt : program->body()) {
+        if (stmt->kind() != ast::NodeKind::CNOTGate)
+            kinds.push_back(stmt->kind());
+    }
+    EXPECT_EQ(kinds, std::vector<ast::NodeKind>(
+                         {ast::NodeKind::RegisterDecl,
+                          ast::NodeKind::RegisterDecl,
+                          ast::NodeKind::MeasureStmt, ast::NodeKind::IfStmt,
+                          ast::NodeKind::MeasureStmt}));
+}
+/******************************************************************************/
+
+// A pseudo-random program of CNOTs, with Hadamard & T gates if requested
+static std::string random_program(int length, bool clifford_t) {
+    std::string ret = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "\n"
+                      "qreg q[9];\n";
+    for (auto i = 0; i < length; i++) {
+        auto a = (7 * i + 3) % 9;
+        auto b = (5 * i * i + 1) % 9;
+        if (clifford_t && i % 5 == 0)
+            ret += "h q[" + std::to_string(a) + "];\n";
+        else if (clifford_t && i % 3 == 0)
+            ret += "t q[" + std::to_string(a) + "];\n";
+        else if (a != b)
+            ret += "CX q[" + std::to_string(a) + "],q[" + std::to_string(b) +
+                   "];\n";
+    }
+    return ret;
+}
+
+/******************************************************************************/
+TEST(Parallel_Mapper, Steiner) {
+    auto pre = random_program(400, true);
+
+    auto serial = parser::parse_string(pre, "parallel_steiner.qasm");
+    mapping::steiner_mapping(test_device, *serial);
+    std::stringstream expected;
+    expected << *serial;
+
+    auto parallel = parser::parse_string(pre, "parallel_steiner.qasm");
+    mapping::ParallelMapper::config params;
+    params.num_threads = 4;
+    params.min_block_size = 16;
+    mapping::parallel_mapping(test_device, *parallel, params);
+    std::stringstream actual;
+    actual << *parallel;
+
+    EXPECT_EQ(actual.str(), expected.str());
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Parallel_Mapper, Restore) {
+    for (auto alg : {mapping::mapping_algorithm::swap,
+                     mapping::mapping_algorithm::lookahead}) {
+        auto program =
+            parser::parse_string(random_program(200, false), "parallel.qasm");
+        auto expected = cnot_function(*program, false);
+
+        mapping::ParallelMapper::config params;
+        params.algorithm = alg;
+        params.num_threads = 4;
+        params.min_block_size = 16;
+        mapping::ParallelMapper mapper(test_device, params);
+        mapper.run(*program);
+        auto actual = cnot_function(*program, true);
+        EXPECT_GT(mapper.num_restoring_swaps(), 0u);
+
+        auto& init = mapper.initial_layout();
+        auto& fin = mapper.final_layout();
+        for (auto i = 0; i < 9; i++) {
+            for (auto j = 0; j < 9; j++)
+                EXPECT_EQ(actual[fin[i]][init[j]], expected[i][j]);
+        }
+    }
+}
+/******************************************************************************/
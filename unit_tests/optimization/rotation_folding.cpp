@@ -228,3 +228,98 @@ TEST(Rotation_folding, Global_Phase) {
     EXPECT_EQ(ss.str(), post);
 }
 /******************************************************************************/
+
+/******************************************************************************/
+TEST(Rotation_folding, Parallel_Blocks) {
+    std::string pre = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "\n"
+                      "gate foo a {\n"
+                      "\tt a;\n"
+                      "\tt a;\n"
+                      "}\n"
+                      "qreg q[2];\n"
+                      "t q[0];\n"
+                      "t q[1];\n"
+                      "t q[0];\n"
+                      "tdg q[1];\n";
+
+    std::string post = "OPENQASM 2.0;\n"
+                       "include \"qelib1.inc\";\n"
+                       "\n"
+                       "gate foo a {\n"
+                       "\ts a;\n"
+                       "}\n"
+                       "qreg q[2];\n"
+                       "s q[0];\n";
+
+    auto program = parser::parse_string(pre, "parallel_blocks.qasm");
+    optimization::fold_rotations(*program, {true, 4});
+    std::stringstream ss;
+    ss << *program;
+
+    EXPECT_EQ(ss.str(), post);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Rotation_folding, Window) {
+    std::string pre = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "\n"
+                      "qreg q[2];\n"
+                      "t q[0];\n"
+                      "t q[1];\n"
+                      "t q[0];\n";
+
+    std::string post = "OPENQASM 2.0;\n"
+                       "include \"qelib1.inc\";\n"
+                       "\n"
+                       "qreg q[2];\n"
+                       "t q[1];\n"
+                       "s q[0];\n";
+
+    auto program = parser::parse_string(pre, "window.qasm");
+    optimization::fold_rotations(*program, {true, 1, 2});
+    std::stringstream ss;
+    ss << *program;
+
+    EXPECT_EQ(ss.str(), post);
+
+    // A window of one rotation cannot see past t q[1]
+    auto unchanged = parser::parse_string(pre, "window.qasm");
+    optimization::fold_rotations(*unchanged, {true, 1, 1});
+    std::stringstream ss2;
+    ss2 << *unchanged;
+
+    EXPECT_EQ(ss2.str(), pre);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Rotation_folding, Window_Operators) {
+    std::string pre = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "\n"
+                      "qreg q[2];\n"
+                      "t q[0];\n";
+    for (auto i = 0; i < 20; i++)
+        pre += "U(0.1,0.2,0.3) q[1];\n";
+    pre += "t q[0];\n";
+
+    // The uninterpreted gates commute with t q[0], but fill the window
+    auto unchanged = parser::parse_string(pre, "window_operators.qasm");
+    optimization::fold_rotations(*unchanged, {true, 1, 2});
+    std::stringstream ss;
+    ss << *unchanged;
+    EXPECT_NE(ss.str().find("t q[0];\nU"), std::string::npos);
+    EXPECT_EQ(ss.str().find("s q[0]"), std::string::npos);
+
+    // Without a window, the rotations merge
+    auto folded = parser::parse_string(pre, "window_operators.qasm");
+    optimization::fold_rotations(*folded);
+    std::stringstream ss2;
+    ss2 << *folded;
+    EXPECT_NE(ss2.str().find("s q[0]"), std::string::npos);
+}
+/******************************************************************************/
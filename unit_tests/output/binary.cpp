@@ -0,0 +1,118 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gtest/gtest.h"
+#include "parser/parser.hpp"
+#include "output/binary.hpp"
+
+#include <sstream>
+
+using namespace staq;
+
+// Testing the binary circuit format
+
+/******************************************************************************/
+TEST(Binary_Format, Round_Trip) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "qreg q[2];\n"
+                      "creg c[2];\n"
+                      "opaque a(x) q;\n"
+                      "gate b(x,y) p,q {\n"
+                      "  U(-(x+y)*pi/2,sin(x^2),-0.000000123456789) p;\n"
+                      "  CX p,q;\n"
+                      "  ancilla a[1];\n"
+                      "  dirty ancilla b[1];\n"
+                      "}\n"
+                      "oracle d q { \"dummy.v\" }\n"
+                      "U(0,0.1234567,-300) q[0];\n"
+                      "CX q[0],q[1];\n"
+                      "b(1,2.5) q[0],q[1];\n"
+                      "cx q[1],q[0];\n"
+                      "barrier q,c[0];\n"
+                      "reset q;\n"
+                      "measure q -> c;\n"
+                      "if(c==1) a(ln(2)) q[0];\n";
+    auto prog = parser::parse_string(src, "binary.qasm");
+
+    std::stringstream bin;
+    output::BinaryOutputter outputter(bin);
+    outputter.run(*prog);
+
+    auto read = parser::parse_binary(bin);
+    std::stringstream expected, actual;
+    expected << *prog;
+    actual << *read;
+    EXPECT_EQ(actual.str(), expected.str());
+    EXPECT_EQ(read->body().size(), prog->body().size());
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Binary_Format, Malformed) {
+    auto prog = parser::parse_string("OPENQASM 2.0;\n"
+                                     "include \"qelib1.inc\";\n"
+                                     "qreg q[2];\n"
+                                     "cx q[0],q[1];\n",
+                                     "binary.qasm");
+    std::stringstream bin;
+    output::BinaryOutputter outputter(bin);
+    outputter.run(*prog);
+    auto data = bin.str();
+
+    for (auto size : {data.size() - 1, data.size() / 2, std::size_t(5)}) {
+        std::stringstream truncated(data.substr(0, size));
+        EXPECT_THROW(parser::parse_binary(truncated), parser::ParseError);
+    }
+
+    auto bad_version = data;
+    bad_version[4] = 2;
+    std::stringstream is(bad_version);
+    EXPECT_THROW(parser::parse_binary(is), parser::ParseError);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Binary_Format, Semantic_Check) {
+    // A gate on an undeclared register
+    parser::Position pos;
+    std::list<ast::ptr<ast::Stmt>> body;
+    body.emplace_back(ast::CNOTGate::create(pos, ast::VarAccess(pos, "q", 0),
+                                            ast::VarAccess(pos, "q", 1)));
+    auto prog = ast::Program::create(pos, false, std::move(body));
+
+    std::stringstream bin;
+    output::BinaryOutputter outputter(bin);
+    outputter.run(*prog);
+    auto data = bin.str();
+
+    std::stringstream checked(data);
+    testing::internal::CaptureStderr();
+    EXPECT_THROW(parser::parse_binary(checked), ast::SemanticError);
+    testing::internal::GetCapturedStderr();
+
+    std::stringstream unchecked(data);
+    EXPECT_NO_THROW(parser::parse_binary(unchecked, "", false));
+}
+/******************************************************************************/
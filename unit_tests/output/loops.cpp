@@ -0,0 +1,113 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gtest/gtest.h"
+#include "parser/parser.hpp"
+#include "output/projectq.hpp"
+
+#include <sstream>
+
+using namespace staq;
+
+// Testing loop detection for the source-code outputters
+
+static std::vector<ast::Stmt*> body(ast::Program& prog) {
+    std::vector<ast::Stmt*> ret;
+    prog.foreach_stmt([&ret](auto& stmt) {
+        if (typeid(stmt) != typeid(ast::GateDecl))
+            ret.push_back(&stmt);
+    });
+    return ret;
+}
+
+/******************************************************************************/
+TEST(Loops, Broadcast) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "qreg q[4];\n"
+                      "qreg r[5];\n"
+                      "h q[0];\n"
+                      "h q[1];\n"
+                      "h q[2];\n"
+                      "h q[3];\n"
+                      "cx q[3],r[0];\n"
+                      "cx q[2],r[2];\n"
+                      "cx q[1],r[4];\n";
+
+    auto prog = parser::parse_string(src, "broadcast.qasm");
+    auto loops = output::find_loops(body(*prog));
+
+    ASSERT_EQ(loops.size(), 4);
+    EXPECT_EQ(loops[0].count, 1);
+    EXPECT_EQ(loops[1].count, 1);
+    EXPECT_EQ(loops[2].count, 4);
+    EXPECT_EQ(loops[2].body.size(), 1);
+    EXPECT_EQ(loops[3].count, 3);
+
+    std::stringstream ss;
+    output::ProjectQOutputter::config params;
+    params.loops = true;
+    output::ProjectQOutputter(ss, params).run(*prog);
+    EXPECT_NE(ss.str().find("    for i in range(4):\n"
+                            "        ops.HGate() | (q[i])\n"
+                            "    for i in range(3):\n"
+                            "        CNOTGate() | (q[-i + 3], r[2*i])\n"),
+              std::string::npos);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Loops, Repeated_Block) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "qreg q[3];\n"
+                      "qreg c[3];\n"
+                      "cx q[0],c[0];\n"
+                      "rz(0.5) c[0];\n"
+                      "cx q[1],c[1];\n"
+                      "rz(0.5) c[1];\n"
+                      "cx q[2],c[2];\n"
+                      "rz(0.25) c[2];\n";
+
+    auto prog = parser::parse_string(src, "repeated_block.qasm");
+    auto loops = output::find_loops(body(*prog));
+
+    ASSERT_EQ(loops.size(), 5);
+    EXPECT_EQ(loops[2].count, 2);
+    EXPECT_EQ(loops[2].body.size(), 2);
+    EXPECT_EQ(loops[3].count, 1);
+    EXPECT_EQ(loops[4].count, 1);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Loops, Fresh_Variable) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "qreg i[3];\n"
+                      "qreg i_[3];\n";
+
+    auto prog = parser::parse_string(src, "fresh_variable.qasm");
+    EXPECT_EQ(output::loop_variable(*prog), "i__");
+}
+/******************************************************************************/
@@ -0,0 +1,81 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gtest/gtest.h"
+#include "parser/parser.hpp"
+#include "output/qasm.hpp"
+
+#include <sstream>
+
+using namespace staq;
+
+// Testing the buffered QASM outputter against pretty printing
+
+static std::string src = "OPENQASM 2.0;\n"
+                         "include \"qelib1.inc\";\n"
+                         "qreg q[2];\n"
+                         "creg c[2];\n"
+                         "opaque a(x) q;\n"
+                         "gate b(x,y) p,q {\n"
+                         "  U(-(x+y)*pi/2,sin(x^2),-0.000000123456789) p;\n"
+                         "  CX p,q;\n"
+                         "  ancilla a[1];\n"
+                         "  dirty ancilla b[1];\n"
+                         "}\n"
+                         "oracle d q { \"dummy.v\" }\n"
+                         "U(0,0.1234567,3) q[0];\n"
+                         "CX q[0],q[1];\n"
+                         "b(1,2.5) q[0],q[1];\n"
+                         "cx q[1],q[0];\n"
+                         "barrier q,c[0];\n"
+                         "reset q;\n"
+                         "measure q -> c;\n"
+                         "if(c==1) a(ln(2)) q[0];\n";
+
+/******************************************************************************/
+TEST(QASM_Output, Same_As_Pretty_Print) {
+    auto prog = parser::parse_string(src, "qasm_output.qasm");
+    std::stringstream expected, actual;
+    expected << *prog;
+
+    output::QASMOutputter outputter(actual);
+    outputter.run(*prog);
+    EXPECT_EQ(actual.str(), expected.str());
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(QASM_Output, Parallel) {
+    auto prog = parser::parse_string(src, "qasm_output.qasm");
+    std::stringstream expected;
+    expected << *prog;
+
+    for (std::size_t block_size : {1, 2, 3, 100}) {
+        std::stringstream actual;
+        output::QASMOutputter outputter(actual, {3, block_size, 1});
+        outputter.run(*prog);
+        EXPECT_EQ(actual.str(), expected.str());
+    }
+}
+/******************************************************************************/
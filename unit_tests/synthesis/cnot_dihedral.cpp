@@ -24,10 +24,13 @@
 
 #include "gtest/gtest.h"
 #include "mapping/device.hpp"
-#include "synthesis/cnot_dihedral.hpp"
+#include "synthesis/cnot_dihedral_cache.hpp"
 #include "utils/templates.hpp"
 #include "ast/expr.hpp"
 
+#include <algorithm>
+#include <random>
+
 using namespace staq;
 using namespace utils;
 using namespace ast;
@@ -279,3 +282,97 @@ TEST(Gray_Steiner, Fill_flush) {
     EXPECT_TRUE(eq(synthesis::gray_steiner(f, mat, test_device), output));
 }
 /******************************************************************************/
+
+/******************************************************************************/
+TEST(Gray_Steiner, Count) {
+    std::mt19937 gen(7);
+    std::bernoulli_distribution coin(0.3);
+    auto n = mapping::tokyo.qubits();
+
+    for (auto trial = 0; trial < 5; trial++) {
+        std::list<synthesis::phase_term> f1, f2;
+        for (auto i = 0; i < 10; i++) {
+            std::vector<bool> vec(n);
+            for (auto j = 0; j < n; j++)
+                vec[j] = coin(gen);
+            f1.emplace_back(phase(vec, angles::pi_quarter));
+            f2.emplace_back(phase(vec, angles::pi_quarter));
+        }
+
+        synthesis::linear_op<bool> mat(n, std::vector<bool>(n));
+        for (auto i = 0; i < n; i++)
+            mat[i][i] = true;
+        for (auto i = 0; i < 3 * n; i++) {
+            auto ctrl = gen() % n, tgt = gen() % n;
+            if (ctrl != tgt)
+                synthesis::operator^=(mat[tgt], mat[ctrl]);
+        }
+
+        int cnots = 0;
+        for (auto& gate : synthesis::gray_steiner(f1, mat, mapping::tokyo)) {
+            if (std::holds_alternative<std::pair<int, int>>(gate))
+                cnots++;
+        }
+        EXPECT_EQ(synthesis::gray_steiner_count(f2, mat, mapping::tokyo),
+                  cnots);
+    }
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Cnot_Dihedral_Cache, Agrees_With_Synthesis) {
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> numerator(1, 7);
+    auto n = mapping::tokyo.qubits();
+    synthesis::cnot_dihedral_cache cache;
+
+    for (auto trial = 0; trial < 10; trial++) {
+        // Only the first few trials are distinct, the rest should hit
+        std::vector<int> parities{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13};
+        std::shuffle(parities.begin(), parities.end(),
+                     std::mt19937(trial % 3));
+        std::list<synthesis::phase_term> f1, f2, f3, f4, f5, f6;
+        for (auto i = 0; i < 6; i++) {
+            std::vector<bool> vec(n);
+            for (auto j = 0; j < 4; j++)
+                vec[trial + 3 * j] = (parities[i] >> j) & 1;
+            Angle theta(numerator(gen), 8);
+            f1.emplace_back(phase(vec, theta));
+            f2.emplace_back(phase(vec, theta));
+            f3.emplace_back(phase(vec, theta));
+            f4.emplace_back(phase(vec, theta));
+            f5.emplace_back(phase(vec, theta));
+            f6.emplace_back(phase(vec, theta));
+        }
+
+        synthesis::linear_op<bool> mat(n, std::vector<bool>(n));
+        for (auto i = 0; i < n; i++)
+            mat[i][i] = true;
+        synthesis::operator^=(mat[trial + 3], mat[trial]);
+
+        EXPECT_TRUE(
+            eq(cache.gray_synth(f1, mat), synthesis::gray_synth(f2, mat)));
+        EXPECT_TRUE(eq(cache.gray_steiner(f3, mat, mapping::tokyo),
+                       synthesis::gray_steiner(f4, mat, mapping::tokyo)));
+
+        // Replayed CNOTs respect the coupling graph
+        int cnots = 0;
+        cache.gray_steiner(
+            f5, mat, mapping::tokyo,
+            [&cnots](int ctrl, int tgt) {
+                EXPECT_TRUE(mapping::tokyo.coupled(ctrl, tgt) ||
+                            mapping::tokyo.coupled(tgt, ctrl));
+                cnots++;
+            },
+            [](int, int) {});
+        EXPECT_TRUE(f5.empty());
+        EXPECT_EQ(cnots,
+                  synthesis::gray_steiner_count(f6, mat, mapping::tokyo));
+    }
+
+    // Gray-synth circuits are relabeled, gray-steiner circuits are not
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.misses, 3 + 10);
+    EXPECT_EQ(stats.hits, 7 + 10);
+}
+/******************************************************************************/
@@ -26,6 +26,8 @@
 #include "mapping/device.hpp"
 #include "synthesis/linear_reversible.hpp"
 
+#include <random>
+
 using namespace staq;
 using circuit = std::list<std::pair<int, int>>;
 
@@ -54,6 +56,29 @@ static mapping::Device test_device("Test device", 9,
                                        {0, 0, 0, 0.1, 0, 0, 0, 0.11, 0},
                                    });
 
+// Applies a cnot circuit to the identity
+static synthesis::linear_op<bool> simulate(int n, const circuit& circ) {
+    synthesis::linear_op<bool> mat(n, std::vector<bool>(n, false));
+    for (int i = 0; i < n; i++)
+        mat[i][i] = true;
+    for (auto& [ctrl, tgt] : circ)
+        synthesis::operator^=(mat[tgt], mat[ctrl]);
+    return mat;
+}
+
+// Random invertible operator from a random cnot circuit
+static synthesis::linear_op<bool> random_op(int n, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> dist(0, n - 1);
+    circuit circ;
+    for (int i = 0; i < n * n; i++) {
+        int ctrl = dist(gen), tgt = dist(gen);
+        if (ctrl != tgt)
+            circ.emplace_back(ctrl, tgt);
+    }
+    return simulate(n, circ);
+}
+
 // Testing linear reversible (cnot) synthesis
 
 /******************************************************************************/
@@ -97,6 +122,56 @@ TEST(Gaussian_Synthesis, 3_Qubit) {
 }
 /******************************************************************************/
 
+/******************************************************************************/
+TEST(PMH_Synthesis, Base) {
+    synthesis::linear_op<bool> mat{
+        {1, 0},
+        {1, 1},
+    };
+    EXPECT_EQ(synthesis::pmh(mat), circuit({{0, 1}}));
+    EXPECT_EQ(simulate(2, synthesis::pmh(mat)), mat);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(PMH_Synthesis, Swap) {
+    synthesis::linear_op<bool> mat{
+        {0, 1},
+        {1, 0},
+    };
+    EXPECT_EQ(simulate(2, synthesis::pmh(mat)), mat);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(PMH_Synthesis, Agrees_With_Gauss_Jordan) {
+    for (int n : {3, 8, 17, 64, 65, 130}) {
+        auto mat = random_op(n, n);
+        auto gj = synthesis::gauss_jordan(mat);
+        EXPECT_EQ(simulate(n, gj), mat);
+        for (int section_size : {0, 1, 3, 8}) {
+            auto circ = synthesis::pmh(mat, section_size);
+            EXPECT_EQ(simulate(n, circ), mat);
+        }
+        if (n >= 64) {
+            EXPECT_LT(synthesis::pmh(mat).size(), gj.size());
+        }
+    }
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(PMH_Synthesis, Selectable) {
+    auto mat = random_op(20, 1);
+    EXPECT_EQ(
+        synthesis::synthesize_linear(mat, synthesis::linear_synth::pmh, 2),
+        synthesis::pmh(mat, 2));
+    EXPECT_EQ(synthesis::synthesize_linear(
+                  mat, synthesis::linear_synth::gauss_jordan),
+              synthesis::gauss_jordan(mat));
+}
+/******************************************************************************/
+
 /******************************************************************************/
 TEST(Steiner_Gauss, Base) {
     synthesis::linear_op<bool> mat{
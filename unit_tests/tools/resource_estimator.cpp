@@ -0,0 +1,100 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "gtest/gtest.h"
+#include "parser/parser.hpp"
+#include "transformations/inline.hpp"
+#include "tools/resource_estimator.hpp"
+
+using namespace staq;
+
+// Testing hierarchical resource estimation
+
+/******************************************************************************/
+TEST(Resource_Estimator, Same_As_Inlined) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "gate foo(a) x,y { rz(a) x; cx x,y; h y; }\n"
+                      "gate bar x,y,z { foo(pi/2) x,y; foo(pi/4) y,z; t x; }\n"
+                      "qreg q[4];\n"
+                      "qreg r[4];\n"
+                      "creg c[4];\n"
+                      "bar q[0],q[1],q[2];\n"
+                      "h q;\n"
+                      "bar q[1],r[0],r[1];\n"
+                      "cx q,r;\n"
+                      "foo(0.5) q,r;\n"
+                      "measure r -> c;\n";
+
+    auto prog = parser::parse_string(src, "same_as_inlined.qasm");
+    auto hierarchical = tools::estimate_resources(*prog);
+    transformations::inline_ast(*prog);
+    auto inlined = tools::estimate_resources(*prog);
+
+    EXPECT_EQ(hierarchical, inlined);
+    EXPECT_EQ(hierarchical["rz(0.5)"], 4);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Resource_Estimator, Exact_Depth) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "gate g a,b,c { cx a,b; cx a,b; x c; }\n"
+                      "qreg q[3];\n"
+                      "g q[0],q[1],q[2];\n"
+                      "x q[2];\n"
+                      "x q[2];\n";
+
+    auto prog = parser::parse_string(src, "exact_depth.qasm");
+    auto count = tools::estimate_resources(*prog);
+
+    EXPECT_EQ(count["depth"], 3);
+    EXPECT_EQ(count["cx"], 2);
+    EXPECT_EQ(count["x"], 3);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Resource_Estimator, Local_Ancillas) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "gate g a { ancilla t[1]; cx a,t[0]; cx a,t[0]; "
+                      "h t[0]; }\n"
+                      "qreg q[2];\n"
+                      "g q;\n";
+
+    auto prog = parser::parse_string(src, "local_ancillas.qasm");
+    auto count = tools::estimate_resources(*prog);
+
+    EXPECT_EQ(count["depth"], 3);
+    EXPECT_EQ(count["ancillas"], 2);
+    EXPECT_EQ(count["cx"], 4);
+
+    // The inliner shares one ancilla between both applications
+    transformations::inline_ast(*prog);
+    EXPECT_GT(tools::estimate_resources(*prog)["depth"], count["depth"]);
+}
+/******************************************************************************/
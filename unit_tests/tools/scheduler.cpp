@@ -0,0 +1,172 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "gtest/gtest.h"
+#include "parser/parser.hpp"
+#include "mapping/device_file.hpp"
+#include "tools/scheduler.hpp"
+#include "transformations/inline.hpp"
+
+using namespace staq;
+
+// Testing ASAP/ALAP scheduling
+
+static std::string src = "OPENQASM 2.0;\n"
+                         "include \"qelib1.inc\";\n"
+                         "qreg q[3];\n"
+                         "creg c[3];\n"
+                         "t q[0];\n"
+                         "cx q[0],q[1];\n"
+                         "t q[1];\n"
+                         "h q[2];\n"
+                         "cx q[1],q[2];\n"
+                         "measure q -> c;\n";
+
+/******************************************************************************/
+TEST(Scheduler, Unit_Durations) {
+    auto prog = parser::parse_string(src, "unit_durations.qasm");
+    auto report = tools::schedule(*prog);
+
+    EXPECT_EQ(report.latency, 5);
+    EXPECT_EQ(report.t_depth, 2);
+    EXPECT_EQ(report.cnot_depth, 2);
+
+    ASSERT_EQ(report.critical_path.size(), 5);
+    EXPECT_EQ(report.critical_path[0].text, "t q[0]");
+    EXPECT_EQ(report.critical_path[4].text, "measure q[1],c[1]");
+
+    // q[2] is free for two steps after the hadamard, unless scheduled late
+    auto& q2 = report.wires[2];
+    ASSERT_EQ(q2.name, "q[2]");
+    EXPECT_EQ(q2.busy, 3);
+    EXPECT_EQ(q2.idle_asap, 2);
+    EXPECT_EQ(q2.idle_alap, 0);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Scheduler, Gate_Durations) {
+    auto prog = parser::parse_string(src, "gate_durations.qasm");
+    tools::Scheduler::config params;
+    params.durations["cx"] = 10;
+    params.durations["measure"] = 100;
+    auto report = tools::schedule(*prog, params);
+
+    EXPECT_EQ(report.latency, 1 + 10 + 1 + 10 + 100);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Scheduler, Device_Durations) {
+    auto dev = mapping::parse_device("qubits 3\n"
+                                     "qubit 0 0.99 2\n"
+                                     "edge 0 1 0.99 20\n"
+                                     "edge 1 2 0.99 30\n",
+                                     "device_durations");
+    ASSERT_TRUE(dev);
+
+    auto prog = parser::parse_string(src, "device_durations.qasm");
+    tools::Scheduler::config params;
+    params.device = &*dev;
+    auto report = tools::schedule(*prog, params);
+
+    // Unspecified durations fall back to the default
+    EXPECT_EQ(report.latency, 2 + 20 + 1 + 30 + 1);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Scheduler, Declared_Gate_Depths) {
+    std::string decls = "OPENQASM 2.0;\n"
+                        "include \"qelib1.inc\";\n"
+                        "gate tt a,b { t a; cx a,b; t b; }\n"
+                        "qreg q[3];\n";
+    std::string body = "ccx q[0],q[1],q[2];\n"
+                       "tt q[2],q[0];\n"
+                       "tt q[1],q[2];\n";
+
+    auto prog = parser::parse_string(decls + body, "declared.qasm");
+    tools::Scheduler::config params;
+    params.overrides = {"t", "tdg", "cx"};
+    auto report = tools::schedule(*prog, params);
+
+    // The same schedule as the inlined program
+    auto inlined = parser::parse_string(decls + body, "declared.qasm");
+    transformations::inline_ast(*inlined, {false, {"t", "tdg", "cx"}, "anc"});
+    auto expected = tools::schedule(*inlined);
+    EXPECT_EQ(report.latency, expected.latency);
+    EXPECT_EQ(report.t_depth, expected.t_depth);
+    EXPECT_EQ(report.cnot_depth, expected.cnot_depth);
+    EXPECT_EQ(report.t_depth, 6);
+    EXPECT_EQ(report.wires.size(), 3);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Scheduler, Depth_Bounds) {
+    std::string decls = "OPENQASM 2.0;\n"
+                        "include \"qelib1.inc\";\n"
+                        "gate maj a,b,c { cx c,b; cx c,a; ccx a,b,c; }\n"
+                        "gate tt a,b { ancilla x[1]; t a; cx a,x[0]; t x[0]; "
+                        "cx x[0],b; t b; }\n"
+                        "qreg q[3];\n";
+    std::string body = "maj q[0],q[1],q[2];\n"
+                        "tt q[2],q[0];\n"
+                        "t q[1];\n"
+                        "tt q[1],q[2];\n"
+                        "maj q[2],q[0],q[1];\n";
+
+    // Depths are counted at the same granularity as the estimated depth
+    auto prog = parser::parse_string(decls + body, "depth_bounds.qasm");
+    auto count = tools::estimate_resources(*prog);
+    auto report = tools::schedule(*prog);
+    EXPECT_EQ(report.latency, count["depth"]);
+    EXPECT_GE(count["depth"], report.t_depth);
+    EXPECT_GE(count["depth"], report.cnot_depth);
+    EXPECT_EQ(report.t_depth, 4);
+    EXPECT_EQ(report.cnot_depth, 6);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Scheduler, Register_Barrier) {
+    std::string barrier = "OPENQASM 2.0;\n"
+                          "include \"qelib1.inc\";\n"
+                          "qreg q[3];\n"
+                          "t q[0];\n"
+                          "t q[0];\n"
+                          "barrier q;\n"
+                          "t q[2];\n";
+
+    auto prog = parser::parse_string(barrier, "register_barrier.qasm");
+    auto report = tools::schedule(*prog);
+
+    // q[2] waits for q[0] at the barrier
+    EXPECT_EQ(report.latency, 3);
+    EXPECT_EQ(report.t_depth, 3);
+    ASSERT_EQ(report.critical_path.size(), 4);
+    EXPECT_EQ(report.critical_path[2].text, "barrier q[0],q[1],q[2]");
+}
+/******************************************************************************/
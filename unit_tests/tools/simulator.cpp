@@ -0,0 +1,143 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gtest/gtest.h"
+#include "parser/parser.hpp"
+#include "optimization/rotation_folding.hpp"
+#include "optimization/simplify.hpp"
+#include "tools/verifier.hpp"
+
+#include <random>
+
+using namespace staq;
+
+// Testing state vector simulation & equivalence checking
+
+/******************************************************************************/
+TEST(Simulator, Bell_State) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "qreg q[2];\n"
+                      "creg c[2];\n"
+                      "h q[0];\n"
+                      "cx q[0],q[1];\n"
+                      "measure q -> c;\n";
+
+    auto prog = parser::parse_string(src, "bell_state.qasm");
+    auto state = tools::simulate(*prog);
+
+    ASSERT_EQ(state.size(), 4);
+    EXPECT_NEAR(state[0].real(), 1 / std::sqrt(2.0), 1e-12);
+    EXPECT_NEAR(std::abs(state[1]), 0, 1e-12);
+    EXPECT_NEAR(std::abs(state[2]), 0, 1e-12);
+    EXPECT_NEAR(state[3].real(), 1 / std::sqrt(2.0), 1e-12);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Simulator, Blocked) {
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> qubit(0, 13);
+    std::uniform_real_distribution<double> angle(0, 6.28);
+
+    std::vector<tools::sim_gate> gates;
+    for (auto i = 0; i < 200; i++) {
+        auto t = qubit(gen);
+        auto c = qubit(gen);
+        auto m = tools::amplitude(std::cos(angle(gen)), std::sin(angle(gen)));
+        tools::sim_gate gate{t, {}, {m, 0.5, -0.5, std::conj(m)}};
+        if (i % 4 == 1)
+            gate.matrix = {0, 1, 1, 0};
+        else if (i % 4 == 2)
+            gate.matrix = {1, 0, 0, m};
+        if (c != t && i % 3 == 0)
+            gate.controls.push_back(c);
+        gates.push_back(gate);
+    }
+
+    tools::StateVector blocked(14, {2, 3});
+    tools::StateVector whole(14, {1, 14});
+    blocked.run(gates);
+    whole.run(gates);
+
+    for (std::size_t i = 0; i < whole.size(); i++)
+        EXPECT_NEAR(std::abs(blocked[i] - whole[i]), 0, 1e-9);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Simulator, Equivalence) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "qreg q[3];\n"
+                      "h q[0];\n"
+                      "t q[1];\n"
+                      "cx q[0],q[1];\n"
+                      "t q[1];\n"
+                      "ccx q[0],q[1],q[2];\n"
+                      "cx q[0],q[1];\n"
+                      "tdg q[1];\n"
+                      "h q[0];\n"
+                      "swap q[1],q[2];\n";
+
+    auto prog = parser::parse_string(src, "equivalence.qasm");
+    auto optimized = parser::parse_string(src, "equivalence.qasm");
+    optimization::fold_rotations(*optimized);
+    optimization::simplify(*optimized);
+    EXPECT_TRUE(tools::check_equivalence(*prog, *optimized).equivalent);
+
+    auto modified = parser::parse_string(src + "t q[2];\n", "modified.qasm");
+    auto result = tools::check_equivalence(*prog, *modified);
+    EXPECT_FALSE(result.equivalent);
+    EXPECT_LT(result.fidelity, 0.99);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Simulator, Relocated_Qubits) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "qreg q[2];\n"
+                      "h q[0];\n"
+                      "cx q[0],q[1];\n"
+                      "swap q[0],q[1];\n";
+    std::string moved = "OPENQASM 2.0;\n"
+                        "include \"qelib1.inc\";\n"
+                        "qreg r[3];\n"
+                        "h r[2];\n"
+                        "cx r[2],r[0];\n";
+
+    auto prog = parser::parse_string(src, "relocated.qasm");
+    auto compiled = parser::parse_string(moved, "moved.qasm");
+
+    parser::Position pos;
+    tools::qubit_correspondence qubits;
+    ast::VarAccess q0(pos, "q", 0), q1(pos, "q", 1);
+    ast::VarAccess r0(pos, "r", 0), r2(pos, "r", 2);
+    qubits.insert_or_assign(q0, tools::qubit_location{r2, r0});
+    qubits.insert_or_assign(q1, tools::qubit_location{r0, r2});
+    EXPECT_TRUE(tools::check_equivalence(*prog, *compiled, qubits).equivalent);
+    EXPECT_FALSE(tools::check_equivalence(*prog, *compiled).equivalent);
+}
+/******************************************************************************/
@@ -0,0 +1,145 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gtest/gtest.h"
+#include "parser/parser.hpp"
+#include "optimization/simplify.hpp"
+#include "tools/verifier.hpp"
+
+#include <random>
+
+using namespace staq;
+using Gatelib = gates::ChannelRepr<int>;
+
+// Testing stabilizer simulation & Clifford equivalence checking
+
+/******************************************************************************/
+TEST(Stabilizer, Measurement) {
+    std::mt19937_64 gen(1);
+    tools::Tableau ghz(1000);
+    ghz.h(0);
+    for (auto i = 0; i + 1 < 1000; i++)
+        ghz.cx(i, i + 1);
+
+    auto first = ghz.measure(0, gen);
+    for (auto i = 1; i < 1000; i++)
+        EXPECT_EQ(ghz.measure(i, gen), first);
+    EXPECT_EQ(ghz.measure(0, gen), first);
+
+    tools::Tableau one(2);
+    one.x(1);
+    one.h(0);
+    one.s(0);
+    one.s(0);
+    one.h(0);
+    EXPECT_TRUE(one.measure(0, gen));
+    EXPECT_TRUE(one.measure(1, gen));
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Stabilizer, Channel_Clifford) {
+    tools::Tableau native(3);
+    native.h(0);
+    native.cx(0, 1);
+    native.sdg(2);
+    native.cz(2, 0);
+
+    tools::Tableau channel(3);
+    channel.apply(Gatelib::Clifford::h(0));
+    channel.apply(Gatelib::Clifford::cnot(0, 1));
+    channel.apply(Gatelib::Clifford::sdg(2));
+    channel.apply(Gatelib::Clifford::h(0) * Gatelib::Clifford::cnot(2, 0) *
+                  Gatelib::Clifford::h(0));
+    EXPECT_EQ(native, channel);
+
+    tools::Tableau plus(1);
+    plus.h(0);
+    EXPECT_EQ(plus.stabilizer(0), Gatelib::Pauli::x(0));
+    EXPECT_EQ(plus.destabilizer(0), Gatelib::Pauli::z(0));
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Stabilizer, Identities) {
+    auto check = [](std::string a, std::string b) {
+        std::string header = "OPENQASM 2.0;\n"
+                             "include \"qelib1.inc\";\n"
+                             "qreg q[2];\n";
+        auto p = parser::parse_string(header + a, "a.qasm");
+        auto q = parser::parse_string(header + b, "b.qasm");
+        return tools::check_equivalence(*p, *q).equivalent;
+    };
+
+    EXPECT_TRUE(
+        check("h q[0]; s q[0]; h q[0];", "sdg q[0]; h q[0]; sdg q[0];"));
+    EXPECT_TRUE(check("cz q[0],q[1];", "h q[1]; cx q[0],q[1]; h q[1];"));
+    EXPECT_TRUE(check("swap q[0],q[1];", "cx q[1],q[0]; cx q[0],q[1]; "
+                                         "cx q[1],q[0];"));
+    EXPECT_TRUE(check("y q[0];", "x q[0]; z q[0];"));
+    EXPECT_TRUE(check("U(pi/2,0,pi) q[0];", "h q[0];"));
+    EXPECT_FALSE(check("s q[0];", "sdg q[0];"));
+    EXPECT_FALSE(check("cx q[0],q[1];", "cx q[1],q[0];"));
+    EXPECT_FALSE(check("x q[0];", "x q[1];"));
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Stabilizer, Wide_Equivalence) {
+    std::mt19937 gen(2);
+    std::uniform_int_distribution<int> qubit(0, 1999);
+    std::string src = "OPENQASM 2.0;\n"
+                      "include \"qelib1.inc\";\n"
+                      "qreg q[2000];\n";
+    for (auto i = 0; i < 10000; i++) {
+        auto a = std::to_string(qubit(gen));
+        auto b = std::to_string(qubit(gen));
+        switch (i % 5) {
+            case 0:
+                src += "h q[" + a + "];\n";
+                break;
+            case 1:
+                src += "s q[" + a + "];\n";
+                break;
+            case 2:
+                // Cancelled by simplification
+                src += "h q[" + a + "];\nh q[" + a + "];\n";
+                break;
+            default:
+                if (a != b)
+                    src += "cx q[" + a + "],q[" + b + "];\n";
+        }
+    }
+
+    auto prog = parser::parse_string(src, "wide.qasm");
+    auto simplified = parser::parse_string(src, "wide.qasm");
+    optimization::simplify(*simplified);
+    auto result = tools::check_equivalence(*prog, *simplified);
+    EXPECT_TRUE(result.equivalent);
+    EXPECT_EQ(result.num_qubits, 2000);
+
+    auto modified = parser::parse_string(src + "s q[1000];\n", "wide.qasm");
+    EXPECT_FALSE(tools::check_equivalence(*prog, *modified).equivalent);
+}
+/******************************************************************************/
@@ -251,3 +251,38 @@ TEST(Inline, Mixed_Ancilla) {
     EXPECT_EQ(ss.str(), post);
 }
 /******************************************************************************/
+
+/******************************************************************************/
+TEST(Inline, Repeated_Call) {
+    std::string pre = "OPENQASM 2.0;\n"
+                      "\n"
+                      "gate foo(x) a,b {\n"
+                      "\tCX a,b;\n"
+                      "\tU(0,0,x) b;\n"
+                      "}\n"
+                      "qreg q[2];\n"
+                      "qreg r[1];\n"
+                      "foo(pi) q[0],q[1];\n"
+                      "foo(pi/2) q[1],r[0];\n";
+
+    std::string post = "OPENQASM 2.0;\n"
+                       "\n"
+                       "gate foo(x) a,b {\n"
+                       "\tCX a,b;\n"
+                       "\tU(0,0,x) b;\n"
+                       "}\n"
+                       "qreg q[2];\n"
+                       "qreg r[1];\n"
+                       "CX q[0],q[1];\n"
+                       "U(0,0,pi) q[1];\n"
+                       "CX q[1],r[0];\n"
+                       "U(0,0,pi/2) r[0];\n";
+
+    auto program = parser::parse_string(pre, "repeated_call.qasm");
+    transformations::inline_ast(*program);
+    std::stringstream ss;
+    ss << *program;
+
+    EXPECT_EQ(ss.str(), post);
+}
+/******************************************************************************/
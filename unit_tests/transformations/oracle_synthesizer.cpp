@@ -0,0 +1,298 @@
+/*
+ * This file is part of staq.
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gtest/gtest.h"
+#include "parser/parser.hpp"
+#include "transformations/oracle_synthesizer.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace staq;
+
+// Testing oracle synthesis & the on-disk cache of synthesized oracles
+//
+// Logic synthesis libraries aren't safe to include in more than one
+// translation unit, so all oracle tests live here
+
+static std::string synthesize(const std::string& src,
+                              transformations::OracleSynthesizer::config params,
+                              synthesis::oracle_cache::statistics& stats) {
+    auto prog = parser::parse_string(src, "oracle.qasm");
+    stats = transformations::synthesize_oracles(*prog, params);
+    std::stringstream ss;
+    ss << *prog;
+    return ss.str();
+}
+
+/******************************************************************************/
+TEST(Oracle_Cache, Reuse) {
+    auto dir = std::filesystem::temp_directory_path() / "staq_oracle_cache";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    auto fname = (dir / "and3.v").string();
+    std::ofstream(fname) << "module top ( a, b, c, d );\n"
+                            "  input a, b, c;\n"
+                            "  output d;\n"
+                            "  assign d = a & b & c;\n"
+                            "endmodule\n";
+
+    auto oracle = [&fname](const std::string& params) {
+        return "OPENQASM 2.0;\n"
+               "oracle and3 " +
+               params + " { \"" + fname + "\" }\n";
+    };
+    transformations::OracleSynthesizer::config params{
+        (dir / "cache").string()};
+    synthesis::oracle_cache::statistics stats;
+
+    auto fresh = synthesize(oracle("a,b,c,d"), {}, stats);
+    EXPECT_EQ(synthesize(oracle("a,b,c,d"), params, stats), fresh);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(synthesize(oracle("a,b,c,d"), params, stats), fresh);
+    EXPECT_EQ(stats.hits, 1);
+
+    // Other parameter names reuse the entry
+    auto renamed = synthesize(oracle("d,c,x,a"), {}, stats);
+    EXPECT_EQ(synthesize(oracle("d,c,x,a"), params, stats), renamed);
+    EXPECT_EQ(stats.hits, 1);
+
+    // A corrupted entry is evicted quietly & stored again
+    for (auto& entry : std::filesystem::directory_iterator(dir / "cache")) {
+        auto size = std::filesystem::file_size(entry.path());
+        std::filesystem::resize_file(entry.path(), size - 3);
+    }
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(synthesize(oracle("a,b,c,d"), params, stats), fresh);
+    EXPECT_EQ(testing::internal::GetCapturedStderr(), "");
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(synthesize(oracle("a,b,c,d"), params, stats), fresh);
+    EXPECT_EQ(stats.hits, 1);
+
+    // Changes to the file don't
+    std::ofstream(fname) << "module top ( a, b, c, d );\n"
+                            "  input a, b, c;\n"
+                            "  output d;\n"
+                            "  assign d = a & b | c;\n"
+                            "endmodule\n";
+    synthesize(oracle("a,b,c,d"), params, stats);
+    EXPECT_EQ(stats.misses, 1);
+
+    std::filesystem::remove_all(dir);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Oracle_Synthesis, Parallel) {
+    auto dir = std::filesystem::temp_directory_path() / "staq_oracles";
+    std::filesystem::create_directories(dir);
+
+    std::string src = "OPENQASM 2.0;\n"
+                      "qreg q[4];\n";
+    std::string ops[] = {"&", "|", "^", "& ~"};
+    for (auto i = 0; i < 8; i++) {
+        auto fname = (dir / ("f" + std::to_string(i) + ".v")).string();
+        std::ofstream(fname) << "module top ( a, b, c, d );\n"
+                                "  input a, b, c;\n"
+                                "  output d;\n"
+                                "  assign d = (a "
+                             << ops[i % 4] << " b) " << ops[(i / 4) % 4]
+                             << " c;\n"
+                                "endmodule\n";
+        src += "oracle o" + std::to_string(i) + " a,b,c,d { \"" + fname +
+               "\" }\n";
+        src += "o" + std::to_string(i) + " q[0],q[1],q[2],q[3];\n";
+    }
+
+    auto serial = parser::parse_string(src, "parallel.qasm");
+    transformations::synthesize_oracles(*serial);
+    auto parallel = parser::parse_string(src, "parallel.qasm");
+    transformations::OracleSynthesizer::config params;
+    params.num_threads = 4;
+    transformations::synthesize_oracles(*parallel, params);
+
+    std::stringstream expected, actual;
+    expected << *serial;
+    actual << *parallel;
+    EXPECT_EQ(actual.str(), expected.str());
+    EXPECT_EQ(actual.str().find("oracle"), std::string::npos);
+    EXPECT_LT(actual.str().find("gate o0"), actual.str().find("gate o7"));
+
+    std::filesystem::remove_all(dir);
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Oracle_Synthesis, Parallel_Error) {
+    std::string src = "OPENQASM 2.0;\n"
+                      "oracle o0 a,b { \"missing.v\" }\n"
+                      "oracle o1 a,b { \"missing.v\" }\n";
+
+    auto prog = parser::parse_string(src, "parallel_error.qasm");
+    transformations::OracleSynthesizer::config params;
+    params.num_threads = 2;
+    EXPECT_THROW(transformations::synthesize_oracles(*prog, params),
+                 ast::SemanticError);
+}
+/******************************************************************************/
+
+// Testing the readers of logic files
+
+static std::string write_file(const std::string& name,
+                              const std::string& contents) {
+    auto dir = std::filesystem::temp_directory_path() / "staq_formats";
+    std::filesystem::create_directories(dir);
+    auto fname = (dir / name).string();
+    std::ofstream(fname) << contents;
+    return fname;
+}
+
+static std::string truth_table(const std::string& fname) {
+    auto mig = synthesis::read_network(fname);
+    if (mig.num_pis() == 0 || mig.num_pos() != 1)
+        return "";
+    mockturtle::default_simulator<kitty::dynamic_truth_table> sim(
+        mig.num_pis());
+    return kitty::to_hex(mockturtle::simulate<kitty::dynamic_truth_table>(
+        mig, sim)[0]);
+}
+
+/******************************************************************************/
+TEST(Oracle_Synthesis, Formats) {
+    // (a & b) ^ ~(c | d), with a the least significant input
+    EXPECT_EQ(truth_table(write_file("f.v", "module top ( a, b, c, d, e );\n"
+                                            "  input a, b, c, d;\n"
+                                            "  output e;\n"
+                                            "  wire x, y;\n"
+                                            "  assign x = a & b;\n"
+                                            "  assign y = c | d;\n"
+                                            "  assign e = x ^ ~y;\n"
+                                            "endmodule\n")),
+              "8887");
+    EXPECT_EQ(truth_table(write_file("f.bench", "INPUT(a)\n"
+                                                "INPUT(b)\n"
+                                                "INPUT(c)\n"
+                                                "INPUT(d)\n"
+                                                "OUTPUT(e)\n"
+                                                "e = XOR(x, y)\n"
+                                                "x = AND(a, b)\n"
+                                                "y = NOR(c, d)\n")),
+              "8887");
+    EXPECT_EQ(truth_table(write_file("lut.bench", "INPUT(a)\n"
+                                                  "INPUT(b)\n"
+                                                  "INPUT(c)\n"
+                                                  "INPUT(d)\n"
+                                                  "OUTPUT(e)\n"
+                                                  "x = LUT 0x8 (a, b)\n"
+                                                  "e = LUT 0x9 (x, y)\n"
+                                                  "y = OR(c, d)\n")),
+              "8887");
+    EXPECT_EQ(truth_table(write_file("f.blif", ".model top\n"
+                                               ".inputs a b c d\n"
+                                               ".outputs e\n"
+                                               ".names x y e\n"
+                                               "10 1\n"
+                                               "01 1\n"
+                                               ".names a b x\n"
+                                               "11 1\n"
+                                               ".names c d y\n"
+                                               "1- 0\n"
+                                               "-1 0\n"
+                                               ".end\n")),
+              "8887");
+    EXPECT_EQ(truth_table(write_file("f.pla", ".i 4\n"
+                                              ".o 1\n"
+                                              "0000 1\n"
+                                              "1000 1\n"
+                                              "0100 1\n"
+                                              "1110 1\n"
+                                              "1101 1\n"
+                                              "1111 1\n"
+                                              ".e\n")),
+              "8887");
+
+    // Undefined signals are reported
+    EXPECT_EQ(truth_table(write_file("bad.blif", ".model top\n"
+                                                 ".inputs a\n"
+                                                 ".outputs e\n"
+                                                 ".names a z e\n"
+                                                 "11 1\n"
+                                                 ".end\n")),
+              "");
+
+    std::filesystem::remove_all(std::filesystem::temp_directory_path() /
+                                "staq_formats");
+}
+/******************************************************************************/
+
+/******************************************************************************/
+TEST(Oracle_Synthesis, Parameters) {
+    auto fname = write_file("and4.v", "module top ( a, b, c, d, e );\n"
+                                      "  input a, b, c, d;\n"
+                                      "  output e;\n"
+                                      "  assign e = a & b & c & d;\n"
+                                      "endmodule\n");
+    auto mig = synthesis::read_network(fname);
+    std::vector<ast::symbol> params{"a", "b", "c", "d", "e"};
+
+    auto cost = [&mig, &params](const synthesis::synthesis_params& ps) {
+        std::size_t t = 0;
+        std::size_t rotations = 0;
+        int ancillas = 0;
+        for (auto& gate :
+             synthesis::synthesize_net({}, mig, params, "anc", ps)) {
+            if (auto anc = dynamic_cast<ast::AncillaDecl*>(gate.get()))
+                ancillas += anc->size();
+            else if (auto dg = dynamic_cast<ast::DeclaredGate*>(gate.get())) {
+                t += dg->name() == "t" || dg->name() == "tdg";
+                rotations += dg->name() == "rz";
+            }
+        }
+        return std::make_tuple(ancillas, rotations, t);
+    };
+
+    synthesis::synthesis_params ps;
+    auto [ancillas, rotations, t] = cost(ps);
+    EXPECT_EQ(rotations, 0);
+
+    // An exhaustive search can't do worse than the defaults
+    ps.automatic = true;
+    ps.budget = 0;
+    ps.objective = synthesis::synthesis_objective::t_count;
+    auto [t_ancillas, t_rotations, t_t] = cost(ps);
+    EXPECT_EQ(t_rotations, 0);
+    EXPECT_LE(t_t, t);
+
+    ps.objective = synthesis::synthesis_objective::qubits;
+    EXPECT_LE(std::get<0>(cost(ps)), ancillas);
+
+    // A spent budget stops after the given parameters
+    ps.budget = 1e-9;
+    EXPECT_EQ(cost(ps), std::make_tuple(ancillas, rotations, t));
+
+    std::filesystem::remove_all(std::filesystem::temp_directory_path() /
+                                "staq_formats");
+}
+/******************************************************************************/